@@ -1,3 +1,14 @@
 #include "math/complex.h"
 #include "math/vector.h"
 #include "math/rotator.h"
+#include "math/vector_array.h"
+#include "math/quaternion_array.h"
+#include "math/simd_vector.h"
+#include "math/simd_quaternion.h"
+#include "math/transform.h"
+#include "math/aabb.h"
+#include "math/bvh.h"
+#include "math/fft.h"
+#include "math/fixed.h"
+#include "math/dual_quaternion.h"
+#include "math/quantized.h"
@@ -0,0 +1,2 @@
+#include "physics/rigid_body.h"
+#include "physics/broadphase.h"
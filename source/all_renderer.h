@@ -1 +1,3 @@
-#include "renderer/draw.h"
\ No newline at end of file
+#include "renderer/framebuffer.h"
+#include "renderer/rasterizer.h"
+#include "renderer/ray_tracer.h"
@@ -0,0 +1,3 @@
+#include "scene/transform_hierarchy.h"
+#include "scene/skinning.h"
+#include "scene/snapshot.h"
@@ -0,0 +1,129 @@
+#include "../all_math.h"
+#include "../core/allocators.h"
+#include "../core/parallel.h"
+#include "bench.h"
+#include <list>
+using namespace std;
+
+// Per frame scratch data on the default allocator against FrameArena,
+// ThreadArenas, FixedSizePool and ObjectPool. One op is one frame's worth of
+// work: building it, using it and (for the arenas) resetting. The arena rows
+// print the last frame's allocation counters.
+
+const size_t vertex_count = 10000;
+const size_t contact_lists = 1000;
+
+struct Contact {
+  Vector3<float> point, normal;
+  float depth;
+};
+
+struct Body {
+  Vector3<float> position, velocity;
+  QuaternionRotator<float> orientation;
+};
+
+// Vertices transformed into a buffer grown one push_back at a time
+template <class Buffer>
+void transformVertices(const vector<Vector3<float>>& vertices, const QuaternionRotator<float>& rot, Buffer& out) {
+  for (const Vector3<float>& v : vertices)
+    out.push_back(rot.rotate(v) + Vector3<float>(1.0f, 2.0f, 3.0f));
+}
+
+// Contact lists of 1 to 8 contacts each
+template <class List, class Make>
+void buildContacts(Make make) {
+  for (size_t c = 0; c < contact_lists; ++c) {
+    List contacts = make();
+    for (size_t k = 0; k <= c % 8; ++k) {
+      Contact contact = {Vector3<float>(float(k), float(c), 0.0f), Vector3<float>::up, 0.01f * float(k)};
+      contacts.push_back(contact);
+    }
+    doNotOptimize(contacts.back().depth);
+  }
+}
+
+void printStats(const AllocationStats& stats) {
+  cout << "  last frame: " << stats.allocations << " allocations, " << stats.bytes << " bytes, "
+       << stats.in_use << (stats.in_use == 1 ? " block\n" : " blocks\n");
+}
+
+int main(int argc, char** argv) {
+  BenchRunner bench(argc, argv);
+  vector<Vector3<float>> vertices(vertex_count);
+  for (size_t i = 0; i < vertex_count; ++i)
+    vertices[i] = Vector3<float>(float(i % 13), float(i % 7), float(i % 5));
+  QuaternionRotator<float> rot(0.7f, Vector3<float>(1.0f, 1.0f, 0.0f));
+  FrameArena arena;
+
+  bench.run<float>("transform 10k vertices, std::vector", [&](size_t) {
+    vector<Vector3<float>> out;
+    transformVertices(vertices, rot, out);
+    doNotOptimize(out.back());
+  });
+  bench.run<float>("transform 10k vertices, ArenaVector", [&](size_t) {
+    ArenaAllocator<Vector3<float>> allocator(arena);
+    ArenaVector<Vector3<float>> out(allocator);
+    transformVertices(vertices, rot, out);
+    doNotOptimize(out.back());
+    arena.reset();
+  });
+  printStats(arena.lastFrameStats());
+
+  bench.run<float>("1000 contact lists, std::vector", [&](size_t) {
+    buildContacts<vector<Contact>>([]() { return vector<Contact>(); });
+  });
+  bench.run<float>("1000 contact lists, ArenaVector", [&](size_t) {
+    buildContacts<ArenaVector<Contact>>([&]() { return ArenaVector<Contact>(ArenaAllocator<Contact>(arena)); });
+    arena.reset();
+  });
+  printStats(arena.lastFrameStats());
+
+  ThreadArenas thread_arenas;
+  unsigned threads = hardwareThreads();
+  string suffix = ", " + to_string(threads) + (threads == 1 ? " thread" : " threads");
+  bench.run<float>("contacts per chunk, std::vector" + suffix, [&](size_t) {
+    parallelChunks(threads, threads, 1, [&](size_t, size_t) {
+      buildContacts<vector<Contact>>([]() { return vector<Contact>(); });
+    });
+  });
+  bench.run<float>("contacts per chunk, ThreadArenas" + suffix, [&](size_t) {
+    parallelChunks(threads, threads, 1, [&](size_t, size_t) {
+      FrameArena& local = thread_arenas.local();
+      buildContacts<ArenaVector<Contact>>([&]() { return ArenaVector<Contact>(ArenaAllocator<Contact>(local)); });
+    });
+    thread_arenas.reset();
+  });
+  printStats(thread_arenas.lastFrameStats());
+
+  bench.run<float>("1000 list nodes, std::list", [&](size_t) {
+    list<Vector3<float>> nodes;
+    for (size_t i = 0; i < 1000; ++i)
+      nodes.push_back(vertices[i]);
+    doNotOptimize(nodes.back());
+  });
+  FixedSizePool node_pool;
+  bench.run<float>("1000 list nodes, PoolAllocator", [&](size_t) {
+    PoolAllocator<Vector3<float>> allocator(node_pool);
+    list<Vector3<float>, PoolAllocator<Vector3<float>>> nodes(allocator);
+    for (size_t i = 0; i < 1000; ++i)
+      nodes.push_back(vertices[i]);
+    doNotOptimize(nodes.back());
+  });
+
+  vector<Body*> bodies(1000);
+  bench.run<float>("1000 bodies, new and delete", [&](size_t) {
+    for (Body*& body : bodies)
+      body = new Body{vertices[0], vertices[1], rot};
+    for (Body* body : bodies)
+      delete body;
+  });
+  ObjectPool<Body> body_pool;
+  bench.run<float>("1000 bodies, ObjectPool", [&](size_t) {
+    for (Body*& body : bodies)
+      body = body_pool.create(Body{vertices[0], vertices[1], rot});
+    for (Body* body : bodies)
+      body_pool.destroy(body);
+  });
+  cout << "  pool: " << body_pool.capacity() << " slots, " << body_pool.live() << " live\n";
+}
@@ -0,0 +1,181 @@
+#if !defined(BENCH_H_INCLUDED)
+  #define BENCH_H_INCLUDED
+
+  #include <algorithm>
+  #include <chrono>
+  #include <fstream>
+  #include <iomanip>
+  #include <iostream>
+  #include <math.h>
+  #include <stdlib.h>
+  #include <string>
+  #include <string.h>
+  #include <vector>
+
+  // Keeps the compiler from discarding a result it can prove is unused
+  template <typename value_type>
+  inline void doNotOptimize(const value_type& value) {
+    #if defined(__GNUC__)
+      asm volatile("" : : "r"(&value) : "memory");
+    #else
+      static const volatile void* sink;
+      sink = &value;
+    #endif
+  }
+
+  template <typename num_type> struct TypeName { static const char* get() { return "unknown"; } };
+  template <> struct TypeName<float> { static const char* get() { return "float"; } };
+  template <> struct TypeName<double> { static const char* get() { return "double"; } };
+  template <> struct TypeName<long double> { static const char* get() { return "long double"; } };
+
+  struct BenchResult {
+    std::string name;
+    std::string type;
+    size_t iterations;
+    int repetitions;
+    double ns_median;
+    double ns_mean;
+    double ns_stddev;
+    double ns_min;
+  };
+
+  // Times op(i) for i = 0, 1, 2, ... after a warm-up, in batches sized to take about
+  // sample_ms each, and keeps per-batch statistics. op should index its inputs with
+  // i so that the work differs between calls, and pass its result to doNotOptimize.
+  // Usage: bench [--filter text] [--json file] [--label text] [--repetitions n]
+  //              [--sample-ms ms] [--warmup-ms ms]
+  class BenchRunner {
+    public :
+      std::string filter;
+      std::string json_path;
+      std::string label;
+      int repetitions;
+      double sample_ms;
+      double warmup_ms;
+
+      BenchRunner(int argc, char** argv) : repetitions(11), sample_ms(2), warmup_ms(5) {
+        for (int i = 1; i + 1 < argc; i += 2) {
+          if (strcmp(argv[i], "--filter") == 0)
+            filter = argv[i + 1];
+          else if (strcmp(argv[i], "--json") == 0)
+            json_path = argv[i + 1];
+          else if (strcmp(argv[i], "--label") == 0)
+            label = argv[i + 1];
+          else if (strcmp(argv[i], "--repetitions") == 0)
+            repetitions = std::max(1, atoi(argv[i + 1]));
+          else if (strcmp(argv[i], "--sample-ms") == 0)
+            sample_ms = atof(argv[i + 1]);
+          else if (strcmp(argv[i], "--warmup-ms") == 0)
+            warmup_ms = atof(argv[i + 1]);
+          else
+            std::cerr << "Unknown option " << argv[i] << "\n";
+        }
+        std::cout << std::setw(44) << std::left << "benchmark" << std::setw(13) << "type" << std::right
+                  << std::setw(12) << "ns/op" << std::setw(10) << "+-%" << std::setw(15) << "ops/s" << "\n";
+      }
+      ~BenchRunner() {
+        if (not json_path.empty())
+          writeJson();
+      }
+
+      bool enabled(const std::string& name) const {
+        return filter.empty() or name.find(filter) != std::string::npos;
+      }
+
+      template <typename num_type, class Op>
+      void run(const std::string& name, Op op) {
+        run(name, TypeName<num_type>::get(), op);
+      }
+      template <class Op>
+      void run(const std::string& name, const std::string& type, Op op) {
+        if (not enabled(name))
+          return;
+        typedef std::chrono::steady_clock clock;
+        size_t i = 0;
+
+        // Warm-up, also used to estimate how many calls fit in one sample
+        size_t calls = 0;
+        clock::time_point start = clock::now();
+        double elapsed = 0;
+        do {
+          for (size_t end = i + 64; i < end; ++i)
+            op(i);
+          calls += 64;
+          elapsed = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+        } while (elapsed < warmup_ms);
+        size_t iterations = std::max<size_t>(1, size_t(calls * sample_ms / elapsed));
+
+        std::vector<double> samples(repetitions);
+        for (int r = 0; r < repetitions; ++r) {
+          start = clock::now();
+          for (size_t end = i + iterations; i < end; ++i)
+            op(i);
+          samples[r] = std::chrono::duration<double, std::nano>(clock::now() - start).count() / iterations;
+        }
+
+        BenchResult result;
+        result.name = name;
+        result.type = type;
+        result.iterations = iterations;
+        result.repetitions = repetitions;
+        std::sort(samples.begin(), samples.end());
+        result.ns_min = samples[0];
+        result.ns_median = repetitions % 2 ? samples[repetitions / 2]
+                                           : (samples[repetitions / 2 - 1] + samples[repetitions / 2]) / 2;
+        double sum = 0, sqr_sum = 0;
+        for (int r = 0; r < repetitions; ++r)
+          sum += samples[r];
+        result.ns_mean = sum / repetitions;
+        for (int r = 0; r < repetitions; ++r)
+          sqr_sum += (samples[r] - result.ns_mean) * (samples[r] - result.ns_mean);
+        result.ns_stddev = repetitions > 1 ? sqrt(sqr_sum / (repetitions - 1)) : 0;
+        results.push_back(result);
+
+        std::cout << std::setw(44) << std::left << name << std::setw(13) << type << std::right << std::fixed
+                  << std::setprecision(3) << std::setw(12) << result.ns_median
+                  << std::setprecision(1) << std::setw(10) << 100 * result.ns_stddev / result.ns_mean
+                  << std::setprecision(0) << std::setw(15) << 1e9 / result.ns_median << "\n";
+      }
+
+      const std::vector<BenchResult>& getResults() const {
+        return results;
+      }
+
+    private :
+      std::vector<BenchResult> results;
+
+      static std::string escape(const std::string& s) {
+        std::string out;
+        for (char c : s) {
+          if (c == '"' or c == '\\')
+            out += '\\';
+          out += c;
+        }
+        return out;
+      }
+      void writeJson() const {
+        std::ofstream file(json_path.c_str());
+        if (not file) {
+          std::cerr << "Could not open " << json_path << "\n";
+          return;
+        }
+        file << std::setprecision(6);
+        file << "{\n  \"label\": \"" << escape(label) << "\",\n";
+        #if defined(__VERSION__)
+          file << "  \"compiler\": \"" << escape(__VERSION__) << "\",\n";
+        #endif
+        file << "  \"results\": [\n";
+        for (size_t i = 0; i < results.size(); ++i) {
+          const BenchResult& r = results[i];
+          file << "    {\"name\": \"" << escape(r.name) << "\", \"type\": \"" << escape(r.type)
+               << "\", \"ns_per_op\": " << r.ns_median << ", \"ns_mean\": " << r.ns_mean
+               << ", \"ns_stddev\": " << r.ns_stddev << ", \"ns_min\": " << r.ns_min
+               << ", \"ops_per_second\": " << 1e9 / r.ns_median << ", \"iterations\": " << r.iterations
+               << ", \"repetitions\": " << r.repetitions << "}" << (i + 1 < results.size() ? ",\n" : "\n");
+        }
+        file << "  ]\n}\n";
+        std::cout << "Wrote " << results.size() << " results to " << json_path << "\n";
+      }
+  };
+
+#endif
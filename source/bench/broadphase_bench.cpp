@@ -0,0 +1,95 @@
+#include "../all_math.h"
+#include "../all_physics.h"
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Milliseconds per frame (update plus findPairs) of both broadphases at 10k, 100k
+// and 1M moving spheres at constant density, one thread and all hardware threads.
+// Build with e.g. g++ -std=c++17 -O2 -march=native -pthread broadphase_bench.cpp
+
+struct Scene {
+  Vector3Array<float> positions;
+  vector<float> radii;
+  vector<float> vx, vy, vz;
+  unsigned seed;
+
+  explicit Scene(size_t n) : positions(n), radii(n), vx(n), vy(n), vz(n), seed(12345) {
+    // About 8 cubic units per object, radii from 0.25 to 0.5
+    float side = float(cbrt(8.0 * n));
+    for (size_t i = 0; i < n; ++i) {
+      positions.set(i, Vector3<float>(side * random(), side * random(), side * random()));
+      radii[i] = 0.25f + 0.25f * random();
+      vx[i] = 0.04f * random() - 0.02f;
+      vy[i] = 0.04f * random() - 0.02f;
+      vz[i] = 0.04f * random() - 0.02f;
+    }
+  }
+  float random() {
+    seed = seed * 1664525u + 1013904223u;
+    return float(seed >> 8) / float(1 << 24);
+  }
+  void step() {
+    for (size_t i = 0; i < radii.size(); ++i) {
+      positions.x[i] += vx[i];
+      positions.y[i] += vy[i];
+      positions.z[i] += vz[i];
+    }
+  }
+};
+
+template <class BroadphaseType>
+void time(const string& name, BroadphaseType& broadphase, Scene& scene, unsigned threads, int frames) {
+  vector<BroadphasePair> pairs;
+  broadphase.update(scene.positions, scene.radii.data(), threads);
+  broadphase.findPairs(pairs, threads);
+  double total = 0;
+  for (int f = 0; f < frames; ++f) {
+    scene.step();
+    auto start = chrono::steady_clock::now();
+    broadphase.update(scene.positions, scene.radii.data(), threads);
+    broadphase.findPairs(pairs, threads);
+    total += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+  }
+  size_t n = scene.radii.size();
+  cout << setw(26) << left << name << setw(10) << right << n << setw(9) << threads << fixed
+       << setprecision(3) << setw(14) << total / frames << setprecision(1) << setw(14) << total / frames * 1e6 / n
+       << setw(12) << pairs.size() << "\n";
+}
+
+int main() {
+  cout << setw(26) << left << "broadphase" << setw(10) << right << "objects" << setw(9) << "threads"
+       << setw(14) << "ms/frame" << setw(14) << "ns/object" << setw(12) << "pairs" << "\n";
+  size_t counts[] = {10000, 100000, 1000000};
+  unsigned thread_counts[] = {1, hardwareThreads()};
+  for (size_t n : counts) {
+    int frames = n >= 1000000 ? 3 : 10;
+    for (unsigned threads : thread_counts) {
+      Scene hash_scene(n), sap_scene(n);
+      SpatialHashBroadphase<float> hash(1.0f);
+      SweepAndPruneBroadphase<float> sap;
+      time("SpatialHashBroadphase", hash, hash_scene, threads, frames);
+      time("SweepAndPruneBroadphase", sap, sap_scene, threads, frames);
+      if (threads == hardwareThreads())
+        break;
+    }
+    if (n == 10000) {
+      // The O(n^2) loop this replaces
+      Scene scene(n);
+      auto start = chrono::steady_clock::now();
+      size_t found = 0;
+      for (size_t i = 0; i < n; ++i)
+        for (size_t j = i + 1; j < n; ++j) {
+          float s = scene.radii[i] + scene.radii[j];
+          if (scene.positions[i].from(scene.positions[j]).sqrMagnitude() < s * s)
+            ++found;
+        }
+      double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+      cout << setw(26) << left << "all pairs" << setw(10) << right << n << setw(9) << 1 << fixed
+           << setprecision(3) << setw(14) << ms << setprecision(1) << setw(14) << ms * 1e6 / n << setw(12) << found << "\n";
+    }
+  }
+}
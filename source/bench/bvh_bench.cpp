@@ -0,0 +1,110 @@
+#include "../all_math.h"
+#include "../core/parallel.h"
+#include "bench.h"
+using namespace std;
+
+// BVH build, refit and queries over 100k and 1M small boxes scattered through a
+// cube, as from a triangle soup. One op is one build, one refit or one query, so
+// the ops/s column of the query rows is rays (or segments, spheres, boxes) per
+// second on one core. The linear scan row is what raycast replaces.
+
+unsigned seed = 12345;
+
+float random01() {
+  seed = seed * 1664525u + 1013904223u;
+  return float(seed >> 8) / float(1 << 24);
+}
+
+vector<AABB<float>> sampleBoxes(size_t n) {
+  float side = float(cbrt(double(n))) * 4;
+  vector<AABB<float>> boxes(n);
+  for (size_t i = 0; i < n; ++i) {
+    Vector3<float> c(side * random01(), side * random01(), side * random01());
+    Vector3<float> e(0.2f + random01(), 0.2f + random01(), 0.2f + random01());
+    boxes[i] = AABB<float>::fromCenterExtents(c, e);
+  }
+  return boxes;
+}
+
+int main(int argc, char** argv) {
+  BenchRunner bench(argc, argv);
+  size_t counts[] = {100000, 1000000};
+  for (size_t n : counts) {
+    vector<AABB<float>> boxes = sampleBoxes(n);
+    float side = float(cbrt(double(n))) * 4;
+    string suffix = ", " + to_string(n / 1000) + "k boxes";
+    BVH<float> bvh;
+
+    unsigned thread_counts[] = {1, hardwareThreads()};
+    for (unsigned threads : thread_counts) {
+      bench.run<float>("build, " + to_string(threads) + (threads == 1 ? " thread" : " threads") + suffix,
+                       [&](size_t) { bvh.build(boxes, threads); });
+      if (threads == hardwareThreads())
+        break;
+    }
+    bvh.build(boxes);
+    cout << bvh.nodeCount() << " nodes\n";
+
+    vector<AABB<float>> moved(boxes);
+    bench.run<float>("refit" + suffix, [&](size_t i) {
+      float d = (i & 1) ? 0.01f : -0.01f;
+      for (AABB<float>& box : moved) {
+        box.min.x += d;
+        box.max.x += d;
+      }
+      bvh.refit(moved);
+    });
+    bvh.build(boxes);
+
+    // Rays from random points inside the cube in random directions
+    const size_t ray_count = 4096;
+    vector<Vector3<float>> origins(ray_count), directions(ray_count), ends(ray_count);
+    for (size_t r = 0; r < ray_count; ++r) {
+      origins[r] = Vector3<float>(side * random01(), side * random01(), side * random01());
+      directions[r] = Vector3<float>(random01() - 0.5f, random01() - 0.5f, random01() - 0.5f).normalized();
+      ends[r] = origins[r] + directions[r] * (side / 4);
+    }
+    bench.run<float>("raycast" + suffix, [&](size_t i) {
+      doNotOptimize(bvh.raycast(origins[i % ray_count], directions[i % ray_count]));
+    });
+    bench.run<float>("raycast, sphere callback" + suffix, [&](size_t i) {
+      const Vector3<float>& o = origins[i % ray_count];
+      const Vector3<float>& d = directions[i % ray_count];
+      doNotOptimize(bvh.raycast(o, d, numeric_limits<float>::infinity(), [&](uint32_t p, float t_max) {
+        // Sphere inscribed in the box
+        Vector3<float> m = o.from(boxes[p].center());
+        float r = boxes[p].halfExtents().x;
+        float b = m.dotProduct(d), c = m.sqrMagnitude() - r * r;
+        float disc = b * b - c;
+        if (disc < 0)
+          return t_max;
+        float t = -b - sqrt(disc);
+        return t >= 0 ? t : t_max;
+      }));
+    });
+    bench.run<float>("segmentCast" + suffix, [&](size_t i) {
+      doNotOptimize(bvh.segmentCast(origins[i % ray_count], ends[i % ray_count]));
+    });
+    vector<uint32_t> found;
+    bench.run<float>("overlapSphere, radius 4" + suffix, [&](size_t i) {
+      found.clear();
+      doNotOptimize(bvh.overlapSphere(origins[i % ray_count], 4.0f, found));
+    });
+    bench.run<float>("overlapBox, half extent 4" + suffix, [&](size_t i) {
+      found.clear();
+      doNotOptimize(bvh.overlapBox(AABB<float>::fromCenterExtents(origins[i % ray_count], Vector3<float>(4.0f)), found));
+    });
+    if (n == counts[0])
+      bench.run<float>("linear scan raycast" + suffix, [&](size_t i) {
+        const Vector3<float>& d = directions[i % ray_count];
+        Vector3<float> inv(1 / d.x, 1 / d.y, 1 / d.z);
+        float best = numeric_limits<float>::infinity();
+        for (const AABB<float>& box : boxes) {
+          float t = 0;
+          if (box.intersectRay(origins[i % ray_count], inv, t, best))
+            best = t;
+        }
+        doNotOptimize(best);
+      });
+  }
+}
@@ -0,0 +1,78 @@
+#include "../all_math.h"
+#include "bench.h"
+#include <stdio.h>
+#include <vector>
+using namespace std;
+
+// Rotator composition: AngleAxisRotator::compose on single rotators, and
+// composeChain against a left to right fold of compose over chains of
+// chain_length joints, for every rotator type. Chain rows are per link.
+
+const size_t chain_length = 256;
+
+template <class RotatorType>
+void benchChain(BenchRunner& bench, const char* name, const vector<RotatorType>& rots) {
+  typedef typename RotatorType::value_type num_type;
+  typedef Vector3<num_type> V3;
+  // Against rotating through every link in turn
+  V3 v(num_type(0.3), num_type(-1), num_type(2)), expected = v;
+  RotatorType fold = rots[0];
+  for (size_t k = 0; k < chain_length; ++k)
+    expected = rots[k].rotate(expected);
+  for (size_t k = 1; k < chain_length; ++k)
+    fold = fold.compose(rots[k]);
+  printf("%s %s chain of %zu, fold error %g, composeChain error %g\n", TypeName<num_type>::get(), name, chain_length,
+         double((fold.rotate(v) - expected).magnitude()),
+         double((composeChain(rots.data(), chain_length).rotate(v) - expected).magnitude()));
+
+  char row[64];
+  snprintf(row, sizeof(row), "%s chain, compose fold", name);
+  bench.run<num_type>(row, [&](size_t i) {
+    if (i % chain_length == 0) {
+      RotatorType r = rots[0];
+      for (size_t k = 1; k < chain_length; ++k)
+        r = r.compose(rots[k]);
+      doNotOptimize(r);
+    }
+  });
+  snprintf(row, sizeof(row), "%s chain, composeChain", name);
+  bench.run<num_type>(row, [&](size_t i) {
+    if (i % chain_length == 0)
+      doNotOptimize(composeChain(rots.data(), chain_length));
+  });
+}
+
+template <typename num_type>
+void benchComposition(BenchRunner& bench) {
+  typedef Vector3<num_type> V3;
+  const size_t m = 1023;
+  vector<AngleAxisRotator<num_type>> aars(m + 1);
+  vector<QuaternionRotator<num_type>> quats(m + 1);
+  vector<RotationMatrix<num_type>> mats(m + 1);
+  for (size_t i = 0; i <= m; ++i) {
+    V3 axis(num_type(1), num_type(i % 5) - 2, num_type(i % 3) + num_type(0.5));
+    aars[i] = AngleAxisRotator<num_type>(num_type(i % 628) / 100 - num_type(3.1), axis.normalized());
+    quats[i] = QuaternionRotator<num_type>(aars[i]);
+    mats[i] = RotationMatrix<num_type>(aars[i]);
+  }
+
+  V3 v(num_type(0.3), num_type(-1), num_type(2));
+  double max_error = 0;
+  for (size_t i = 0; i < m; ++i) {
+    double e = (aars[i].compose(aars[i + 1]).rotate(v) - aars[i + 1].rotate(aars[i].rotate(v))).magnitude();
+    max_error = e > max_error ? e : max_error;
+  }
+  printf("%s AngleAxisRotator.compose max error %g\n", TypeName<num_type>::get(), max_error);
+  bench.run<num_type>("AngleAxisRotator.compose", [&](size_t i) { doNotOptimize(aars[i & m].compose(aars[(i + 1) & m])); });
+  bench.run<num_type>("QuaternionRotator.compose", [&](size_t i) { doNotOptimize(quats[i & m].compose(quats[(i + 1) & m])); });
+
+  benchChain(bench, "QuaternionRotator", quats);
+  benchChain(bench, "RotationMatrix", mats);
+  benchChain(bench, "AngleAxisRotator", aars);
+}
+
+int main(int argc, char** argv) {
+  BenchRunner bench(argc, argv);
+  benchComposition<float>(bench);
+  benchComposition<double>(bench);
+}
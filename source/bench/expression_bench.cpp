@@ -0,0 +1,138 @@
+#include "../all_math.h"
+#include "../math/expression.h"
+#include "bench.h"
+#include <stdio.h>
+#include <vector>
+using namespace std;
+
+// The opt-in expression layer of math/expression.h against the eager operators:
+// the rotator formulas on single values, and chains of Vector3Array kernels,
+// which make one pass and one temporary per step, against the same expressions
+// evaluated in one pass. The arrays fit in L2, so the batch rows measure the
+// passes rather than memory bandwidth. Batch rows are per element.
+
+const size_t element_count = 1 << 14;
+
+template <typename num_type>
+void benchExpressions(BenchRunner& bench) {
+  typedef Vector3<num_type> V3;
+  const size_t m = 1023;
+  vector<V3> vecs(m + 1);
+  vector<AngleAxisRotator<num_type>> aars(m + 1);
+  vector<QuaternionRotator<num_type>> quats(m + 1);
+  for (size_t i = 0; i <= m; ++i) {
+    vecs[i] = V3(num_type(i % 7), num_type(1), num_type(i % 3) - 1);
+    aars[i] = AngleAxisRotator<num_type>(num_type(i) / 100, V3(num_type(1), num_type(i % 5), num_type(2)));
+    quats[i] = QuaternionRotator<num_type>(aars[i]);
+  }
+  bench.run<num_type>("AngleAxisRotator.rotate", [&](size_t i) { doNotOptimize(aars[i & m].rotate(vecs[i & m])); });
+  // Rodrigues' formula as in AngleAxisRotator::rotate
+  bench.run<num_type>("AngleAxisRotator.rotate, lazy", [&](size_t i) {
+    const AngleAxisRotator<num_type>& rot = aars[i & m];
+    num_type mag = rot.axis.magnitude(), c = cos(rot.angle), s = sin(rot.angle);
+    auto axis = lazy(rot.axis);
+    auto v = lazy(vecs[i & m]);
+    doNotOptimize((v * (mag * c) + axis * axis.dotProduct(v) * ((1 - c) / mag) + axis.crossProduct(v) * s).eval());
+  });
+  bench.run<num_type>("QuaternionRotator.rotate", [&](size_t i) { doNotOptimize(quats[i & m].rotate(vecs[i & m])); });
+  bench.run<num_type>("QuaternionRotator.rotate, lazy", [&](size_t i) {
+    auto q = lazy(quats[i & m]);
+    doNotOptimize((q * lazy(vecs[i & m]).pureQuaternion() * ~q).vectorPart().eval());
+  });
+
+  Vector3Array<num_type> p(element_count), v(element_count), a(element_count), out(element_count), lazy_out(element_count);
+  for (size_t i = 0; i < element_count; ++i) {
+    p.set(i, V3(num_type(i % 97), num_type(i % 89) / 2, num_type(i % 83) - 41));
+    v.set(i, V3(num_type(1), num_type(i % 7), num_type(0.5)));
+    a.set(i, V3(num_type(0), num_type(-9.8), num_type(i % 3)));
+  }
+  const num_type dt = num_type(1) / 64;
+
+  // Every batch row is checked against its eager counterpart first
+  auto check = [&](const char* name) {
+    double max_error = 0;
+    for (size_t i = 0; i < element_count; ++i) {
+      double e = (out.get(i) - lazy_out.get(i)).magnitude();
+      max_error = e > max_error ? e : max_error;
+    }
+    printf("%s %s, max difference %g\n", TypeName<num_type>::get(), name, max_error);
+  };
+
+  // out = p + v dt + a dt^2 / 2
+  auto integrate = [&]() {
+    p.multiplyAdd(v, dt, out);
+    out.multiplyAdd(a, dt * dt / 2, out);
+  };
+  auto integrate_lazy = [&]() { evaluate(lazy(p) + lazy(v) * dt + lazy(a) * (dt * dt / 2), lazy_out); };
+  // out = (v x a) dt + p - a
+  auto chain = [&]() {
+    v.crossProduct(a, out);
+    out.scale(dt, out);
+    out.add(p, out);
+    out.from(a, out);
+  };
+  auto chain_lazy = [&]() { evaluate(lazy(v).crossProduct(lazy(a)) * dt + lazy(p) - lazy(a), lazy_out); };
+  AngleAxisRotator<num_type> aar(num_type(0.8), V3(num_type(0), num_type(1), num_type(1)));
+  auto rodrigues = [&]() { aar.rotateMany(p, out); };
+  auto rodrigues_lazy = [&]() {
+    num_type mag = aar.axis.magnitude(), c = cos(aar.angle), s = sin(aar.angle);
+    auto axis = lazy(aar.axis);
+    auto vec = lazy(p);
+    evaluate(vec * (mag * c) + axis * axis.dotProduct(vec) * ((1 - c) / mag) + axis.crossProduct(vec) * s, lazy_out);
+  };
+  QuaternionRotator<num_type> quat(aar);
+  auto sandwich = [&]() { quat.rotateMany(p, out); };
+  auto sandwich_lazy = [&]() { evaluate((lazy(quat) * lazy(p).pureQuaternion() * ~lazy(quat)).vectorPart(), lazy_out); };
+
+  integrate(); integrate_lazy(); check("integrate");
+  chain(); chain_lazy(); check("chain");
+  rodrigues(); rodrigues_lazy(); check("Rodrigues");
+  sandwich(); sandwich_lazy(); check("q v q*");
+
+  bench.run<num_type>("integrate, Vector3Array kernels", [&](size_t i) {
+    if (i % element_count == 0)
+      integrate();
+    doNotOptimize(out.x[0]);
+  });
+  bench.run<num_type>("integrate, lazy", [&](size_t i) {
+    if (i % element_count == 0)
+      integrate_lazy();
+    doNotOptimize(lazy_out.x[0]);
+  });
+  bench.run<num_type>("cross chain, Vector3Array kernels", [&](size_t i) {
+    if (i % element_count == 0)
+      chain();
+    doNotOptimize(out.x[0]);
+  });
+  bench.run<num_type>("cross chain, lazy", [&](size_t i) {
+    if (i % element_count == 0)
+      chain_lazy();
+    doNotOptimize(lazy_out.x[0]);
+  });
+  bench.run<num_type>("AngleAxisRotator.rotateMany", [&](size_t i) {
+    if (i % element_count == 0)
+      rodrigues();
+    doNotOptimize(out.x[0]);
+  });
+  bench.run<num_type>("AngleAxisRotator Rodrigues, lazy", [&](size_t i) {
+    if (i % element_count == 0)
+      rodrigues_lazy();
+    doNotOptimize(lazy_out.x[0]);
+  });
+  bench.run<num_type>("QuaternionRotator.rotateMany", [&](size_t i) {
+    if (i % element_count == 0)
+      sandwich();
+    doNotOptimize(out.x[0]);
+  });
+  bench.run<num_type>("QuaternionRotator q v q*, lazy", [&](size_t i) {
+    if (i % element_count == 0)
+      sandwich_lazy();
+    doNotOptimize(lazy_out.x[0]);
+  });
+}
+
+int main(int argc, char** argv) {
+  BenchRunner bench(argc, argv);
+  benchExpressions<float>(bench);
+  benchExpressions<double>(bench);
+}
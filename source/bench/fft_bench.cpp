@@ -0,0 +1,70 @@
+#include "../math/fft.h"
+#include "bench.h"
+using namespace std;
+
+// FFTPlan and RealFFTPlan from 64 to 2^20 points, float and double. One op is one
+// transform; the plan is built outside the timing, as it's meant to be reused.
+// The multiply row at 64 points is the per-element Complex::multiply DFT the
+// plans replace.
+
+template <typename num_type>
+void benchSize(BenchRunner& bench, size_t n) {
+  typedef Complex<num_type> C;
+  string suffix = ", " + (n >= 1024 ? to_string(n / 1024) + "k" : to_string(n));
+  vector<C> in(n), out(n);
+  vector<num_type> re(n), im(n), out_re(n), out_im(n), samples(n);
+  for (size_t i = 0; i < n; ++i) {
+    in[i] = C(num_type(sin(0.1 * double(i))), num_type(cos(0.37 * double(i))));
+    re[i] = in[i].re;
+    im[i] = in[i].im;
+    samples[i] = in[i].re;
+  }
+  FFTPlan<num_type> plan(n);
+  bench.run<num_type>("forward interleaved" + suffix, [&](size_t) {
+    plan.forward(in.data(), out.data());
+    doNotOptimize(out[1].re);
+  });
+  bench.run<num_type>("forward in place" + suffix, [&](size_t) {
+    plan.forward(out.data());
+    doNotOptimize(out[1].re);
+  });
+  bench.run<num_type>("forward split" + suffix, [&](size_t) {
+    plan.forward(re.data(), im.data(), out_re.data(), out_im.data());
+    doNotOptimize(out_re[1]);
+  });
+  bench.run<num_type>("inverse interleaved" + suffix, [&](size_t) {
+    plan.inverse(in.data(), out.data());
+    doNotOptimize(out[1].re);
+  });
+  RealFFTPlan<num_type> real_plan(n);
+  bench.run<num_type>("real forward" + suffix, [&](size_t) {
+    real_plan.forward(samples.data(), out.data());
+    doNotOptimize(out[1].re);
+  });
+  bench.run<num_type>("real inverse" + suffix, [&](size_t) {
+    real_plan.inverse(out.data(), samples.data());
+    doNotOptimize(samples[1]);
+  });
+  if (n == 64) {
+    vector<C> w(n);
+    for (size_t k = 0; k < n; ++k)
+      w[k] = C(num_type(cos(-2 * M_PI * double(k) / double(n))), num_type(sin(-2 * M_PI * double(k) / double(n))));
+    bench.run<num_type>("DFT with Complex::multiply" + suffix, [&](size_t) {
+      for (size_t k = 0; k < n; ++k) {
+        C sum;
+        for (size_t j = 0; j < n; ++j)
+          sum += in[j].multiply(w[j * k % n]);
+        out[k] = sum;
+      }
+      doNotOptimize(out[1].re);
+    });
+  }
+}
+
+int main(int argc, char** argv) {
+  BenchRunner bench(argc, argv);
+  for (size_t n = 64; n <= (size_t(1) << 20); n *= 4) {
+    benchSize<float>(bench, n);
+    benchSize<double>(bench, n);
+  }
+}
@@ -0,0 +1,123 @@
+#include "../all_math.h"
+#include "bench.h"
+#include <stdio.h>
+using namespace std;
+
+// Fixed<16, 16> against float through the same math templates, and a replay
+// check: a 200 step simulation of spinning, drifting bodies is hashed bit by bit
+// for both types. fixed_bench_O0 is this file built at -O0; the Fixed checksums
+// of the two builds must be equal, while the float ones may differ with the
+// optimizer's contractions and the libm in use.
+
+typedef Fixed<16, 16> Fixed16;
+template <> struct TypeName<Fixed16> { static const char* get() { return "Fixed<16,16>"; } };
+
+const size_t body_count = 1024;
+const size_t table_size = 256;
+
+template <typename num_type>
+num_type sample(size_t i, int salt) {
+  return num_type(double((i * 2654435761u + salt * 40503u) % 2000) / 1000.0 - 1.0);
+}
+
+template <typename num_type>
+struct Bodies {
+  vector<Vector3<num_type>> position, velocity;
+  vector<QuaternionRotator<num_type>> orientation, spin;
+
+  Bodies() : position(body_count), velocity(body_count), orientation(body_count), spin(body_count) {
+    for (size_t i = 0; i < body_count; ++i) {
+      position[i] = Vector3<num_type>(sample<num_type>(i, 1), sample<num_type>(i, 2), sample<num_type>(i, 3));
+      velocity[i] = Vector3<num_type>(sample<num_type>(i, 4), sample<num_type>(i, 5), sample<num_type>(i, 6));
+      spin[i] = QuaternionRotator<num_type>(sample<num_type>(i, 7) / 10,
+                                            Vector3<num_type>(sample<num_type>(i, 8), sample<num_type>(i, 9), num_type(1)));
+    }
+  }
+  // Orientations advance by their spin and are renormalized, and positions move
+  // along the rotated velocity with a sine wobble
+  void step(size_t frame) {
+    num_type dt = num_type(1) / 60, phase = num_type(int(frame % 360)) / 57;
+    num_type wobble = sin(phase) * cos(phase / 2);
+    for (size_t i = 0; i < body_count; ++i) {
+      orientation[i] = orientation[i].compose(spin[i]).normalized();
+      position[i] += orientation[i].rotate(velocity[i]) * dt + Vector3<num_type>::up * (wobble * dt);
+    }
+  }
+};
+
+template <typename value_type>
+void hashBytes(uint64_t& hash, const value_type& value) {
+  const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&value);
+  for (size_t k = 0; k < sizeof(value); ++k)
+    hash = (hash ^ bytes[k]) * 1099511628211u;
+}
+
+// FNV-1a over every position and orientation after 200 steps, plus a batch
+// rotation and the angles between successive bodies
+template <typename num_type>
+uint64_t replayChecksum() {
+  Bodies<num_type> bodies;
+  for (size_t frame = 0; frame < 200; ++frame)
+    bodies.step(frame);
+  vector<Vector3<num_type>> rotated(body_count);
+  bodies.orientation[0].rotateMany(bodies.position.data(), rotated.data(), body_count);
+  uint64_t hash = 14695981039346656037u;
+  for (size_t i = 0; i < body_count; ++i) {
+    hashBytes(hash, bodies.position[i]);
+    hashBytes(hash, bodies.orientation[i].w);
+    hashBytes(hash, bodies.orientation[i].x);
+    hashBytes(hash, bodies.orientation[i].y);
+    hashBytes(hash, bodies.orientation[i].z);
+    hashBytes(hash, rotated[i]);
+    hashBytes(hash, bodies.position[i].angleTo(bodies.position[(i + 1) % body_count]));
+  }
+  return hash;
+}
+
+template <typename num_type>
+void benchType(BenchRunner& bench) {
+  typedef Vector3<num_type> V3;
+  vector<V3> a(table_size), b(table_size);
+  vector<num_type> s(table_size);
+  vector<QuaternionRotator<num_type>> q(table_size);
+  for (size_t i = 0; i < table_size; ++i) {
+    a[i] = V3(sample<num_type>(i, 1), sample<num_type>(i, 2), sample<num_type>(i, 3));
+    b[i] = V3(sample<num_type>(i, 4), sample<num_type>(i, 5), sample<num_type>(i, 6));
+    s[i] = sample<num_type>(i, 7) * 3;
+    q[i] = QuaternionRotator<num_type>(s[i], b[i]).normalized();
+  }
+  const size_t m = table_size - 1;
+
+  bench.run<num_type>("multiply add", [&](size_t i) { doNotOptimize(s[i & m] * s[(i + 1) & m] + s[(i + 2) & m]); });
+  bench.run<num_type>("divide", [&](size_t i) { doNotOptimize(s[i & m] / (s[(i + 1) & m] + num_type(4))); });
+  bench.run<num_type>("sqrt", [&](size_t i) { doNotOptimize(sqrt(s[i & m] + num_type(3))); });
+  bench.run<num_type>("sin + cos", [&](size_t i) { doNotOptimize(sin(s[i & m]) + cos(s[i & m])); });
+  bench.run<num_type>("acos", [&](size_t i) { doNotOptimize(acos(s[i & m] / 3)); });
+  bench.run<num_type>("Vector3.crossProduct", [&](size_t i) { doNotOptimize(a[i & m].crossProduct(b[i & m])); });
+  bench.run<num_type>("Vector3.normalized", [&](size_t i) { doNotOptimize(a[i & m].normalized()); });
+  bench.run<num_type>("Vector3.angleTo", [&](size_t i) { doNotOptimize(a[i & m].angleTo(b[i & m])); });
+  bench.run<num_type>("Quaternion.slerp", [&](size_t i) { doNotOptimize(q[i & m].slerp(q[(i + 1) & m], s[i & m] / 6 + num_type(0.5))); });
+  bench.run<num_type>("QuaternionRotator.fromAngleAxis", [&](size_t i) { doNotOptimize(QuaternionRotator<num_type>(s[i & m], a[i & m])); });
+  bench.run<num_type>("QuaternionRotator.rotate", [&](size_t i) { doNotOptimize(q[i & m].rotate(a[i & m])); });
+
+  vector<V3> vecs(body_count), out(body_count);
+  for (size_t i = 0; i < body_count; ++i)
+    vecs[i] = a[i & m];
+  bench.run<num_type>("QuaternionRotator.rotateMany 1024", [&](size_t i) {
+    q[i & m].rotateMany(vecs.data(), out.data(), body_count);
+    doNotOptimize(out[0]);
+  });
+  Bodies<num_type> bodies;
+  bench.run<num_type>("simulation step, 1024 bodies", [&](size_t i) {
+    bodies.step(i);
+    doNotOptimize(bodies.position[0]);
+  });
+}
+
+int main(int argc, char** argv) {
+  printf("float checksum %016llx\n", (unsigned long long)replayChecksum<float>());
+  printf("Fixed<16,16> checksum %016llx\n", (unsigned long long)replayChecksum<Fixed16>());
+  BenchRunner bench(argc, argv);
+  benchType<float>(bench);
+  benchType<Fixed16>(bench);
+}
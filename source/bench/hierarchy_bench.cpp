@@ -0,0 +1,76 @@
+#include "../all_math.h"
+#include "../all_scene.h"
+#include "bench.h"
+using namespace std;
+
+// One TransformHierarchy::update per op on a 100k node scene with varying
+// fractions of moved nodes, against recomposing every node's world pose up its
+// parent chain each frame. Also prints how many nodes each frame recomputed.
+
+const size_t node_count = 100000;
+const size_t branching = 8;
+
+typedef TransformHierarchy<float> Hierarchy;
+
+Pose<float> samplePose(size_t i) {
+  float a = float(i % 628) / 100;
+  return Pose<float>(QuaternionRotator<float>(a, Vector3<float>(1.0f, float(i % 3), 2.0f)),
+                     Vector3<float>(float(i % 7), 1.0f, float(i % 5)), 1.0f);
+}
+
+int main(int argc, char** argv) {
+  BenchRunner bench(argc, argv);
+  Hierarchy scene;
+  vector<Hierarchy::Node> nodes;
+  for (size_t i = 0; i < node_count; ++i)
+    nodes.push_back(scene.create(samplePose(i), i == 0 ? Hierarchy::none : nodes[(i - 1) / branching]));
+  scene.update();
+  cout << node_count << " nodes on " << scene.levels() << " levels, " << hardwareThreads() << " hardware threads\n";
+
+  unsigned thread_counts[] = {1, hardwareThreads()};
+  for (unsigned threads : thread_counts) {
+    string suffix = " " + to_string(threads) + (threads == 1 ? " thread" : " threads");
+    bench.run<float>("update, nothing moved" + suffix, [&](size_t) { doNotOptimize(scene.update(threads)); });
+    // Leaves are the last node_count - node_count / branching nodes
+    bench.run<float>("update, 1% of leaves moved" + suffix, [&](size_t i) {
+      for (size_t k = 0; k < node_count / 100; ++k)
+        scene.setLocal(nodes[node_count - 1 - (k * 97 + i) % (node_count - node_count / branching)], samplePose(k + i));
+      doNotOptimize(scene.update(threads));
+    });
+    bench.run<float>("update, 1% of non-root nodes moved" + suffix, [&](size_t i) {
+      for (size_t k = 0; k < node_count / 100; ++k)
+        scene.setLocal(nodes[1 + (k * 101 + i) % (node_count - 1)], samplePose(k + i));
+      doNotOptimize(scene.update(threads));
+    });
+    bench.run<float>("update, root moved" + suffix, [&](size_t i) {
+      scene.setLocal(nodes[0], samplePose(i));
+      doNotOptimize(scene.update(threads));
+    });
+    if (threads == hardwareThreads())
+      break;
+  }
+
+  // What the hierarchy replaces: compose up the parent chain for every node
+  vector<Pose<float>> world(node_count);
+  bench.run<float>("naive parent chain compose", [&](size_t) {
+    for (size_t n = 0; n < node_count; ++n) {
+      Pose<float> w = scene.local(nodes[n]);
+      for (Hierarchy::Node p = scene.parent(nodes[n]); p != Hierarchy::none; p = scene.parent(p))
+        w = scene.local(p).compose(w);
+      world[n] = w;
+    }
+    doNotOptimize(world[0]);
+  });
+
+  // Recomputed counts for one frame of each kind
+  scene.update();
+  cout << "recomputed, nothing moved: " << scene.update() << "\n";
+  for (size_t k = 0; k < node_count / 100; ++k)
+    scene.setLocal(nodes[node_count - 1 - k * 97 % (node_count - node_count / branching)], samplePose(k));
+  cout << "recomputed, 1% of leaves moved: " << scene.update() << "\n";
+  for (size_t k = 0; k < node_count / 100; ++k)
+    scene.setLocal(nodes[1 + k * 101 % (node_count - 1)], samplePose(k));
+  cout << "recomputed, 1% of non-root nodes moved: " << scene.update() << "\n";
+  scene.setLocal(nodes[0], samplePose(1));
+  cout << "recomputed, root moved: " << scene.update() << "\n";
+}
@@ -0,0 +1,78 @@
+#include "../all_math.h"
+#include "../all_physics.h"
+#include "../core/parallel.h"
+#include "bench.h"
+using namespace std;
+
+// Scaling of the JobSystem from 1 thread to every hardware thread, doubling in
+// between. Each row is one whole workload, so ops/s is workloads per second:
+//  - rotateMany over 1M vectors through parallelFor,
+//  - a RigidBodies step of 100k bodies, which goes through parallelChunks and
+//    so through the shared system,
+//  - a binary tree of 4096 tiny jobs with children, for scheduling overhead,
+//  - a chain of 256 continuations, which can't run in parallel at all.
+
+const size_t vector_count = 1000000;
+const size_t body_count = 100000;
+
+size_t tree(JobSystem& jobs, size_t depth) {
+  if (depth == 0)
+    return 1;
+  size_t left = 0;
+  JobHandle group = jobs.create(nullptr);
+  jobs.run(jobs.createChild(group, [&]() { left = tree(jobs, depth - 1); }));
+  size_t right = tree(jobs, depth - 1);
+  jobs.run(group);
+  jobs.wait(group);
+  return left + right;
+}
+
+int main(int argc, char** argv) {
+  BenchRunner bench(argc, argv);
+  vector<Vector3<float>> vecs(vector_count), out(vector_count);
+  for (size_t i = 0; i < vector_count; ++i)
+    vecs[i] = Vector3<float>(float(i % 97), float(i % 89) - 40, float(i % 83) / 7);
+  QuaternionRotator<float> rot(1.1f, Vector3<float>(1.0f, 2.0f, 3.0f));
+
+  RigidBodies<float> bodies;
+  for (size_t i = 0; i < body_count; ++i)
+    bodies.add(Vector3<float>(float(i % 100), float(i / 100 % 100), float(i / 10000)), QuaternionRotator<float>(float(i % 628) / 100, Vector3<float>(1.0f, float(i % 3), 2.0f)),
+               1.0f + float(i % 4), RigidBodies<float>::boxInertia(1.0f, Vector3<float>(0.5f, 1.0f, 0.25f)),
+               Vector3<float>(1.0f, 0.0f, 2.0f), Vector3<float>(0.1f, 0.2f, 0.3f));
+
+  vector<unsigned> thread_counts;
+  for (unsigned threads = 1; threads < hardwareThreads(); threads *= 2)
+    thread_counts.push_back(threads);
+  thread_counts.push_back(hardwareThreads());
+
+  for (unsigned threads : thread_counts) {
+    JobSystem jobs(threads);
+    string suffix = ", " + to_string(threads) + (threads == 1 ? " thread" : " threads");
+    bench.run<float>("parallelFor rotateMany 1M" + suffix, [&](size_t) {
+      jobs.parallelFor(0, vector_count, 0, [&](size_t begin, size_t end) {
+        rot.rotateMany(vecs.data() + begin, out.data() + begin, end - begin);
+      });
+      doNotOptimize(out[0]);
+    });
+    bench.run<float>("RigidBodies integrate 100k" + suffix, [&](size_t) {
+      bodies.integrate(1.0f / 120, threads);
+      doNotOptimize(bodies.position.x[0]);
+    });
+    bench.run<float>("job tree 4096 leaves" + suffix, [&](size_t) {
+      doNotOptimize(tree(jobs, 12));
+    });
+    bench.run<float>("continuation chain 256" + suffix, [&](size_t) {
+      size_t count = 0;
+      JobHandle first = jobs.create([&]() { ++count; }), last = first;
+      for (int k = 1; k < 256; ++k) {
+        JobHandle next = jobs.create([&]() { ++count; });
+        jobs.then(last, next);
+        jobs.run(next);
+        last = next;
+      }
+      jobs.run(first);
+      jobs.wait(last);
+      doNotOptimize(count);
+    });
+  }
+}
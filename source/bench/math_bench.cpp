@@ -0,0 +1,294 @@
+#include "../all_math.h"
+#include "bench.h"
+using namespace std;
+
+// Times every public operation in all_math.h for float, double and long double.
+// Inputs cycle through a small table so each call sees different data; the
+// reported ns/op includes the loop and table lookup (well under a nanosecond).
+
+const size_t table_size = 256;
+
+template <typename num_type>
+num_type sample(size_t i, int salt) {
+  return num_type(((i * 2654435761u + salt * 40503u) % 2000) / 1000.0 - 1.0);
+}
+
+template <typename num_type>
+void benchVectors(BenchRunner& bench) {
+  typedef Vector2<num_type> V2;
+  typedef Vector3<num_type> V3;
+  vector<V2> a2(table_size), b2(table_size);
+  vector<V3> a3(table_size), b3(table_size);
+  vector<num_type> s(table_size);
+  for (size_t i = 0; i < table_size; ++i) {
+    a2[i] = V2(sample<num_type>(i, 1), sample<num_type>(i, 2));
+    b2[i] = V2(sample<num_type>(i, 3), sample<num_type>(i, 4));
+    a3[i] = V3(sample<num_type>(i, 1), sample<num_type>(i, 2), sample<num_type>(i, 3));
+    b3[i] = V3(sample<num_type>(i, 4), sample<num_type>(i, 5), sample<num_type>(i, 6));
+    s[i] = sample<num_type>(i, 7) + num_type(2);
+  }
+  const size_t m = table_size - 1;
+  
+  bench.run<num_type>("Vector2.add", [&](size_t i) { doNotOptimize(a2[i & m] + b2[i & m]); });
+  bench.run<num_type>("Vector2.from", [&](size_t i) { doNotOptimize(a2[i & m] - b2[i & m]); });
+  bench.run<num_type>("Vector2.scale", [&](size_t i) { doNotOptimize(a2[i & m] * s[i & m]); });
+  bench.run<num_type>("Vector2.divide", [&](size_t i) { doNotOptimize(a2[i & m] / s[i & m]); });
+  bench.run<num_type>("Vector2.dotProduct", [&](size_t i) { doNotOptimize(a2[i & m].dotProduct(b2[i & m])); });
+  bench.run<num_type>("Vector2.crossProduct", [&](size_t i) { doNotOptimize(a2[i & m].crossProduct(b2[i & m])); });
+  bench.run<num_type>("Vector2.sqrMagnitude", [&](size_t i) { doNotOptimize(a2[i & m].sqrMagnitude()); });
+  bench.run<num_type>("Vector2.magnitude", [&](size_t i) { doNotOptimize(a2[i & m].magnitude()); });
+  bench.run<num_type>("Vector2.normalized", [&](size_t i) { doNotOptimize(a2[i & m].normalized()); });
+  bench.run<num_type>("Vector2.cheapNormalized", [&](size_t i) { doNotOptimize(a2[i & m].cheapNormalized()); });
+  bench.run<num_type>("Vector2.setMagnitude", [&](size_t i) { doNotOptimize(a2[i & m].setMagnitude(s[i & m])); });
+  bench.run<num_type>("Vector2.clamp", [&](size_t i) { doNotOptimize(a2[i & m].clamp(num_type(0.5))); });
+  bench.run<num_type>("Vector2.angleFrom", [&](size_t i) { doNotOptimize(a2[i & m].angleFrom(b2[i & m])); });
+  bench.run<num_type>("Vector2.equals", [&](size_t i) { doNotOptimize(a2[i & m] == b2[i & m]); });
+  bench.run<num_type>("Vector2.compare", [&](size_t i) { doNotOptimize(a2[i & m] < b2[i & m]); });
+  
+  bench.run<num_type>("Vector3.add", [&](size_t i) { doNotOptimize(a3[i & m] + b3[i & m]); });
+  bench.run<num_type>("Vector3.from", [&](size_t i) { doNotOptimize(a3[i & m] - b3[i & m]); });
+  bench.run<num_type>("Vector3.scale", [&](size_t i) { doNotOptimize(a3[i & m] * s[i & m]); });
+  bench.run<num_type>("Vector3.divide", [&](size_t i) { doNotOptimize(a3[i & m] / s[i & m]); });
+  bench.run<num_type>("Vector3.dotProduct", [&](size_t i) { doNotOptimize(a3[i & m].dotProduct(b3[i & m])); });
+  bench.run<num_type>("Vector3.crossProduct", [&](size_t i) { doNotOptimize(a3[i & m].crossProduct(b3[i & m])); });
+  bench.run<num_type>("Vector3.sqrMagnitude", [&](size_t i) { doNotOptimize(a3[i & m].sqrMagnitude()); });
+  bench.run<num_type>("Vector3.magnitude", [&](size_t i) { doNotOptimize(a3[i & m].magnitude()); });
+  bench.run<num_type>("Vector3.normalized", [&](size_t i) { doNotOptimize(a3[i & m].normalized()); });
+  bench.run<num_type>("Vector3.cheapNormalized", [&](size_t i) { doNotOptimize(a3[i & m].cheapNormalized()); });
+  bench.run<num_type>("Vector3.setMagnitude", [&](size_t i) { doNotOptimize(a3[i & m].setMagnitude(s[i & m])); });
+  bench.run<num_type>("Vector3.clamp", [&](size_t i) { doNotOptimize(a3[i & m].clamp(num_type(0.5))); });
+  bench.run<num_type>("Vector3.angleTo", [&](size_t i) { doNotOptimize(a3[i & m].angleTo(b3[i & m])); });
+  bench.run<num_type>("Vector3.equals", [&](size_t i) { doNotOptimize(a3[i & m] == b3[i & m]); });
+  bench.run<num_type>("Vector3.compare", [&](size_t i) { doNotOptimize(a3[i & m] < b3[i & m]); });
+  bench.run<num_type>("Vector3.subscript", [&](size_t i) { doNotOptimize(a3[i & m][int(i)]); });
+}
+
+template <typename num_type>
+void benchComplex(BenchRunner& bench) {
+  typedef Complex<num_type> C;
+  typedef Quaternion<num_type> Q;
+  vector<C> a(table_size), b(table_size);
+  vector<Q> p(table_size), q(table_size);
+  vector<num_type> s(table_size);
+  for (size_t i = 0; i < table_size; ++i) {
+    a[i] = C(sample<num_type>(i, 1), sample<num_type>(i, 2));
+    b[i] = C(sample<num_type>(i, 3), sample<num_type>(i, 4) + num_type(2));
+    p[i] = Q(sample<num_type>(i, 1), sample<num_type>(i, 2), sample<num_type>(i, 3), sample<num_type>(i, 4));
+    q[i] = Q(sample<num_type>(i, 5) + num_type(2), sample<num_type>(i, 6), sample<num_type>(i, 7), sample<num_type>(i, 8));
+    s[i] = sample<num_type>(i, 9) + num_type(2);
+  }
+  const size_t m = table_size - 1;
+  
+  bench.run<num_type>("Complex.add", [&](size_t i) { doNotOptimize(a[i & m] + b[i & m]); });
+  bench.run<num_type>("Complex.subtract", [&](size_t i) { doNotOptimize(a[i & m] - b[i & m]); });
+  bench.run<num_type>("Complex.multiply", [&](size_t i) { doNotOptimize(a[i & m] * b[i & m]); });
+  bench.run<num_type>("Complex.multiplyScalar", [&](size_t i) { doNotOptimize(a[i & m] * s[i & m]); });
+  bench.run<num_type>("Complex.divide", [&](size_t i) { doNotOptimize(a[i & m].divide(b[i & m])); });
+  bench.run<num_type>("Complex.divideScalar", [&](size_t i) { doNotOptimize(a[i & m] / s[i & m]); });
+  bench.run<num_type>("Complex.conjugate", [&](size_t i) { doNotOptimize(~a[i & m]); });
+  bench.run<num_type>("Complex.magnitude", [&](size_t i) { doNotOptimize(a[i & m].magnitude()); });
+  bench.run<num_type>("Complex.arg", [&](size_t i) { doNotOptimize(a[i & m].arg()); });
+  bench.run<num_type>("Complex.normalized", [&](size_t i) { doNotOptimize(a[i & m].normalized()); });
+  bench.run<num_type>("Complex.cheapNormalized", [&](size_t i) { doNotOptimize(a[i & m].cheapNormalized()); });
+  
+  bench.run<num_type>("Quaternion.add", [&](size_t i) { doNotOptimize(p[i & m] + q[i & m]); });
+  bench.run<num_type>("Quaternion.subtract", [&](size_t i) { doNotOptimize(p[i & m] - q[i & m]); });
+  bench.run<num_type>("Quaternion.multiply", [&](size_t i) { doNotOptimize(p[i & m] * q[i & m]); });
+  bench.run<num_type>("Quaternion.multiplyScalar", [&](size_t i) { doNotOptimize(p[i & m] * s[i & m]); });
+  bench.run<num_type>("Quaternion.divideScalar", [&](size_t i) { doNotOptimize(p[i & m].divide(s[i & m])); });
+  bench.run<num_type>("Quaternion.conjugate", [&](size_t i) { doNotOptimize(~p[i & m]); });
+  bench.run<num_type>("Quaternion.inverse", [&](size_t i) { doNotOptimize(q[i & m].inverse()); });
+  bench.run<num_type>("Quaternion.magnitude", [&](size_t i) { doNotOptimize(p[i & m].magnitude()); });
+  bench.run<num_type>("Quaternion.normalized", [&](size_t i) { doNotOptimize(p[i & m].normalized()); });
+  bench.run<num_type>("Quaternion.cheapNormalized", [&](size_t i) { doNotOptimize(p[i & m].cheapNormalized()); });
+  
+  vector<Q> up(table_size), uq(table_size);
+  for (size_t i = 0; i < table_size; ++i) {
+    up[i] = p[i].normalized();
+    uq[i] = q[i].normalized();
+    s[i] = (sample<num_type>(i, 10) + 1) / 2;
+  }
+  bench.run<num_type>("Quaternion.nlerp", [&](size_t i) { doNotOptimize(up[i & m].nlerp(uq[i & m], s[i & m])); });
+  bench.run<num_type>("Quaternion.slerp", [&](size_t i) { doNotOptimize(up[i & m].slerp(uq[i & m], s[i & m])); });
+  bench.run<num_type>("Quaternion.slerp<Fast>", [&](size_t i) { doNotOptimize(up[i & m].template slerp<FastPrecision>(uq[i & m], s[i & m])); });
+  bench.run<num_type>("Quaternion.fastSlerp", [&](size_t i) { doNotOptimize(up[i & m].fastSlerp(uq[i & m], s[i & m])); });
+}
+
+template <class RotatorType, typename num_type>
+void benchRotator(BenchRunner& bench, const string& name, const vector<RotatorType>& rots, const vector<Vector3<num_type>>& vecs) {
+  const size_t m = table_size - 1;
+  bench.run<num_type>(name + ".rotate", [&](size_t i) { doNotOptimize(rots[i & m] * vecs[i & m]); });
+  bench.run<num_type>(name + ".unrotate", [&](size_t i) { doNotOptimize(rots[i & m].unrotate(vecs[i & m])); });
+  bench.run<num_type>(name + ".compose", [&](size_t i) { doNotOptimize(rots[i & m] * rots[(i + 1) & m]); });
+  bench.run<num_type>(name + ".inverse", [&](size_t i) { doNotOptimize(rots[i & m].inverse()); });
+  bench.run<num_type>(name + ".normalized", [&](size_t i) { doNotOptimize(rots[i & m].normalized()); });
+  bench.run<num_type>(name + ".rotateFromTo", [&](size_t i) {
+    doNotOptimize(rots[i & m].rotateFromTo(vecs[i & m], vecs[(i + 1) & m]));
+  });
+  // Per point cost of the batch path
+  const size_t batch = 1024;
+  vector<Vector3<num_type>> points(batch), out(batch);
+  for (size_t i = 0; i < batch; ++i)
+    points[i] = vecs[i & m];
+  Vector3Array<num_type> soa(points.data(), batch), soa_out(batch);
+  bench.run<num_type>(name + ".rotateMany(AoS) per point", [&](size_t i) {
+    if (i % batch == 0)
+      rots[(i / batch) & m].rotateMany(points.data(), out.data(), batch);
+    doNotOptimize(out[0]);
+  });
+  bench.run<num_type>(name + ".rotateMany(SoA) per point", [&](size_t i) {
+    if (i % batch == 0)
+      rots[(i / batch) & m].rotateMany(soa, soa_out);
+    doNotOptimize(soa_out.x[0]);
+  });
+}
+
+template <typename num_type>
+void benchRotators(BenchRunner& bench) {
+  vector<Vector3<num_type>> vecs(table_size);
+  vector<QuaternionRotator<num_type>> quats(table_size);
+  vector<RotationMatrix<num_type>> mats(table_size);
+  vector<AngleAxisRotator<num_type>> aars(table_size);
+  for (size_t i = 0; i < table_size; ++i) {
+    vecs[i] = Vector3<num_type>(sample<num_type>(i, 1), sample<num_type>(i, 2), sample<num_type>(i, 3) + num_type(2));
+    Vector3<num_type> axis(sample<num_type>(i, 4), sample<num_type>(i, 5), sample<num_type>(i, 6) + num_type(2));
+    num_type angle = 3 * sample<num_type>(i, 7);
+    quats[i] = QuaternionRotator<num_type>(angle, axis).normalized();
+    mats[i] = RotationMatrix<num_type>(angle, axis.normalized());
+    aars[i] = AngleAxisRotator<num_type>(angle, axis.normalized());
+  }
+  const size_t m = table_size - 1;
+  
+  benchRotator(bench, "QuaternionRotator", quats, vecs);
+  benchRotator(bench, "RotationMatrix", mats, vecs);
+  benchRotator(bench, "AngleAxisRotator", aars, vecs);
+  
+  bench.run<num_type>("RotationMatrix.fromEuler", [&](size_t i) {
+    doNotOptimize(RotationMatrix<num_type>(vecs[i & m].x, vecs[i & m].y, vecs[i & m].z));
+  });
+  bench.run<num_type>("RotationMatrix.fromAngleAxis", [&](size_t i) { doNotOptimize(RotationMatrix<num_type>(aars[i & m])); });
+  bench.run<num_type>("RotationMatrix.toAngleAxis", [&](size_t i) { doNotOptimize(AngleAxisRotator<num_type>(mats[i & m])); });
+  bench.run<num_type>("QuaternionRotator.fromAngleAxis", [&](size_t i) { doNotOptimize(QuaternionRotator<num_type>(aars[i & m])); });
+  bench.run<num_type>("QuaternionRotator.fromMatrix", [&](size_t i) { doNotOptimize(QuaternionRotator<num_type>(mats[i & m])); });
+  bench.run<num_type>("QuaternionRotator.toAngleAxis", [&](size_t i) { doNotOptimize(AngleAxisRotator<num_type>(quats[i & m])); });
+  bench.run<num_type>("QuaternionRotator.toMatrix", [&](size_t i) { doNotOptimize(RotationMatrix<num_type>(quats[i & m])); });
+}
+
+template <typename num_type>
+void benchArrays(BenchRunner& bench) {
+  // Per element cost of the Vector3Array kernels
+  const size_t n = 4096;
+  Vector3Array<num_type> a(n), b(n), out(n);
+  vector<num_type> scalars(n);
+  for (size_t i = 0; i < n; ++i) {
+    a.set(i, Vector3<num_type>(sample<num_type>(i, 1), sample<num_type>(i, 2), sample<num_type>(i, 3)));
+    b.set(i, Vector3<num_type>(sample<num_type>(i, 4), sample<num_type>(i, 5), sample<num_type>(i, 6)));
+  }
+  bench.run<num_type>("Vector3Array.add per element", [&](size_t i) { if (i % n == 0) a.add(b, out); doNotOptimize(out.x[0]); });
+  bench.run<num_type>("Vector3Array.scale per element", [&](size_t i) { if (i % n == 0) a.scale(num_type(2), out); doNotOptimize(out.x[0]); });
+  bench.run<num_type>("Vector3Array.multiplyAdd per element", [&](size_t i) { if (i % n == 0) a.multiplyAdd(b, num_type(0.5), out); doNotOptimize(out.x[0]); });
+  bench.run<num_type>("Vector3Array.dotProduct per element", [&](size_t i) { if (i % n == 0) a.dotProduct(b, scalars.data()); doNotOptimize(scalars[0]); });
+  bench.run<num_type>("Vector3Array.crossProduct per element", [&](size_t i) { if (i % n == 0) a.crossProduct(b, out); doNotOptimize(out.x[0]); });
+  bench.run<num_type>("Vector3Array.sqrMagnitude per element", [&](size_t i) { if (i % n == 0) a.sqrMagnitude(scalars.data()); doNotOptimize(scalars[0]); });
+  bench.run<num_type>("Vector3Array.normalized per element", [&](size_t i) { if (i % n == 0) a.normalized(out); doNotOptimize(out.x[0]); });
+  bench.run<num_type>("Vector3Array.clamp per element", [&](size_t i) { if (i % n == 0) a.clamp(num_type(0.5), out); doNotOptimize(out.x[0]); });
+  
+  QuaternionArray<num_type> p(n), q(n), qout(n);
+  for (size_t i = 0; i < n; ++i) {
+    p.set(i, Quaternion<num_type>(sample<num_type>(i, 1), sample<num_type>(i, 2), sample<num_type>(i, 3), sample<num_type>(i, 4) + 2).normalized());
+    q.set(i, Quaternion<num_type>(sample<num_type>(i, 5), sample<num_type>(i, 6) + 2, sample<num_type>(i, 7), sample<num_type>(i, 8)).normalized());
+    scalars[i] = (sample<num_type>(i, 9) + 1) / 2;
+  }
+  bench.run<num_type>("QuaternionArray.multiply per element", [&](size_t i) { if (i % n == 0) p.multiply(q, qout); doNotOptimize(qout.w[0]); });
+  bench.run<num_type>("QuaternionArray.normalized per element", [&](size_t i) { if (i % n == 0) p.normalized(qout); doNotOptimize(qout.w[0]); });
+  bench.run<num_type>("QuaternionArray.nlerp per element", [&](size_t i) { if (i % n == 0) p.nlerp(q, scalars.data(), qout); doNotOptimize(qout.w[0]); });
+  bench.run<num_type>("QuaternionArray.slerp per element", [&](size_t i) { if (i % n == 0) p.slerp(q, scalars.data(), qout); doNotOptimize(qout.w[0]); });
+  bench.run<num_type>("QuaternionArray.fastSlerp per element", [&](size_t i) { if (i % n == 0) p.fastSlerp(q, scalars.data(), qout); doNotOptimize(qout.w[0]); });
+}
+
+template <typename num_type>
+void benchTransforms(BenchRunner& bench) {
+  vector<Matrix4x4<num_type>> mats(table_size);
+  vector<Vector3<num_type>> vecs(table_size);
+  for (size_t i = 0; i < table_size; ++i) {
+    Vector3<num_type> t(sample<num_type>(i, 1), sample<num_type>(i, 2), sample<num_type>(i, 3));
+    Vector3<num_type> scale(sample<num_type>(i, 4) + num_type(2), sample<num_type>(i, 5) + num_type(2), num_type(1));
+    mats[i] = Matrix4x4<num_type>(RotationMatrix<num_type>(t.x, t.y, t.z), t, scale);
+    vecs[i] = Vector3<num_type>(sample<num_type>(i, 6), sample<num_type>(i, 7), sample<num_type>(i, 8));
+  }
+  const size_t m = table_size - 1;
+  
+  bench.run<num_type>("Matrix4x4.multiply", [&](size_t i) { doNotOptimize(mats[i & m] * mats[(i + 1) & m]); });
+  bench.run<num_type>("Matrix4x4.affineInverse", [&](size_t i) { doNotOptimize(mats[i & m].affineInverse()); });
+  bench.run<num_type>("Matrix4x4.transformPoint", [&](size_t i) { doNotOptimize(mats[i & m].transformPoint(vecs[i & m])); });
+  bench.run<num_type>("Matrix4x4.transformDirection", [&](size_t i) { doNotOptimize(mats[i & m].transformDirection(vecs[i & m])); });
+  bench.run<num_type>("Matrix4x4.fromRotationMatrix", [&](size_t i) {
+    doNotOptimize(Matrix4x4<num_type>(RotationMatrix<num_type>(), vecs[i & m], vecs[(i + 1) & m]));
+  });
+  const size_t batch = 1024;
+  vector<Vector3<num_type>> points(batch), out(batch);
+  for (size_t i = 0; i < batch; ++i)
+    points[i] = vecs[i & m];
+  Vector3Array<num_type> soa(points.data(), batch), soa_out(batch);
+  bench.run<num_type>("Matrix4x4.transformPoints(AoS) per point", [&](size_t i) {
+    if (i % batch == 0)
+      mats[(i / batch) & m].transformPoints(points.data(), out.data(), batch);
+    doNotOptimize(out[0]);
+  });
+  bench.run<num_type>("Matrix4x4.transformPoints(SoA) per point", [&](size_t i) {
+    if (i % batch == 0)
+      mats[(i / batch) & m].transformPoints(soa, soa_out);
+    doNotOptimize(soa_out.x[0]);
+  });
+}
+
+void benchSimd(BenchRunner& bench) {
+  // Float only, to compare against the Vector3<float> and Quaternion<float> rows
+  vector<SimdVector3> a(table_size), b(table_size);
+  vector<SimdQuaternion> p(table_size), q(table_size);
+  vector<float> s(table_size);
+  for (size_t i = 0; i < table_size; ++i) {
+    a[i] = SimdVector3(sample<float>(i, 1), sample<float>(i, 2), sample<float>(i, 3));
+    b[i] = SimdVector3(sample<float>(i, 4), sample<float>(i, 5), sample<float>(i, 6));
+    p[i] = SimdQuaternion(sample<float>(i, 1), sample<float>(i, 2), sample<float>(i, 3), sample<float>(i, 4));
+    q[i] = SimdQuaternion(sample<float>(i, 5) + 2, sample<float>(i, 6), sample<float>(i, 7), sample<float>(i, 8));
+    s[i] = sample<float>(i, 9) + 2;
+  }
+  const size_t m = table_size - 1;
+  
+  bench.run<float>("SimdVector3.add", [&](size_t i) { doNotOptimize(a[i & m] + b[i & m]); });
+  bench.run<float>("SimdVector3.from", [&](size_t i) { doNotOptimize(a[i & m] - b[i & m]); });
+  bench.run<float>("SimdVector3.scale", [&](size_t i) { doNotOptimize(a[i & m] * s[i & m]); });
+  bench.run<float>("SimdVector3.divide", [&](size_t i) { doNotOptimize(a[i & m] / s[i & m]); });
+  bench.run<float>("SimdVector3.dotProduct", [&](size_t i) { doNotOptimize(a[i & m].dotProduct(b[i & m])); });
+  bench.run<float>("SimdVector3.crossProduct", [&](size_t i) { doNotOptimize(a[i & m].crossProduct(b[i & m])); });
+  bench.run<float>("SimdVector3.sqrMagnitude", [&](size_t i) { doNotOptimize(a[i & m].sqrMagnitude()); });
+  bench.run<float>("SimdVector3.magnitude", [&](size_t i) { doNotOptimize(a[i & m].magnitude()); });
+  bench.run<float>("SimdVector3.normalized", [&](size_t i) { doNotOptimize(a[i & m].normalized()); });
+  bench.run<float>("SimdVector3.clamp", [&](size_t i) { doNotOptimize(a[i & m].clamp(0.5f)); });
+  
+  bench.run<float>("SimdQuaternion.add", [&](size_t i) { doNotOptimize(p[i & m] + q[i & m]); });
+  bench.run<float>("SimdQuaternion.multiply", [&](size_t i) { doNotOptimize(p[i & m] * q[i & m]); });
+  bench.run<float>("SimdQuaternion.conjugate", [&](size_t i) { doNotOptimize(~p[i & m]); });
+  bench.run<float>("SimdQuaternion.inverse", [&](size_t i) { doNotOptimize(q[i & m].inverse()); });
+  bench.run<float>("SimdQuaternion.magnitude", [&](size_t i) { doNotOptimize(p[i & m].magnitude()); });
+  bench.run<float>("SimdQuaternion.normalized", [&](size_t i) { doNotOptimize(p[i & m].normalized()); });
+  bench.run<float>("SimdQuaternion.rotate", [&](size_t i) { doNotOptimize(p[i & m].rotate(a[i & m])); });
+}
+
+template <typename num_type>
+void benchAll(BenchRunner& bench) {
+  benchVectors<num_type>(bench);
+  benchComplex<num_type>(bench);
+  benchRotators<num_type>(bench);
+  benchTransforms<num_type>(bench);
+  benchArrays<num_type>(bench);
+}
+
+int main(int argc, char** argv) {
+  BenchRunner bench(argc, argv);
+  benchAll<float>(bench);
+  benchSimd(bench);
+  benchAll<double>(bench);
+  benchAll<long double>(bench);
+}
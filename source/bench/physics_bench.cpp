@@ -0,0 +1,47 @@
+#include "../all_math.h"
+#include "../all_physics.h"
+#include "bench.h"
+using namespace std;
+
+// Cost per body of one RigidBodies step, single-threaded and across all
+// hardware threads. ops/s / 1000 is bodies per millisecond.
+
+const size_t body_count = 100000;
+
+template <typename num_type>
+void benchIntegrators(BenchRunner& bench) {
+  RigidBodies<num_type> bodies;
+  for (size_t i = 0; i < body_count; ++i) {
+    num_type a = num_type(i % 628) / 100;
+    bodies.add(Vector3<num_type>(num_type(i % 100), num_type(i / 100 % 100), num_type(i / 10000)),
+               QuaternionRotator<num_type>(a, Vector3<num_type>(num_type(1), num_type(i % 3), num_type(2))),
+               i % 50 == 0 ? num_type(0) : num_type(1 + i % 4),
+               RigidBodies<num_type>::boxInertia(num_type(1 + i % 4), Vector3<num_type>(num_type(0.5), num_type(1), num_type(0.25))),
+               Vector3<num_type>(num_type(1), num_type(0), num_type(2)), Vector3<num_type>(num_type(0.1), num_type(0.2), a));
+  }
+  const num_type dt = num_type(1) / 120;
+  unsigned thread_counts[] = {1, hardwareThreads()};
+  for (unsigned threads : thread_counts) {
+    string suffix = " " + to_string(threads) + (threads == 1 ? " thread" : " threads");
+    bench.run<num_type>("integrate per body" + suffix, [&](size_t i) {
+      if (i % body_count == 0)
+        bodies.integrate(dt, threads);
+      doNotOptimize(bodies.position.x[0]);
+    });
+    bench.run<num_type>("integrateVerlet per body" + suffix, [&](size_t i) {
+      if (i % body_count == 0) {
+        bodies.applyForce(i / body_count % body_count, Vector3<num_type>(num_type(1), num_type(0), num_type(0)));
+        bodies.integrateVerlet(dt, threads);
+      }
+      doNotOptimize(bodies.position.x[0]);
+    });
+    if (threads == hardwareThreads())
+      break;
+  }
+}
+
+int main(int argc, char** argv) {
+  BenchRunner bench(argc, argv);
+  benchIntegrators<float>(bench);
+  benchIntegrators<double>(bench);
+}
@@ -0,0 +1,79 @@
+#include "../all_math.h"
+#include "bench.h"
+using namespace std;
+
+// Maximum error of each precision policy against long double libm, and the cost
+// of each function against libm. The error table in math/precision.h comes
+// from this program.
+
+const size_t table_size = 1024;
+
+template <typename num_type, class precision>
+void printErrors(const char* policy) {
+  long double rsqrt_err = 0, sin_err = 0, cos_err = 0, acos_err = 0;
+  for (int i = 1; i <= 1000000; ++i) {
+    // Reciprocal square root over several decades, relative error
+    num_type x = num_type(pow(10.0L, -6 + 12.0L * i / 1000000));
+    long double r = precision::reciprocalSquareRoot(x);
+    long double exact = 1 / sqrtl((long double)x);
+    rsqrt_err = max(rsqrt_err, fabsl(r - exact) / exact);
+    
+    num_type a = num_type(-100 + 200.0L * i / 1000000);
+    num_type s, c;
+    precision::sineCosine(a, s, c);
+    sin_err = max(sin_err, fabsl(s - sinl((long double)a)));
+    cos_err = max(cos_err, fabsl(c - cosl((long double)a)));
+    
+    num_type u = num_type(-1 + 2.0L * i / 1000000);
+    acos_err = max(acos_err, fabsl(precision::arcCosine(u) - acosl((long double)u)));
+  }
+  cout << setw(18) << left << policy << setw(13) << TypeName<num_type>::get() << right << scientific << setprecision(2)
+       << setw(12) << rsqrt_err << setw(12) << sin_err << setw(12) << cos_err << setw(12) << acos_err << "\n";
+}
+
+template <typename num_type, class precision>
+void benchPolicy(BenchRunner& bench, const string& policy, const vector<num_type>& positive, const vector<num_type>& angles,
+                 const vector<num_type>& unit, const vector<Vector3<num_type>>& vecs) {
+  const size_t m = table_size - 1;
+  bench.run<num_type>(policy + ".reciprocalSquareRoot", [&](size_t i) { doNotOptimize(precision::reciprocalSquareRoot(positive[i & m])); });
+  bench.run<num_type>(policy + ".sine", [&](size_t i) { doNotOptimize(precision::sine(angles[i & m])); });
+  bench.run<num_type>(policy + ".cosine", [&](size_t i) { doNotOptimize(precision::cosine(angles[i & m])); });
+  bench.run<num_type>(policy + ".arcCosine", [&](size_t i) { doNotOptimize(precision::arcCosine(unit[i & m])); });
+  bench.run<num_type>(policy + " Vector3.normalized", [&](size_t i) {
+    doNotOptimize(vecs[i & m].template normalized<precision>());
+  });
+  bench.run<num_type>(policy + " RotationMatrix.fromEuler", [&](size_t i) {
+    doNotOptimize(RotationMatrix<num_type>::template fromEuler<precision>(angles[i & m], angles[(i + 1) & m], angles[(i + 2) & m]));
+  });
+}
+
+template <typename num_type>
+void benchType(BenchRunner& bench) {
+  vector<num_type> positive(table_size), angles(table_size), unit(table_size);
+  vector<Vector3<num_type>> vecs(table_size);
+  for (size_t i = 0; i < table_size; ++i) {
+    positive[i] = num_type(0.01 + i * 0.37);
+    angles[i] = num_type(-10 + 20.0 * i / table_size);
+    unit[i] = num_type(-1 + 2.0 * i / table_size);
+    vecs[i] = Vector3<num_type>(angles[i], unit[i], positive[i]);
+  }
+  benchPolicy<num_type, ExactPrecision>(bench, "ExactPrecision", positive, angles, unit, vecs);
+  benchPolicy<num_type, FastPrecision>(bench, "FastPrecision", positive, angles, unit, vecs);
+  benchPolicy<num_type, FastestPrecision>(bench, "FastestPrecision", positive, angles, unit, vecs);
+}
+
+int main(int argc, char** argv) {
+  cout << "Maximum error: reciprocalSquareRoot relative over [1e-6, 1e6], sine and cosine absolute over\n"
+       << "[-100, 100], arcCosine absolute over [-1, 1]\n";
+  cout << setw(18) << left << "policy" << setw(13) << "type" << right << setw(12) << "rsqrt" << setw(12) << "sine"
+       << setw(12) << "cosine" << setw(12) << "arcCosine" << "\n";
+  printErrors<float, FastPrecision>("FastPrecision");
+  printErrors<float, FastestPrecision>("FastestPrecision");
+  printErrors<double, FastPrecision>("FastPrecision");
+  printErrors<double, FastestPrecision>("FastestPrecision");
+  cout << "\n" << defaultfloat;
+  
+  BenchRunner bench(argc, argv);
+  benchType<float>(bench);
+  benchType<double>(bench);
+}
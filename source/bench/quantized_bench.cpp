@@ -0,0 +1,102 @@
+#include "../all_math.h"
+#include "bench.h"
+#include <stdio.h>
+#include <vector>
+using namespace std;
+
+// Keyframe buffers of a rotation and a position each, stored as full
+// QuaternionArray and Vector3Array, or packed with PackedQuaternion32 or
+// PackedQuaternion48 and PackedVector3 (in math/quantized.h). Decoding copies
+// the full buffers and unpacks the packed ones into the same working arrays.
+// The full buffers are larger than L2, so the decode rows include memory
+// traffic. Buffer rows are per keyframe.
+
+const size_t key_count = 1 << 18;
+
+template <class Packed, typename num_type>
+void benchPacked(BenchRunner& bench, const char* name, const QuaternionArray<num_type>& rotations,
+                 const vector<PackedVector3>& packed_positions, const AABB<num_type>& bounds,
+                 QuaternionArray<num_type>& out_rotations, Vector3Array<num_type>& out_positions) {
+  vector<Packed> packed(key_count);
+  packQuaternions(rotations, packed.data());
+  unpackQuaternions(packed.data(), key_count, out_rotations);
+  double max_angle = 0;
+  for (size_t i = 0; i < key_count; ++i) {
+    Quaternion<double> a(rotations.w[i], rotations.x[i], rotations.y[i], rotations.z[i]);
+    Quaternion<double> b(out_rotations.w[i], out_rotations.x[i], out_rotations.y[i], out_rotations.z[i]);
+    Quaternion<double> r = b.multiply(a.conjugate());
+    double angle = 2 * atan2(sqrt(r.x * r.x + r.y * r.y + r.z * r.z), fabs(r.w));
+    max_angle = angle > max_angle ? angle : max_angle;
+  }
+  printf("%s %s: %zu bytes per keyframe, max angle error %g degrees\n", TypeName<num_type>::get(), name,
+         sizeof(Packed) + sizeof(PackedVector3), max_angle * 180 / 3.14159265358979);
+
+  char row[64];
+  snprintf(row, sizeof(row), "decode, %s", name);
+  bench.run<num_type>(row, [&](size_t i) {
+    if (i % key_count == 0) {
+      unpackQuaternions(packed.data(), key_count, out_rotations);
+      unpackVectors(packed_positions.data(), key_count, bounds, out_positions);
+    }
+    doNotOptimize(out_rotations.w[0]);
+  });
+  snprintf(row, sizeof(row), "encode, %s", name);
+  bench.run<num_type>(row, [&](size_t i) {
+    if (i % key_count == 0)
+      packQuaternions(rotations, packed.data());
+    doNotOptimize(packed[0]);
+  });
+  const size_t m = 1023;
+  snprintf(row, sizeof(row), "%s::unpack", name);
+  bench.run<num_type>(row, [&](size_t i) { doNotOptimize(packed[i & m].template unpack<num_type>()); });
+  snprintf(row, sizeof(row), "%s::pack", name);
+  bench.run<num_type>(row, [&](size_t i) { doNotOptimize(Packed::pack(rotations.get(i & m))); });
+}
+
+template <typename num_type>
+void benchQuantized(BenchRunner& bench) {
+  typedef Vector3<num_type> V3;
+  // A 20 m walk with turns and bobbing
+  QuaternionArray<num_type> rotations(key_count);
+  Vector3Array<num_type> positions(key_count);
+  for (size_t i = 0; i < key_count; ++i) {
+    num_type t = num_type(i) / num_type(key_count);
+    V3 axis(sin(num_type(i % 997)), num_type(1), cos(num_type(i % 991)));
+    rotations.set(i, QuaternionRotator<num_type>(num_type(i % 1571) / 250 - num_type(3.1), axis.normalized()));
+    positions.set(i, V3(20 * t - 10, num_type(1) + sin(num_type(i) / 50) / 10, 8 * sin(6 * t)));
+  }
+  AABB<num_type> bounds(V3(num_type(-10), num_type(0), num_type(-8)), V3(num_type(10), num_type(2), num_type(8)));
+  vector<PackedVector3> packed_positions(key_count);
+  packVectors(positions, bounds, packed_positions.data());
+  QuaternionArray<num_type> out_rotations(key_count);
+  Vector3Array<num_type> out_positions(key_count);
+  unpackVectors(packed_positions.data(), key_count, bounds, out_positions);
+  double max_error = 0;
+  for (size_t i = 0; i < key_count; ++i) {
+    double e = (positions.get(i) - out_positions.get(i)).magnitude();
+    max_error = e > max_error ? e : max_error;
+  }
+  printf("%s full: %zu bytes per keyframe; PackedVector3 over 20 x 2 x 16 m, max error %g m\n", TypeName<num_type>::get(),
+         4 * sizeof(num_type) + 3 * sizeof(num_type), max_error);
+
+  bench.run<num_type>("decode, full keyframes", [&](size_t i) {
+    if (i % key_count == 0) {
+      out_rotations = rotations;
+      out_positions = positions;
+    }
+    doNotOptimize(out_rotations.w[0]);
+  });
+  benchPacked<PackedQuaternion32>(bench, "PackedQuaternion32", rotations, packed_positions, bounds, out_rotations, out_positions);
+  benchPacked<PackedQuaternion48>(bench, "PackedQuaternion48", rotations, packed_positions, bounds, out_rotations, out_positions);
+  bench.run<num_type>("encode, PackedVector3", [&](size_t i) {
+    if (i % key_count == 0)
+      packVectors(positions, bounds, packed_positions.data());
+    doNotOptimize(packed_positions[0]);
+  });
+}
+
+int main(int argc, char** argv) {
+  BenchRunner bench(argc, argv);
+  benchQuantized<float>(bench);
+  benchQuantized<double>(bench);
+}
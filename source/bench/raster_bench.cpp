@@ -0,0 +1,77 @@
+#include "../all_math.h"
+#include "../all_renderer.h"
+#include "bench.h"
+#include <cstring>
+using namespace std;
+
+// Frames of 20k randomly placed and rotated cubes (240k triangles) seen in
+// perspective at 1280x720, on one thread and on every hardware thread. One op
+// is one render of the queued cubes; the breakdown after each row is from the
+// last frame. --ppm <path> saves that frame.
+
+unsigned seed = 12345;
+
+float random01() {
+  seed = seed * 1664525u + 1013904223u;
+  return float(seed >> 8) / float(1 << 24);
+}
+
+float randomRange(float low, float high) {
+  return low + (high - low) * random01();
+}
+
+void printStats(const RasterStats& stats) {
+  cout << "  " << stats.triangles << " triangles, " << stats.culled << " culled, " << stats.clipped << " clipped, "
+       << stats.pixels << " pixels, " << stats.blocks << " blocks (" << stats.blocks_rejected << " rejected by depth)\n"
+       << "  vertex " << stats.vertex_ms << " ms, setup " << stats.setup_ms << " ms, binning " << stats.binning_ms
+       << " ms, raster " << stats.raster_ms << " ms, " << stats.trianglesPerSecond() / 1e6 << "M triangles/s\n";
+}
+
+int main(int argc, char** argv) {
+  string ppm_path;
+  vector<char*> args(argv, argv + argc);
+  for (size_t i = 1; i + 1 < args.size(); ++i)
+    if (strcmp(args[i], "--ppm") == 0) {
+      ppm_path = args[i + 1];
+      args.erase(args.begin() + i, args.begin() + i + 2);
+      break;
+    }
+  BenchRunner bench(int(args.size()), args.data());
+
+  const int width = 1280, height = 720;
+  Vector3<float> cube[8] = {{-1, -1, -1}, {1, -1, -1}, {1, 1, -1}, {-1, 1, -1},
+                            {-1, -1, 1}, {1, -1, 1}, {1, 1, 1}, {-1, 1, 1}};
+  uint32_t indices[36] = {0, 2, 1, 0, 3, 2, 4, 5, 6, 4, 6, 7, 0, 1, 5, 0, 5, 4,
+                          2, 3, 7, 2, 7, 6, 1, 2, 6, 1, 6, 5, 0, 4, 7, 0, 7, 3};
+  Matrix4x4<float> view_projection = Matrix4x4<float>::perspective(1.0f, float(width) / height, 0.1f, 100.0f)
+                                   * Matrix4x4<float>::lookAt(Vector3<float>(0.0f, -12.0f, 3.0f), Vector3<float>(0.0f),
+                                                              Vector3<float>(0.0f, 0.0f, 1.0f));
+  Rasterizer rasterizer;
+  rasterizer.begin();
+  for (int k = 0; k < 20000; ++k) {
+    QuaternionRotator<float> rotation(randomRange(-4, 4), Vector3<float>(random01() - 0.5f, random01() - 0.5f, random01() - 0.5f));
+    Vector3<float> position(randomRange(-8, 8), randomRange(-12, 12), randomRange(-4, 4));
+    uint32_t colors[12];
+    for (int f = 0; f < 12; ++f)
+      colors[f] = packColor(uint8_t(60 + f * 15), uint8_t(k * 7), uint8_t(200 - f * 10));
+    rasterizer.draw(cube, 8, indices, 36, view_projection * Matrix4x4<float>(rotation, position, Vector3<float>(0.3f)), 0, colors);
+  }
+
+  Framebuffer framebuffer(width, height);
+  unsigned thread_counts[] = {1, hardwareThreads()};
+  for (unsigned threads : thread_counts) {
+    string name = "render 240k triangles, " + to_string(threads) + (threads == 1 ? " thread" : " threads");
+    if (not bench.enabled(name))
+      continue;
+    bench.run<float>(name, [&](size_t) {
+      framebuffer.clear(0x202020);
+      rasterizer.render(framebuffer, threads);
+    });
+    printStats(rasterizer.lastStats());
+    if (threads == hardwareThreads())
+      break;
+  }
+
+  if (not ppm_path.empty() and not framebuffer.savePPM(ppm_path))
+    cerr << "Can't write " << ppm_path << "\n";
+}
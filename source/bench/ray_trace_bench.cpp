@@ -0,0 +1,69 @@
+#include "../all_math.h"
+#include "../all_renderer.h"
+#include "bench.h"
+#include <cstring>
+using namespace std;
+
+// Passes of the RayTracer over 3000 cubes on a ground slab (36k triangles) at
+// 640x360, on one thread and on every hardware thread. One op is one pass, one
+// primary and up to one shadow ray per pixel; the counters after each row are
+// from the last pass. --ppm <path> saves the image after 16 more passes.
+
+unsigned seed = 12345;
+
+float random01() {
+  seed = seed * 1664525u + 1013904223u;
+  return float(seed >> 8) / float(1 << 24);
+}
+
+int main(int argc, char** argv) {
+  string ppm_path;
+  vector<char*> args(argv, argv + argc);
+  for (size_t i = 1; i + 1 < args.size(); ++i)
+    if (strcmp(args[i], "--ppm") == 0) {
+      ppm_path = args[i + 1];
+      args.erase(args.begin() + i, args.begin() + i + 2);
+      break;
+    }
+  BenchRunner bench(int(args.size()), args.data());
+
+  Vector3<float> cube[8] = {{-1, -1, -1}, {1, -1, -1}, {1, 1, -1}, {-1, 1, -1},
+                            {-1, -1, 1}, {1, -1, 1}, {1, 1, 1}, {-1, 1, 1}};
+  uint32_t indices[36] = {0, 2, 1, 0, 3, 2, 4, 5, 6, 4, 6, 7, 0, 1, 5, 0, 5, 4,
+                          2, 3, 7, 2, 7, 6, 1, 2, 6, 1, 6, 5, 0, 4, 7, 0, 7, 3};
+  RayTracer tracer;
+  tracer.begin();
+  tracer.draw(cube, 8, indices, 36, Matrix4x4<float>(RotationMatrix<float>(), Vector3<float>(0.0f, 0.0f, -1.0f),
+                                                     Vector3<float>(30.0f, 30.0f, 0.01f)), packColor(200, 200, 200));
+  for (int k = 0; k < 3000; ++k) {
+    QuaternionRotator<float> rotation(random01() * 6, Vector3<float>(random01(), random01(), random01()));
+    Vector3<float> position(random01() * 40 - 20, random01() * 40 - 20, random01() * 3);
+    tracer.draw(cube, 8, indices, 36, Matrix4x4<float>(rotation, position, Vector3<float>(0.4f)),
+                packColor(uint8_t(random01() * 255), uint8_t(random01() * 255), uint8_t(random01() * 255)));
+  }
+  tracer.build(hardwareThreads());
+  cout << tracer.triangleCount() << " triangles, BVH built in " << tracer.lastStats().build_ms << " ms\n";
+  tracer.setCamera(RayCamera::lookAt(Vector3<float>(0.0f, -30.0f, 12.0f), Vector3<float>(0.0f), Vector3<float>::up, 0.9f));
+
+  Framebuffer framebuffer(640, 360);
+  unsigned thread_counts[] = {1, hardwareThreads()};
+  for (unsigned threads : thread_counts) {
+    string name = "pass 640x360, " + to_string(threads) + (threads == 1 ? " thread" : " threads");
+    if (not bench.enabled(name))
+      continue;
+    bench.run<float>(name, [&](size_t) { tracer.renderPass(framebuffer, threads); });
+    const RayTraceStats& stats = tracer.lastStats();
+    cout << "  " << stats.primary_rays << " primary and " << stats.shadow_rays << " shadow rays in " << stats.packets
+         << " packets, " << stats.raysPerSecond() / 1e6 << "M rays/s\n";
+    if (threads == hardwareThreads())
+      break;
+  }
+
+  if (not ppm_path.empty()) {
+    tracer.reset();
+    for (int pass = 0; pass < 16; ++pass)
+      tracer.renderPass(framebuffer, hardwareThreads());
+    if (not framebuffer.savePPM(ppm_path))
+      cerr << "Can't write " << ppm_path << "\n";
+  }
+}
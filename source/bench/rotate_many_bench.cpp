@@ -0,0 +1,69 @@
+#include "../all_math.h"
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+using namespace std;
+
+// Throughput of rotateMany against the per-vector Rotator::operator*
+// Build with e.g. g++ -std=c++17 -O2 -march=native rotate_many_bench.cpp
+
+const size_t point_count = 1 << 16;
+const int repeats = 50;
+
+template <class Func>
+double nsPerPoint(Func func) {
+  func();
+  auto start = chrono::steady_clock::now();
+  for (int r = 0; r < repeats; ++r)
+    func();
+  auto end = chrono::steady_clock::now();
+  return chrono::duration<double, nano>(end - start).count() / (double(repeats) * point_count);
+}
+
+template <class RotatorType>
+void compare(const char* name, const RotatorType& rot, const vector<Vector3<float>>& points) {
+  vector<Vector3<float>> out(points.size()), batch_out(points.size());
+  Vector3Array<float> soa(points.data(), points.size()), soa_out;
+  
+  double single = nsPerPoint([&]() {
+    for (size_t i = 0; i < points.size(); ++i)
+      out[i] = rot * points[i];
+  });
+  double many = nsPerPoint([&]() {
+    rot.rotateMany(points.data(), batch_out.data(), points.size());
+  });
+  double lanes = nsPerPoint([&]() {
+    rot.rotateMany(soa, soa_out);
+  });
+  
+  float max_err = 0;
+  for (size_t i = 0; i < points.size(); ++i) {
+    float err = (out[i] - batch_out[i]).magnitude();
+    if (err > max_err)
+      max_err = err;
+  }
+  cout << setw(18) << left << name << right << fixed << setprecision(3)
+       << setw(12) << single << setw(12) << many << setw(12) << lanes
+       << setw(10) << setprecision(2) << single / many << "x"
+       << setw(10) << single / lanes << "x"
+       << "   max err " << scientific << setprecision(2) << max_err << "\n";
+}
+
+int main() {
+  vector<Vector3<float>> points(point_count);
+  for (size_t i = 0; i < point_count; ++i)
+    points[i] = Vector3<float>(float(i % 97) - 48, float(i % 89) * 0.5f, float(i % 83) - 41);
+  
+  QuaternionRotator<float> quat(1.2f, Vector3<float>(1, 2, 3));
+  quat = quat.normalized();
+  RotationMatrix<float> mat(0.3f, -0.7f, 1.1f);
+  AngleAxisRotator<float> aar(0.8f, Vector3<float>(0, 1, 1));
+  
+  cout << point_count << " points, ns per point\n";
+  cout << setw(18) << left << "rotator" << right << setw(12) << "operator*" << setw(12) << "many AoS"
+       << setw(12) << "many SoA" << setw(11) << "AoS gain" << setw(11) << "SoA gain" << "\n";
+  compare("QuaternionRotator", quat, points);
+  compare("RotationMatrix", mat, points);
+  compare("AngleAxisRotator", aar, points);
+}
@@ -0,0 +1,79 @@
+#include "../all_math.h"
+#include "bench.h"
+#include <stdio.h>
+#include <vector>
+using namespace std;
+
+// Conversions between QuaternionRotator and RotationMatrix: the closed forms on
+// single rotators, the old route through AngleAxisRotator (trigonometry both
+// ways), and the batch versions. Batch rows are per rotator.
+
+const size_t rotator_count = 1 << 12;
+
+template <typename num_type>
+void benchConversions(BenchRunner& bench) {
+  typedef Vector3<num_type> V3;
+  const size_t m = rotator_count - 1;
+  vector<QuaternionRotator<num_type>> quats(rotator_count), back(rotator_count);
+  vector<RotationMatrix<num_type>> mats(rotator_count), batch_mats(rotator_count);
+  for (size_t i = 0; i < rotator_count; ++i) {
+    V3 axis(num_type(1), num_type(i % 5) - 2, num_type(i % 3) + num_type(0.5));
+    quats[i] = QuaternionRotator<num_type>(num_type(i % 628) / 100 - num_type(3.1), axis.normalized());
+    mats[i] = RotationMatrix<num_type>(quats[i]);
+  }
+
+  // Rotating through either form must agree, and q -> M -> q must give q back up
+  // to sign. Every angle in (-pi, pi) is covered, so each of Shepperd's four cases
+  // is taken
+  QuaternionRotator<num_type>::toMatrices(quats.data(), batch_mats.data(), rotator_count);
+  QuaternionRotator<num_type>::fromMatrices(batch_mats.data(), back.data(), rotator_count);
+  double rotate_error = 0, round_trip_error = 0, batch_error = 0;
+  V3 v(num_type(0.3), num_type(-1), num_type(2));
+  for (size_t i = 0; i < rotator_count; ++i) {
+    double e = (mats[i].rotate(v) - quats[i].rotate(v)).magnitude();
+    rotate_error = e > rotate_error ? e : rotate_error;
+    QuaternionRotator<num_type> q(mats[i]);
+    e = 1 - fabs(double(q.dotProduct(quats[i])));
+    round_trip_error = e > round_trip_error ? e : round_trip_error;
+    e = (batch_mats[i].rotate(v) - mats[i].rotate(v)).magnitude() + (back[i].rotate(v) - q.rotate(v)).magnitude();
+    batch_error = e > batch_error ? e : batch_error;
+  }
+  printf("%s rotate max error %g, round trip 1 - |q.q'| max %g, batch against single max difference %g\n",
+         TypeName<num_type>::get(), rotate_error, round_trip_error, batch_error);
+
+  bench.run<num_type>("q to matrix", [&](size_t i) { doNotOptimize(RotationMatrix<num_type>(quats[i & m])); });
+  bench.run<num_type>("q to matrix, via AngleAxisRotator", [&](size_t i) {
+    doNotOptimize(RotationMatrix<num_type>(AngleAxisRotator<num_type>(quats[i & m])));
+  });
+  bench.run<num_type>("matrix to q", [&](size_t i) { doNotOptimize(QuaternionRotator<num_type>(mats[i & m])); });
+  bench.run<num_type>("matrix to AngleAxisRotator", [&](size_t i) { doNotOptimize(AngleAxisRotator<num_type>(mats[i & m])); });
+
+  QuaternionArray<num_type> quat_array;
+  QuaternionRotator<num_type>::fromMatrices(mats.data(), quat_array, rotator_count);
+  bench.run<num_type>("toMatrices", [&](size_t i) {
+    if (i % rotator_count == 0)
+      QuaternionRotator<num_type>::toMatrices(quats.data(), batch_mats.data(), rotator_count);
+    doNotOptimize(batch_mats[0].matrix[0][0]);
+  });
+  bench.run<num_type>("toMatrices, QuaternionArray", [&](size_t i) {
+    if (i % rotator_count == 0)
+      QuaternionRotator<num_type>::toMatrices(quat_array, batch_mats.data());
+    doNotOptimize(batch_mats[0].matrix[0][0]);
+  });
+  bench.run<num_type>("fromMatrices", [&](size_t i) {
+    if (i % rotator_count == 0)
+      QuaternionRotator<num_type>::fromMatrices(mats.data(), back.data(), rotator_count);
+    doNotOptimize(back[0].w);
+  });
+  bench.run<num_type>("fromMatrices, QuaternionArray", [&](size_t i) {
+    if (i % rotator_count == 0)
+      QuaternionRotator<num_type>::fromMatrices(mats.data(), quat_array, rotator_count);
+    doNotOptimize(quat_array.w[0]);
+  });
+}
+
+int main(int argc, char** argv) {
+  BenchRunner bench(argc, argv);
+  benchConversions<float>(bench);
+  benchConversions<double>(bench);
+}
@@ -0,0 +1,141 @@
+#include "../all_math.h"
+#include "../all_scene.h"
+#include "bench.h"
+#include <stdio.h>
+using namespace std;
+
+// SkinnedMesh::skin, dual quaternion skinning, against linear blend skinning
+// with a matrix palette, on a 64 bone mesh with four influences per vertex. The
+// matrix version below is the portable layout, a scalar gather and blend per
+// block followed by SIMD transforms. ops/s / 1000 is vertices per millisecond.
+
+const size_t vertex_count = 20000;
+const size_t bone_count = 64;
+
+// Linear blend skinning: each vertex blends the 3x4 affine parts of its bones'
+// matrices and transforms by the result
+template <typename num_type>
+void skinMatrices(const SkinnedMesh<num_type>& mesh, const Matrix4x4<num_type>* palette,
+                  Vector3Array<num_type>& out_positions, Vector3Array<num_type>& out_normals) {
+  const size_t block = 64;
+  out_positions.resize(mesh.size());
+  out_normals.resize(mesh.size());
+  alignas(64) num_type blended[12][block];
+  for (size_t start = 0; start < mesh.size(); start += block) {
+    size_t m = mesh.size() - start < block ? mesh.size() - start : block;
+    for (size_t i = 0; i < m; ++i) {
+      num_type sum[12] = {};
+      for (size_t j = 0; j < SkinnedMesh<num_type>::max_influences; ++j) {
+        const num_type (*mat)[4] = palette[mesh.bone[j][start + i]].matrix;
+        num_type k = mesh.weight[j][start + i];
+        for (int c = 0; c < 12; ++c)
+          sum[c] += mat[c / 4][c % 4] * k;
+      }
+      for (int c = 0; c < 12; ++c)
+        blended[c][i] = sum[c];
+    }
+    const num_type *px = mesh.positions.x + start, *py = mesh.positions.y + start, *pz = mesh.positions.z + start;
+    const num_type *nx = mesh.normals.x + start, *ny = mesh.normals.y + start, *nz = mesh.normals.z + start;
+    num_type* out[6] = {out_positions.x + start, out_positions.y + start, out_positions.z + start,
+                        out_normals.x + start, out_normals.y + start, out_normals.z + start};
+    forEachLane<num_type>(m, [&](auto lanes, size_t i) {
+      typedef decltype(lanes) L;
+      typename L::reg x = L::load(px + i), y = L::load(py + i), z = L::load(pz + i);
+      typename L::reg a = L::load(nx + i), b = L::load(ny + i), c = L::load(nz + i);
+      for (int r = 0; r < 3; ++r) {
+        typename L::reg m_0 = L::load(blended[4 * r] + i), m_1 = L::load(blended[4 * r + 1] + i),
+                        m_2 = L::load(blended[4 * r + 2] + i), m_3 = L::load(blended[4 * r + 3] + i);
+        L::store(out[r] + i, L::mulAdd(m_2, z, L::mulAdd(m_1, y, L::mulAdd(m_0, x, m_3))));
+        L::store(out[3 + r] + i, L::mulAdd(m_2, c, L::mulAdd(m_1, b, L::mul(m_0, a))));
+      }
+    });
+  }
+}
+
+template <typename num_type>
+void benchSkinning(BenchRunner& bench) {
+  typedef Vector3<num_type> V3;
+  // A chain of bones along z, each bound at its own height and posed with a
+  // twist and a bend
+  vector<DualQuaternion<num_type>> bind_inverse(bone_count), pose(bone_count), dq_palette(bone_count);
+  vector<Matrix4x4<num_type>> mat_bind_inverse(bone_count), mat_pose(bone_count), mat_palette(bone_count);
+  for (size_t b = 0; b < bone_count; ++b) {
+    V3 bind_position(num_type(0), num_type(0), num_type(b));
+    bind_inverse[b] = DualQuaternion<num_type>(QuaternionRotator<num_type>(), bind_position).inverse();
+    pose[b] = DualQuaternion<num_type>(QuaternionRotator<num_type>(num_type(0.05) * num_type(b), V3(num_type(0.2), num_type(0), num_type(1))),
+                                       V3(num_type(0.1) * num_type(b), num_type(0), num_type(b)));
+    mat_bind_inverse[b] = bind_inverse[b].toMatrix();
+    mat_pose[b] = pose[b].toMatrix();
+  }
+  SkinnedMesh<num_type> mesh;
+  for (size_t i = 0; i < vertex_count; ++i) {
+    num_type height = num_type(i) * num_type(bone_count - 1) / num_type(vertex_count), a = num_type(i % 97) / 15;
+    size_t b = size_t(height);
+    uint16_t bones[4] = {uint16_t(b), uint16_t(b + 1 < bone_count ? b + 1 : b), uint16_t(b > 0 ? b - 1 : b),
+                         uint16_t(b + 2 < bone_count ? b + 2 : b)};
+    num_type f = height - num_type(b);
+    num_type weights[4] = {num_type(0.8) * (1 - f), num_type(0.8) * f, num_type(0.1), num_type(0.1)};
+    mesh.add(V3(cos(a), sin(a), height), V3(cos(a), sin(a), num_type(0)), bones, weights, 4);
+  }
+
+  bench.run<num_type>("DualQuaternion palette, 64 bones", [&](size_t i) {
+    for (size_t b = 0; b < bone_count; ++b)
+      dq_palette[b] = pose[b].multiply(bind_inverse[b]);
+    doNotOptimize(dq_palette[i % bone_count].real.w);
+  });
+  bench.run<num_type>("Matrix4x4 palette, 64 bones", [&](size_t i) {
+    for (size_t b = 0; b < bone_count; ++b)
+      mat_palette[b] = mat_pose[b].multiply(mat_bind_inverse[b]);
+    doNotOptimize(mat_palette[i % bone_count].matrix[0][0]);
+  });
+
+  Vector3Array<num_type> dq_positions, dq_normals, mat_positions, mat_normals;
+  mesh.skin(dq_palette.data(), dq_positions, dq_normals);
+  skinMatrices(mesh, mat_palette.data(), mat_positions, mat_normals);
+  // Both agree on single bone vertices; the blends differ by design elsewhere
+  double max_error = 0;
+  for (size_t i = 0; i < vertex_count; ++i) {
+    DualQuaternion<num_type> dqs[4];
+    num_type weights[4];
+    for (size_t j = 0; j < 4; ++j) {
+      dqs[j] = dq_palette[mesh.bone[j][i]];
+      weights[j] = mesh.weight[j][i];
+    }
+    V3 p = DualQuaternion<num_type>::blend(dqs, weights, 4).transformPoint(mesh.positions.get(i));
+    double e = (p - dq_positions.get(i)).magnitude();
+    max_error = e > max_error ? e : max_error;
+  }
+  printf("%s skin against DualQuaternion::blend, max error %g\n", TypeName<num_type>::get(), max_error);
+
+  bench.run<num_type>("skin per vertex, dual quaternions", [&](size_t i) {
+    if (i % vertex_count == 0)
+      mesh.skin(dq_palette.data(), dq_positions, dq_normals);
+    doNotOptimize(dq_positions.x[0]);
+  });
+  bench.run<num_type>("skin per vertex, matrices", [&](size_t i) {
+    if (i % vertex_count == 0)
+      skinMatrices(mesh, mat_palette.data(), mat_positions, mat_normals);
+    doNotOptimize(mat_positions.x[0]);
+  });
+  if (hardwareThreads() > 1)
+    bench.run<num_type>("skin per vertex, dual quaternions, threads", [&](size_t i) {
+      if (i % vertex_count == 0)
+        mesh.skin(dq_palette.data(), dq_positions, dq_normals, hardwareThreads());
+      doNotOptimize(dq_positions.x[0]);
+    });
+
+  const size_t m = bone_count - 1;
+  V3 point(num_type(0.5), num_type(-1), num_type(2));
+  bench.run<num_type>("DualQuaternion.transformPoint", [&](size_t i) { doNotOptimize(dq_palette[i & m].transformPoint(point)); });
+  bench.run<num_type>("Matrix4x4.transformPoint", [&](size_t i) { doNotOptimize(mat_palette[i & m].transformPoint(point)); });
+  bench.run<num_type>("DualQuaternion.sclerp", [&](size_t i) {
+    doNotOptimize(pose[i & m].sclerp(pose[(i + 7) & m], num_type(i & 15) / 16));
+  });
+  bench.run<num_type>("DualQuaternion.normalized", [&](size_t i) { doNotOptimize(dq_palette[i & m].multiply(num_type(1.5)).normalized()); });
+}
+
+int main(int argc, char** argv) {
+  BenchRunner bench(argc, argv);
+  benchSkinning<float>(bench);
+  benchSkinning<double>(bench);
+}
@@ -0,0 +1,95 @@
+#include "../all_math.h"
+#include "../all_scene.h"
+#include "bench.h"
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+using namespace std;
+
+// Snapshot files (in all_scene.h) of 2M positions and rotations: writing them,
+// opening the memory map, and getting the data into a batch kernel either as
+// zero-copy views or by loading copies, from a raw file and from one packed
+// with PackedVector3 and PackedQuaternion48. The files are in the page cache
+// after the first write, so the rows measure mapping and copying rather than
+// the disk. Rows are per call. --file <path> sets the raw file, default
+// snapshot_bench.snap; the packed one adds .packed, and both are removed at the end.
+
+const size_t element_count = 1 << 21;
+
+int main(int argc, char** argv) {
+  string path = "snapshot_bench.snap";
+  vector<char*> args(argv, argv + argc);
+  for (size_t i = 1; i + 1 < args.size(); ++i)
+    if (strcmp(args[i], "--file") == 0) {
+      path = args[i + 1];
+      args.erase(args.begin() + i, args.begin() + i + 2);
+      break;
+    }
+  string packed_path = path + ".packed";
+  BenchRunner bench(int(args.size()), args.data());
+
+  typedef Vector3<float> V3;
+  Vector3Array<float> positions(element_count);
+  QuaternionArray<float> rotations(element_count);
+  for (size_t i = 0; i < element_count; ++i) {
+    float t = float(i) / float(element_count);
+    positions.set(i, V3(1000 * t - 500, float(i % 100) / 10, 400 * sin(20 * t)));
+    rotations.set(i, QuaternionRotator<float>(float(i % 628) / 100, V3(sin(float(i)), 1.0f, cos(float(i))).normalized()));
+  }
+  SnapshotWriter raw, packed;
+  raw.add("positions", positions);
+  raw.add("rotations", rotations);
+  packed.add("positions", positions, SnapshotSection::packed_vector3);
+  packed.add("rotations", rotations, SnapshotSection::packed_quaternion48);
+  if (not raw.write(path) or not packed.write(packed_path)) {
+    fprintf(stderr, "Can't write %s\n", path.c_str());
+    return 1;
+  }
+
+  Snapshot snapshot;
+  snapshot.open(packed_path);
+  size_t packed_size = snapshot.section(0).size + snapshot.section(1).size;
+  snapshot.open(path);
+  size_t raw_size = snapshot.section(0).size + snapshot.section(1).size;
+  printf("%zu positions and rotations: raw sections %zu MB, packed %zu MB\n", element_count, raw_size >> 20, packed_size >> 20);
+  snapshot.close();
+
+  bench.run<float>("write raw", [&](size_t) { doNotOptimize(raw.write(path)); });
+  bench.run<float>("write packed", [&](size_t) { doNotOptimize(packed.write(packed_path)); });
+  bench.run<float>("open", [&](size_t) {
+    doNotOptimize(snapshot.open(path));
+    doNotOptimize(snapshot.vectors<float>("positions").x);
+  });
+
+  // The same kernel pass on mapped views and on loaded copies
+  QuaternionRotator<float> rot(0.5f, V3(0.0f, 0.0f, 1.0f));
+  Vector3Array<float> loaded_positions, out;
+  QuaternionArray<float> loaded_rotations;
+  bench.run<float>("open, rotateMany on view", [&](size_t) {
+    snapshot.open(path);
+    rot.rotateMany(snapshot.vectors<float>("positions"), out);
+    doNotOptimize(out.x[0]);
+  });
+  bench.run<float>("open, load, rotateMany", [&](size_t) {
+    snapshot.open(path);
+    snapshot.load("positions", loaded_positions);
+    snapshot.load("rotations", loaded_rotations);
+    rot.rotateMany(loaded_positions, out);
+    doNotOptimize(out.x[0]);
+  });
+  bench.run<float>("open packed, load, rotateMany", [&](size_t) {
+    snapshot.open(packed_path);
+    snapshot.load("positions", loaded_positions);
+    snapshot.load("rotations", loaded_rotations);
+    rot.rotateMany(loaded_positions, out);
+    doNotOptimize(out.x[0]);
+  });
+  bench.run<float>("rotateMany on owned array", [&](size_t) {
+    rot.rotateMany(positions, out);
+    doNotOptimize(out.x[0]);
+  });
+
+  snapshot.close();
+  remove(path.c_str());
+  remove(packed_path.c_str());
+}
@@ -0,0 +1,89 @@
+#include "../all_math.h"
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+using namespace std;
+
+// Rotator calls made through the CRTP base in a tight loop, against the same
+// loop through an equivalent virtual interface (what Rotator used to be)
+// Build with e.g. g++ -std=c++17 -O2 static_dispatch_bench.cpp
+
+static_assert(sizeof(QuaternionRotator<float>) == 4 * sizeof(float), "QuaternionRotator should be its payload");
+static_assert(sizeof(RotationMatrix<float>) == 9 * sizeof(float), "RotationMatrix should be its payload");
+static_assert(sizeof(AngleAxisRotator<float>) == 4 * sizeof(float), "AngleAxisRotator should be its payload");
+static_assert(IsRotator<QuaternionRotator<double>>::value and not IsRotator<Quaternion<double>>::value, "IsRotator");
+#if defined(__cpp_concepts)
+  static_assert(RotatorType<RotationMatrix<float>> and not RotatorType<Vector3<float>>, "RotatorType");
+#endif
+
+const size_t point_count = 1 << 14;
+const int repeats = 200;
+
+// Virtual dispatch reference
+template <typename num_type>
+class VirtualRotator {
+  public :
+    virtual ~VirtualRotator() {}
+    virtual Vector3<num_type> rotate(const Vector3<num_type>&) const = 0;
+};
+template <class RotatorType>
+class VirtualAdapter : public VirtualRotator<typename RotatorType::value_type> {
+  public :
+    RotatorType rot;
+    VirtualAdapter(const RotatorType& r) : rot(r) {}
+    Vector3<typename RotatorType::value_type> rotate(const Vector3<typename RotatorType::value_type>& vec) const {
+      return rot.rotate(vec);
+    }
+};
+
+// Generic code over any rotator, called through the base class reference
+template <class FinalType, typename num_type>
+num_type staticLoop(const Rotator<FinalType, num_type>& rot, const vector<Vector3<num_type>>& points) {
+  num_type sum = 0;
+  for (size_t i = 0; i < points.size(); ++i)
+    sum += (rot * points[i]).x;
+  return sum;
+}
+template <typename num_type>
+__attribute__((noinline)) num_type virtualLoop(const VirtualRotator<num_type>& rot, const vector<Vector3<num_type>>& points) {
+  num_type sum = 0;
+  for (size_t i = 0; i < points.size(); ++i)
+    sum += rot.rotate(points[i]).x;
+  return sum;
+}
+
+template <class Func>
+double nsPerCall(Func func) {
+  volatile float sink = func();
+  auto start = chrono::steady_clock::now();
+  for (int r = 0; r < repeats; ++r)
+    sink = func();
+  auto end = chrono::steady_clock::now();
+  (void)sink;
+  return chrono::duration<double, nano>(end - start).count() / (double(repeats) * point_count);
+}
+
+template <class RotatorType>
+void compare(const char* name, const RotatorType& rot, const vector<Vector3<float>>& points) {
+  VirtualAdapter<RotatorType> adapter(rot);
+  const VirtualRotator<float>& dynamic_rot = adapter;
+  double static_ns = nsPerCall([&]() { return staticLoop(rot, points); });
+  double virtual_ns = nsPerCall([&]() { return virtualLoop(dynamic_rot, points); });
+  cout << setw(18) << left << name << right << setw(6) << sizeof(RotatorType)
+       << fixed << setprecision(3) << setw(12) << static_ns << setw(12) << virtual_ns
+       << setw(10) << setprecision(2) << virtual_ns / static_ns << "x\n";
+}
+
+int main() {
+  vector<Vector3<float>> points(point_count);
+  for (size_t i = 0; i < point_count; ++i)
+    points[i] = Vector3<float>(float(i % 97) - 48, float(i % 89) * 0.5f, float(i % 83) - 41);
+  
+  cout << "ns per rotate call\n";
+  cout << setw(18) << left << "rotator" << right << setw(6) << "bytes" << setw(12) << "static"
+       << setw(12) << "virtual" << setw(11) << "speedup" << "\n";
+  compare("QuaternionRotator", QuaternionRotator<float>(1.2f, Vector3<float>(1, 2, 3)).normalized(), points);
+  compare("RotationMatrix", RotationMatrix<float>(0.3f, -0.7f, 1.1f), points);
+  compare("AngleAxisRotator", AngleAxisRotator<float>(0.8f, Vector3<float>(0, 1, 1)), points);
+}
@@ -0,0 +1,384 @@
+#if !defined(ALLOCATORS_H_INCLUDED)
+  #define ALLOCATORS_H_INCLUDED
+
+  #include <atomic>
+  #include <cstddef>
+  #include <map>
+  #include <memory>
+  #include <mutex>
+  #include <new>
+  #include <stdint.h>
+  #include <thread>
+  #include <utility>
+  #include <vector>
+
+  // Counters of one frame of a FrameArena, or of a FixedSizePool so far
+  struct AllocationStats {
+    size_t allocations;
+    // Requested, not counting alignment padding
+    size_t bytes;
+    // Live in a pool; blocks used by an arena
+    size_t in_use;
+
+    AllocationStats() : allocations(0), bytes(0), in_use(0) {}
+    AllocationStats& operator+=(const AllocationStats& stats) {
+      allocations += stats.allocations;
+      bytes += stats.bytes;
+      in_use += stats.in_use;
+      return *this;
+    }
+  };
+
+  // Linear allocator for scratch data that lives for one frame. allocate() bumps
+  // a pointer through blocks of block_size bytes, and reset() rewinds to the first
+  // block in O(1), keeping every block for the next frame, so once the arena has
+  // grown to a frame's peak it stops touching the heap. Nothing is destroyed on
+  // reset: keep trivially destructible data here, or destroy it yourself.
+  // Not thread safe; see ThreadArenas
+  class FrameArena {
+    public :
+      static constexpr size_t default_block_size = size_t(1) << 20;
+
+      explicit FrameArena(size_t block_size = default_block_size)
+        : block_size(block_size == 0 ? default_block_size : block_size), block(0), current(0), end(0) {}
+      ~FrameArena() {
+        for (const Block& b : blocks)
+          ::operator delete(b.data);
+      }
+      FrameArena(const FrameArena&) = delete;
+      FrameArena& operator=(const FrameArena&) = delete;
+
+      // size bytes aligned to alignment, a power of two
+      void* allocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+        uintptr_t p = (current + alignment - 1) & ~uintptr_t(alignment - 1);
+        if (p + size > end or current == 0)
+          p = nextBlock(size, alignment);
+        current = p + size;
+        ++frame.allocations;
+        frame.bytes += size;
+        return reinterpret_cast<void*>(p);
+      }
+      // Uninitialized room for n objects of T
+      template <class T>
+      T* allocateArray(size_t n) {
+        return static_cast<T*>(allocate(n * sizeof(T), alignof(T)));
+      }
+      template <class T, class... Args>
+      T* create(Args&&... args) {
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+      }
+
+      // Ends the frame: everything allocated since the last reset is gone
+      void reset() {
+        last_frame = frame;
+        frame = AllocationStats();
+        block = 0;
+        current = blocks.empty() ? 0 : blocks[0].begin();
+        end = blocks.empty() ? 0 : blocks[0].end();
+        if (not blocks.empty())
+          frame.in_use = 1;
+      }
+
+      const AllocationStats& frameStats() const {
+        return frame;
+      }
+      const AllocationStats& lastFrameStats() const {
+        return last_frame;
+      }
+      // Bytes held in blocks
+      size_t capacity() const {
+        size_t total = 0;
+        for (const Block& b : blocks)
+          total += b.size;
+        return total;
+      }
+
+    private :
+      struct Block {
+        void* data;
+        size_t size;
+
+        uintptr_t begin() const {
+          return reinterpret_cast<uintptr_t>(data);
+        }
+        uintptr_t end() const {
+          return begin() + size;
+        }
+      };
+
+      size_t block_size;
+      std::vector<Block> blocks;
+      size_t block;
+      uintptr_t current, end;
+      AllocationStats frame, last_frame;
+
+      // Start of a block after the current one with room for size at alignment,
+      // reusing the blocks of earlier frames before adding one
+      uintptr_t nextBlock(size_t size, size_t alignment) {
+        size_t k = current == 0 ? 0 : block + 1;
+        for (; k < blocks.size(); ++k) {
+          uintptr_t p = (blocks[k].begin() + alignment - 1) & ~uintptr_t(alignment - 1);
+          if (p + size <= blocks[k].end())
+            break;
+        }
+        if (k == blocks.size()) {
+          size_t bytes = size + alignment > block_size ? size + alignment : block_size;
+          Block b = {::operator new(bytes), bytes};
+          blocks.push_back(b);
+        }
+        block = k;
+        frame.in_use = k + 1;
+        end = blocks[k].end();
+        return (blocks[k].begin() + alignment - 1) & ~uintptr_t(alignment - 1);
+      }
+  };
+
+  // A FrameArena per thread, made the first time the thread asks for one, for
+  // scratch data built inside parallel jobs
+  class ThreadArenas {
+    public :
+      explicit ThreadArenas(size_t block_size = FrameArena::default_block_size) : block_size(block_size), id(nextId()) {}
+      ThreadArenas(const ThreadArenas&) = delete;
+      ThreadArenas& operator=(const ThreadArenas&) = delete;
+
+      // The calling thread's arena
+      FrameArena& local() {
+        Cache& cache = threadCache();
+        if (cache.owner == id)
+          return *cache.arena;
+        std::lock_guard<std::mutex> guard(lock);
+        std::unique_ptr<FrameArena>& arena = arenas[std::this_thread::get_id()];
+        if (not arena)
+          arena.reset(new FrameArena(block_size));
+        cache.owner = id;
+        cache.arena = arena.get();
+        return *arena;
+      }
+      // Resets every thread's arena; no thread may be allocating meanwhile
+      void reset() {
+        std::lock_guard<std::mutex> guard(lock);
+        for (auto& entry : arenas)
+          entry.second->reset();
+      }
+      // Summed over the threads
+      AllocationStats frameStats() const {
+        std::lock_guard<std::mutex> guard(lock);
+        AllocationStats total;
+        for (const auto& entry : arenas)
+          total += entry.second->frameStats();
+        return total;
+      }
+      AllocationStats lastFrameStats() const {
+        std::lock_guard<std::mutex> guard(lock);
+        AllocationStats total;
+        for (const auto& entry : arenas)
+          total += entry.second->lastFrameStats();
+        return total;
+      }
+      size_t arenaCount() const {
+        std::lock_guard<std::mutex> guard(lock);
+        return arenas.size();
+      }
+
+    private :
+      // The last set of arenas the thread used, so local() only locks on a change
+      struct Cache {
+        uint64_t owner;
+        FrameArena* arena;
+      };
+
+      size_t block_size;
+      // Unique per instance, unlike addresses, which a new instance may reuse
+      uint64_t id;
+      mutable std::mutex lock;
+      std::map<std::thread::id, std::unique_ptr<FrameArena>> arenas;
+
+      static uint64_t nextId() {
+        static std::atomic<uint64_t> next(1);
+        return next++;
+      }
+      static Cache& threadCache() {
+        static thread_local Cache cache = {0, nullptr};
+        return cache;
+      }
+  };
+
+  // Equal sized slots carved out of chunks, with freed slots kept on a list for
+  // reuse. The slot size is fixed by the constructor or, when that gets 0, by the
+  // first allocation; larger requests go to the heap. Slots and heap blocks are
+  // aligned to the alignment given to the constructor, at least max_align_t's.
+  // Memory returns to the system only when the pool is destroyed. Not thread safe
+  class FixedSizePool {
+    public :
+      static constexpr size_t slots_per_chunk = 256;
+
+      explicit FixedSizePool(size_t slot_size = 0, size_t alignment = alignof(std::max_align_t))
+        : slot_size(0), alignment(alignment < alignof(std::max_align_t) ? alignof(std::max_align_t) : alignment),
+          free_list(nullptr) {
+        if (slot_size != 0)
+          setSlotSize(slot_size);
+      }
+      ~FixedSizePool() {
+        for (void* chunk : chunks)
+          ::operator delete(chunk, std::align_val_t(alignment));
+      }
+      FixedSizePool(const FixedSizePool&) = delete;
+      FixedSizePool& operator=(const FixedSizePool&) = delete;
+
+      void* allocate(size_t size) {
+        if (slot_size == 0)
+          setSlotSize(size);
+        ++counters.allocations;
+        counters.bytes += size;
+        if (size > slot_size)
+          return ::operator new(size, std::align_val_t(alignment));
+        if (free_list == nullptr)
+          addChunk();
+        Slot* slot = free_list;
+        free_list = slot->next;
+        ++counters.in_use;
+        return slot;
+      }
+      // size as given to allocate
+      void deallocate(void* p, size_t size) {
+        if (p == nullptr)
+          return;
+        if (size > slot_size) {
+          ::operator delete(p, std::align_val_t(alignment));
+          return;
+        }
+        Slot* slot = static_cast<Slot*>(p);
+        slot->next = free_list;
+        free_list = slot;
+        --counters.in_use;
+      }
+
+      size_t slotSize() const {
+        return slot_size;
+      }
+      // Slots in chunks, free or not
+      size_t capacity() const {
+        return chunks.size() * slots_per_chunk;
+      }
+      const AllocationStats& stats() const {
+        return counters;
+      }
+
+    private :
+      struct Slot {
+        Slot* next;
+      };
+
+      size_t slot_size;
+      size_t alignment;
+      Slot* free_list;
+      std::vector<void*> chunks;
+      AllocationStats counters;
+
+      void setSlotSize(size_t size) {
+        slot_size = size < sizeof(Slot) ? sizeof(Slot) : size;
+        slot_size = (slot_size + alignment - 1) / alignment * alignment;
+      }
+      void addChunk() {
+        char* chunk = static_cast<char*>(::operator new(slot_size * slots_per_chunk, std::align_val_t(alignment)));
+        chunks.push_back(chunk);
+        for (size_t i = slots_per_chunk; i-- != 0;) {
+          Slot* slot = reinterpret_cast<Slot*>(chunk + i * slot_size);
+          slot->next = free_list;
+          free_list = slot;
+        }
+      }
+  };
+
+  // Typed FixedSizePool that constructs and destroys its objects
+  template <class T>
+  class ObjectPool {
+    public :
+      ObjectPool() : pool(sizeof(T), alignof(T)) {}
+
+      template <class... Args>
+      T* create(Args&&... args) {
+        return new (pool.allocate(sizeof(T))) T(std::forward<Args>(args)...);
+      }
+      void destroy(T* object) {
+        if (object == nullptr)
+          return;
+        object->~T();
+        pool.deallocate(object, sizeof(T));
+      }
+
+      size_t live() const {
+        return pool.stats().in_use;
+      }
+      size_t capacity() const {
+        return pool.capacity();
+      }
+      const AllocationStats& stats() const {
+        return pool.stats();
+      }
+
+    private :
+      FixedSizePool pool;
+  };
+
+  // Standard allocator on a FrameArena, for containers that live for a frame,
+  // e.g. ArenaVector<Vector3<float>> vertices(ArenaAllocator<Vector3<float>>(arena)).
+  // Deallocation does nothing; the memory comes back at the arena's reset, and the
+  // container must be gone by then
+  template <class T>
+  class ArenaAllocator {
+    public :
+      typedef T value_type;
+
+      FrameArena* arena;
+
+      ArenaAllocator(FrameArena& frame_arena) noexcept : arena(&frame_arena) {}
+      template <class U>
+      ArenaAllocator(const ArenaAllocator<U>& other) noexcept : arena(other.arena) {}
+
+      T* allocate(size_t n) {
+        return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+      }
+      void deallocate(T*, size_t) noexcept {}
+
+      template <class U>
+      bool operator==(const ArenaAllocator<U>& other) const {return arena == other.arena;}
+      template <class U>
+      bool operator!=(const ArenaAllocator<U>& other) const {return arena != other.arena;}
+  };
+  template <class T>
+  using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+  // Standard allocator on a FixedSizePool, for node based containers (lists, sets,
+  // maps), whose nodes then come from the pool's slots. Give each container its
+  // own pool with slot size 0, so the first node fixes it
+  template <class T>
+  class PoolAllocator {
+    public :
+      typedef T value_type;
+
+      FixedSizePool* pool;
+
+      PoolAllocator(FixedSizePool& fixed_size_pool) noexcept : pool(&fixed_size_pool) {}
+      template <class U>
+      PoolAllocator(const PoolAllocator<U>& other) noexcept : pool(other.pool) {}
+
+      T* allocate(size_t n) {
+        if (alignof(T) > alignof(std::max_align_t))
+          return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(alignof(T))));
+        return static_cast<T*>(pool->allocate(n * sizeof(T)));
+      }
+      void deallocate(T* p, size_t n) noexcept {
+        if (alignof(T) > alignof(std::max_align_t))
+          ::operator delete(p, std::align_val_t(alignof(T)));
+        else
+          pool->deallocate(p, n * sizeof(T));
+      }
+
+      template <class U>
+      bool operator==(const PoolAllocator<U>& other) const {return pool == other.pool;}
+      template <class U>
+      bool operator!=(const PoolAllocator<U>& other) const {return pool != other.pool;}
+  };
+
+#endif
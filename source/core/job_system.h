@@ -0,0 +1,360 @@
+#if !defined(JOB_SYSTEM_H_INCLUDED)
+  #define JOB_SYSTEM_H_INCLUDED
+
+  #include <atomic>
+  #include <condition_variable>
+  #include <deque>
+  #include <functional>
+  #include <memory>
+  #include <mutex>
+  #include <stddef.h>
+  #include <stdint.h>
+  #include <thread>
+  #include <vector>
+
+  // Hardware threads, at least 1
+  inline unsigned hardwareThreads() {
+    unsigned n = std::thread::hardware_concurrency();
+    return n == 0 ? 1 : n;
+  }
+
+  class JobSystem;
+
+  // A unit of work for JobSystem. It finishes once its work and all of its
+  // children have run, and is queued once run() was called and every job it
+  // was made a continuation of has finished
+  class Job {
+    public :
+      bool finished() const {
+        return unfinished.load(std::memory_order_acquire) == 0;
+      }
+
+    private :
+      friend class JobSystem;
+
+      std::function<void()> work;
+      std::shared_ptr<Job> parent;
+      // This job and its unfinished children
+      std::atomic<int> unfinished;
+      // The hold run() releases, plus one per unfinished job this one continues
+      std::atomic<int> dependencies;
+      std::mutex continuation_lock;
+      std::vector<std::shared_ptr<Job>> continuations;
+      bool done;
+      // Keeps the job alive while it's queued or running
+      std::shared_ptr<Job> self;
+
+      Job() : unfinished(1), dependencies(1), done(false) {}
+  };
+  typedef std::shared_ptr<Job> JobHandle;
+
+  // Chase-Lev work-stealing deque of a fixed capacity. The owner thread pushes
+  // and pops at the bottom, any other thread steals from the top
+  class JobDeque {
+    public :
+      static constexpr int64_t capacity = 4096;
+
+      JobDeque() : top(0), bottom(0) {
+        for (std::atomic<Job*>& slot : slots)
+          slot.store(nullptr, std::memory_order_relaxed);
+      }
+
+      // Owner only; false when full
+      bool push(Job* job) {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        if (b - t >= capacity)
+          return false;
+        slots[b & (capacity - 1)].store(job, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return true;
+      }
+      // Owner only; newest first
+      Job* pop() {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+        if (t > b) {
+          bottom.store(b + 1, std::memory_order_relaxed);
+          return nullptr;
+        }
+        Job* job = slots[b & (capacity - 1)].load(std::memory_order_relaxed);
+        if (t == b) {
+          // Last one, racing the thieves for it
+          if (not top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            job = nullptr;
+          bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return job;
+      }
+      // Any thread; oldest first. nullptr when empty or when another thief won
+      Job* steal() {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b)
+          return nullptr;
+        Job* job = slots[t & (capacity - 1)].load(std::memory_order_relaxed);
+        if (not top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+          return nullptr;
+        return job;
+      }
+      size_t size() const {
+        int64_t n = bottom.load(std::memory_order_relaxed) - top.load(std::memory_order_relaxed);
+        return n > 0 ? size_t(n) : 0;
+      }
+
+    private :
+      std::atomic<int64_t> top, bottom;
+      std::atomic<Job*> slots[capacity];
+  };
+
+  // Work-stealing scheduler. Each worker thread owns a JobDeque: jobs it starts go
+  // to the bottom of its own deque, it works from there newest first, and when
+  // that runs dry it steals the oldest job of another worker. The thread that
+  // builds the system owns a deque too and works through wait(), so a system of
+  // n threads starts n - 1 workers. Jobs started from any other thread go through
+  // a shared queue.
+  //
+  // Idle workers spin briefly and then sleep until a job is started. Jobs still
+  // queued when the system is destroyed are dropped, so wait for them first.
+  class JobSystem {
+    public :
+      // Spins without work before a worker goes to sleep
+      static constexpr int idle_spins = 64;
+
+      explicit JobSystem(unsigned threads = hardwareThreads()) : stopping(false), sleepers(0), epoch(0) {
+        if (threads == 0)
+          threads = 1;
+        for (unsigned i = 0; i < threads; ++i)
+          deques.emplace_back(new JobDeque());
+        threadSlot() = {this, 0};
+        workers.reserve(threads - 1);
+        for (unsigned i = 1; i < threads; ++i)
+          workers.emplace_back([this, i]() { workerLoop(i); });
+      }
+      ~JobSystem() {
+        {
+          std::lock_guard<std::mutex> lock(sleep_lock);
+          stopping = true;
+        }
+        sleep_signal.notify_all();
+        for (std::thread& worker : workers)
+          worker.join();
+        if (threadSlot().system == this)
+          threadSlot() = {nullptr, 0};
+      }
+      JobSystem(const JobSystem&) = delete;
+      JobSystem& operator=(const JobSystem&) = delete;
+
+      // Process-wide system with a thread per hardware thread, for the engine's
+      // parallel helpers; built by the first thread to ask for it
+      static JobSystem& shared() {
+        static JobSystem system;
+        return system;
+      }
+
+      unsigned threadCount() const {
+        return unsigned(deques.size());
+      }
+
+      // A job not yet queued, so continuations can be set up before run()
+      JobHandle create(std::function<void()> work) {
+        JobHandle job(new Job());
+        job->work = std::move(work);
+        return job;
+      }
+      // As create, for a job that parent doesn't finish without; call before parent finishes
+      JobHandle createChild(const JobHandle& parent, std::function<void()> work) {
+        JobHandle job = create(std::move(work));
+        parent->unfinished.fetch_add(1, std::memory_order_relaxed);
+        job->parent = parent;
+        return job;
+      }
+      // continuation is queued only after job has finished; call before run(continuation)
+      void then(const JobHandle& job, const JobHandle& continuation) {
+        std::lock_guard<std::mutex> lock(job->continuation_lock);
+        if (job->done)
+          return;
+        continuation->dependencies.fetch_add(1, std::memory_order_relaxed);
+        job->continuations.push_back(continuation);
+      }
+      // Queues job once its dependencies are done; once per job
+      void run(const JobHandle& job) {
+        release(job);
+      }
+      JobHandle submit(std::function<void()> work) {
+        JobHandle job = create(std::move(work));
+        run(job);
+        return job;
+      }
+      // Runs other jobs until job has finished
+      void wait(const JobHandle& job) {
+        while (not job->finished())
+          if (not executeOne())
+            std::this_thread::yield();
+      }
+
+      // op(begin, end) over [begin, end) in pieces of at least grain elements,
+      // returning when all are done. A piece splits its upper half off as a job
+      // for others to steal while the running thread's deque is short, so ranges
+      // split further where threads are idle and run whole where they aren't.
+      // grain 0 picks about 8 pieces per thread
+      template <class Op>
+      void parallelFor(size_t begin, size_t end, size_t grain, Op op) {
+        if (end <= begin)
+          return;
+        if (grain == 0)
+          grain = (end - begin + 8 * threadCount() - 1) / (8 * threadCount());
+        if (threadCount() == 1 or end - begin <= grain) {
+          op(begin, end);
+          return;
+        }
+        JobHandle group = create(std::function<void()>());
+        forRange(group, begin, end, grain, op);
+        run(group);
+        wait(group);
+      }
+
+    private :
+      struct ThreadSlot {
+        const JobSystem* system;
+        size_t index;
+      };
+
+      std::vector<std::unique_ptr<JobDeque>> deques;
+      std::vector<std::thread> workers;
+      // Jobs started from threads without a deque
+      std::mutex shared_lock;
+      std::deque<Job*> shared_queue;
+      std::mutex sleep_lock;
+      std::condition_variable sleep_signal;
+      bool stopping;
+      std::atomic<int> sleepers;
+      // Bumped whenever a job is queued, so a worker going to sleep can tell it missed one
+      std::atomic<uint64_t> epoch;
+
+      static ThreadSlot& threadSlot() {
+        static thread_local ThreadSlot slot = {nullptr, 0};
+        return slot;
+      }
+      JobDeque* ownDeque() const {
+        const ThreadSlot& slot = threadSlot();
+        return slot.system == this ? deques[slot.index].get() : nullptr;
+      }
+
+      template <class Op>
+      void forRange(const JobHandle& group, size_t begin, size_t end, size_t grain, Op& op) {
+        JobDeque* own = ownDeque();
+        while (end - begin > grain) {
+          if (own != nullptr and own->size() >= 2) {
+            // Enough queued here for thieves; keep the rest
+            op(begin, begin + grain);
+            begin += grain;
+            continue;
+          }
+          size_t mid = begin + (end - begin) / 2;
+          Op* shared_op = &op;
+          run(createChild(group, [this, group, mid, end, grain, shared_op]() {
+            forRange(group, mid, end, grain, *shared_op);
+          }));
+          end = mid;
+          own = ownDeque();
+        }
+        op(begin, end);
+      }
+
+      void release(const JobHandle& job) {
+        if (job->dependencies.fetch_sub(1, std::memory_order_acq_rel) != 1)
+          return;
+        job->self = job;
+        JobDeque* own = ownDeque();
+        if (own != nullptr) {
+          if (not own->push(job.get())) {
+            // Full; run it here rather than block
+            execute(job.get());
+            return;
+          }
+        }
+        else {
+          std::lock_guard<std::mutex> lock(shared_lock);
+          shared_queue.push_back(job.get());
+        }
+        epoch.fetch_add(1);
+        if (sleepers.load() > 0) {
+          std::lock_guard<std::mutex> lock(sleep_lock);
+          sleep_signal.notify_one();
+        }
+      }
+
+      void execute(Job* job) {
+        if (job->work)
+          job->work();
+        finish(job);
+      }
+      void finish(Job* job) {
+        if (job->unfinished.fetch_sub(1, std::memory_order_acq_rel) != 1)
+          return;
+        JobHandle keep = std::move(job->self);
+        std::vector<JobHandle> next;
+        {
+          std::lock_guard<std::mutex> lock(job->continuation_lock);
+          job->done = true;
+          next.swap(job->continuations);
+        }
+        for (const JobHandle& continuation : next)
+          release(continuation);
+        JobHandle parent = std::move(job->parent);
+        if (parent)
+          finish(parent.get());
+      }
+
+      // Runs one job from this thread's deque, another worker's or the shared queue
+      bool executeOne() {
+        const ThreadSlot& slot = threadSlot();
+        size_t own = slot.system == this ? slot.index : 0;
+        Job* job = nullptr;
+        if (slot.system == this)
+          job = deques[own]->pop();
+        for (size_t k = 1; job == nullptr and k <= deques.size(); ++k)
+          job = deques[(own + k) % deques.size()]->steal();
+        if (job == nullptr) {
+          std::lock_guard<std::mutex> lock(shared_lock);
+          if (not shared_queue.empty()) {
+            job = shared_queue.front();
+            shared_queue.pop_front();
+          }
+        }
+        if (job == nullptr)
+          return false;
+        execute(job);
+        return true;
+      }
+
+      void workerLoop(size_t index) {
+        threadSlot() = {this, index};
+        int idle = 0;
+        for (;;) {
+          uint64_t seen = epoch.load();
+          if (executeOne()) {
+            idle = 0;
+            continue;
+          }
+          if (++idle < idle_spins) {
+            std::this_thread::yield();
+            continue;
+          }
+          std::unique_lock<std::mutex> lock(sleep_lock);
+          if (stopping)
+            return;
+          ++sleepers;
+          sleep_signal.wait(lock, [&]() { return stopping or epoch.load() != seen; });
+          --sleepers;
+          idle = 0;
+        }
+      }
+  };
+
+#endif
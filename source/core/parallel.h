@@ -0,0 +1,59 @@
+#if !defined(PARALLEL_H_INCLUDED)
+  #define PARALLEL_H_INCLUDED
+
+  #include <atomic>
+  #include <stddef.h>
+  #include "job_system.h"
+
+  // Runs op(begin, end) over [0, n) split into up to `threads` contiguous chunks of
+  // at least min_chunk elements, as jobs on JobSystem::shared(). The calling
+  // thread takes the first chunk and helps with the rest, so small ranges never
+  // touch the job system
+  template <class Op>
+  inline void parallelChunks(size_t n, unsigned threads, size_t min_chunk, Op op) {
+    if (min_chunk == 0)
+      min_chunk = 1;
+    size_t chunks = (n + min_chunk - 1) / min_chunk;
+    if (chunks > threads)
+      chunks = threads;
+    if (chunks <= 1) {
+      if (n != 0)
+        op(size_t(0), n);
+      return;
+    }
+    JobSystem& jobs = JobSystem::shared();
+    JobHandle group = jobs.create(std::function<void()>());
+    for (size_t c = 1; c < chunks; ++c)
+      jobs.run(jobs.createChild(group, [&op, n, c, chunks]() { op(n * c / chunks, n * (c + 1) / chunks); }));
+    op(size_t(0), n / chunks);
+    jobs.run(group);
+    jobs.wait(group);
+  }
+
+  // Runs op(i) for every i in [0, n) on up to `threads` threads of
+  // JobSystem::shared(), each taking the next index as it finishes the last, for
+  // tasks of uneven cost
+  template <class Op>
+  inline void parallelTasks(size_t n, unsigned threads, Op op) {
+    if (threads > n)
+      threads = unsigned(n);
+    if (threads <= 1) {
+      for (size_t i = 0; i < n; ++i)
+        op(i);
+      return;
+    }
+    std::atomic<size_t> next(0);
+    auto work = [&]() {
+      for (size_t i = next++; i < n; i = next++)
+        op(i);
+    };
+    JobSystem& jobs = JobSystem::shared();
+    JobHandle group = jobs.create(std::function<void()>());
+    for (unsigned t = 1; t < threads; ++t)
+      jobs.run(jobs.createChild(group, work));
+    work();
+    jobs.run(group);
+    jobs.wait(group);
+  }
+
+#endif
@@ -0,0 +1,140 @@
+#if !defined(AABB_H_INCLUDED)
+  #define AABB_H_INCLUDED
+
+  #include <limits>
+  #include "vector.h"
+
+  // Axis-aligned bounding box. The default box is empty, with min above max, so
+  // merging anything into it gives that thing's bounds
+  template <typename num_type = float>
+  class AABB {
+    public :
+      Vector3<num_type> min;
+      Vector3<num_type> max;
+
+      AABB() : min(std::numeric_limits<num_type>::infinity()), max(-std::numeric_limits<num_type>::infinity()) {}
+      template <typename other_num_type>
+      AABB(const Vector3<other_num_type>& lower, const Vector3<other_num_type>& upper) : min(lower), max(upper) {}
+      template <typename other_num_type>
+      AABB(const AABB<other_num_type>& box) : min(box.min), max(box.max) {}
+      // Bounds of a sphere
+      template <typename other_num_type>
+      static AABB<num_type> fromSphere(const Vector3<other_num_type>& center, other_num_type radius) {
+        Vector3<num_type> r = Vector3<num_type>(num_type(radius));
+        return AABB<num_type>(Vector3<num_type>(center).from(r), Vector3<num_type>(center).add(r));
+      }
+      template <typename other_num_type>
+      static AABB<num_type> fromCenterExtents(const Vector3<other_num_type>& center, const Vector3<other_num_type>& half_extents) {
+        return AABB<num_type>(Vector3<num_type>(center).from(half_extents), Vector3<num_type>(center).add(half_extents));
+      }
+
+      bool empty() const {
+        return min.x > max.x or min.y > max.y or min.z > max.z;
+      }
+      Vector3<num_type> center() const {
+        return (min + max) * num_type(0.5);
+      }
+      Vector3<num_type> size() const {
+        return max.from(min);
+      }
+      Vector3<num_type> halfExtents() const {
+        return max.from(min) * num_type(0.5);
+      }
+      num_type surfaceArea() const {
+        if (empty())
+          return 0;
+        Vector3<num_type> s = size();
+        return 2 * (s.x * s.y + s.y * s.z + s.z * s.x);
+      }
+      num_type volume() const {
+        if (empty())
+          return 0;
+        Vector3<num_type> s = size();
+        return s.x * s.y * s.z;
+      }
+      // Index of the longest side, 0, 1 or 2 for x, y or z
+      int longestAxis() const {
+        Vector3<num_type> s = size();
+        return s.x >= s.y and s.x >= s.z ? 0 : (s.y >= s.z ? 1 : 2);
+      }
+
+      // Growing
+      template <typename other_num_type>
+      AABB<num_type> merged(const Vector3<other_num_type>& p) const {
+        return AABB<num_type>(Vector3<num_type>(p.x < min.x ? num_type(p.x) : min.x, p.y < min.y ? num_type(p.y) : min.y, p.z < min.z ? num_type(p.z) : min.z),
+                              Vector3<num_type>(p.x > max.x ? num_type(p.x) : max.x, p.y > max.y ? num_type(p.y) : max.y, p.z > max.z ? num_type(p.z) : max.z));
+      }
+      template <typename other_num_type>
+      AABB<num_type> merged(const AABB<other_num_type>& box) const {
+        return AABB<num_type>(Vector3<num_type>(box.min.x < min.x ? num_type(box.min.x) : min.x, box.min.y < min.y ? num_type(box.min.y) : min.y, box.min.z < min.z ? num_type(box.min.z) : min.z),
+                              Vector3<num_type>(box.max.x > max.x ? num_type(box.max.x) : max.x, box.max.y > max.y ? num_type(box.max.y) : max.y, box.max.z > max.z ? num_type(box.max.z) : max.z));
+      }
+      template <typename other_num_type>
+      AABB<num_type> expanded(other_num_type margin) const {
+        Vector3<num_type> m = Vector3<num_type>(num_type(margin));
+        return AABB<num_type>(min.from(m), max.add(m));
+      }
+      template <typename other_num_type>
+      AABB<num_type> intersection(const AABB<other_num_type>& box) const {
+        return AABB<num_type>(Vector3<num_type>(box.min.x > min.x ? num_type(box.min.x) : min.x, box.min.y > min.y ? num_type(box.min.y) : min.y, box.min.z > min.z ? num_type(box.min.z) : min.z),
+                              Vector3<num_type>(box.max.x < max.x ? num_type(box.max.x) : max.x, box.max.y < max.y ? num_type(box.max.y) : max.y, box.max.z < max.z ? num_type(box.max.z) : max.z));
+      }
+
+      // Tests, all inclusive of the boundary
+      template <typename other_num_type>
+      bool contains(const Vector3<other_num_type>& p) const {
+        return p.x >= min.x and p.x <= max.x and p.y >= min.y and p.y <= max.y and p.z >= min.z and p.z <= max.z;
+      }
+      template <typename other_num_type>
+      bool contains(const AABB<other_num_type>& box) const {
+        return contains(box.min) and contains(box.max);
+      }
+      template <typename other_num_type>
+      bool overlaps(const AABB<other_num_type>& box) const {
+        return box.min.x <= max.x and box.max.x >= min.x and box.min.y <= max.y and box.max.y >= min.y
+           and box.min.z <= max.z and box.max.z >= min.z;
+      }
+      // Squared distance from p to the nearest point of the box, zero inside
+      template <typename other_num_type>
+      num_type sqrDistance(const Vector3<other_num_type>& p) const {
+        num_type dx = p.x < min.x ? min.x - p.x : (p.x > max.x ? p.x - max.x : num_type(0));
+        num_type dy = p.y < min.y ? min.y - p.y : (p.y > max.y ? p.y - max.y : num_type(0));
+        num_type dz = p.z < min.z ? min.z - p.z : (p.z > max.z ? p.z - max.z : num_type(0));
+        return dx * dx + dy * dy + dz * dz;
+      }
+      template <typename other_num_type>
+      bool overlapsSphere(const Vector3<other_num_type>& center, other_num_type radius) const {
+        return sqrDistance(center) <= num_type(radius) * num_type(radius);
+      }
+      // Slab test against origin + t * direction for t in [t_min, t_max], given
+      // 1 / direction. On a hit, t_min becomes the entry distance; on a miss it
+      // is left alone
+      bool intersectRay(const Vector3<num_type>& origin, const Vector3<num_type>& inv_direction,
+                        num_type& t_min, num_type t_max) const {
+        num_type t_near = t_min;
+        for (int a = 0; a < 3; ++a) {
+          // Near plane by the sign, so a NaN from 0 * inf keeps the running bounds
+          bool backwards = inv_direction[a] < 0;
+          num_type t_0 = ((backwards ? max[a] : min[a]) - origin[a]) * inv_direction[a];
+          num_type t_1 = ((backwards ? min[a] : max[a]) - origin[a]) * inv_direction[a];
+          t_near = t_0 > t_near ? t_0 : t_near;
+          t_max = t_1 < t_max ? t_1 : t_max;
+          if (t_near > t_max)
+            return false;
+        }
+        t_min = t_near;
+        return true;
+      }
+
+      // Operators
+      template <typename other_num_type>
+      bool operator==(const AABB<other_num_type>& box) const {return min == box.min and max == box.max;}
+      template <typename other_num_type>
+      bool operator!=(const AABB<other_num_type>& box) const {return not (*this == box);}
+      template <typename other_num_type>
+      AABB<num_type>& operator+=(const Vector3<other_num_type>& p) {return *this = merged(p);}
+      template <typename other_num_type>
+      AABB<num_type>& operator+=(const AABB<other_num_type>& box) {return *this = merged(box);}
+  };
+
+#endif
@@ -0,0 +1,516 @@
+#if !defined(BVH_H_INCLUDED)
+  #define BVH_H_INCLUDED
+
+  #include <algorithm>
+  #include <limits>
+  #include <memory>
+  #include <stdint.h>
+  #include <vector>
+  #include "aabb.h"
+  #include "../core/job_system.h"
+  #if defined(__SSE2__)
+    #include <immintrin.h>
+  #endif
+
+  // Entry distances of a ray into four boxes stored as bounds[min/max][axis][box],
+  // with bit c of the result set when box c is hit within [t_min, t_max]. near[a]
+  // is 1 where the ray runs towards -a, so the near plane is always the first
+  // one crossed. The SIMD overloads test all four boxes at once
+  template <typename num_type>
+  inline int slabTest4(const num_type bounds[2][3][4], const num_type origin[3], const num_type inv_direction[3],
+                       const int near[3], num_type t_min, num_type t_max, num_type t_near[4]) {
+    int mask = 0;
+    for (int c = 0; c < 4; ++c) {
+      num_type t_0 = t_min, t_1 = t_max;
+      for (int a = 0; a < 3; ++a) {
+        num_type n = (bounds[near[a]][a][c] - origin[a]) * inv_direction[a];
+        num_type f = (bounds[1 - near[a]][a][c] - origin[a]) * inv_direction[a];
+        t_0 = n > t_0 ? n : t_0;
+        t_1 = f < t_1 ? f : t_1;
+      }
+      t_near[c] = t_0;
+      mask |= int(t_0 <= t_1) << c;
+    }
+    return mask;
+  }
+  #if defined(__SSE2__)
+    inline int slabTest4(const float bounds[2][3][4], const float origin[3], const float inv_direction[3],
+                         const int near[3], float t_min, float t_max, float t_near[4]) {
+      __m128 t_0 = _mm_set1_ps(t_min), t_1 = _mm_set1_ps(t_max);
+      for (int a = 0; a < 3; ++a) {
+        __m128 o = _mm_set1_ps(origin[a]), inv = _mm_set1_ps(inv_direction[a]);
+        t_0 = _mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(bounds[near[a]][a]), o), inv), t_0);
+        t_1 = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(bounds[1 - near[a]][a]), o), inv), t_1);
+      }
+      _mm_storeu_ps(t_near, t_0);
+      return _mm_movemask_ps(_mm_cmple_ps(t_0, t_1));
+    }
+  #endif
+  #if defined(__AVX__)
+    inline int slabTest4(const double bounds[2][3][4], const double origin[3], const double inv_direction[3],
+                         const int near[3], double t_min, double t_max, double t_near[4]) {
+      __m256d t_0 = _mm256_set1_pd(t_min), t_1 = _mm256_set1_pd(t_max);
+      for (int a = 0; a < 3; ++a) {
+        __m256d o = _mm256_set1_pd(origin[a]), inv = _mm256_set1_pd(inv_direction[a]);
+        t_0 = _mm256_max_pd(_mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(bounds[near[a]][a]), o), inv), t_0);
+        t_1 = _mm256_min_pd(_mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(bounds[1 - near[a]][a]), o), inv), t_1);
+      }
+      _mm256_storeu_pd(t_near, t_0);
+      return _mm256_movemask_pd(_mm256_cmp_pd(t_0, t_1, _CMP_LE_OQ));
+    }
+  #endif
+
+  // Closest hit of a ray query; primitive is BVH::none on a miss
+  template <typename num_type = float>
+  struct RayHit {
+    uint32_t primitive;
+    num_type t;
+  };
+
+  // Bounding volume hierarchy over primitives given by their boxes. build() makes
+  // a binary tree with a binned surface area heuristic, building independent
+  // subtrees as jobs on JobSystem::shared(), then collapses it into nodes of four children
+  // whose bounds are stored axis by axis, so one SIMD slab test covers a whole
+  // node. Leaves hold up to four primitive boxes in the same layout, so a leaf
+  // costs one more slab test. Nodes are in depth-first order, every child after
+  // its parent, which is what lets refit() update all bounds in one backwards
+  // pass without touching the topology.
+  //
+  // raycast also takes a callback for exact primitive tests, so the tree works
+  // for triangles and other shapes as well as for boxes.
+  template <typename num_type = float>
+  class BVH {
+    public :
+      static constexpr uint32_t none = 0xFFFFFFFF;
+      static constexpr size_t bin_count = 16;
+      static constexpr size_t max_leaf_size = 4;
+      // Smallest subtree worth a job of its own
+      static constexpr size_t min_parallel = 16384;
+      // Binary depth after which splits fall back to the median, which bounds the
+      // depth of the tree and so the traversal stack
+      static constexpr size_t max_sah_depth = 48;
+      static constexpr size_t stack_size = 256;
+
+      struct Node {
+        num_type bounds[2][3][4];
+        // Node index when count is 0, otherwise the index of a Leaf holding count
+        // primitives. Unused slots have count 0, child none and empty bounds
+        uint32_t child[4];
+        uint32_t count[4];
+      };
+      struct Leaf {
+        num_type bounds[2][3][4];
+        uint32_t primitive[4];
+      };
+
+      BVH() : primitive_count(0) {}
+
+      void build(const AABB<num_type>* boxes, size_t n, unsigned threads = 1) {
+        nodes.clear();
+        leaves.clear();
+        primitive_count = n;
+        if (n == 0)
+          return;
+        // Partitioned in place, so every pass over a range reads memory in order
+        std::vector<BuildPrimitive> primitives(n);
+        AABB<num_type> bounds;
+        for (size_t i = 0; i < n; ++i) {
+          primitives[i] = {boxes[i], boxes[i].center(), uint32_t(i)};
+          bounds += boxes[i];
+        }
+        std::unique_ptr<BuildNode> root = buildRange(primitives.data(), 0, n, bounds, 0, threads == 0 ? 1 : threads);
+        nodes.reserve(n / 6 + 1);
+        leaves.reserve(n / 2 + 1);
+        if (root->left)
+          flatten(primitives.data(), root.get());
+        else {
+          // A single leaf still gets a node, so queries always start at node 0
+          nodes.push_back(Node());
+          clearBoxes(nodes[0].bounds, nodes[0].child, nodes[0].count);
+          setSlot(0, 0, root->bounds, addLeaf(primitives.data(), root.get()), root->count);
+        }
+      }
+      void build(const std::vector<AABB<num_type>>& boxes, unsigned threads = 1) {
+        build(boxes.data(), boxes.size(), threads);
+      }
+      // Updates every bound for moved primitives, keeping the tree as built. boxes
+      // must describe the same primitives as in build. Cheap, but the tree
+      // degrades as primitives drift from where they were at the last build
+      void refit(const AABB<num_type>* boxes) {
+        for (Leaf& leaf : leaves)
+          for (int k = 0; k < 4 and leaf.primitive[k] != none; ++k)
+            setBox(leaf.bounds, k, boxes[leaf.primitive[k]]);
+        for (size_t i = nodes.size(); i-- > 0;) {
+          Node& node = nodes[i];
+          for (int c = 0; c < 4; ++c) {
+            if (node.count[c] != 0)
+              setBox(node.bounds, c, boundsOf(leaves[node.child[c]].bounds, node.count[c]));
+            else if (node.child[c] != none)
+              setBox(node.bounds, c, boundsOf(nodes[node.child[c]].bounds, 4));
+          }
+        }
+      }
+      void refit(const std::vector<AABB<num_type>>& boxes) {
+        refit(boxes.data());
+      }
+
+      size_t size() const {
+        return primitive_count;
+      }
+      size_t nodeCount() const {
+        return nodes.size();
+      }
+      AABB<num_type> bounds() const {
+        return nodes.empty() ? AABB<num_type>() : boundsOf(nodes[0].bounds, 4);
+      }
+      // For traversals kept elsewhere, such as ray packets; node 0 is the root
+      const Node& node(size_t i) const {
+        return nodes[i];
+      }
+      const Leaf& leaf(size_t i) const {
+        return leaves[i];
+      }
+
+      // Closest primitive box along origin + t * direction for t in [0, t_max]
+      RayHit<num_type> raycast(const Vector3<num_type>& origin, const Vector3<num_type>& direction,
+                               num_type t_max = std::numeric_limits<num_type>::infinity()) const {
+        return closestHit(Ray(origin, direction), t_max, [](uint32_t, num_type t_box, num_type) { return t_box; });
+      }
+      // As above, with hit(primitive, t_max) giving the exact distance to a
+      // primitive whose box the ray reaches, or anything not below t_max on a miss
+      template <class Hit>
+      RayHit<num_type> raycast(const Vector3<num_type>& origin, const Vector3<num_type>& direction,
+                               num_type t_max, Hit hit) const {
+        return closestHit(Ray(origin, direction), t_max,
+                          [&](uint32_t primitive, num_type, num_type t) { return hit(primitive, t); });
+      }
+      // Closest hit on the segment from a to b, with t in [0, 1] along it
+      RayHit<num_type> segmentCast(const Vector3<num_type>& a, const Vector3<num_type>& b) const {
+        return raycast(a, b.from(a), num_type(1));
+      }
+
+      // Appends every primitive whose box touches the sphere or box, and returns how many
+      template <typename other_num_type>
+      size_t overlapSphere(const Vector3<other_num_type>& center, other_num_type radius, std::vector<uint32_t>& out) const {
+        Vector3<num_type> c(center);
+        num_type r = num_type(radius), sqr_r = r * r;
+        return overlap(AABB<num_type>::fromSphere(c, r), out,
+                       [&](const AABB<num_type>& box) { return box.sqrDistance(c) <= sqr_r; });
+      }
+      template <typename other_num_type>
+      size_t overlapBox(const AABB<other_num_type>& query, std::vector<uint32_t>& out) const {
+        AABB<num_type> q(query);
+        return overlap(q, out, [&](const AABB<num_type>& box) { return box.overlaps(q); });
+      }
+
+    private :
+      struct BuildNode {
+        AABB<num_type> bounds;
+        std::unique_ptr<BuildNode> left, right;
+        uint32_t first, count;
+      };
+      struct BuildPrimitive {
+        AABB<num_type> box;
+        Vector3<num_type> centroid;
+        uint32_t index;
+      };
+      struct Ray {
+        num_type origin[3], inv[3];
+        int near[3];
+        // A zero component gives an infinite inverse, and 0 * inf = NaN where the
+        // origin lies on a plane; the slab tests keep their running bound on NaN
+        Ray(const Vector3<num_type>& o, const Vector3<num_type>& d) {
+          for (int a = 0; a < 3; ++a) {
+            origin[a] = o[a];
+            inv[a] = 1 / d[a];
+            near[a] = inv[a] < 0;
+          }
+        }
+      };
+
+      std::vector<Node> nodes;
+      std::vector<Leaf> leaves;
+      size_t primitive_count;
+
+      static void setBox(num_type bounds[2][3][4], int c, const AABB<num_type>& box) {
+        for (int a = 0; a < 3; ++a) {
+          bounds[0][a][c] = box.min[a];
+          bounds[1][a][c] = box.max[a];
+        }
+      }
+      static AABB<num_type> getBox(const num_type bounds[2][3][4], int c) {
+        return AABB<num_type>(Vector3<num_type>(bounds[0][0][c], bounds[0][1][c], bounds[0][2][c]),
+                              Vector3<num_type>(bounds[1][0][c], bounds[1][1][c], bounds[1][2][c]));
+      }
+      // Union of the first count boxes; empty slots are empty boxes, so including them changes nothing
+      static AABB<num_type> boundsOf(const num_type bounds[2][3][4], uint32_t count) {
+        AABB<num_type> box;
+        for (uint32_t c = 0; c < count; ++c)
+          box += getBox(bounds, int(c));
+        return box;
+      }
+      static void clearBoxes(num_type bounds[2][3][4], uint32_t ids[4], uint32_t counts[4]) {
+        for (int c = 0; c < 4; ++c) {
+          setBox(bounds, c, AABB<num_type>());
+          ids[c] = none;
+          if (counts)
+            counts[c] = 0;
+        }
+      }
+      void setSlot(size_t n, int c, const AABB<num_type>& box, uint32_t child, uint32_t count) {
+        setBox(nodes[n].bounds, c, box);
+        nodes[n].child[c] = child;
+        nodes[n].count[c] = count;
+      }
+
+      // bounds is the union of the primitive boxes in [begin, end)
+      std::unique_ptr<BuildNode> buildRange(BuildPrimitive* primitives, size_t begin, size_t end,
+                                            const AABB<num_type>& bounds, size_t depth, unsigned threads) {
+        std::unique_ptr<BuildNode> node(new BuildNode());
+        node->bounds = bounds;
+        node->first = uint32_t(begin);
+        node->count = uint32_t(end - begin);
+        if (end - begin <= max_leaf_size)
+          return node;
+        AABB<num_type> centroid_bounds;
+        for (size_t i = begin; i < end; ++i)
+          centroid_bounds += primitives[i].centroid;
+
+        AABB<num_type> left, right;
+        size_t mid = depth < max_sah_depth ? splitSAH(primitives, begin, end, centroid_bounds, left, right) : begin;
+        if (mid == begin or mid == end) {
+          // Every centroid in one bin, or too deep: split at the median of the longest axis
+          int axis = centroid_bounds.longestAxis();
+          mid = (begin + end) / 2;
+          std::nth_element(primitives + begin, primitives + mid, primitives + end, [&](const BuildPrimitive& a, const BuildPrimitive& b) {
+            return a.centroid[axis] < b.centroid[axis];
+          });
+          left = right = AABB<num_type>();
+          for (size_t i = begin; i < mid; ++i)
+            left += primitives[i].box;
+          for (size_t i = mid; i < end; ++i)
+            right += primitives[i].box;
+        }
+
+        if (threads > 1 and mid - begin >= min_parallel and end - mid >= min_parallel) {
+          unsigned left_threads = threads / 2;
+          JobSystem& jobs = JobSystem::shared();
+          JobHandle job = jobs.create([&]() { node->left = buildRange(primitives, begin, mid, left, depth + 1, left_threads); });
+          jobs.run(job);
+          node->right = buildRange(primitives, mid, end, right, depth + 1, threads - left_threads);
+          jobs.wait(job);
+        }
+        else {
+          node->left = buildRange(primitives, begin, mid, left, depth + 1, threads);
+          node->right = buildRange(primitives, mid, end, right, depth + 1, threads);
+        }
+        return node;
+      }
+
+      // Partitions [begin, end) at the cheapest of the bin boundaries on all three
+      // axes and returns the split point with the bounds of both sides, or begin
+      // when no boundary separates anything
+      size_t splitSAH(BuildPrimitive* primitives, size_t begin, size_t end, const AABB<num_type>& centroid_bounds,
+                      AABB<num_type>& left, AABB<num_type>& right) {
+        AABB<num_type> bin_bounds[3][bin_count];
+        size_t bin_counts[3][bin_count] = {};
+        num_type lower[3] = {centroid_bounds.min.x, centroid_bounds.min.y, centroid_bounds.min.z};
+        num_type scale[3];
+        for (int a = 0; a < 3; ++a) {
+          num_type extent = centroid_bounds.max[a] - lower[a];
+          scale[a] = extent > 0 ? num_type(bin_count) * (1 - std::numeric_limits<num_type>::epsilon()) / extent : num_type(0);
+        }
+        for (size_t i = begin; i < end; ++i) {
+          const Vector3<num_type>& c = primitives[i].centroid;
+          size_t b[3] = {binOf(c.x, lower[0], scale[0]), binOf(c.y, lower[1], scale[1]), binOf(c.z, lower[2], scale[2])};
+          for (int a = 0; a < 3; ++a) {
+            ++bin_counts[a][b[a]];
+            bin_bounds[a][b[a]] += primitives[i].box;
+          }
+        }
+
+        // Cost of a split is area * count summed over both sides; the constant
+        // traversal cost and the division by the parent's area don't change the choice
+        num_type best_cost = std::numeric_limits<num_type>::infinity();
+        int best_axis = -1;
+        size_t best_bin = 0;
+        for (int a = 0; a < 3; ++a) {
+          if (scale[a] == 0)
+            continue;
+          num_type right_cost[bin_count];
+          AABB<num_type> box;
+          size_t count = 0;
+          for (size_t b = bin_count; b-- > 1;) {
+            box += bin_bounds[a][b];
+            count += bin_counts[a][b];
+            right_cost[b] = box.surfaceArea() * num_type(count);
+          }
+          box = AABB<num_type>();
+          count = 0;
+          for (size_t b = 0; b + 1 < bin_count; ++b) {
+            box += bin_bounds[a][b];
+            count += bin_counts[a][b];
+            num_type cost = box.surfaceArea() * num_type(count) + right_cost[b + 1];
+            if (count != 0 and count != end - begin and cost < best_cost) {
+              best_cost = cost;
+              best_axis = a;
+              best_bin = b;
+            }
+          }
+        }
+        if (best_axis < 0)
+          return begin;
+        int a = best_axis;
+        for (size_t b = 0; b < bin_count; ++b)
+          (b <= best_bin ? left : right) += bin_bounds[a][b];
+        num_type low = lower[a], s = scale[a];
+        BuildPrimitive* split = std::partition(primitives + begin, primitives + end, [&](const BuildPrimitive& p) {
+          const Vector3<num_type>& c = p.centroid;
+          return binOf(a == 0 ? c.x : (a == 1 ? c.y : c.z), low, s) <= best_bin;
+        });
+        return size_t(split - primitives);
+      }
+      static size_t binOf(num_type x, num_type lower, num_type scale) {
+        int b = int((x - lower) * scale);
+        return b < int(bin_count) ? size_t(b) : bin_count - 1;
+      }
+
+      uint32_t addLeaf(const BuildPrimitive* primitives, const BuildNode* build_node) {
+        Leaf leaf;
+        clearBoxes(leaf.bounds, leaf.primitive, nullptr);
+        for (uint32_t k = 0; k < build_node->count; ++k) {
+          const BuildPrimitive& p = primitives[build_node->first + k];
+          leaf.primitive[k] = p.index;
+          setBox(leaf.bounds, int(k), p.box);
+        }
+        leaves.push_back(leaf);
+        return uint32_t(leaves.size() - 1);
+      }
+
+      // Emits the node for an inner BuildNode, taking as its children up to four
+      // descendants found by repeatedly opening the inner one with the largest area
+      uint32_t flatten(const BuildPrimitive* primitives, const BuildNode* build_node) {
+        const BuildNode* slots[4] = {build_node->left.get(), build_node->right.get(), nullptr, nullptr};
+        int used = 2;
+        while (used < 4) {
+          int open = -1;
+          num_type area = -1;
+          for (int c = 0; c < used; ++c)
+            if (slots[c]->left and slots[c]->bounds.surfaceArea() > area) {
+              open = c;
+              area = slots[c]->bounds.surfaceArea();
+            }
+          if (open < 0)
+            break;
+          const BuildNode* opened = slots[open];
+          slots[open] = opened->left.get();
+          slots[used++] = opened->right.get();
+        }
+        uint32_t index = uint32_t(nodes.size());
+        nodes.push_back(Node());
+        clearBoxes(nodes[index].bounds, nodes[index].child, nodes[index].count);
+        for (int c = 0; c < used; ++c) {
+          if (slots[c]->left) {
+            uint32_t child = flatten(primitives, slots[c]);
+            setSlot(index, c, slots[c]->bounds, child, 0);
+          }
+          else
+            setSlot(index, c, slots[c]->bounds, addLeaf(primitives, slots[c]), slots[c]->count);
+        }
+        return index;
+      }
+
+      // Front to back traversal. test(primitive, t_box, t_max) returns the distance
+      // to a primitive whose box the ray enters at t_box, or t_max or more on a miss
+      template <class Test>
+      RayHit<num_type> closestHit(const Ray& ray, num_type t_max, Test test) const {
+        RayHit<num_type> result = {none, t_max};
+        if (nodes.empty())
+          return result;
+        struct Entry {
+          uint32_t node;
+          num_type t;
+        };
+        Entry stack[stack_size];
+        size_t top = 0;
+        stack[top++] = {0, 0};
+        while (top != 0) {
+          Entry entry = stack[--top];
+          if (entry.t > result.t)
+            continue;
+          const Node& node = nodes[entry.node];
+          num_type t_near[4];
+          int mask = slabTest4(node.bounds, ray.origin, ray.inv, ray.near, num_type(0), result.t, t_near);
+          Entry inner[4];
+          int inner_count = 0;
+          for (; mask != 0; mask &= mask - 1) {
+            int c = lowestBit(mask);
+            if (node.count[c] == 0) {
+              // Insertion sort, farthest first, so the nearest child is pushed last and popped first
+              int k = inner_count++;
+              for (; k > 0 and inner[k - 1].t < t_near[c]; --k)
+                inner[k] = inner[k - 1];
+              inner[k] = {node.child[c], t_near[c]};
+            }
+            else if (t_near[c] <= result.t) {
+              const Leaf& leaf = leaves[node.child[c]];
+              num_type t_box[4];
+              for (int hits = slabTest4(leaf.bounds, ray.origin, ray.inv, ray.near, num_type(0), result.t, t_box);
+                   hits != 0; hits &= hits - 1) {
+                int k = lowestBit(hits);
+                num_type t = test(leaf.primitive[k], t_box[k], result.t);
+                if (t < result.t) {
+                  result.t = t;
+                  result.primitive = leaf.primitive[k];
+                }
+              }
+            }
+          }
+          for (int k = 0; k < inner_count; ++k)
+            stack[top++] = inner[k];
+        }
+        return result;
+      }
+
+      template <class Test>
+      size_t overlap(const AABB<num_type>& query, std::vector<uint32_t>& out, Test test) const {
+        size_t found = out.size();
+        if (nodes.empty())
+          return 0;
+        uint32_t stack[stack_size];
+        size_t top = 0;
+        stack[top++] = 0;
+        while (top != 0) {
+          const Node& node = nodes[stack[--top]];
+          for (int c = 0; c < 4; ++c) {
+            bool hit = node.bounds[0][0][c] <= query.max.x and node.bounds[1][0][c] >= query.min.x
+                   and node.bounds[0][1][c] <= query.max.y and node.bounds[1][1][c] >= query.min.y
+                   and node.bounds[0][2][c] <= query.max.z and node.bounds[1][2][c] >= query.min.z;
+            if (not hit)
+              continue;
+            if (node.count[c] == 0)
+              stack[top++] = node.child[c];
+            else {
+              const Leaf& leaf = leaves[node.child[c]];
+              for (uint32_t k = 0; k < node.count[c]; ++k)
+                if (test(getBox(leaf.bounds, int(k))))
+                  out.push_back(leaf.primitive[k]);
+            }
+          }
+        }
+        return out.size() - found;
+      }
+
+      static int lowestBit(int mask) {
+        #if defined(__GNUC__)
+          return __builtin_ctz(unsigned(mask));
+        #else
+          int c = 0;
+          while (not (mask & (1 << c)))
+            ++c;
+          return c;
+        #endif
+      }
+  };
+
+#endif
@@ -3,6 +3,7 @@
 
   #include <math.h>
   #include <limits>
+  #include "precision.h"
 
   template <typename num_type = float>
   class Complex {
@@ -10,36 +11,34 @@
       num_type re;
       num_type im;
       
-      Complex() {re = 0; im = 0;}
+      constexpr Complex() : re(0), im(0) {}
       
       template <typename other_num_type>
-      Complex(other_num_type a, other_num_type b) {re = a; im = b;}
+      constexpr Complex(other_num_type a, other_num_type b) : re(a), im(b) {}
       template <typename other_num_type>
-      Complex<num_type>& operator=(const Complex<other_num_type>& z) {
-        re = z.re; im = re.im;
+      constexpr Complex<num_type>& operator=(const Complex<other_num_type>& z) {
+        re = z.re; im = z.im;
         return *this;
       }
       template <typename other_num_type>
-      Complex(const Complex<other_num_type>& z) {
-        *this = z;
-      }
+      constexpr Complex(const Complex<other_num_type>& z) : re(z.re), im(z.im) {}
       
-      num_type real() const {
+      constexpr num_type real() const {
         return re;
       }
-      num_type imaginary() const {
+      constexpr num_type imaginary() const {
         return im;
       }
       template <typename other_num_type>
-      bool equals(const Complex<other_num_type>& z) const {
+      constexpr bool equals(const Complex<other_num_type>& z) const {
         return re == z.re and im == z.im;
       }
-      operator bool() const{
+      constexpr operator bool() const {
         return re == num_type(0)
                and im == num_type(0);
       }
       // Typical functions
-      num_type sqrMagnitude() const {
+      constexpr num_type sqrMagnitude() const {
         return re * re + im * im;
       }
       num_type magnitude() const {
@@ -58,104 +57,105 @@
       }
       
       template <typename other_num_type>
-      Complex<num_type> add(const Complex<other_num_type>& z) const {
-        return Complex<num_type>(re + z.re, re + z.im);
+      constexpr Complex<num_type> add(const Complex<other_num_type>& z) const {
+        return Complex<num_type>(re + z.re, im + z.im);
       }
       template <typename other_num_type>
-      Complex<num_type> add(other_num_type z) const {
+      constexpr Complex<num_type> add(other_num_type z) const {
         return Complex<num_type>(re + z, im);
       }
       template <typename other_num_type>
-      Complex<num_type> subtract(const Complex<other_num_type>& z) const {
-        return Complex<num_type>(re - z.re, re - z.im);
+      constexpr Complex<num_type> subtract(const Complex<other_num_type>& z) const {
+        return Complex<num_type>(re - z.re, im - z.im);
       }
       template <typename other_num_type>
-      Complex<num_type> subtract(other_num_type z) const {
+      constexpr Complex<num_type> subtract(other_num_type z) const {
         return Complex<num_type>(re - z, im);
       }
-      Complex<num_type> conjugate() const {
+      constexpr Complex<num_type> conjugate() const {
         return Complex<num_type>(re, -im);
       }
       template <typename other_num_type>
-      Complex<num_type> multiply(const Complex<other_num_type>& z) const {
+      constexpr Complex<num_type> multiply(const Complex<other_num_type>& z) const {
         return Complex<num_type>(re * z.re - im * z.im, re * z.im + z.re * im);
       }
       template <typename other_num_type>
-      Complex<num_type> multiply(other_num_type z) const {
+      constexpr Complex<num_type> multiply(other_num_type z) const {
         return Complex<num_type>(re * z, im * z);
       }
       template <typename other_num_type>
-      Complex<num_type> divide(other_num_type z) const {
+      constexpr Complex<num_type> divide(other_num_type z) const {
         if (z == 0)
           return Complex(std::numeric_limits<num_type>::quiet_NaN(), std::numeric_limits<num_type>::quiet_NaN());
         return Complex<num_type>(re / z, im / z);
       }
       template <typename other_num_type>
-      Complex<num_type> divide(const Complex<other_num_type>& z) const {
+      constexpr Complex<num_type> divide(const Complex<other_num_type>& z) const {
         if (z.re == 0 and z.im == 0)
           return Complex(std::numeric_limits<num_type>::quiet_NaN(), std::numeric_limits<num_type>::quiet_NaN());
-        return multiply(z.conjugate().divide(z.sqrMagnitude));
+        return multiply(z.conjugate().divide(z.sqrMagnitude()));
       }
-      Complex<num_type> normalized() const {
+      template <class precision = typename DefaultPrecision<num_type>::type>
+      constexpr Complex<num_type> normalized() const {
         if (sqrMagnitude() != 0)
-          return divide(magnitude());
+          return multiply(precision::reciprocalSquareRoot(sqrMagnitude()));
         return Complex<num_type>();
       }
-      Complex<num_type> cheapNormalized() const {
+      constexpr Complex<num_type> cheapNormalized() const {
         if (sqrMagnitude() != 0)
           return divide(sqrMagnitude());
         return Complex<num_type>();
       }
       // Operators
       template <typename other_num_type>
-      Complex<num_type> operator+(const Complex<other_num_type>& z) const {return add(z);}
+      constexpr Complex<num_type> operator+(const Complex<other_num_type>& z) const {return add(z);}
       template <typename other_num_type>
-      Complex<num_type> operator+(other_num_type z) const {return add(z);}
+      constexpr Complex<num_type> operator+(other_num_type z) const {return add(z);}
       template <typename other_num_type>
-      friend Complex<num_type> operator+(other_num_type z1, const Complex<other_num_type>& z2) {return z2 + z1;}
+      friend constexpr Complex<num_type> operator+(other_num_type z1, const Complex<other_num_type>& z2) {return z2 + z1;}
       template <typename other_num_type>
-      Complex<num_type> operator-(const Complex<other_num_type>& z) const {return subtract(z);}
+      constexpr Complex<num_type> operator-(const Complex<other_num_type>& z) const {return subtract(z);}
       template <typename other_num_type>
-      Complex<num_type> operator-(other_num_type z) const {return subtract(z);}
+      constexpr Complex<num_type> operator-(other_num_type z) const {return subtract(z);}
       template <typename other_num_type>
-      friend Complex<num_type> operator-(other_num_type z1, const Complex<other_num_type>& z2) {return z2 - z1;}
+      friend constexpr Complex<num_type> operator-(other_num_type z1, const Complex<other_num_type>& z2) {return -(z2 - z1);}
       template <typename other_num_type>
-      Complex<num_type> operator*(const Complex<other_num_type>& z) const {return multiply(z);}
+      constexpr Complex<num_type> operator*(const Complex<other_num_type>& z) const {return multiply(z);}
       template <typename other_num_type>
-      Complex<num_type> operator*(other_num_type z) const {return multiply(z);}
+      constexpr Complex<num_type> operator*(other_num_type z) const {return multiply(z);}
       template <typename other_num_type>
-      friend Complex<num_type> operator*(other_num_type z1, const Complex<other_num_type>& z2) {return z2 * z1;}
+      friend constexpr Complex<num_type> operator*(other_num_type z1, const Complex<other_num_type>& z2) {return z2 * z1;}
       template <typename other_num_type>
-      Complex<num_type> operator/(const Complex<other_num_type>& z) {return divide(z);}
+      constexpr Complex<num_type> operator/(const Complex<other_num_type>& z) const {return divide(z);}
       template <typename other_num_type>
-      Complex<num_type> operator/(other_num_type z) const {return divide(z);}
+      constexpr Complex<num_type> operator/(other_num_type z) const {return divide(z);}
       template <typename other_num_type>
-      friend Complex<num_type> operator/(other_num_type z1, const Complex<other_num_type>& z2) {return z2.conjugate() * z1 / z2.sqrMagnitude();}
+      friend constexpr Complex<num_type> operator/(other_num_type z1, const Complex<other_num_type>& z2) {return z2.conjugate() * z1 / z2.sqrMagnitude();}
       
       template <typename other_num_type>
-      Complex<num_type>& operator+=(const Complex<other_num_type>& z) { return *this = add(z);}
+      constexpr Complex<num_type>& operator+=(const Complex<other_num_type>& z) { return *this = add(z);}
       template <typename other_num_type>
-      Complex<num_type>& operator+=(other_num_type z) { return *this = add(z);}
+      constexpr Complex<num_type>& operator+=(other_num_type z) { return *this = add(z);}
       template <typename other_num_type>
-      Complex<num_type>& operator-=(const Complex<other_num_type>& z) { return *this = subtract(z);}
+      constexpr Complex<num_type>& operator-=(const Complex<other_num_type>& z) { return *this = subtract(z);}
       template <typename other_num_type>
-      Complex<num_type>& operator-=(other_num_type z) { return *this = subtract(z);}
+      constexpr Complex<num_type>& operator-=(other_num_type z) { return *this = subtract(z);}
       template <typename other_num_type>
-      Complex<num_type>& operator*=(const Complex<other_num_type>& z) { return *this = multiply(z);}
+      constexpr Complex<num_type>& operator*=(const Complex<other_num_type>& z) { return *this = multiply(z);}
       template <typename other_num_type>
-      Complex<num_type>& operator*=(other_num_type z) { return *this = multiply(z);}
+      constexpr Complex<num_type>& operator*=(other_num_type z) { return *this = multiply(z);}
       template <typename other_num_type>
-      Complex<num_type>& operator/=(const Complex<other_num_type>& z) { return *this = divide(z);}
+      constexpr Complex<num_type>& operator/=(const Complex<other_num_type>& z) { return *this = divide(z);}
       template <typename other_num_type>
-      Complex<num_type>& operator/=(other_num_type z) { return *this = divide(z);}
+      constexpr Complex<num_type>& operator/=(other_num_type z) { return *this = divide(z);}
       
-      Complex<num_type> operator~() const {return conjugate();}
-      Complex<num_type> operator-() const {return Complex(-re,-im);}
+      constexpr Complex<num_type> operator~() const {return conjugate();}
+      constexpr Complex<num_type> operator-() const {return Complex(-re,-im);}
       
       template <typename other_num_type>
-      bool operator==(const Complex<other_num_type>& z) const {return equals(z);}
+      constexpr bool operator==(const Complex<other_num_type>& z) const {return equals(z);}
       template <typename other_num_type>
-      bool operator!=(const Complex<other_num_type>& q) const {return not equals(q);}
+      constexpr bool operator!=(const Complex<other_num_type>& q) const {return not equals(q);}
       
       // One subscript output with mutable return type, another with const
       num_type operator[](int i) const {
@@ -188,87 +188,81 @@
       num_type y;
       num_type z;
     
-      Quaternion() {w = 0; x = 0; y = 0; z = 0;}
+      constexpr Quaternion() : w(0), x(0), y(0), z(0) {}
       template <typename other_num_type>
-      Quaternion(other_num_type a, other_num_type b, other_num_type c, other_num_type d) {
-        w = a; x = b; y = c; z = d;
-      }
+      constexpr Quaternion(other_num_type a, other_num_type b, other_num_type c, other_num_type d) : w(a), x(b), y(c), z(d) {}
       template <typename other_num_type>
-      Quaternion(const Complex<other_num_type>& z1, const Complex<other_num_type>& z2) {
-        w = z1.re; x = z1.im;
-        y = z2.re; z = z2.im;
-      }
+      constexpr Quaternion(const Complex<other_num_type>& z1, const Complex<other_num_type>& z2)
+        : w(z1.re), x(z1.im), y(z2.re), z(z2.im) {}
       template <typename other_num_type>
-      Quaternion<num_type>& operator=(const Quaternion<other_num_type>& q) {
+      constexpr Quaternion<num_type>& operator=(const Quaternion<other_num_type>& q) {
         w = q.w; x = q.x; y = q.y; z = q.z;
         return *this;
       }
       template <typename other_num_type>
-      Quaternion(const Quaternion<other_num_type>& q) {
-        *this = q;
-      }
+      constexpr Quaternion(const Quaternion<other_num_type>& q) : w(q.w), x(q.x), y(q.y), z(q.z) {}
       
-      num_type scalar() const {
+      constexpr num_type scalar() const {
         return w;
       }
-      Quaternion<num_type> vector() const {
+      constexpr Quaternion<num_type> vector() const {
         return Quaternion(0, x, y, z);
       }
-      Complex<num_type> complex1() const {
+      constexpr Complex<num_type> complex1() const {
         return Complex<num_type>(w,x);
       }
-      Complex<num_type> complex2() const {
+      constexpr Complex<num_type> complex2() const {
         return Complex<num_type>(y,z);
       }
       template <typename other_num_type>
-      bool equals(const Quaternion<other_num_type>& q) const {
+      constexpr bool equals(const Quaternion<other_num_type>& q) const {
         return w == q.w and x == q.x and y == q.y and z == q.z;
       }
-      operator bool const () {
+      constexpr operator bool() const {
         return w == num_type(0)
                and x == num_type(0)
                and y == num_type(0)
                and z == num_type(0);
       }
       // Typical functions
-      num_type sqrMagnitude() const {
+      constexpr num_type sqrMagnitude() const {
         return w * w + x * x + y * y + z * z;
       }
       num_type magnitude() const {
         return sqrt(sqrMagnitude());
       }
       template <typename other_num_type>
-      Quaternion<num_type> add(const Quaternion<other_num_type>& q) const {
+      constexpr Quaternion<num_type> add(const Quaternion<other_num_type>& q) const {
         return Quaternion<num_type>(w + q.w, x + q.x, y + q.y, z + q.z);
       }
       template <typename other_num_type>
-      Quaternion<num_type> add(other_num_type q) const {
+      constexpr Quaternion<num_type> add(other_num_type q) const {
         return Quaternion<num_type>(w + q, x, y, z);
       }
       template <typename other_num_type>
-      Quaternion<num_type> subtract(const Quaternion<other_num_type>& q) const {
+      constexpr Quaternion<num_type> subtract(const Quaternion<other_num_type>& q) const {
         return Quaternion<num_type>(w - q.w, x - q.x, y - q.y, z - q.z);
       }
       template <typename other_num_type>
-      Quaternion<num_type> subtract(other_num_type q) const {
+      constexpr Quaternion<num_type> subtract(other_num_type q) const {
         return Quaternion<num_type>(w - q, x, y, z);
       }
-      Quaternion<num_type> conjugate() const {
+      constexpr Quaternion<num_type> conjugate() const {
         return Quaternion<num_type>(w, -x, -y, -z);
       }
       template <typename other_num_type>
-      Quaternion<num_type> multiply(const Quaternion<other_num_type>& q) const {
+      constexpr Quaternion<num_type> multiply(const Quaternion<other_num_type>& q) const {
         return Quaternion<num_type>(w * q.w - x * q.x - y * q.y - z * q.z,
                                     w * q.x + x * q.w + y * q.z - z * q.y,
                                     w * q.y + y * q.w + z * q.x - x * q.z,
                                     w * q.z + z * q.w + x * q.y - y * q.x);
       }
       template <typename other_num_type>
-      Quaternion<num_type> multiply(other_num_type q) const {
+      constexpr Quaternion<num_type> multiply(other_num_type q) const {
         return Quaternion<num_type>(w * q, x * q, y * q, z * q);
       }
       template <typename other_num_type>
-      Quaternion<num_type> divide(other_num_type q) const {
+      constexpr Quaternion<num_type> divide(other_num_type q) const {
         if (q == 0)
           return Quaternion(std::numeric_limits<num_type>::quiet_NaN(),
                             std::numeric_limits<num_type>::quiet_NaN(),
@@ -276,7 +270,7 @@
                             std::numeric_limits<num_type>::quiet_NaN());
         return Quaternion<num_type>(w / q, x / q, y / q, z / q);
       }
-      Quaternion<num_type> inverse() const {
+      constexpr Quaternion<num_type> inverse() const {
         if (sqrMagnitude() == 0)
           return Quaternion(std::numeric_limits<num_type>::quiet_NaN(),
                             std::numeric_limits<num_type>::quiet_NaN(),
@@ -284,57 +278,96 @@
                             std::numeric_limits<num_type>::quiet_NaN());
         return conjugate().divide(sqrMagnitude());
       }
-      Quaternion<num_type> normalized() const {
+      template <class precision = typename DefaultPrecision<num_type>::type>
+      constexpr Quaternion<num_type> normalized() const {
         if (sqrMagnitude() != 0)
-          return divide(magnitude());
+          return multiply(precision::reciprocalSquareRoot(sqrMagnitude()));
         return Quaternion<num_type>();
       }
-      Quaternion<num_type> cheapNormalized() const {
+      constexpr Quaternion<num_type> cheapNormalized() const {
         if (sqrMagnitude() != 0)
           return divide(sqrMagnitude());
         return Quaternion<num_type>();
       }
+      template <typename other_num_type>
+      constexpr num_type dotProduct(const Quaternion<other_num_type>& q) const {
+        return w * q.w + x * q.x + y * q.y + z * q.z;
+      }
+      // Interpolation between unit quaternions, t in [0, 1]. All three take the
+      // shortest path, flipping q when it lies in the opposite hemisphere
+      template <class precision = typename DefaultPrecision<num_type>::type>
+      constexpr Quaternion<num_type> nlerp(const Quaternion<num_type>& q, num_type t) const {
+        num_type k = dotProduct(q) < 0 ? -t : t;
+        return multiply(1 - t).add(q.multiply(k)).template normalized<precision>();
+      }
+      template <class precision = typename DefaultPrecision<num_type>::type>
+      constexpr Quaternion<num_type> slerp(const Quaternion<num_type>& q, num_type t) const {
+        num_type d = dotProduct(q), sign = 1;
+        if (d < 0) {
+          d = -d;
+          sign = -1;
+        }
+        // Nearly parallel, sin(theta) would lose all precision
+        if (d > num_type(0.9995))
+          return nlerp<precision>(q, t);
+        num_type theta = precision::arcCosine(d);
+        num_type inv_sin = 1 / precision::sine(theta);
+        return multiply(precision::sine((1 - t) * theta) * inv_sin)
+              .add(q.multiply(sign * precision::sine(t * theta) * inv_sin));
+      }
+      // nlerp with t warped by a cubic fitted to slerp's angular velocity
+      // (Kapoulkine, "Approximating slerp"), no trigonometry. Within 7e-4 of slerp
+      template <class precision = typename DefaultPrecision<num_type>::type>
+      constexpr Quaternion<num_type> fastSlerp(const Quaternion<num_type>& q, num_type t) const {
+        num_type d = dotProduct(q);
+        if (d < 0)
+          d = -d;
+        num_type a = num_type(1.0904) + d * (num_type(-3.2452) + d * (num_type(3.55645) - d * num_type(1.43519)));
+        num_type b = num_type(0.848013) + d * (num_type(-1.06021) + d * num_type(0.215638));
+        num_type k = a * (t - num_type(0.5)) * (t - num_type(0.5)) + b;
+        return nlerp<precision>(q, t + t * (t - num_type(0.5)) * (t - 1) * k);
+      }
       // Operators
       template <typename other_num_type>
-      Quaternion<num_type> operator+(const Quaternion<other_num_type>& q) const {return add(q);}
+      constexpr Quaternion<num_type> operator+(const Quaternion<other_num_type>& q) const {return add(q);}
       template <typename other_num_type>
-      Quaternion<num_type> operator+(other_num_type q) const {return add(q);}
+      constexpr Quaternion<num_type> operator+(other_num_type q) const {return add(q);}
       template <typename other_num_type>
-      friend Quaternion<num_type> operator+(other_num_type q1, const Quaternion<other_num_type>& q2) {return q2 + q1;}
+      friend constexpr Quaternion<num_type> operator+(other_num_type q1, const Quaternion<other_num_type>& q2) {return q2 + q1;}
       template <typename other_num_type>
-      Quaternion<num_type> operator-(const Quaternion<other_num_type>& q) const {return subtract(q);}
+      constexpr Quaternion<num_type> operator-(const Quaternion<other_num_type>& q) const {return subtract(q);}
       template <typename other_num_type>
-      Quaternion<num_type> operator-(other_num_type q) const {return subtract(q);}
+      constexpr Quaternion<num_type> operator-(other_num_type q) const {return subtract(q);}
       template <typename other_num_type>
-      friend Quaternion<num_type> operator-(other_num_type q1, const Quaternion<other_num_type>& q2) {return q2 - q1;}
+      friend constexpr Quaternion<num_type> operator-(other_num_type q1, const Quaternion<other_num_type>& q2) {return -(q2 - q1);}
       template <typename other_num_type>
-      Quaternion<num_type> operator*(const Quaternion<other_num_type>& q) const {return multiply(q);}
+      constexpr Quaternion<num_type> operator*(const Quaternion<other_num_type>& q) const {return multiply(q);}
       template <typename other_num_type>
-      Quaternion<num_type> operator*(other_num_type q) const {return multiply(q);}
+      constexpr Quaternion<num_type> operator*(other_num_type q) const {return multiply(q);}
       template <typename other_num_type>
-      friend Quaternion<num_type> operator*(other_num_type q1, const Quaternion<other_num_type>& q2) {return q2 * q1;}
+      friend constexpr Quaternion<num_type> operator*(other_num_type q1, const Quaternion<other_num_type>& q2) {return q2 * q1;}
       
       template <typename other_num_type>
-      Quaternion<num_type>& operator+=(const Quaternion<other_num_type>& q) { return *this = add(q);}
+      constexpr Quaternion<num_type>& operator+=(const Quaternion<other_num_type>& q) { return *this = add(q);}
       template <typename other_num_type>
-      Quaternion<num_type>& operator+=(other_num_type q) { return *this = add(q);}
+      constexpr Quaternion<num_type>& operator+=(other_num_type q) { return *this = add(q);}
       template <typename other_num_type>
-      Quaternion<num_type>& operator-=(const Quaternion<other_num_type>& q) { return *this = subtract(q);}
+      constexpr Quaternion<num_type>& operator-=(const Quaternion<other_num_type>& q) { return *this = subtract(q);}
       template <typename other_num_type>
-      Quaternion<num_type>& operator-=(other_num_type q) { return *this = subtract(q);}
+      constexpr Quaternion<num_type>& operator-=(other_num_type q) { return *this = subtract(q);}
       template <typename other_num_type>
-      Quaternion<num_type>& operator*=(const Quaternion<other_num_type>& q) { return *this = multiply(q);}
+      constexpr Quaternion<num_type>& operator*=(const Quaternion<other_num_type>& q) { return *this = multiply(q);}
       template <typename other_num_type>
-      Quaternion<num_type>& operator*=(other_num_type q) { return *this = multiply(q);}
+      constexpr Quaternion<num_type>& operator*=(other_num_type q) { return *this = multiply(q);}
       
-      Quaternion<num_type> operator~() const {return conjugate();}
-      Quaternion<num_type> operator+() const {return Quaternion(w,x,w,z);}
-      Quaternion<num_type> operator-() const {return Quaternion(-w,-x,-w,-z);}
+      constexpr Quaternion<num_type> operator~() const {return conjugate();}
+      constexpr Quaternion<num_type> operator+() const {return *this;}
+      constexpr Quaternion<num_type> operator-() const {return Quaternion(-w,-x,-y,-z);}
       
       template <typename other_num_type>
-      bool operator==(const Quaternion<other_num_type>& q) const {return equals(q);}
+      constexpr bool operator==(const Quaternion<other_num_type>& q) const {return equals(q);}
       template <typename other_num_type>
-      bool operator!=(const Quaternion<other_num_type>& q) const {return not equals(q);}
+      constexpr bool operator!=(const Quaternion<other_num_type>& q) const {return not equals(q);}
       
       // One subscript output with mutable return type, another with const
       num_type operator[](int i) const {
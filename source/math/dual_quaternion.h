@@ -0,0 +1,176 @@
+#if !defined(DUAL_QUATERNION_H_INCLUDED)
+  #define DUAL_QUATERNION_H_INCLUDED
+
+  #include "transform.h"
+
+  // Rigid transform real + eps dual, with real the rotation and dual = t real / 2
+  // for a translation t applied after it. Eight numbers against the twelve of an
+  // affine matrix, and blending unit dual quaternions keeps them rigid, which
+  // blending matrices does not.
+  //
+  // multiply and operator* follow Matrix4x4: a * b applies b first. compose
+  // applies this first, like Rotator::compose. Most functions expect unit dual
+  // quaternions, i.e. a unit real part orthogonal to the dual part; normalized
+  // restores that after blending or drift
+  template <typename num_type = float>
+  class DualQuaternion {
+    public :
+      typedef num_type value_type;
+
+      Quaternion<num_type> real;
+      Quaternion<num_type> dual;
+
+      constexpr DualQuaternion() : real(1, 0, 0, 0), dual() {}
+      template <typename other_num_type>
+      constexpr DualQuaternion(const Quaternion<other_num_type>& r, const Quaternion<other_num_type>& d) : real(r), dual(d) {}
+      template <typename other_num_type>
+      constexpr DualQuaternion(const DualQuaternion<other_num_type>& dq) : real(dq.real), dual(dq.dual) {}
+      template <typename other_num_type>
+      constexpr DualQuaternion<num_type>& operator=(const DualQuaternion<other_num_type>& dq) {
+        real = dq.real;
+        dual = dq.dual;
+        return *this;
+      }
+      // Rotate, then translate
+      template <typename other_num_type>
+      constexpr DualQuaternion(const QuaternionRotator<other_num_type>& rot,
+                               const Vector3<other_num_type>& translation = Vector3<other_num_type>())
+        : real(rot),
+          dual(Quaternion<num_type>(num_type(0), num_type(translation.x), num_type(translation.y), num_type(translation.z))
+               .multiply(real).multiply(num_type(0.5))) {}
+
+      // Convertors
+      template <typename other_num_type>
+      DualQuaternion(const AngleAxisRotator<other_num_type>& rot,
+                     const Vector3<other_num_type>& translation = Vector3<other_num_type>())
+        : DualQuaternion(QuaternionRotator<other_num_type>(rot), translation) {}
+      template <typename other_num_type>
+      DualQuaternion(const RotationMatrix<other_num_type>& rot,
+                     const Vector3<other_num_type>& translation = Vector3<other_num_type>())
+        : DualQuaternion(QuaternionRotator<other_num_type>(rot), translation) {}
+      // From a rigid Matrix4x4; scale and shear are not representable
+      template <typename other_num_type>
+      explicit DualQuaternion(const Matrix4x4<other_num_type>& mat)
+        : DualQuaternion(QuaternionRotator<other_num_type>(mat.getRotation()), mat.getTranslation()) {}
+      QuaternionRotator<num_type> getRotation() const {
+        return QuaternionRotator<num_type>(real);
+      }
+      constexpr Vector3<num_type> getTranslation() const {
+        Quaternion<num_type> t = dual.multiply(real.conjugate());
+        return Vector3<num_type>(2 * t.x, 2 * t.y, 2 * t.z);
+      }
+      Matrix4x4<num_type> toMatrix() const {
+        return Matrix4x4<num_type>(getRotation(), getTranslation());
+      }
+
+      // Identity element
+      static const DualQuaternion identity;
+
+      template <typename other_num_type>
+      constexpr bool equals(const DualQuaternion<other_num_type>& dq) const {
+        return real.equals(dq.real) and dual.equals(dq.dual);
+      }
+      template <typename other_num_type>
+      constexpr DualQuaternion<num_type> add(const DualQuaternion<other_num_type>& dq) const {
+        return DualQuaternion<num_type>(real.add(dq.real), dual.add(dq.dual));
+      }
+      template <typename other_num_type>
+      constexpr DualQuaternion<num_type> multiply(const DualQuaternion<other_num_type>& dq) const {
+        return DualQuaternion<num_type>(real.multiply(dq.real), real.multiply(dq.dual).add(dual.multiply(dq.real)));
+      }
+      template <typename other_num_type>
+      constexpr DualQuaternion<num_type> multiply(other_num_type s) const {
+        return DualQuaternion<num_type>(real.multiply(s), dual.multiply(s));
+      }
+      // this is applied first, then dq
+      constexpr DualQuaternion<num_type> compose(const DualQuaternion<num_type>& dq) const {
+        return dq.multiply(*this);
+      }
+      // Quaternion conjugate of both parts, the inverse of a unit dual quaternion
+      constexpr DualQuaternion<num_type> conjugate() const {
+        return DualQuaternion<num_type>(real.conjugate(), dual.conjugate());
+      }
+      // Also right for non-unit dual quaternions. A zero real part gives NaNs
+      constexpr DualQuaternion<num_type> inverse() const {
+        Quaternion<num_type> r = real.inverse();
+        return DualQuaternion<num_type>(r, -r.multiply(dual).multiply(r));
+      }
+      // Unit real part, and the dual part made orthogonal to it. A zero real part
+      // gives zero
+      template <class precision = typename DefaultPrecision<num_type>::type>
+      constexpr DualQuaternion<num_type> normalized() const {
+        num_type sqr = real.sqrMagnitude();
+        if (sqr == 0)
+          return DualQuaternion<num_type>(Quaternion<num_type>(), Quaternion<num_type>());
+        num_type inv = precision::reciprocalSquareRoot(sqr);
+        Quaternion<num_type> r = real.multiply(inv), d = dual.multiply(inv);
+        return DualQuaternion<num_type>(r, d.subtract(r.multiply(r.dotProduct(d))));
+      }
+
+      constexpr Vector3<num_type> transformPoint(const Vector3<num_type>& p) const {
+        // Rotation as v + w t + u x t with t = 2 (u x v), then the translation
+        // 2 (w d - d_w u + u x d) with d the vector part of dual
+        Vector3<num_type> u(real.x, real.y, real.z), d(dual.x, dual.y, dual.z);
+        Vector3<num_type> t = u.crossProduct(p) * num_type(2);
+        return p + t * real.w + u.crossProduct(t) + (d * real.w - u * dual.w + u.crossProduct(d)) * num_type(2);
+      }
+      constexpr Vector3<num_type> transformDirection(const Vector3<num_type>& v) const {
+        Vector3<num_type> u(real.x, real.y, real.z);
+        Vector3<num_type> t = u.crossProduct(v) * num_type(2);
+        return v + t * real.w + u.crossProduct(t);
+      }
+
+      // Linear blend of n dual quaternions, renormalized (Kavan et al., "Skinning
+      // with dual quaternions"). Each one is flipped into the hemisphere of the
+      // first, so the blend takes the short way round
+      template <class precision = typename DefaultPrecision<num_type>::type>
+      static constexpr DualQuaternion<num_type> blend(const DualQuaternion<num_type>* dqs, const num_type* weights, size_t n) {
+        DualQuaternion<num_type> sum{Quaternion<num_type>(), Quaternion<num_type>()};
+        for (size_t k = 0; k < n; ++k)
+          sum = sum.add(dqs[k].multiply(dqs[k].real.dotProduct(dqs[0].real) < 0 ? -weights[k] : weights[k]));
+        return sum.template normalized<precision>();
+      }
+      // Screw interpolation, t in [0, 1]: a constant speed rotation about and
+      // translation along one axis. Takes the shortest path like
+      // Quaternion::slerp, and blends linearly when the rotation between the two
+      // is nearly zero, where the screw axis is undefined
+      template <class precision = typename DefaultPrecision<num_type>::type>
+      constexpr DualQuaternion<num_type> sclerp(const DualQuaternion<num_type>& dq, num_type t) const {
+        DualQuaternion<num_type> to = real.dotProduct(dq.real) < 0 ? dq.multiply(num_type(-1)) : dq;
+        DualQuaternion<num_type> diff = conjugate().multiply(to);
+        num_type c = diff.real.w;
+        if (c > num_type(0.9995))
+          return multiply(num_type(1) - t).add(to.multiply(t)).template normalized<precision>();
+        // Half angle, pitch and moment of the screw from this to dq
+        Vector3<num_type> v(diff.real.x, diff.real.y, diff.real.z), vd(diff.dual.x, diff.dual.y, diff.dual.z);
+        num_type half_angle = precision::arcCosine(c < -1 ? num_type(-1) : c);
+        num_type inv_sin = 1 / precision::sine(half_angle);
+        Vector3<num_type> axis = v * inv_sin;
+        num_type half_pitch = -diff.dual.w * inv_sin;
+        Vector3<num_type> moment = (vd - axis * (half_pitch * c)) * inv_sin;
+        num_type s = 0;
+        precision::sineCosine(half_angle * t, s, c);
+        half_pitch = half_pitch * t;
+        Vector3<num_type> r = axis * s, d = moment * s + axis * (half_pitch * c);
+        return multiply(DualQuaternion<num_type>(Quaternion<num_type>(c, r.x, r.y, r.z),
+                                                 Quaternion<num_type>(-half_pitch * s, d.x, d.y, d.z)));
+      }
+
+      // Operators
+      template <typename other_num_type>
+      constexpr DualQuaternion<num_type> operator+(const DualQuaternion<other_num_type>& dq) const {return add(dq);}
+      template <typename other_num_type>
+      constexpr DualQuaternion<num_type> operator*(const DualQuaternion<other_num_type>& dq) const {return multiply(dq);}
+      constexpr DualQuaternion<num_type> operator*(num_type s) const {return multiply(s);}
+      constexpr Vector3<num_type> operator*(const Vector3<num_type>& p) const {return transformPoint(p);}
+      template <typename other_num_type>
+      constexpr DualQuaternion<num_type>& operator*=(const DualQuaternion<other_num_type>& dq) { return *this = multiply(dq);}
+      constexpr DualQuaternion<num_type> operator-() const {return multiply(num_type(-1));}
+      template <typename other_num_type>
+      constexpr bool operator==(const DualQuaternion<other_num_type>& dq) const {return equals(dq);}
+      template <typename other_num_type>
+      constexpr bool operator!=(const DualQuaternion<other_num_type>& dq) const {return not equals(dq);}
+  };
+  template <typename num_type> constexpr DualQuaternion<num_type> DualQuaternion<num_type>::identity;
+
+#endif
@@ -0,0 +1,493 @@
+#if !defined(EXPRESSION_H_INCLUDED)
+  #define EXPRESSION_H_INCLUDED
+
+  #include <stddef.h>
+  #include <limits>
+  #include <type_traits>
+  #include <utility>
+  #include "vector.h"
+  #include "complex.h"
+  #include "vector_array.h"
+  #include "quaternion_array.h"
+
+  // Opt-in lazy arithmetic for Vector2, Vector3, Complex and Quaternion. lazy()
+  // wraps a value, a scalar or an SoA array, and the operators on the result build
+  // an expression tree instead of a temporary per step. The whole tree is then
+  // evaluated in one pass, each output component straight from the leaves, either
+  // into a value by conversion or over whole arrays by evaluate():
+  //
+  //   Vector3<float> r = lazy(vec) * c + lazy(axis) * lazy(axis).dotProduct(lazy(vec)) * k;
+  //   evaluate(lazy(positions) + lazy(velocities) * dt, positions);
+  //
+  // Both operands of an operator must be expressions or scalars; plain values are
+  // wrapped with lazy() first, so none of the eager operators change meaning.
+  // Expressions keep arrays by pointer and must not outlive them. All components
+  // are computed before any is stored, so outputs may alias the inputs
+  template <class Value>
+  struct ExpressionTraits {
+    typedef Value num_type;
+    static const int size = 1;
+    static const bool product = false;
+    static constexpr num_type get(const Value& v, int) { return v; }
+    static constexpr Value make(const num_type* c) { return c[0]; }
+  };
+  template <typename num_type_>
+  struct ExpressionTraits<Vector2<num_type_>> {
+    typedef num_type_ num_type;
+    static const int size = 2;
+    static const bool product = false;
+    static constexpr num_type get(const Vector2<num_type>& v, int c) { return c == 0 ? v.x : v.y; }
+    static constexpr Vector2<num_type> make(const num_type* c) { return Vector2<num_type>(c[0], c[1]); }
+  };
+  template <typename num_type_>
+  struct ExpressionTraits<Vector3<num_type_>> {
+    typedef num_type_ num_type;
+    static const int size = 3;
+    static const bool product = false;
+    static constexpr num_type get(const Vector3<num_type>& v, int c) { return c == 0 ? v.x : c == 1 ? v.y : v.z; }
+    static constexpr Vector3<num_type> make(const num_type* c) { return Vector3<num_type>(c[0], c[1], c[2]); }
+  };
+  template <typename num_type_>
+  struct ExpressionTraits<Complex<num_type_>> {
+    typedef num_type_ num_type;
+    static const int size = 2;
+    static const bool product = true;
+    static constexpr num_type get(const Complex<num_type>& z, int c) { return c == 0 ? z.re : z.im; }
+    static constexpr Complex<num_type> make(const num_type* c) { return Complex<num_type>(c[0], c[1]); }
+  };
+  template <typename num_type_>
+  struct ExpressionTraits<Quaternion<num_type_>> {
+    typedef num_type_ num_type;
+    static const int size = 4;
+    static const bool product = true;
+    static constexpr num_type get(const Quaternion<num_type>& q, int c) { return c == 0 ? q.w : c == 1 ? q.x : c == 2 ? q.y : q.z; }
+    static constexpr Quaternion<num_type> make(const num_type* c) { return Quaternion<num_type>(c[0], c[1], c[2], c[3]); }
+  };
+
+  template <class A, class B, bool subtract> class SumExpression;
+  template <class A, class S, bool divide> class ScaleExpression;
+  template <class A, class B> class DotExpression;
+  template <class A, class B> class CrossExpression;
+  template <class A> class ConjugateExpression;
+  template <class A> class VectorPartExpression;
+  template <class A> class PureQuaternionExpression;
+
+  // Every node provides lane<c, L>(i), component c of element i in the lane set L
+  // of math/simd.h, and count(), the element count of its arrays or the largest
+  // size_t when it has none
+  template <class Derived, class Value>
+  class Expression {
+    public :
+      typedef Value value_type;
+      typedef typename ExpressionTraits<Value>::num_type num_type;
+      static const int size = ExpressionTraits<Value>::size;
+
+      constexpr const Derived& derived() const {
+        return static_cast<const Derived&>(*this);
+      }
+      // Element i of the arrays in the expression, or the value when there are none
+      Value eval(size_t i = 0) const {
+        return evalAt(i, std::make_integer_sequence<int, size>());
+      }
+      operator Value() const {
+        return eval();
+      }
+
+      template <class D>
+      constexpr DotExpression<Derived, D> dotProduct(const Expression<D, Value>& e) const {
+        return DotExpression<Derived, D>(derived(), e.derived());
+      }
+      constexpr DotExpression<Derived, Derived> sqrMagnitude() const {
+        return DotExpression<Derived, Derived>(derived(), derived());
+      }
+      template <class D>
+      constexpr CrossExpression<Derived, D> crossProduct(const Expression<D, Value>& e) const {
+        return CrossExpression<Derived, D>(derived(), e.derived());
+      }
+      constexpr ConjugateExpression<Derived> conjugate() const {
+        return ConjugateExpression<Derived>(derived());
+      }
+      // Vector3 of a quaternion's x, y and z, and the quaternion (0, v) of a Vector3
+      constexpr VectorPartExpression<Derived> vectorPart() const {
+        return VectorPartExpression<Derived>(derived());
+      }
+      constexpr PureQuaternionExpression<Derived> pureQuaternion() const {
+        return PureQuaternionExpression<Derived>(derived());
+      }
+
+    private :
+      template <int... c>
+      Value evalAt(size_t i, std::integer_sequence<int, c...>) const {
+        num_type components[size] = {derived().template lane<c, ScalarLanes<num_type>>(i)...};
+        return ExpressionTraits<Value>::make(components);
+      }
+  };
+
+  template <class Derived, class Value>
+  std::true_type expressionBase(const Expression<Derived, Value>*);
+  std::false_type expressionBase(...);
+  template <class T>
+  struct IsExpression : decltype(expressionBase(static_cast<T*>(nullptr))) {};
+
+  // Leaves
+  template <class Value>
+  class ValueExpression : public Expression<ValueExpression<Value>, Value> {
+    public :
+      Value value;
+
+      constexpr explicit ValueExpression(const Value& v) : value(v) {}
+      template <int c, class L>
+      typename L::reg lane(size_t) const {
+        return L::set(ExpressionTraits<Value>::get(value, c));
+      }
+      constexpr size_t count() const {
+        return std::numeric_limits<size_t>::max();
+      }
+  };
+
+  template <class Value>
+  class ArrayExpression : public Expression<ArrayExpression<Value>, Value> {
+    public :
+      typedef typename ExpressionTraits<Value>::num_type num_type;
+
+      const num_type* components[ExpressionTraits<Value>::size];
+      size_t n;
+
+      ArrayExpression(const num_type* const* p, size_t n) : n(n) {
+        for (int c = 0; c < ExpressionTraits<Value>::size; ++c)
+          components[c] = p[c];
+      }
+      template <int c, class L>
+      typename L::reg lane(size_t i) const {
+        return L::load(components[c] + i);
+      }
+      constexpr size_t count() const {
+        return n;
+      }
+  };
+
+  template <typename num_type>
+  constexpr ValueExpression<Vector2<num_type>> lazy(const Vector2<num_type>& v) {
+    return ValueExpression<Vector2<num_type>>(v);
+  }
+  template <typename num_type>
+  constexpr ValueExpression<Vector3<num_type>> lazy(const Vector3<num_type>& v) {
+    return ValueExpression<Vector3<num_type>>(v);
+  }
+  template <typename num_type>
+  constexpr ValueExpression<Complex<num_type>> lazy(const Complex<num_type>& z) {
+    return ValueExpression<Complex<num_type>>(z);
+  }
+  template <typename num_type>
+  constexpr ValueExpression<Quaternion<num_type>> lazy(const Quaternion<num_type>& q) {
+    return ValueExpression<Quaternion<num_type>>(q);
+  }
+  template <typename num_type, typename = typename std::enable_if<std::is_arithmetic<num_type>::value>::type>
+  constexpr ValueExpression<num_type> lazy(num_type s) {
+    return ValueExpression<num_type>(s);
+  }
+  template <typename num_type>
+  ArrayExpression<Vector3<num_type>> lazy(const Vector3Array<num_type>& arr) {
+    const num_type* p[3] = {arr.x, arr.y, arr.z};
+    return ArrayExpression<Vector3<num_type>>(p, arr.size());
+  }
+  template <typename num_type>
+  ArrayExpression<Quaternion<num_type>> lazy(const QuaternionArray<num_type>& arr) {
+    const num_type* p[4] = {arr.w, arr.x, arr.y, arr.z};
+    return ArrayExpression<Quaternion<num_type>>(p, arr.size());
+  }
+  // n numbers, one scalar per element
+  template <typename num_type>
+  ArrayExpression<num_type> lazy(const num_type* arr, size_t n) {
+    return ArrayExpression<num_type>(&arr, n);
+  }
+
+  // Nodes
+  template <class A, class B, bool subtract>
+  class SumExpression : public Expression<SumExpression<A, B, subtract>, typename A::value_type> {
+    public :
+      A a;
+      B b;
+
+      constexpr SumExpression(const A& a, const B& b) : a(a), b(b) {}
+      template <int c, class L>
+      typename L::reg lane(size_t i) const {
+        if constexpr (subtract)
+          return L::sub(a.template lane<c, L>(i), b.template lane<c, L>(i));
+        else
+          return L::add(a.template lane<c, L>(i), b.template lane<c, L>(i));
+      }
+      constexpr size_t count() const {
+        return a.count() < b.count() ? a.count() : b.count();
+      }
+  };
+
+  template <class A>
+  class NegateExpression : public Expression<NegateExpression<A>, typename A::value_type> {
+    public :
+      A a;
+
+      constexpr explicit NegateExpression(const A& a) : a(a) {}
+      template <int c, class L>
+      typename L::reg lane(size_t i) const {
+        return L::negate(a.template lane<c, L>(i));
+      }
+      constexpr size_t count() const {
+        return a.count();
+      }
+  };
+
+  // a * s, or a / s as a times 1 / s like Vector3::operator/. A zero s gives
+  // infinities rather than the NaN vector of the eager operator
+  template <class A, class S, bool divide>
+  class ScaleExpression : public Expression<ScaleExpression<A, S, divide>, typename A::value_type> {
+    public :
+      A a;
+      S s;
+
+      constexpr ScaleExpression(const A& a, const S& s) : a(a), s(s) {}
+      template <int c, class L>
+      typename L::reg lane(size_t i) const {
+        if constexpr (divide)
+          return L::mul(a.template lane<c, L>(i), L::div(L::set(1), s.template lane<0, L>(i)));
+        else
+          return L::mul(a.template lane<c, L>(i), s.template lane<0, L>(i));
+      }
+      constexpr size_t count() const {
+        return a.count() < s.count() ? a.count() : s.count();
+      }
+  };
+
+  template <class A, class B>
+  class DotExpression : public Expression<DotExpression<A, B>, typename A::num_type> {
+    public :
+      A a;
+      B b;
+
+      constexpr DotExpression(const A& a, const B& b) : a(a), b(b) {}
+      template <int c, class L>
+      typename L::reg lane(size_t i) const {
+        return sum<A::size - 1, L>(i);
+      }
+      constexpr size_t count() const {
+        return a.count() < b.count() ? a.count() : b.count();
+      }
+
+    private :
+      template <int c, class L>
+      typename L::reg sum(size_t i) const {
+        if constexpr (c == 0)
+          return L::mul(a.template lane<0, L>(i), b.template lane<0, L>(i));
+        else
+          return L::mulAdd(a.template lane<c, L>(i), b.template lane<c, L>(i), sum<c - 1, L>(i));
+      }
+  };
+
+  // Vector3 cross product, or the scalar one of Vector2
+  template <class A, class B>
+  class CrossExpression : public Expression<CrossExpression<A, B>,
+                                            typename std::conditional<A::size == 2, typename A::num_type, typename A::value_type>::type> {
+    public :
+      A a;
+      B b;
+
+      constexpr CrossExpression(const A& a, const B& b) : a(a), b(b) {}
+      template <int c, class L>
+      typename L::reg lane(size_t i) const {
+        static_assert(A::size == 2 or A::size == 3, "crossProduct needs a Vector2 or Vector3");
+        const int j = A::size == 2 ? 0 : (c + 1) % 3, k = A::size == 2 ? 1 : (c + 2) % 3;
+        return L::negMulAdd(a.template lane<k, L>(i), b.template lane<j, L>(i),
+                            L::mul(a.template lane<j, L>(i), b.template lane<k, L>(i)));
+      }
+      constexpr size_t count() const {
+        return a.count() < b.count() ? a.count() : b.count();
+      }
+  };
+
+  // Complex and Hamilton products, as Complex::multiply and Quaternion::multiply
+  template <class A, class B>
+  class ProductExpression : public Expression<ProductExpression<A, B>, typename A::value_type> {
+    public :
+      A a;
+      B b;
+
+      constexpr ProductExpression(const A& a, const B& b) : a(a), b(b) {}
+      template <int c, class L>
+      typename L::reg lane(size_t i) const {
+        static_assert(ExpressionTraits<typename A::value_type>::product, "only Complex and Quaternion expressions multiply");
+        if constexpr (A::size == 2) {
+          if constexpr (c == 0)
+            return L::negMulAdd(get<1, L>(a, i), get<1, L>(b, i), L::mul(get<0, L>(a, i), get<0, L>(b, i)));
+          else
+            return L::mulAdd(get<0, L>(a, i), get<1, L>(b, i), L::mul(get<1, L>(a, i), get<0, L>(b, i)));
+        } else if constexpr (c == 0) {
+          return L::negMulAdd(get<3, L>(a, i), get<3, L>(b, i), L::negMulAdd(get<2, L>(a, i), get<2, L>(b, i),
+                 L::negMulAdd(get<1, L>(a, i), get<1, L>(b, i), L::mul(get<0, L>(a, i), get<0, L>(b, i)))));
+        } else {
+          // w q_c + c q_w + j q_k - k q_j over the cyclic order x, y, z
+          const int j = c % 3 + 1, k = j % 3 + 1;
+          return L::negMulAdd(get<k, L>(a, i), get<j, L>(b, i), L::mulAdd(get<j, L>(a, i), get<k, L>(b, i),
+                 L::mulAdd(get<c, L>(a, i), get<0, L>(b, i), L::mul(get<0, L>(a, i), get<c, L>(b, i)))));
+        }
+      }
+      constexpr size_t count() const {
+        return a.count() < b.count() ? a.count() : b.count();
+      }
+
+    private :
+      template <int c, class L, class E>
+      static typename L::reg get(const E& e, size_t i) {
+        return e.template lane<c, L>(i);
+      }
+  };
+
+  template <class A>
+  class ConjugateExpression : public Expression<ConjugateExpression<A>, typename A::value_type> {
+    public :
+      A a;
+
+      constexpr explicit ConjugateExpression(const A& a) : a(a) {}
+      template <int c, class L>
+      typename L::reg lane(size_t i) const {
+        static_assert(ExpressionTraits<typename A::value_type>::product, "only Complex and Quaternion expressions conjugate");
+        if constexpr (c == 0)
+          return a.template lane<0, L>(i);
+        else
+          return L::negate(a.template lane<c, L>(i));
+      }
+      constexpr size_t count() const {
+        return a.count();
+      }
+  };
+
+  template <class A>
+  class VectorPartExpression : public Expression<VectorPartExpression<A>, Vector3<typename A::num_type>> {
+    public :
+      A a;
+
+      constexpr explicit VectorPartExpression(const A& a) : a(a) {}
+      template <int c, class L>
+      typename L::reg lane(size_t i) const {
+        static_assert(A::size == 4, "vectorPart needs a Quaternion");
+        return a.template lane<c + 1, L>(i);
+      }
+      constexpr size_t count() const {
+        return a.count();
+      }
+  };
+
+  template <class A>
+  class PureQuaternionExpression : public Expression<PureQuaternionExpression<A>, Quaternion<typename A::num_type>> {
+    public :
+      A a;
+
+      constexpr explicit PureQuaternionExpression(const A& a) : a(a) {}
+      template <int c, class L>
+      typename L::reg lane(size_t i) const {
+        static_assert(A::size == 3, "pureQuaternion needs a Vector3");
+        if constexpr (c == 0)
+          return L::set(0);
+        else
+          return a.template lane<c - 1, L>(i);
+      }
+      constexpr size_t count() const {
+        return a.count();
+      }
+  };
+
+  // Operators
+  template <class DA, class DB, class Value>
+  constexpr SumExpression<DA, DB, false> operator+(const Expression<DA, Value>& a, const Expression<DB, Value>& b) {
+    return SumExpression<DA, DB, false>(a.derived(), b.derived());
+  }
+  template <class DA, class DB, class Value>
+  constexpr SumExpression<DA, DB, true> operator-(const Expression<DA, Value>& a, const Expression<DB, Value>& b) {
+    return SumExpression<DA, DB, true>(a.derived(), b.derived());
+  }
+  template <class D, class Value>
+  constexpr NegateExpression<D> operator-(const Expression<D, Value>& a) {
+    return NegateExpression<D>(a.derived());
+  }
+  template <class D, class Value>
+  constexpr ConjugateExpression<D> operator~(const Expression<D, Value>& a) {
+    return ConjugateExpression<D>(a.derived());
+  }
+  // Scales when either side is a scalar expression, otherwise the Complex or
+  // Quaternion product
+  template <class DA, class VA, class DB, class VB>
+  constexpr auto operator*(const Expression<DA, VA>& a, const Expression<DB, VB>& b) {
+    if constexpr (ExpressionTraits<VB>::size == 1)
+      return ScaleExpression<DA, DB, false>(a.derived(), b.derived());
+    else if constexpr (ExpressionTraits<VA>::size == 1)
+      return ScaleExpression<DB, DA, false>(b.derived(), a.derived());
+    else {
+      static_assert(std::is_same<VA, VB>::value, "both sides of a product must have the same type");
+      return ProductExpression<DA, DB>(a.derived(), b.derived());
+    }
+  }
+  template <class DA, class VA, class DB, typename num_type>
+  constexpr ScaleExpression<DA, DB, true> operator/(const Expression<DA, VA>& a, const Expression<DB, num_type>& s) {
+    static_assert(ExpressionTraits<num_type>::size == 1, "expressions only divide by scalars");
+    return ScaleExpression<DA, DB, true>(a.derived(), s.derived());
+  }
+  template <class D, class Value, typename S, typename = typename std::enable_if<not IsExpression<S>::value>::type>
+  constexpr auto operator*(const Expression<D, Value>& a, S s) {
+    return a * ValueExpression<typename Expression<D, Value>::num_type>(s);
+  }
+  template <class D, class Value, typename S, typename = typename std::enable_if<not IsExpression<S>::value>::type>
+  constexpr auto operator*(S s, const Expression<D, Value>& a) {
+    return a * ValueExpression<typename Expression<D, Value>::num_type>(s);
+  }
+  template <class D, class Value, typename S, typename = typename std::enable_if<not IsExpression<S>::value>::type>
+  constexpr auto operator/(const Expression<D, Value>& a, S s) {
+    return a / ValueExpression<typename Expression<D, Value>::num_type>(s);
+  }
+
+  // Batch evaluation: out[c][i] = component c of element i for every element of
+  // the arrays in e
+  template <class L, class E, typename num_type, int... c>
+  inline void storeExpression(const E& e, num_type* const* out, size_t i, std::integer_sequence<int, c...>) {
+    typename L::reg r[] = {e.template lane<c, L>(i)...};
+    for (int k = 0; k < E::size; ++k)
+      L::store(out[k] + i, r[k]);
+  }
+  template <class E, typename num_type>
+  inline void evaluateLanes(const E& e, num_type* const* out, size_t n) {
+    // A local copy, so the stores can't alias the leaves and the compiler keeps
+    // their broadcasts out of the loop
+    const E local = e;
+    forEachLane<num_type>(n, [&](auto lanes, size_t i) {
+      typedef decltype(lanes) L;
+      storeExpression<L>(local, out, i, std::make_integer_sequence<int, E::size>());
+    });
+  }
+
+  // out takes the element count of the arrays in e, or keeps its size when there
+  // are none. Returns the count
+  template <class D, typename num_type>
+  size_t evaluate(const Expression<D, Vector3<num_type>>& e, Vector3Array<num_type>& out) {
+    size_t n = e.derived().count();
+    if (n != std::numeric_limits<size_t>::max())
+      out.resize(n);
+    num_type* const p[3] = {out.x, out.y, out.z};
+    evaluateLanes(e.derived(), p, out.size());
+    return out.size();
+  }
+  template <class D, typename num_type>
+  size_t evaluate(const Expression<D, Quaternion<num_type>>& e, QuaternionArray<num_type>& out) {
+    size_t n = e.derived().count();
+    if (n != std::numeric_limits<size_t>::max())
+      out.resize(n);
+    num_type* const p[4] = {out.w, out.x, out.y, out.z};
+    evaluateLanes(e.derived(), p, out.size());
+    return out.size();
+  }
+  // out must hold the element count of the arrays in e, which must have some
+  template <class D, typename num_type>
+  size_t evaluate(const Expression<D, num_type>& e, num_type* out) {
+    size_t n = e.derived().count();
+    evaluateLanes(e.derived(), &out, n);
+    return n;
+  }
+
+#endif
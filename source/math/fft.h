@@ -0,0 +1,305 @@
+#if !defined(FFT_H_INCLUDED)
+  #define FFT_H_INCLUDED
+
+  #include <limits>
+  #include <math.h>
+  #include <stddef.h>
+  #include <stdint.h>
+  #include <vector>
+  #include "complex.h"
+  #include "simd.h"
+
+  // Radix-2 FFT plan for one power of two size: the bit reversal permutation and
+  // every stage's twiddle factors are computed once and reused by each call.
+  // Transforms take either interleaved Complex arrays or split arrays of real and
+  // imaginary parts, out of place or in place (in == out). The butterflies work on
+  // the split form a SimdLanes register at a time, so interleaved calls split the
+  // data into the plan's scratch arrays and back, and a plan must not be used by
+  // two threads at once.
+  //
+  // forward computes X[k] = sum x[j] exp(-2 pi i jk / n) and inverse the same with
+  // +i, divided by n, so inverse(forward(x)) = x. Sizes other than powers of two
+  // give NaN outputs.
+  template <typename num_type = float>
+  class FFTPlan {
+    public :
+      explicit FFTPlan(size_t size = 0) {
+        resize(size);
+      }
+      void resize(size_t size) {
+        n = size;
+        reversed.clear();
+        twiddle_re.clear();
+        twiddle_im.clear();
+        if (not supported(n))
+          return;
+        size_t bits = 0;
+        while ((size_t(1) << bits) < n)
+          ++bits;
+        reversed.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+          size_t r = 0;
+          for (size_t b = 0; b < bits; ++b)
+            r |= (i >> b & 1) << (bits - 1 - b);
+          reversed[i] = uint32_t(r);
+        }
+        // Stage with half size h keeps exp(-2 pi i k / 2h) for k < h from index h - 1
+        twiddle_re.resize(n > 1 ? n - 1 : 0);
+        twiddle_im.resize(twiddle_re.size());
+        const long double pi = 3.141592653589793238462643383279502884L;
+        for (size_t half = 1; half < n; half *= 2)
+          for (size_t k = 0; k < half; ++k) {
+            long double angle = -pi * (long double)k / (long double)half;
+            twiddle_re[half - 1 + k] = num_type(cosl(angle));
+            twiddle_im[half - 1 + k] = num_type(sinl(angle));
+          }
+        scratch_re.assign(n, num_type(0));
+        scratch_im.assign(n, num_type(0));
+      }
+
+      static bool supported(size_t size) {
+        return size != 0 and (size & (size - 1)) == 0 and size <= (size_t(1) << 31);
+      }
+      size_t size() const {
+        return n;
+      }
+
+      // Interleaved
+      void forward(const Complex<num_type>* in, Complex<num_type>* out) {
+        transform(in, out, false);
+      }
+      void inverse(const Complex<num_type>* in, Complex<num_type>* out) {
+        transform(in, out, true);
+      }
+      void forward(Complex<num_type>* data) {
+        transform(data, data, false);
+      }
+      void inverse(Complex<num_type>* data) {
+        transform(data, data, true);
+      }
+      void forward(const std::vector<Complex<num_type>>& in, std::vector<Complex<num_type>>& out) {
+        out.resize(n);
+        transform(in.data(), out.data(), false);
+      }
+      void inverse(const std::vector<Complex<num_type>>& in, std::vector<Complex<num_type>>& out) {
+        out.resize(n);
+        transform(in.data(), out.data(), true);
+      }
+
+      // Split. The inverse is the forward transform with the real and imaginary
+      // parts swapped on the way in and out
+      void forward(const num_type* in_re, const num_type* in_im, num_type* out_re, num_type* out_im) {
+        transform(in_re, in_im, out_re, out_im, num_type(1));
+      }
+      void inverse(const num_type* in_re, const num_type* in_im, num_type* out_re, num_type* out_im) {
+        transform(in_im, in_re, out_im, out_re, num_type(1) / num_type(n));
+      }
+
+    private :
+      size_t n;
+      std::vector<uint32_t> reversed;
+      std::vector<num_type> twiddle_re, twiddle_im;
+      std::vector<num_type> scratch_re, scratch_im;
+
+      void transform(const Complex<num_type>* in, Complex<num_type>* out, bool inverse) {
+        if (not supported(n)) {
+          fillNaN(out);
+          return;
+        }
+        num_type* re = scratch_re.data();
+        num_type* im = scratch_im.data();
+        // Split and permute in one pass; in may be out, as it's read in full first
+        for (size_t i = 0; i < n; ++i) {
+          re[reversed[i]] = inverse ? in[i].im : in[i].re;
+          im[reversed[i]] = inverse ? in[i].re : in[i].im;
+        }
+        stages(re, im);
+        num_type scale = inverse ? num_type(1) / num_type(n) : num_type(1);
+        for (size_t i = 0; i < n; ++i) {
+          out[i].re = (inverse ? im[i] : re[i]) * scale;
+          out[i].im = (inverse ? re[i] : im[i]) * scale;
+        }
+      }
+      void transform(const num_type* in_re, const num_type* in_im, num_type* out_re, num_type* out_im, num_type scale) {
+        if (not supported(n)) {
+          for (size_t i = 0; i < n; ++i)
+            out_re[i] = out_im[i] = std::numeric_limits<num_type>::quiet_NaN();
+          return;
+        }
+        if (in_re == out_re and in_im == out_im) {
+          for (size_t i = 0; i < n; ++i) {
+            size_t j = reversed[i];
+            if (i < j) {
+              num_type t = out_re[i]; out_re[i] = out_re[j]; out_re[j] = t;
+              t = out_im[i]; out_im[i] = out_im[j]; out_im[j] = t;
+            }
+          }
+        }
+        else
+          for (size_t i = 0; i < n; ++i) {
+            out_re[reversed[i]] = in_re[i];
+            out_im[reversed[i]] = in_im[i];
+          }
+        stages(out_re, out_im);
+        if (scale != num_type(1))
+          for (size_t i = 0; i < n; ++i) {
+            out_re[i] *= scale;
+            out_im[i] *= scale;
+          }
+      }
+      void fillNaN(Complex<num_type>* out) const {
+        for (size_t i = 0; i < n; ++i)
+          out[i] = Complex<num_type>(std::numeric_limits<num_type>::quiet_NaN(), std::numeric_limits<num_type>::quiet_NaN());
+      }
+
+      // Decimation in time over bit reversed data. The first two stages, whose
+      // twiddles are 1 and -i, go together as one radix-4 pass; later stages
+      // run whole registers of butterflies while a half holds at least one
+      void stages(num_type* re, num_type* im) const {
+        typedef SimdLanes<num_type> Wide;
+        if (n == 2) {
+          num_type r = re[1], i = im[1];
+          re[1] = re[0] - r; im[1] = im[0] - i;
+          re[0] += r; im[0] += i;
+          return;
+        }
+        for (size_t s = 0; s + 3 < n; s += 4) {
+          num_type a_re = re[s] + re[s + 1], a_im = im[s] + im[s + 1];
+          num_type b_re = re[s] - re[s + 1], b_im = im[s] - im[s + 1];
+          num_type c_re = re[s + 2] + re[s + 3], c_im = im[s + 2] + im[s + 3];
+          num_type d_re = re[s + 2] - re[s + 3], d_im = im[s + 2] - im[s + 3];
+          // d times -i is (d_im, -d_re)
+          re[s] = a_re + c_re; im[s] = a_im + c_im;
+          re[s + 2] = a_re - c_re; im[s + 2] = a_im - c_im;
+          re[s + 1] = b_re + d_im; im[s + 1] = b_im - d_re;
+          re[s + 3] = b_re - d_im; im[s + 3] = b_im + d_re;
+        }
+        for (size_t half = 4; half < n; half *= 2) {
+          const num_type* w_re = &twiddle_re[half - 1];
+          const num_type* w_im = &twiddle_im[half - 1];
+          for (size_t start = 0; start < n; start += 2 * half) {
+            if (half >= Wide::width)
+              butterflies<Wide>(re + start, im + start, w_re, w_im, half);
+            else
+              butterflies<ScalarLanes<num_type>>(re + start, im + start, w_re, w_im, half);
+          }
+        }
+      }
+      // x[k], x[k + half] = x[k] + w[k] x[k + half], x[k] - w[k] x[k + half]
+      template <class L>
+      static void butterflies(num_type* re, num_type* im, const num_type* w_re, const num_type* w_im, size_t half) {
+        typedef typename L::reg reg;
+        num_type* upper_re = re + half;
+        num_type* upper_im = im + half;
+        for (size_t k = 0; k < half; k += L::width) {
+          reg wr = L::load(w_re + k), wi = L::load(w_im + k);
+          reg ur = L::load(upper_re + k), ui = L::load(upper_im + k);
+          reg tr = L::negMulAdd(wi, ui, L::mul(wr, ur));
+          reg ti = L::mulAdd(wi, ur, L::mul(wr, ui));
+          reg lr = L::load(re + k), li = L::load(im + k);
+          L::store(upper_re + k, L::sub(lr, tr));
+          L::store(upper_im + k, L::sub(li, ti));
+          L::store(re + k, L::add(lr, tr));
+          L::store(im + k, L::add(li, ti));
+        }
+      }
+  };
+
+  // FFT of n real samples through a complex FFTPlan of n / 2: even and odd
+  // samples are packed as the real and imaginary parts, and one extra pass
+  // separates their spectra. forward gives the n / 2 + 1 bins from 0 to the
+  // Nyquist frequency, the rest being their conjugates; inverse takes those bins
+  // back to n samples. n must be a power of two of at least 2
+  template <typename num_type = float>
+  class RealFFTPlan {
+    public :
+      explicit RealFFTPlan(size_t size = 0) {
+        resize(size);
+      }
+      void resize(size_t size) {
+        n = size;
+        half_plan.resize(size / 2);
+        packed.assign(size / 2, Complex<num_type>());
+        twiddles.clear();
+        if (not supported(n))
+          return;
+        const long double pi = 3.141592653589793238462643383279502884L;
+        twiddles.resize(n / 2 + 1);
+        for (size_t k = 0; k <= n / 2; ++k) {
+          long double angle = -2 * pi * (long double)k / (long double)n;
+          twiddles[k] = Complex<num_type>(num_type(cosl(angle)), num_type(sinl(angle)));
+        }
+      }
+
+      static bool supported(size_t size) {
+        return size >= 2 and FFTPlan<num_type>::supported(size);
+      }
+      size_t size() const {
+        return n;
+      }
+      size_t bins() const {
+        return n / 2 + 1;
+      }
+
+      // n samples in, n / 2 + 1 bins out
+      void forward(const num_type* in, Complex<num_type>* out) {
+        if (not supported(n)) {
+          for (size_t k = 0; k < n / 2 + 1; ++k)
+            out[k] = Complex<num_type>(std::numeric_limits<num_type>::quiet_NaN(), std::numeric_limits<num_type>::quiet_NaN());
+          return;
+        }
+        size_t m = n / 2;
+        Complex<num_type>* z = packed.data();
+        for (size_t j = 0; j < m; ++j)
+          z[j] = Complex<num_type>(in[2 * j], in[2 * j + 1]);
+        half_plan.forward(z);
+        // Even spectrum E = (Z[k] + conj Z[m - k]) / 2, odd O = (Z[k] - conj Z[m - k]) / 2i,
+        // X[k] = E + w^k O. k and m - k are done together, so z can hold both
+        for (size_t k = 0; k <= m / 2; ++k) {
+          size_t l = (m - k) % m;
+          Complex<num_type> a = z[k], b = z[l];
+          out[k] = combine(a, b, twiddles[k]);
+          out[m - k] = combine(b, a, twiddles[m - k]);
+        }
+      }
+      // n / 2 + 1 bins in, n samples out
+      void inverse(const Complex<num_type>* in, num_type* out) {
+        if (not supported(n)) {
+          for (size_t j = 0; j < n; ++j)
+            out[j] = std::numeric_limits<num_type>::quiet_NaN();
+          return;
+        }
+        size_t m = n / 2;
+        Complex<num_type>* z = packed.data();
+        // E = (X[k] + conj X[m - k]) / 2, O = (X[k] - conj X[m - k]) conj(w^k) / 2, Z = E + iO
+        for (size_t k = 0; k < m; ++k) {
+          Complex<num_type> a = in[k], b = in[m - k].conjugate();
+          Complex<num_type> even = (a + b) * num_type(0.5);
+          Complex<num_type> odd = (a - b).multiply(twiddles[k].conjugate()) * num_type(0.5);
+          z[k] = Complex<num_type>(even.re - odd.im, even.im + odd.re);
+        }
+        half_plan.inverse(z);
+        for (size_t j = 0; j < m; ++j) {
+          out[2 * j] = z[j].re;
+          out[2 * j + 1] = z[j].im;
+        }
+      }
+
+    private :
+      size_t n;
+      FFTPlan<num_type> half_plan;
+      std::vector<Complex<num_type>> packed;
+      std::vector<Complex<num_type>> twiddles;
+
+      // Bin k from z[k] = a and z[m - k] = b
+      static Complex<num_type> combine(const Complex<num_type>& a, const Complex<num_type>& b, const Complex<num_type>& w) {
+        Complex<num_type> c = b.conjugate();
+        Complex<num_type> even = (a + c) * num_type(0.5);
+        Complex<num_type> d = (a - c) * num_type(0.5);
+        // d / i = (d.im, -d.re)
+        Complex<num_type> odd(d.im, -d.re);
+        return even + w.multiply(odd);
+      }
+  };
+
+#endif
@@ -0,0 +1,346 @@
+#if !defined(FIXED_H_INCLUDED)
+  #define FIXED_H_INCLUDED
+
+  #include <array>
+  #include <limits>
+  #include <stdint.h>
+  #include <type_traits>
+  #include "precision.h"
+  #include "simd.h"
+
+  // Integer pieces of the Fixed functions, on Q30 values (value * 2^30) held in
+  // int64_t. Only integer operations, so every compiler and flag set gives the
+  // same bits
+  struct FixedMath {
+    static constexpr int frac_bits = 30;
+    static constexpr int64_t one = int64_t(1) << frac_bits;
+    static constexpr int64_t half_pi = int64_t(ConstexprPrecision::pi / 2 * one + 0.5L);
+    static constexpr int cordic_steps = 30;
+
+    // floor(sqrt(n)). The double estimate is within one of the answer and the
+    // integer corrections make it exact, so the result does not depend on the FPU
+    static uint64_t squareRoot(uint64_t n) {
+      uint64_t root = uint64_t(::sqrt(double(n)));
+      while (root * root > n)
+        --root;
+      while ((root + 1) * (root + 1) <= n)
+        ++root;
+      return root;
+    }
+    // round(a * b / 2^30)
+    static constexpr int64_t multiply(int64_t a, int64_t b) {
+      return (a * b + (one >> 1)) >> frac_bits;
+    }
+    // round(value / 2^from * 2^to)
+    static constexpr int64_t rescale(int64_t value, int from, int to) {
+      if (from > to)
+        return (value + (int64_t(1) << (from - to - 1))) >> (from - to);
+      return value * (int64_t(1) << (to - from));
+    }
+
+    // Quadrant of angle and the Taylor series of the remainder in [-pi/4, pi/4],
+    // in Horner form with integer divisions, to degree 11 and 12
+    static constexpr void sineCosine(int64_t angle, int64_t& s, int64_t& c) {
+      int64_t quadrant = (angle < 0 ? angle - half_pi / 2 : angle + half_pi / 2) / half_pi;
+      int64_t r = angle - quadrant * half_pi, r2 = multiply(r, r);
+      int64_t ts = one, tc = one;
+      const int64_t sine_steps[5] = {110, 72, 42, 20, 6}, cosine_steps[6] = {132, 90, 56, 30, 12, 2};
+      for (int64_t k : sine_steps)
+        ts = one - multiply(r2, ts) / k;
+      for (int64_t k : cosine_steps)
+        tc = one - multiply(r2, tc) / k;
+      int64_t sr = multiply(r, ts), cr = tc;
+      switch (quadrant & 3) {
+        case 0 : s = sr; c = cr; break;
+        case 1 : s = cr; c = -sr; break;
+        case 2 : s = -sr; c = -cr; break;
+        default : s = -cr; c = sr; break;
+      }
+    }
+    // acos(x) for x in [-1, 1] as the angle of (x, sqrt(1 - x^2)), by steps of
+    // branchless CORDIC vectoring after a quarter turn that brings it within range
+    // when x < 0. Each step adds about a bit
+    static int64_t arcCosine(int64_t x, int steps) {
+      x = x > one ? one : (x < -one ? -one : x);
+      int64_t y = int64_t(squareRoot(uint64_t(one * one - x * x))), angle = 0;
+      if (x < 0) {
+        int64_t t = x;
+        x = y;
+        y = -t;
+        angle = half_pi;
+      }
+      for (int i = 0; i < steps; ++i) {
+        // Rotates toward y = 0: sign is 0 for y >= 0 and -1 for y < 0, and
+        // (v ^ sign) - sign negates v where y < 0
+        int64_t sign = y >> 63, dx = y >> i, dy = x >> i;
+        x += (dx ^ sign) - sign;
+        y -= (dy ^ sign) - sign;
+        angle += (arc_tangents[i] ^ sign) - sign;
+      }
+      return angle;
+    }
+
+    // atan(2^-i) for the CORDIC steps, computed by the compiler
+    static const std::array<int64_t, cordic_steps> arc_tangents;
+    static constexpr std::array<int64_t, cordic_steps> arcTangents() {
+      std::array<int64_t, cordic_steps> table = {};
+      long double t = 1;
+      for (int i = 0; i < cordic_steps; ++i, t /= 2)
+        table[i] = int64_t(ConstexprPrecision::arcTangentLong(t) * one + 0.5L);
+      return table;
+    }
+  };
+  inline constexpr std::array<int64_t, FixedMath::cordic_steps> FixedMath::arc_tangents = FixedMath::arcTangents();
+
+  // Signed fixed point number with IntBits integer bits, sign included, and
+  // FracBits fraction bits in an int32_t, for simulation that has to replay to the
+  // same bits on every compiler, flag set and CPU. It is a num_type like float:
+  // Vector3<Fixed<16, 16>>, QuaternionRotator<Fixed<16, 16>> and the rest work as
+  // they are, with sqrt, sin, cos and acos below found by argument dependent
+  // lookup, so keep the default ExactPrecision (the approximate policies go
+  // through float). Overflow is defined:
+  //  - +, -, * and / saturate to [lowest, max] instead of wrapping; * and / round
+  //    to nearest,
+  //  - x / 0 is max or lowest by the sign of x, and 0 / 0 is 0. There is no NaN,
+  //    so the math types' NaN results come out as 0,
+  //  - conversions from integers and floating point round and saturate the same way
+  template <int IntBits, int FracBits>
+  class Fixed {
+    static_assert(IntBits >= 1 and FracBits >= 0 and IntBits + FracBits <= 32, "Fixed has to fit an int32_t, sign included");
+
+    public :
+      typedef int32_t raw_type;
+      static constexpr int int_bits = IntBits;
+      static constexpr int frac_bits = FracBits;
+      static constexpr int64_t one_raw = int64_t(1) << FracBits;
+      static constexpr int64_t max_raw = (int64_t(1) << (IntBits + FracBits - 1)) - 1;
+      static constexpr int64_t min_raw = -(int64_t(1) << (IntBits + FracBits - 1));
+
+      raw_type raw;
+
+      constexpr Fixed() : raw(0) {}
+      template <typename other_num_type, typename std::enable_if<std::is_integral<other_num_type>::value, int>::type = 0>
+      constexpr Fixed(other_num_type n) : raw(fromInteger(n)) {}
+      template <typename other_num_type, typename std::enable_if<std::is_floating_point<other_num_type>::value, int>::type = 0>
+      constexpr Fixed(other_num_type n) : raw(fromFloating(n)) {}
+      template <int OtherIntBits, int OtherFracBits>
+      explicit constexpr Fixed(const Fixed<OtherIntBits, OtherFracBits>& f)
+        : raw(saturate(FixedMath::rescale(f.raw, OtherFracBits, FracBits))) {}
+      static constexpr Fixed fromRaw(int64_t r) {
+        Fixed f;
+        f.raw = saturate(r);
+        return f;
+      }
+
+      // Floating point exactly up to the float's own rounding; integers truncate
+      // toward zero like a float to int conversion
+      template <typename other_num_type, typename std::enable_if<std::is_floating_point<other_num_type>::value, int>::type = 0>
+      explicit constexpr operator other_num_type() const {
+        return other_num_type(raw) / other_num_type(one_raw);
+      }
+      template <typename other_num_type, typename std::enable_if<std::is_integral<other_num_type>::value
+                                                                 and not std::is_same<other_num_type, bool>::value, int>::type = 0>
+      explicit constexpr operator other_num_type() const {
+        return other_num_type(raw / one_raw);
+      }
+      explicit constexpr operator bool() const {
+        return raw != 0;
+      }
+
+      friend constexpr Fixed operator+(Fixed a, Fixed b) { return fromRaw(int64_t(a.raw) + b.raw);}
+      friend constexpr Fixed operator-(Fixed a, Fixed b) { return fromRaw(int64_t(a.raw) - b.raw);}
+      friend constexpr Fixed operator*(Fixed a, Fixed b) { return fromRaw(FixedMath::rescale(int64_t(a.raw) * b.raw, 2 * FracBits, FracBits));}
+      friend constexpr Fixed operator/(Fixed a, Fixed b) {
+        if (b.raw == 0)
+          return fromRaw(a.raw > 0 ? max_raw : (a.raw < 0 ? min_raw : 0));
+        int64_t n = int64_t(a.raw) * one_raw, q = n / b.raw, r = n % b.raw;
+        // Round half away from zero
+        if (2 * (r < 0 ? -r : r) >= (b.raw < 0 ? -int64_t(b.raw) : int64_t(b.raw)))
+          q += (n < 0) == (b.raw < 0) ? 1 : -1;
+        return fromRaw(q);
+      }
+      constexpr Fixed operator-() const { return fromRaw(-int64_t(raw));}
+      constexpr Fixed operator+() const { return *this;}
+
+      constexpr Fixed& operator+=(Fixed a) { return *this = *this + a;}
+      constexpr Fixed& operator-=(Fixed a) { return *this = *this - a;}
+      constexpr Fixed& operator*=(Fixed a) { return *this = *this * a;}
+      constexpr Fixed& operator/=(Fixed a) { return *this = *this / a;}
+
+      friend constexpr bool operator==(Fixed a, Fixed b) { return a.raw == b.raw;}
+      friend constexpr bool operator!=(Fixed a, Fixed b) { return a.raw != b.raw;}
+      friend constexpr bool operator<(Fixed a, Fixed b) { return a.raw < b.raw;}
+      friend constexpr bool operator>(Fixed a, Fixed b) { return a.raw > b.raw;}
+      friend constexpr bool operator<=(Fixed a, Fixed b) { return a.raw <= b.raw;}
+      friend constexpr bool operator>=(Fixed a, Fixed b) { return a.raw >= b.raw;}
+
+    private :
+      static constexpr raw_type saturate(int64_t r) {
+        return raw_type(r > max_raw ? max_raw : (r < min_raw ? min_raw : r));
+      }
+      template <typename other_num_type>
+      static constexpr raw_type fromInteger(other_num_type n) {
+        if (n > 0 and uint64_t(n) > uint64_t(max_raw >> FracBits))
+          return raw_type(max_raw);
+        if (n < 0 and int64_t(n) < (min_raw >> FracBits))
+          return raw_type(min_raw);
+        return raw_type(int64_t(n) * one_raw);
+      }
+      // Splits off the integer part first, so the rounding is exact in any float type
+      template <typename other_num_type>
+      static constexpr raw_type fromFloating(other_num_type n) {
+        other_num_type scaled = n * other_num_type(one_raw);
+        if (not (scaled == scaled))
+          return 0;
+        if (scaled >= other_num_type(max_raw))
+          return raw_type(max_raw);
+        if (scaled <= other_num_type(min_raw))
+          return raw_type(min_raw);
+        int64_t whole = int64_t(scaled);
+        other_num_type rest = scaled - other_num_type(whole);
+        if (rest >= other_num_type(0.5))
+          ++whole;
+        else if (rest <= other_num_type(-0.5))
+          --whole;
+        return saturate(whole);
+      }
+  };
+
+  // Negative x gives 0, for want of a NaN
+  template <int IntBits, int FracBits>
+  Fixed<IntBits, FracBits> sqrt(Fixed<IntBits, FracBits> x) {
+    if (x.raw <= 0)
+      return Fixed<IntBits, FracBits>();
+    uint64_t n = uint64_t(x.raw) << FracBits, root = FixedMath::squareRoot(n);
+    // Round to nearest: (root + 1/2)^2 = root^2 + root + 1/4
+    if (n - root * root > root)
+      ++root;
+    return Fixed<IntBits, FracBits>::fromRaw(int64_t(root));
+  }
+  template <int IntBits, int FracBits>
+  constexpr Fixed<IntBits, FracBits> sin(Fixed<IntBits, FracBits> x) {
+    int64_t s = 0, c = 0;
+    FixedMath::sineCosine(FixedMath::rescale(x.raw, FracBits, FixedMath::frac_bits), s, c);
+    return Fixed<IntBits, FracBits>::fromRaw(FixedMath::rescale(s, FixedMath::frac_bits, FracBits));
+  }
+  template <int IntBits, int FracBits>
+  constexpr Fixed<IntBits, FracBits> cos(Fixed<IntBits, FracBits> x) {
+    int64_t s = 0, c = 0;
+    FixedMath::sineCosine(FixedMath::rescale(x.raw, FracBits, FixedMath::frac_bits), s, c);
+    return Fixed<IntBits, FracBits>::fromRaw(FixedMath::rescale(c, FixedMath::frac_bits, FracBits));
+  }
+  template <int IntBits, int FracBits>
+  Fixed<IntBits, FracBits> acos(Fixed<IntBits, FracBits> x) {
+    const int steps = FracBits + 4 < FixedMath::cordic_steps ? FracBits + 4 : FixedMath::cordic_steps;
+    int64_t angle = FixedMath::arcCosine(FixedMath::rescale(x.raw, FracBits, FixedMath::frac_bits), steps);
+    return Fixed<IntBits, FracBits>::fromRaw(FixedMath::rescale(angle, FixedMath::frac_bits, FracBits));
+  }
+
+  namespace std {
+    template <int IntBits, int FracBits>
+    struct numeric_limits<Fixed<IntBits, FracBits>> {
+      typedef Fixed<IntBits, FracBits> F;
+
+        static constexpr bool is_specialized = true;
+        static constexpr bool is_signed = true;
+        static constexpr bool is_integer = false;
+        static constexpr bool is_exact = true;
+        static constexpr bool is_bounded = true;
+        static constexpr bool has_infinity = false;
+        static constexpr bool has_quiet_NaN = false;
+        static constexpr bool has_signaling_NaN = false;
+        static constexpr int radix = 2;
+        static constexpr int digits = IntBits + FracBits - 1;
+
+        static constexpr F min() { return F::fromRaw(1);}
+        static constexpr F lowest() { return F::fromRaw(F::min_raw);}
+        static constexpr F max() { return F::fromRaw(F::max_raw);}
+        static constexpr F epsilon() { return F::fromRaw(1);}
+        static constexpr F round_error() { return F(0.5);}
+        static constexpr F infinity() { return F();}
+        static constexpr F quiet_NaN() { return F();}
+        static constexpr F signaling_NaN() { return F();}
+        static constexpr F denorm_min() { return F();}
+    };
+  }
+
+  // 8 lanes of int32 with the same saturation and rounding as the scalar operators,
+  // so batch kernels give the scalar results bit for bit. Division and square root
+  // have no integer instructions and go lane by lane
+  #if defined(__AVX2__)
+    template <int IntBits, int FracBits>
+    struct SimdLanes<Fixed<IntBits, FracBits>> {
+      typedef Fixed<IntBits, FracBits> F;
+      typedef __m256i reg;
+      typedef __m256i mask;
+      static const size_t width = 8;
+
+      static reg load(const F* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+      static void store(F* p, reg a) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), a); }
+      static reg set(F a) { return _mm256_set1_epi32(a.raw); }
+
+      // Wrapped sums overflowed where both inputs differ in sign from the result
+      static reg add(reg a, reg b) {
+        reg s = _mm256_add_epi32(a, b);
+        reg overflow = _mm256_srai_epi32(_mm256_and_si256(_mm256_xor_si256(a, s), _mm256_xor_si256(b, s)), 31);
+        return clamp(_mm256_blendv_epi8(s, limitBySign(a), overflow));
+      }
+      static reg sub(reg a, reg b) {
+        reg d = _mm256_sub_epi32(a, b);
+        reg overflow = _mm256_srai_epi32(_mm256_and_si256(_mm256_xor_si256(a, b), _mm256_xor_si256(a, d)), 31);
+        return clamp(_mm256_blendv_epi8(d, limitBySign(a), overflow));
+      }
+      static reg negate(reg a) { return sub(_mm256_setzero_si256(), a); }
+      // Even and odd lanes as rounded 64 bit products, compared against the limits
+      // before the shifts, which can then be logical
+      static reg mul(reg a, reg b) {
+        reg half = _mm256_set1_epi64x(FracBits > 0 ? int64_t(1) << (FracBits > 0 ? FracBits - 1 : 0) : 0);
+        reg even = _mm256_add_epi64(_mm256_mul_epi32(a, b), half);
+        reg odd = _mm256_add_epi64(_mm256_mul_epi32(_mm256_srli_epi64(a, 32), _mm256_srli_epi64(b, 32)), half);
+        reg high_limit = _mm256_set1_epi64x(((F::max_raw + 1) << FracBits) - 1), low_limit = _mm256_set1_epi64x(F::min_raw * F::one_raw);
+        reg high = _mm256_blend_epi32(_mm256_cmpgt_epi64(even, high_limit), _mm256_cmpgt_epi64(odd, high_limit), 0xAA);
+        reg low = _mm256_blend_epi32(_mm256_cmpgt_epi64(low_limit, even), _mm256_cmpgt_epi64(low_limit, odd), 0xAA);
+        reg v = _mm256_blend_epi32(_mm256_srli_epi64(even, FracBits), _mm256_slli_epi64(odd, 32 - FracBits), 0xAA);
+        v = _mm256_blendv_epi8(v, _mm256_set1_epi32(int32_t(F::max_raw)), high);
+        return _mm256_blendv_epi8(v, _mm256_set1_epi32(int32_t(F::min_raw)), low);
+      }
+      static reg div(reg a, reg b) {
+        return eachLane(a, b, [](F x, F y) { return x / y; });
+      }
+      static reg mulAdd(reg a, reg b, reg c) { return add(mul(a, b), c); }
+      static reg negMulAdd(reg a, reg b, reg c) { return sub(c, mul(a, b)); }
+      static reg squareRoot(reg a) {
+        return eachLane(a, a, [](F x, F) { return sqrt(x); });
+      }
+      static reg min(reg a, reg b) { return _mm256_min_epi32(a, b); }
+      static reg max(reg a, reg b) { return _mm256_max_epi32(a, b); }
+
+      static mask greater(reg a, reg b) { return _mm256_cmpgt_epi32(a, b); }
+      static mask less(reg a, reg b) { return _mm256_cmpgt_epi32(b, a); }
+      static reg select(mask m, reg a, reg b) { return _mm256_blendv_epi8(b, a, m); }
+      static mask both(mask a, mask b) { return _mm256_and_si256(a, b); }
+      static int bits(mask m) { return _mm256_movemask_ps(_mm256_castsi256_ps(m)); }
+
+    private :
+      static reg limitBySign(reg a) {
+        // INT32_MAX, or INT32_MIN where a < 0
+        return _mm256_xor_si256(_mm256_srai_epi32(a, 31), _mm256_set1_epi32(0x7FFFFFFF));
+      }
+      static reg clamp(reg a) {
+        if (IntBits + FracBits == 32)
+          return a;
+        return _mm256_max_epi32(_mm256_min_epi32(a, _mm256_set1_epi32(int32_t(F::max_raw))), _mm256_set1_epi32(int32_t(F::min_raw)));
+      }
+      template <class Op>
+      static reg eachLane(reg a, reg b, Op op) {
+        alignas(32) F x[8], y[8];
+        store(x, a);
+        store(y, b);
+        for (int i = 0; i < 8; ++i)
+          x[i] = op(x[i], y[i]);
+        return load(x);
+      }
+    };
+  #endif
+
+#endif
@@ -0,0 +1,334 @@
+#if !defined(PRECISION_H_INCLUDED)
+  #define PRECISION_H_INCLUDED
+
+  #include <math.h>
+  #include <stdint.h>
+  #include <string.h>
+  #include <limits>
+  #if defined(__SSE__)
+    #include <immintrin.h>
+  #endif
+
+  // Precision policies for the transcendental parts of the math types. Pass one as
+  // a template argument per call, e.g. vec.normalized<FastPrecision>(), or choose
+  // one per number type by specializing DefaultPrecision.
+  //
+  // Maximum errors against long double libm, measured by bench/precision_bench.cpp
+  // (relative for reciprocalSquareRoot, absolute otherwise):
+  //
+  //                                  FastPrecision         FastestPrecision
+  //                                 float     double       float     double
+  //   reciprocalSquareRoot (x > 0) 2.5e-7    1.6e-7       3.3e-4    3.3e-4
+  //   sine, cosine (|x| <= 100)    2.9e-6    6.9e-11      9.5e-6    6.7e-6
+  //   arcCosine (|x| <= 1)         4.2e-7    2.2e-8       4.5e-4    4.5e-4
+  //
+  // ExactPrecision is libm. The approximate reciprocal square roots start from the
+  // single precision hardware estimate, scaled by a power of two for subnormals and
+  // doubles outside the float range, so they hold for every positive finite x but
+  // double gains little over float. Sine and cosine reduce the argument in
+  // num_type, so their error grows with |x|, and they are garbage but defined far
+  // beyond 1e18. ConstexprPrecision's sine and cosine are NaN beyond |x| = 7.2e18.
+  struct ExactPrecision {
+    template <typename num_type>
+    static num_type squareRoot(num_type x) {
+      using ::sqrt;
+      return sqrt(x);
+    }
+    template <typename num_type>
+    static num_type reciprocalSquareRoot(num_type x) {
+      using ::sqrt;
+      return 1 / sqrt(x);
+    }
+    template <typename num_type>
+    static num_type sine(num_type x) {
+      using ::sin;
+      return sin(x);
+    }
+    template <typename num_type>
+    static num_type cosine(num_type x) {
+      using ::cos;
+      return cos(x);
+    }
+    template <typename num_type>
+    static void sineCosine(num_type x, num_type& s, num_type& c) {
+      s = sine(x);
+      c = cosine(x);
+    }
+    template <typename num_type>
+    static num_type arcCosine(num_type x) {
+      using ::acos;
+      return acos(x);
+    }
+  };
+
+  // Shared pieces of the approximate policies
+  struct ApproximatePrecision {
+    // Single precision estimate of 1 / sqrt(x), relative error below 3.7e-4
+    static float reciprocalSquareRootEstimate(float x) {
+      #if defined(__SSE__)
+        return _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(x)));
+      #else
+        // Bit-level initial guess refined once, to match the hardware estimate
+        uint32_t i;
+        memcpy(&i, &x, sizeof(i));
+        i = 0x5F375A86 - (i >> 1);
+        float y;
+        memcpy(&y, &i, sizeof(y));
+        return y * (1.5f - 0.5f * x * y * y);
+      #endif
+    }
+    // The estimate for any num_type. Outside the normal float range, including
+    // float subnormals, x is scaled into it by an even power of two, which the
+    // result undoes by half that power; 0, inf and NaN go through unscaled
+    template <typename num_type>
+    static num_type reciprocalSquareRootGuess(num_type x) {
+      if (x >= num_type(std::numeric_limits<float>::min()) and x <= num_type(std::numeric_limits<float>::max()))
+        return num_type(reciprocalSquareRootEstimate(float(x)));
+      return scaledReciprocalSquareRootGuess(x);
+    }
+    template <typename num_type>
+    #if defined(__GNUC__)
+      __attribute__((noinline))
+    #endif
+    static num_type scaledReciprocalSquareRootGuess(num_type x) {
+      if (not (x > 0 and x < std::numeric_limits<num_type>::infinity()))
+        return num_type(reciprocalSquareRootEstimate(float(x)));
+      using ::frexp;
+      using ::ldexp;
+      int e;
+      num_type m = frexp(x, &e);
+      if (e & 1) {
+        m *= 2;
+        --e;
+      }
+      return ldexp(num_type(reciprocalSquareRootEstimate(float(m))), -e / 2);
+    }
+    template <typename num_type>
+    static num_type newtonStep(num_type x, num_type y) {
+      // x * y first, so a subnormal x isn't halved into zero
+      return y * (num_type(1.5) - x * y * y * num_type(0.5));
+    }
+
+    // Reduces x to [-pi/2, pi/2] with sin(x) unchanged, and returns the sign of cos(x)
+    template <typename num_type>
+    static num_type reduce(num_type& x) {
+      const num_type pi = num_type(3.14159265358979323846264338327950288L);
+      const num_type half_pi = num_type(1.57079632679489661923132169163975144L);
+      const num_type inv_two_pi = num_type(0.159154943091895335768883763372514362L);
+      // Beyond 2^62 turns k is already a whole number, and too large to convert
+      num_type k = x * inv_two_pi;
+      if (k < num_type(4.611686018427387904e18) and k > num_type(-4.611686018427387904e18))
+        k = num_type((long long)(k + (k < 0 ? num_type(-0.5) : num_type(0.5))));
+      x = x - k * (2 * pi);
+      // Selects rather than branches, the fold is unpredictable for arbitrary angles
+      bool fold = x > half_pi or x < -half_pi;
+      x = fold ? (x < 0 ? -pi : pi) - x : x;
+      return fold ? num_type(-1) : num_type(1);
+    }
+  };
+
+  // Reciprocal square root from the hardware estimate plus one Newton step, and
+  // minimax polynomials for sine, cosine and arc cosine
+  struct FastPrecision : ApproximatePrecision {
+    template <typename num_type>
+    static num_type reciprocalSquareRoot(num_type x) {
+      return newtonStep(x, reciprocalSquareRootGuess(x));
+    }
+    template <typename num_type>
+    static num_type squareRoot(num_type x) {
+      return x > 0 ? x * reciprocalSquareRoot(x) : num_type(0);
+    }
+    template <typename num_type>
+    static void sineCosine(num_type x, num_type& s, num_type& c) {
+      num_type sign = reduce(x);
+      num_type x2 = x * x;
+      s = x * (num_type(0.9999999999987953) + x2 * (num_type(-0.1666666665461862) + x2 * (num_type(0.008333332248595162)
+            + x2 * (num_type(-0.0001984100291255655) + x2 * (num_type(2.7531529591516387e-06) + x2 * num_type(-2.398473831207364e-08))))));
+      c = sign * (num_type(0.9999999999992518) + x2 * (num_type(-0.4999999999702404) + x2 * (num_type(0.04166666647338512)
+            + x2 * (num_type(-0.0013888884180015637) + x2 * (num_type(2.4801040649631744e-05)
+            + x2 * (num_type(-2.7524696439169713e-07) + x2 * num_type(1.9907857774112255e-09)))))));
+    }
+    template <typename num_type>
+    static num_type sine(num_type x) {
+      num_type s, c;
+      sineCosine(x, s, c);
+      return s;
+    }
+    template <typename num_type>
+    static num_type cosine(num_type x) {
+      num_type s, c;
+      sineCosine(x, s, c);
+      return c;
+    }
+    // Abramowitz and Stegun 4.4.46, with acos(-x) = pi - acos(x)
+    template <typename num_type>
+    static num_type arcCosine(num_type x) {
+      num_type a = x < 0 ? -x : x;
+      if (a > 1)
+        a = 1;
+      num_type p = num_type(1.5707963050) + a * (num_type(-0.2145988016) + a * (num_type(0.0889789874)
+                 + a * (num_type(-0.0501743046) + a * (num_type(0.0308918810) + a * (num_type(-0.0170881256)
+                 + a * (num_type(0.0066700901) + a * num_type(-0.0012624911)))))));
+      using ::sqrt;
+      p = p * sqrt(1 - a);
+      return x < 0 ? num_type(3.14159265358979323846264338327950288L) - p : p;
+    }
+  };
+
+  // Raw hardware reciprocal square root estimate and low-order polynomials
+  struct FastestPrecision : ApproximatePrecision {
+    template <typename num_type>
+    static num_type reciprocalSquareRoot(num_type x) {
+      return reciprocalSquareRootGuess(x);
+    }
+    template <typename num_type>
+    static num_type squareRoot(num_type x) {
+      return x > 0 ? x * reciprocalSquareRoot(x) : num_type(0);
+    }
+    template <typename num_type>
+    static void sineCosine(num_type x, num_type& s, num_type& c) {
+      num_type sign = reduce(x);
+      num_type x2 = x * x;
+      s = x * (num_type(0.9999966159096194) + x2 * (num_type(-0.1666482838248572)
+            + x2 * (num_type(0.008306325232428488) + x2 * num_type(-0.00018363654102754721))));
+      c = sign * (num_type(0.999993295286881) + x2 * (num_type(-0.4999124397484861)
+            + x2 * (num_type(0.041487748081303136) + x2 * num_type(-0.0012712094942830055))));
+    }
+    template <typename num_type>
+    static num_type sine(num_type x) {
+      num_type s, c;
+      sineCosine(x, s, c);
+      return s;
+    }
+    template <typename num_type>
+    static num_type cosine(num_type x) {
+      num_type s, c;
+      sineCosine(x, s, c);
+      return c;
+    }
+    // Abramowitz and Stegun 4.4.45, with acos(-x) = pi - acos(x)
+    template <typename num_type>
+    static num_type arcCosine(num_type x) {
+      num_type a = x < 0 ? -x : x;
+      if (a > 1)
+        a = 1;
+      num_type p = num_type(1.5707288) + a * (num_type(-0.2121144) + a * (num_type(0.0742610) + a * num_type(-0.0187293)));
+      p = p * squareRoot(1 - a);
+      return x < 0 ? num_type(3.14159265358979323846264338327950288L) - p : p;
+    }
+  };
+
+  // Usable in constant expressions, for orientations and tables the compiler
+  // builds, e.g.
+  //   constexpr QuaternionRotator<float> yaw = QuaternionRotator<float>::fromAngleAxis<ConstexprPrecision>(0.5f, Vector3<float>::up);
+  // Series and Newton iterations in long double, within an ulp of libm for float
+  // and double but much slower, so keep it out of code that runs per frame
+  struct ConstexprPrecision {
+    template <typename num_type>
+    static constexpr num_type squareRoot(num_type x) {
+      return num_type(squareRootLong(x));
+    }
+    template <typename num_type>
+    static constexpr num_type reciprocalSquareRoot(num_type x) {
+      return num_type(1 / squareRootLong(x));
+    }
+    template <typename num_type>
+    static constexpr void sineCosine(num_type x, num_type& s, num_type& c) {
+      long double ls = 0, lc = 0;
+      sineCosineLong(x, ls, lc);
+      s = num_type(ls);
+      c = num_type(lc);
+    }
+    template <typename num_type>
+    static constexpr num_type sine(num_type x) {
+      long double s = 0, c = 0;
+      sineCosineLong(x, s, c);
+      return num_type(s);
+    }
+    template <typename num_type>
+    static constexpr num_type cosine(num_type x) {
+      long double s = 0, c = 0;
+      sineCosineLong(x, s, c);
+      return num_type(c);
+    }
+    // acos(x) = 2 atan(sqrt((1 - x) / (1 + x)))
+    template <typename num_type>
+    static constexpr num_type arcCosine(num_type x) {
+      long double a = x;
+      if (not (a >= -1 and a <= 1))
+        return std::numeric_limits<num_type>::quiet_NaN();
+      if (a == -1)
+        return num_type(pi);
+      return num_type(2 * arcTangentLong(squareRootLong((1 - a) / (1 + a))));
+    }
+
+    static constexpr long double pi = 3.14159265358979323846264338327950288L;
+
+    static constexpr long double squareRootLong(long double x) {
+      if (x == 0 or x == std::numeric_limits<long double>::infinity())
+        return x;
+      if (not (x > 0))
+        return std::numeric_limits<long double>::quiet_NaN();
+      // Newton from [1/4, 4), where (1 + x) / 2 is a close enough start
+      long double scale = 1;
+      while (x >= 4) {
+        x /= 4;
+        scale *= 2;
+      }
+      while (x < 0.25L) {
+        x *= 4;
+        scale /= 2;
+      }
+      long double y = (1 + x) / 2;
+      for (int i = 0; i < 6; ++i)
+        y = (y + x / y) / 2;
+      return y * scale;
+    }
+    static constexpr void sineCosineLong(long double x, long double& s, long double& c) {
+      // Quadrant k of x, and r = x - k pi/2 in [-pi/4, pi/4]
+      // Beyond 2^62 quadrants no bit of r would be right, nor does k convert
+      long double k = x / (pi / 2);
+      if (not (k < 4.611686018427387904e18L and k > -4.611686018427387904e18L)) {
+        s = c = std::numeric_limits<long double>::quiet_NaN();
+        return;
+      }
+      long long quadrant = (long long)(k < 0 ? k - 0.5L : k + 0.5L);
+      long double r = x - (long double)quadrant * (pi / 2);
+      long double r2 = r * r, sr = r, cr = 1, term_s = r, term_c = 1;
+      for (int n = 1; n < 14; ++n) {
+        term_s = -term_s * r2 / ((2 * n) * (2 * n + 1));
+        term_c = -term_c * r2 / ((2 * n - 1) * (2 * n));
+        sr += term_s;
+        cr += term_c;
+      }
+      switch (quadrant & 3) {
+        case 0 : s = sr; c = cr; break;
+        case 1 : s = cr; c = -sr; break;
+        case 2 : s = -sr; c = -cr; break;
+        default : s = -cr; c = sr; break;
+      }
+    }
+    // For x >= 0: folded to [0, 1], then halved twice with
+    // atan(x) = 2 atan(x / (1 + sqrt(1 + x^2))) before the series
+    static constexpr long double arcTangentLong(long double x) {
+      if (x > 1)
+        return pi / 2 - arcTangentLong(1 / x);
+      for (int i = 0; i < 2; ++i)
+        x = x / (1 + squareRootLong(1 + x * x));
+      long double x2 = x * x, term = x, sum = x;
+      for (int n = 1; n < 24; ++n) {
+        term = -term * x2;
+        sum += term / (2 * n + 1);
+      }
+      return 4 * sum;
+    }
+  };
+
+  // Policy used when none is given. Specialize to change it for a number type:
+  //   template <> struct DefaultPrecision<float> { typedef FastPrecision type; };
+  template <typename num_type>
+  struct DefaultPrecision {
+    typedef ExactPrecision type;
+  };
+
+#endif
@@ -0,0 +1,272 @@
+#if !defined(QUANTIZED_H_INCLUDED)
+  #define QUANTIZED_H_INCLUDED
+
+  #include <stdint.h>
+  #include "rotator.h"
+  #include "aabb.h"
+
+  // Compact storage for rotations and positions, e.g. keyframes and saved states.
+  // Values are packed and unpacked one at a time or in bulk, with the arithmetic
+  // on SIMD lanes and only the bit fields handled per element.
+  //
+  // Quaternions use smallest-three codes: the largest magnitude component is left
+  // out and rebuilt from the unit norm, its index takes 2 bits, and the other
+  // three, which lie in [-1/sqrt(2), 1/sqrt(2)], take `bits` each. q and -q are
+  // the same rotation, so the sign is picked to make the dropped component
+  // positive. Only the rotation is kept: the scale of a non-unit q is dropped.
+  // With h = 1/sqrt(2) / (2^bits - 1) the rounding of a stored field, the dropped
+  // component is off by at most 3 h, so the rotation angle error is at most
+  // 2 sqrt(12) h:
+  //   PackedQuaternion32, 3 x 10 bits : 0.27 degrees (4.8e-3 radians)
+  //   PackedQuaternion48, 3 x 15 bits : 0.0086 degrees (1.5e-4 radians)
+  // The bulk functions round with fused multiply-adds where the target has them,
+  // so a field can differ in its last bit from the single value pack
+  struct PackedQuaternion32 {
+    static const int bits = 10;
+    uint32_t code;
+
+    void set(uint32_t index, uint32_t a, uint32_t b, uint32_t c) {
+      code = index << 30 | a << 20 | b << 10 | c;
+    }
+    uint32_t index() const {
+      return code >> 30;
+    }
+    uint32_t field(int i) const {
+      return code >> (20 - 10 * i) & 0x3FF;
+    }
+
+    template <typename num_type>
+    static PackedQuaternion32 pack(const Quaternion<num_type>& q);
+    template <typename num_type = float>
+    QuaternionRotator<num_type> unpack() const;
+  };
+  // Three 16 bit words, each a 15 bit field; the index is split over the top
+  // bits of the first two
+  struct PackedQuaternion48 {
+    static const int bits = 15;
+    uint16_t code[3];
+
+    void set(uint32_t index, uint32_t a, uint32_t b, uint32_t c) {
+      code[0] = uint16_t((index >> 1) << 15 | a);
+      code[1] = uint16_t((index & 1) << 15 | b);
+      code[2] = uint16_t(c);
+    }
+    uint32_t index() const {
+      return uint32_t(code[0] >> 15) << 1 | uint32_t(code[1] >> 15);
+    }
+    uint32_t field(int i) const {
+      return code[i] & 0x7FFFu;
+    }
+
+    template <typename num_type>
+    static PackedQuaternion48 pack(const Quaternion<num_type>& q);
+    template <typename num_type = float>
+    QuaternionRotator<num_type> unpack() const;
+  };
+
+  // Smallest-three on lanes of w, x, y, z. encode gives the dropped index and the
+  // three fields as whole numbers in [0, 2^bits - 1], still as num_type
+  template <int bits, class L, typename num_type>
+  inline void smallestThreeEncodeLanes(const typename L::reg (&q)[4], typename L::reg& index, typename L::reg (&fields)[3]) {
+    typedef typename L::reg R;
+    const num_type top = num_type((1 << bits) - 1), half_range = num_type(0.70710678118654752);
+    R a_w = L::max(q[0], L::negate(q[0])), a_x = L::max(q[1], L::negate(q[1])),
+      a_y = L::max(q[2], L::negate(q[2])), a_z = L::max(q[3], L::negate(q[3]));
+    typename L::mask x_over_w = L::greater(a_x, a_w), z_over_y = L::greater(a_z, a_y);
+    typename L::mask yz_over_wx = L::greater(L::select(z_over_y, a_z, a_y), L::select(x_over_w, a_x, a_w));
+    R largest = L::select(yz_over_wx, L::select(z_over_y, q[3], q[2]), L::select(x_over_w, q[1], q[0]));
+    index = L::select(yz_over_wx, L::select(z_over_y, L::set(3), L::set(2)), L::select(x_over_w, L::set(1), L::set(0)));
+    // Normalize, flip to a positive dropped component, and map [-1/sqrt(2), 1/sqrt(2)]
+    // onto [0.5, top + 0.5] so truncation rounds
+    R sqr_mag = L::mulAdd(q[3], q[3], L::mulAdd(q[2], q[2], L::mulAdd(q[1], q[1], L::mul(q[0], q[0]))));
+    R k = L::div(L::set(top / (2 * half_range)), L::squareRoot(sqr_mag));
+    k = L::select(L::less(largest, L::set(0)), L::negate(k), k);
+    R rest[3] = {L::select(yz_over_wx, q[0], L::select(x_over_w, q[0], q[1])),
+                 L::select(yz_over_wx, q[1], q[2]),
+                 L::select(yz_over_wx, L::select(z_over_y, q[2], q[3]), q[3])};
+    // Clamping also keeps the NaNs of a zero quaternion out of the fields
+    for (int c = 0; c < 3; ++c)
+      fields[c] = L::min(L::max(L::mulAdd(rest[c], k, L::set(top / 2 + num_type(0.5))), L::set(0)), L::set(top));
+  }
+  template <int bits, class L, typename num_type>
+  inline void smallestThreeDecodeLanes(typename L::reg index, const typename L::reg (&fields)[3], typename L::reg (&q)[4]) {
+    typedef typename L::reg R;
+    const num_type top = num_type((1 << bits) - 1), half_range = num_type(0.70710678118654752);
+    R step = L::set(2 * half_range / top), low = L::set(-half_range);
+    R c_0 = L::mulAdd(fields[0], step, low), c_1 = L::mulAdd(fields[1], step, low), c_2 = L::mulAdd(fields[2], step, low);
+    R rest = L::negMulAdd(c_2, c_2, L::negMulAdd(c_1, c_1, L::negMulAdd(c_0, c_0, L::set(1))));
+    R d = L::squareRoot(L::max(rest, L::set(0)));
+    typename L::mask after_0 = L::greater(index, L::set(num_type(0.5))), after_1 = L::greater(index, L::set(num_type(1.5))),
+                     after_2 = L::greater(index, L::set(num_type(2.5)));
+    q[0] = L::select(after_0, c_0, d);
+    q[1] = L::select(after_0, L::select(after_1, c_1, d), c_0);
+    q[2] = L::select(after_1, L::select(after_2, c_2, d), c_1);
+    q[3] = L::select(after_2, d, c_2);
+  }
+
+  template <class Packed, typename num_type>
+  inline Packed packQuaternion(const Quaternion<num_type>& q) {
+    typedef ScalarLanes<num_type> S;
+    num_type lanes[4] = {q.w, q.x, q.y, q.z}, index, fields[3];
+    smallestThreeEncodeLanes<Packed::bits, S, num_type>(lanes, index, fields);
+    Packed packed;
+    packed.set(uint32_t(index), uint32_t(fields[0]), uint32_t(fields[1]), uint32_t(fields[2]));
+    return packed;
+  }
+  template <class Packed, typename num_type>
+  inline QuaternionRotator<num_type> unpackQuaternion(const Packed& packed) {
+    typedef ScalarLanes<num_type> S;
+    num_type fields[3] = {num_type(packed.field(0)), num_type(packed.field(1)), num_type(packed.field(2))}, q[4];
+    smallestThreeDecodeLanes<Packed::bits, S, num_type>(num_type(packed.index()), fields, q);
+    return Quaternion<num_type>(q[0], q[1], q[2], q[3]);
+  }
+  template <typename num_type>
+  PackedQuaternion32 PackedQuaternion32::pack(const Quaternion<num_type>& q) {
+    return packQuaternion<PackedQuaternion32>(q);
+  }
+  template <typename num_type>
+  QuaternionRotator<num_type> PackedQuaternion32::unpack() const {
+    return unpackQuaternion<PackedQuaternion32, num_type>(*this);
+  }
+  template <typename num_type>
+  PackedQuaternion48 PackedQuaternion48::pack(const Quaternion<num_type>& q) {
+    return packQuaternion<PackedQuaternion48>(q);
+  }
+  template <typename num_type>
+  QuaternionRotator<num_type> PackedQuaternion48::unpack() const {
+    return unpackQuaternion<PackedQuaternion48, num_type>(*this);
+  }
+
+  // Bulk versions for PackedQuaternion32 and PackedQuaternion48, staged 64 at a
+  // time between the bit fields and the lanes
+  template <class Packed, typename num_type>
+  void packQuaternions(const QuaternionArray<num_type>& quats, Packed* out) {
+    const size_t block = 64;
+    alignas(64) num_type index[block], fields[3][block];
+    for (size_t start = 0; start < quats.size(); start += block) {
+      size_t m = quats.size() - start < block ? quats.size() - start : block;
+      const num_type *w = quats.w + start, *x = quats.x + start, *y = quats.y + start, *z = quats.z + start;
+      forEachLane<num_type>(m, [&](auto lanes, size_t i) {
+        typedef decltype(lanes) L;
+        typename L::reg q[4] = {L::load(w + i), L::load(x + i), L::load(y + i), L::load(z + i)}, k, f[3];
+        smallestThreeEncodeLanes<Packed::bits, L, num_type>(q, k, f);
+        L::store(index + i, k);
+        for (int c = 0; c < 3; ++c)
+          L::store(fields[c] + i, f[c]);
+      });
+      for (size_t i = 0; i < m; ++i)
+        out[start + i].set(uint32_t(index[i]), uint32_t(fields[0][i]), uint32_t(fields[1][i]), uint32_t(fields[2][i]));
+    }
+  }
+  template <class Packed, typename num_type>
+  void unpackQuaternions(const Packed* packed, size_t n, QuaternionArray<num_type>& out) {
+    const size_t block = 64;
+    alignas(64) num_type index[block], fields[3][block];
+    out.resize(n);
+    for (size_t start = 0; start < n; start += block) {
+      size_t m = n - start < block ? n - start : block;
+      for (size_t i = 0; i < m; ++i) {
+        index[i] = num_type(packed[start + i].index());
+        for (int c = 0; c < 3; ++c)
+          fields[c][i] = num_type(packed[start + i].field(c));
+      }
+      num_type *w = out.w + start, *x = out.x + start, *y = out.y + start, *z = out.z + start;
+      forEachLane<num_type>(m, [&](auto lanes, size_t i) {
+        typedef decltype(lanes) L;
+        typename L::reg f[3] = {L::load(fields[0] + i), L::load(fields[1] + i), L::load(fields[2] + i)}, q[4];
+        smallestThreeDecodeLanes<Packed::bits, L, num_type>(L::load(index + i), f, q);
+        L::store(w + i, q[0]);
+        L::store(x + i, q[1]);
+        L::store(y + i, q[2]);
+        L::store(z + i, q[3]);
+      });
+    }
+  }
+
+  // 16 bits per axis over a fixed box, e.g. the bounds of an animation track.
+  // Points outside are clamped to it. The error per axis is the box size along it
+  // / 131070, e.g. 0.15 mm over 20 m, plus the rounding of num_type
+  struct PackedVector3 {
+    uint16_t x, y, z;
+
+    template <typename num_type>
+    static PackedVector3 pack(const Vector3<num_type>& vec, const AABB<num_type>& bounds) {
+      typedef ScalarLanes<num_type> S;
+      num_type v[3] = {vec.x, vec.y, vec.z}, fields[3];
+      encodeLanes<S, num_type>(v, bounds, fields);
+      PackedVector3 packed = {uint16_t(fields[0]), uint16_t(fields[1]), uint16_t(fields[2])};
+      return packed;
+    }
+    template <typename num_type>
+    Vector3<num_type> unpack(const AABB<num_type>& bounds) const {
+      typedef ScalarLanes<num_type> S;
+      num_type fields[3] = {num_type(x), num_type(y), num_type(z)}, v[3];
+      decodeLanes<S, num_type>(fields, bounds, v);
+      return Vector3<num_type>(v[0], v[1], v[2]);
+    }
+
+    // Fields as whole numbers in [0, 65535], still as num_type
+    template <class L, typename num_type>
+    static void encodeLanes(const typename L::reg (&v)[3], const AABB<num_type>& bounds, typename L::reg (&fields)[3]) {
+      const num_type top = 65535, low[3] = {bounds.min.x, bounds.min.y, bounds.min.z},
+                     size[3] = {bounds.max.x - low[0], bounds.max.y - low[1], bounds.max.z - low[2]};
+      for (int c = 0; c < 3; ++c) {
+        typename L::reg u = L::mulAdd(L::sub(v[c], L::set(low[c])), L::set(top / size[c]), L::set(num_type(0.5)));
+        fields[c] = L::min(L::max(u, L::set(0)), L::set(top));
+      }
+    }
+    template <class L, typename num_type>
+    static void decodeLanes(const typename L::reg (&fields)[3], const AABB<num_type>& bounds, typename L::reg (&v)[3]) {
+      const num_type top = 65535, low[3] = {bounds.min.x, bounds.min.y, bounds.min.z},
+                     size[3] = {bounds.max.x - low[0], bounds.max.y - low[1], bounds.max.z - low[2]};
+      for (int c = 0; c < 3; ++c)
+        v[c] = L::mulAdd(fields[c], L::set(size[c] / top), L::set(low[c]));
+    }
+  };
+
+  template <typename num_type>
+  void packVectors(const Vector3Array<num_type>& vecs, const AABB<num_type>& bounds, PackedVector3* out) {
+    const size_t block = 64;
+    alignas(64) num_type fields[3][block];
+    for (size_t start = 0; start < vecs.size(); start += block) {
+      size_t m = vecs.size() - start < block ? vecs.size() - start : block;
+      const num_type *x = vecs.x + start, *y = vecs.y + start, *z = vecs.z + start;
+      forEachLane<num_type>(m, [&](auto lanes, size_t i) {
+        typedef decltype(lanes) L;
+        typename L::reg v[3] = {L::load(x + i), L::load(y + i), L::load(z + i)}, f[3];
+        PackedVector3::encodeLanes<L, num_type>(v, bounds, f);
+        for (int c = 0; c < 3; ++c)
+          L::store(fields[c] + i, f[c]);
+      });
+      for (size_t i = 0; i < m; ++i) {
+        out[start + i].x = uint16_t(fields[0][i]);
+        out[start + i].y = uint16_t(fields[1][i]);
+        out[start + i].z = uint16_t(fields[2][i]);
+      }
+    }
+  }
+  template <typename num_type>
+  void unpackVectors(const PackedVector3* packed, size_t n, const AABB<num_type>& bounds, Vector3Array<num_type>& out) {
+    const size_t block = 64;
+    alignas(64) num_type fields[3][block];
+    out.resize(n);
+    for (size_t start = 0; start < n; start += block) {
+      size_t m = n - start < block ? n - start : block;
+      for (size_t i = 0; i < m; ++i) {
+        fields[0][i] = num_type(packed[start + i].x);
+        fields[1][i] = num_type(packed[start + i].y);
+        fields[2][i] = num_type(packed[start + i].z);
+      }
+      num_type *x = out.x + start, *y = out.y + start, *z = out.z + start;
+      forEachLane<num_type>(m, [&](auto lanes, size_t i) {
+        typedef decltype(lanes) L;
+        typename L::reg f[3] = {L::load(fields[0] + i), L::load(fields[1] + i), L::load(fields[2] + i)}, v[3];
+        PackedVector3::decodeLanes<L, num_type>(f, bounds, v);
+        L::store(x + i, v[0]);
+        L::store(y + i, v[1]);
+        L::store(z + i, v[2]);
+      });
+    }
+  }
+
+#endif
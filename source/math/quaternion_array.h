@@ -0,0 +1,325 @@
+#if !defined(QUATERNION_ARRAY_H_INCLUDED)
+  #define QUATERNION_ARRAY_H_INCLUDED
+
+  #include <new>
+  #include <string.h>
+  #include "complex.h"
+  #include "simd.h"
+
+  // Structure-of-arrays container of Quaternions, laid out like Vector3Array
+  // with one cache line aligned lane per component. Kernels write into an output
+  // array which may alias this or the inputs.
+  template <typename num_type = float>
+  class QuaternionArray {
+    public :
+      static const size_t alignment = 64;
+
+      num_type* w;
+      num_type* x;
+      num_type* y;
+      num_type* z;
+
+      QuaternionArray() : w(nullptr), x(nullptr), y(nullptr), z(nullptr), count(0), cap(0) {}
+      explicit QuaternionArray(size_t n) : QuaternionArray() {
+        resize(n);
+      }
+      template <typename other_num_type>
+      QuaternionArray(const Quaternion<other_num_type>* quats, size_t n) : QuaternionArray() {
+        fromQuaternions(quats, n);
+      }
+      QuaternionArray(const QuaternionArray<num_type>& arr) : QuaternionArray() {
+        *this = arr;
+      }
+      // Borrowed lanes, as in Vector3Array::borrow
+      static QuaternionArray<num_type> borrow(const num_type* w, const num_type* x, const num_type* y, const num_type* z, size_t n) {
+        QuaternionArray<num_type> arr;
+        arr.w = const_cast<num_type*>(w);
+        arr.x = const_cast<num_type*>(x);
+        arr.y = const_cast<num_type*>(y);
+        arr.z = const_cast<num_type*>(z);
+        arr.count = n;
+        return arr;
+      }
+      QuaternionArray(QuaternionArray<num_type>&& arr) : QuaternionArray() {
+        swap(arr);
+      }
+      QuaternionArray<num_type>& operator=(const QuaternionArray<num_type>& arr) {
+        if (this != &arr) {
+          resize(arr.count);
+          memcpy(w, arr.w, count * sizeof(num_type));
+          memcpy(x, arr.x, count * sizeof(num_type));
+          memcpy(y, arr.y, count * sizeof(num_type));
+          memcpy(z, arr.z, count * sizeof(num_type));
+        }
+        return *this;
+      }
+      QuaternionArray<num_type>& operator=(QuaternionArray<num_type>&& arr) {
+        swap(arr);
+        return *this;
+      }
+      ~QuaternionArray() {
+        if (cap != 0)
+          release(w);
+      }
+
+      void swap(QuaternionArray<num_type>& arr) {
+        num_type* t;
+        t = w; w = arr.w; arr.w = t;
+        t = x; x = arr.x; arr.x = t;
+        t = y; y = arr.y; arr.y = t;
+        t = z; z = arr.z; arr.z = t;
+        size_t s;
+        s = count; count = arr.count; arr.count = s;
+        s = cap; cap = arr.cap; arr.cap = s;
+      }
+
+      // Container functions
+      size_t size() const {
+        return count;
+      }
+      size_t capacity() const {
+        return cap;
+      }
+      bool empty() const {
+        return count == 0;
+      }
+      void clear() {
+        count = 0;
+      }
+      void reserve(size_t n) {
+        if (n < count)
+          n = count;
+        if (n <= cap)
+          return;
+        size_t per_line = alignment / sizeof(num_type);
+        size_t new_cap = (n + per_line - 1) / per_line * per_line;
+        num_type* block = allocate(4 * new_cap);
+        if (count != 0) {
+          memcpy(block, w, count * sizeof(num_type));
+          memcpy(block + new_cap, x, count * sizeof(num_type));
+          memcpy(block + 2 * new_cap, y, count * sizeof(num_type));
+          memcpy(block + 3 * new_cap, z, count * sizeof(num_type));
+        }
+        if (cap != 0)
+          release(w);
+        w = block;
+        x = block + new_cap;
+        y = block + 2 * new_cap;
+        z = block + 3 * new_cap;
+        cap = new_cap;
+      }
+      // New elements are identity rotations
+      void resize(size_t n) {
+        if (n > cap)
+          reserve(n > 2 * cap ? n : 2 * cap);
+        for (size_t i = count; i < n; ++i) {
+          w[i] = 1;
+          x[i] = y[i] = z[i] = 0;
+        }
+        count = n;
+      }
+      template <typename other_num_type>
+      void append(const Quaternion<other_num_type>& q) {
+        if (count >= cap)
+          reserve(count == 0 ? alignment / sizeof(num_type) : 2 * count);
+        set(count++, q);
+      }
+
+      // Conversion to and from plain Quaternion
+      Quaternion<num_type> get(size_t i) const {
+        return Quaternion<num_type>(w[i], x[i], y[i], z[i]);
+      }
+      template <typename other_num_type>
+      void set(size_t i, const Quaternion<other_num_type>& q) {
+        w[i] = q.w; x[i] = q.x; y[i] = q.y; z[i] = q.z;
+      }
+      Quaternion<num_type> operator[](size_t i) const {
+        return get(i);
+      }
+      template <typename other_num_type>
+      void fromQuaternions(const Quaternion<other_num_type>* quats, size_t n) {
+        resize(n);
+        for (size_t i = 0; i < n; ++i)
+          set(i, quats[i]);
+      }
+      template <typename other_num_type>
+      void toQuaternions(Quaternion<other_num_type>* quats) const {
+        for (size_t i = 0; i < count; ++i) {
+          quats[i].w = w[i]; quats[i].x = x[i]; quats[i].y = y[i]; quats[i].z = z[i];
+        }
+      }
+
+      // Batch kernels, element-wise counterparts of the Quaternion functions
+      // out must hold min(size(), q.size()) numbers
+      void dotProduct(const QuaternionArray<num_type>& q, num_type* out) const {
+        size_t n = count < q.count ? count : q.count;
+        const num_type *qw = q.w, *qx = q.x, *qy = q.y, *qz = q.z;
+        forEachLane<num_type>(n, [&](auto lanes, size_t i) {
+          typedef decltype(lanes) L;
+          typename L::reg dot = L::mul(L::load(w + i), L::load(qw + i));
+          dot = L::mulAdd(L::load(x + i), L::load(qx + i), dot);
+          dot = L::mulAdd(L::load(y + i), L::load(qy + i), dot);
+          dot = L::mulAdd(L::load(z + i), L::load(qz + i), dot);
+          L::store(out + i, dot);
+        });
+      }
+      // Hamilton product this * q
+      void multiply(const QuaternionArray<num_type>& q, QuaternionArray<num_type>& out) const {
+        size_t n = prepare(q, out);
+        const num_type *qw = q.w, *qx = q.x, *qy = q.y, *qz = q.z;
+        num_type *ow = out.w, *ox = out.x, *oy = out.y, *oz = out.z;
+        forEachLane<num_type>(n, [&](auto lanes, size_t i) {
+          typedef decltype(lanes) L;
+          typename L::reg aw = L::load(w + i), ax = L::load(x + i), ay = L::load(y + i), az = L::load(z + i),
+                          bw = L::load(qw + i), bx = L::load(qx + i), by = L::load(qy + i), bz = L::load(qz + i);
+          typename L::reg rw = L::negMulAdd(az, bz, L::negMulAdd(ay, by, L::negMulAdd(ax, bx, L::mul(aw, bw))));
+          typename L::reg rx = L::negMulAdd(az, by, L::mulAdd(ay, bz, L::mulAdd(ax, bw, L::mul(aw, bx))));
+          typename L::reg ry = L::mulAdd(az, bx, L::mulAdd(ay, bw, L::negMulAdd(ax, bz, L::mul(aw, by))));
+          typename L::reg rz = L::mulAdd(az, bw, L::negMulAdd(ay, bx, L::mulAdd(ax, by, L::mul(aw, bz))));
+          L::store(ow + i, rw);
+          L::store(ox + i, rx);
+          L::store(oy + i, ry);
+          L::store(oz + i, rz);
+        });
+      }
+      // Zero quaternions stay zero, as in Quaternion::normalized
+      void normalized(QuaternionArray<num_type>& out) const {
+        size_t n = prepare(out);
+        num_type *ow = out.w, *ox = out.x, *oy = out.y, *oz = out.z;
+        forEachLane<num_type>(n, [&](auto lanes, size_t i) {
+          typedef decltype(lanes) L;
+          typename L::reg qw = L::load(w + i), qx = L::load(x + i), qy = L::load(y + i), qz = L::load(z + i);
+          typename L::reg sqr = L::mulAdd(qz, qz, L::mulAdd(qy, qy, L::mulAdd(qx, qx, L::mul(qw, qw))));
+          typename L::reg zero = L::set(0);
+          typename L::reg inv = L::select(L::greater(sqr, zero), L::div(L::set(1), L::squareRoot(sqr)), zero);
+          L::store(ow + i, L::mul(qw, inv));
+          L::store(ox + i, L::mul(qx, inv));
+          L::store(oy + i, L::mul(qy, inv));
+          L::store(oz + i, L::mul(qz, inv));
+        });
+      }
+
+      // Interpolation from this towards q with one weight per element, t must
+      // hold min(size(), q.size()) numbers. Inputs are unit quaternions; every
+      // element takes the shortest path and the results are renormalized
+      void nlerp(const QuaternionArray<num_type>& q, const num_type* t, QuaternionArray<num_type>& out) const {
+        interpolate(q, out, [&](auto lanes, size_t i, auto d, auto& k_0, auto& k_1) {
+          typedef decltype(lanes) L;
+          typename L::reg s = L::load(t + i);
+          k_0 = L::sub(L::set(1), s);
+          k_1 = L::select(L::less(d, L::set(0)), L::sub(L::set(0), s), s);
+        });
+      }
+      // Within 4e-7 of Quaternion::slerp for float and 4e-9 for double. The angle between two unit
+      // quaternions on the shortest path is at most pi / 2, so acos and sin are
+      // evaluated as polynomials without range reduction
+      void slerp(const QuaternionArray<num_type>& q, const num_type* t, QuaternionArray<num_type>& out) const {
+        interpolate(q, out, [&](auto lanes, size_t i, auto d, auto& k_0, auto& k_1) {
+          typedef decltype(lanes) L;
+          typename L::reg s = L::load(t + i), one = L::set(1);
+          typename L::mask flip = L::less(d, L::set(0));
+          typename L::reg a = L::min(L::select(flip, L::sub(L::set(0), d), d), one);
+          typename L::reg theta = arcCosine<L>(a);
+          typename L::reg inv_sin = L::div(one, sine<L>(theta));
+          typename L::reg k_near = L::sub(one, s);
+          typename L::reg k_far = L::mul(sine<L>(L::mul(k_near, theta)), inv_sin);
+          // Nearly parallel, fall back to nlerp as the scalar version does
+          typename L::mask parallel = L::greater(a, L::set(num_type(0.9995)));
+          k_0 = L::select(parallel, k_near, k_far);
+          k_1 = L::select(parallel, s, L::mul(sine<L>(L::mul(s, theta)), inv_sin));
+          k_1 = L::select(flip, L::sub(L::set(0), k_1), k_1);
+        });
+      }
+      // Batch Quaternion::fastSlerp, within 7e-4 of slerp
+      void fastSlerp(const QuaternionArray<num_type>& q, const num_type* t, QuaternionArray<num_type>& out) const {
+        interpolate(q, out, [&](auto lanes, size_t i, auto d, auto& k_0, auto& k_1) {
+          typedef decltype(lanes) L;
+          typename L::reg s = L::load(t + i), half = L::set(num_type(0.5)), one = L::set(1);
+          typename L::mask flip = L::less(d, L::set(0));
+          typename L::reg a = L::select(flip, L::sub(L::set(0), d), d);
+          typename L::reg p = L::mulAdd(a, L::set(num_type(-1.43519)), L::set(num_type(3.55645)));
+          p = L::mulAdd(L::mulAdd(a, p, L::set(num_type(-3.2452))), a, L::set(num_type(1.0904)));
+          typename L::reg b = L::mulAdd(a, L::set(num_type(0.215638)), L::set(num_type(-1.06021)));
+          b = L::mulAdd(a, b, L::set(num_type(0.848013)));
+          typename L::reg c = L::sub(s, half);
+          typename L::reg k = L::mulAdd(L::mul(p, c), c, b);
+          s = L::mulAdd(L::mul(L::mul(s, c), L::sub(s, one)), k, s);
+          k_0 = L::sub(one, s);
+          k_1 = L::select(flip, L::sub(L::set(0), s), s);
+        });
+      }
+
+    private :
+      size_t count;
+      size_t cap;
+
+      static num_type* allocate(size_t n) {
+        return static_cast<num_type*>(::operator new(n * sizeof(num_type), std::align_val_t(alignment)));
+      }
+      static void release(num_type* p) {
+        if (p != nullptr)
+          ::operator delete(p, std::align_val_t(alignment));
+      }
+      size_t prepare(QuaternionArray<num_type>& out) const {
+        if (&out != this)
+          out.resize(count);
+        return count;
+      }
+      size_t prepare(const QuaternionArray<num_type>& a, QuaternionArray<num_type>& out) const {
+        size_t n = count < a.count ? count : a.count;
+        if (&out != this and &out != &a)
+          out.resize(n);
+        return n;
+      }
+
+      // Lane-wise FastPrecision polynomials on the ranges slerp needs, sine on
+      // [0, pi / 2] and arc cosine on [0, 1]
+      template <class L>
+      static typename L::reg sine(typename L::reg x) {
+        typename L::reg x2 = L::mul(x, x);
+        typename L::reg p = L::mulAdd(x2, L::set(num_type(-2.398473831207364e-08)), L::set(num_type(2.7531529591516387e-06)));
+        p = L::mulAdd(x2, p, L::set(num_type(-0.0001984100291255655)));
+        p = L::mulAdd(x2, p, L::set(num_type(0.008333332248595162)));
+        p = L::mulAdd(x2, p, L::set(num_type(-0.1666666665461862)));
+        p = L::mulAdd(x2, p, L::set(num_type(0.9999999999987953)));
+        return L::mul(x, p);
+      }
+      template <class L>
+      static typename L::reg arcCosine(typename L::reg a) {
+        typename L::reg p = L::mulAdd(a, L::set(num_type(-0.0012624911)), L::set(num_type(0.0066700901)));
+        p = L::mulAdd(a, p, L::set(num_type(-0.0170881256)));
+        p = L::mulAdd(a, p, L::set(num_type(0.0308918810)));
+        p = L::mulAdd(a, p, L::set(num_type(-0.0501743046)));
+        p = L::mulAdd(a, p, L::set(num_type(0.0889789874)));
+        p = L::mulAdd(a, p, L::set(num_type(-0.2145988016)));
+        p = L::mulAdd(a, p, L::set(num_type(1.5707963050)));
+        return L::mul(p, L::squareRoot(L::sub(L::set(1), a)));
+      }
+      // out = normalize(this * k_0 + q * k_1), with weights(lanes, i, dot, k_0, k_1)
+      template <class Weights>
+      void interpolate(const QuaternionArray<num_type>& q, QuaternionArray<num_type>& out, Weights weights) const {
+        size_t n = prepare(q, out);
+        const num_type *qw = q.w, *qx = q.x, *qy = q.y, *qz = q.z;
+        num_type *ow = out.w, *ox = out.x, *oy = out.y, *oz = out.z;
+        forEachLane<num_type>(n, [&](auto lanes, size_t i) {
+          typedef decltype(lanes) L;
+          typename L::reg aw = L::load(w + i), ax = L::load(x + i), ay = L::load(y + i), az = L::load(z + i),
+                          bw = L::load(qw + i), bx = L::load(qx + i), by = L::load(qy + i), bz = L::load(qz + i);
+          typename L::reg d = L::mulAdd(az, bz, L::mulAdd(ay, by, L::mulAdd(ax, bx, L::mul(aw, bw))));
+          typename L::reg k_0, k_1;
+          weights(lanes, i, d, k_0, k_1);
+          typename L::reg rw = L::mulAdd(bw, k_1, L::mul(aw, k_0));
+          typename L::reg rx = L::mulAdd(bx, k_1, L::mul(ax, k_0));
+          typename L::reg ry = L::mulAdd(by, k_1, L::mul(ay, k_0));
+          typename L::reg rz = L::mulAdd(bz, k_1, L::mul(az, k_0));
+          typename L::reg sqr = L::mulAdd(rz, rz, L::mulAdd(ry, ry, L::mulAdd(rx, rx, L::mul(rw, rw))));
+          typename L::reg inv = L::div(L::set(1), L::squareRoot(sqr));
+          L::store(ow + i, L::mul(rw, inv));
+          L::store(ox + i, L::mul(rx, inv));
+          L::store(oy + i, L::mul(ry, inv));
+          L::store(oz + i, L::mul(rz, inv));
+        });
+      }
+  };
+
+#endif
@@ -3,67 +3,105 @@
   
   #include "vector.h"
   #include "complex.h"
+  #include "vector_array.h"
+  #include "quaternion_array.h"
+  #include <array>
+  #include <type_traits>
+  #if defined(__cpp_concepts)
+    #include <concepts>
+  #endif
 
-  // Curiously Recursive Template Parameter to tailor virtual functions to be overridden
+  // Curiously Recurring Template Pattern: every call is forwarded to FinalType at
+  // compile time, so rotators carry no vtable pointer and calls inline.
+  // FinalType must provide rotate, normalized, inverse, compose, rotateFromTo and rotateLanes
   template <class FinalType, typename num_type = float>
   class Rotator {
     public :
+      typedef num_type value_type;
+      
       static const FinalType identity;
     
-      virtual Vector3<num_type> rotate(const Vector3<num_type>&) const = 0;
-      virtual Vector3<num_type> operator*(const Vector3<num_type>& vec) const {
-        return rotate(vec);
+      constexpr Vector3<num_type> operator*(const Vector3<num_type>& vec) const {
+        return derived().rotate(vec);
       }
-      
-      virtual FinalType normalized() const = 0;
-      virtual FinalType inverse() const = 0;
-      virtual Vector3<num_type> unrotate(const Vector3<num_type>& vec) const {
-        return this->inverse().rotate(vec);
+      Vector3<num_type> unrotate(const Vector3<num_type>& vec) const {
+        return derived().inverse().rotate(vec);
+      }
+      constexpr FinalType operator*(const FinalType& rot) const {
+        return derived().compose(rot);
       }
       
-      virtual FinalType compose(const FinalType&) const = 0;
-      virtual FinalType operator*(const FinalType& rot) const {
-        return compose(rot);
-      }
-      // virtual FinalType& operator*=(const FinalType& rot) {
-        // *this = compose(rot);
-        // return *this;
-      // }
-      virtual FinalType rotateFromTo(const Vector3<num_type>&, const Vector3<num_type>&) const = 0;
+      // Batch rotation through FinalType::rotateLanes, which works on SoA lanes and
+      // precomputes the rotator's constants once. Outputs may alias the inputs
+      void rotateMany(const Vector3Array<num_type>& vecs, Vector3Array<num_type>& out) const {
+        if (&out != &vecs)
+          out.resize(vecs.size());
+        derived().rotateLanes(vecs.x, vecs.y, vecs.z, out.x, out.y, out.z, vecs.size());
+      }
+      void rotateMany(const Vector3<num_type>* vecs, Vector3<num_type>* out, size_t n) const {
+        const FinalType& rot = derived();
+        forEachVectorBlock(vecs, out, n, [&](const num_type* x, const num_type* y, const num_type* z,
+                                             num_type* out_x, num_type* out_y, num_type* out_z, size_t m) {
+          rot.rotateLanes(x, y, z, out_x, out_y, out_z, m);
+        });
+      }
+    
+    protected :
+      constexpr const FinalType& derived() const {
+        return static_cast<const FinalType&>(*this);
+      }
   };
+  
+  // Lets generic code accept any rotator: IsRotator<T>::value, or the RotatorType
+  // concept where concepts are available
+  template <class FinalType, typename num_type>
+  std::true_type rotatorBase(const Rotator<FinalType, num_type>*);
+  std::false_type rotatorBase(...);
+  template <class T>
+  struct IsRotator : decltype(rotatorBase(static_cast<T*>(nullptr))) {};
+  
+  #if defined(__cpp_concepts)
+    template <class T>
+    concept RotatorType = IsRotator<T>::value and requires(const T& rot, const Vector3<typename T::value_type>& vec) {
+      { rot.rotate(vec) } -> std::convertible_to<Vector3<typename T::value_type>>;
+      { rot.compose(rot) } -> std::convertible_to<T>;
+      { rot.inverse() } -> std::convertible_to<T>;
+      { rot.normalized() } -> std::convertible_to<T>;
+    };
+  #endif
+
+  template <typename num_type>
+  class QuaternionRotator;
 
   template <typename num_type = float>
-  class AngleAxisRotator : public virtual Rotator<AngleAxisRotator<num_type>, num_type> {
+  class AngleAxisRotator : public Rotator<AngleAxisRotator<num_type>, num_type> {
     public :
       num_type angle;
       Vector3<num_type> axis;
       
-      AngleAxisRotator() {
-        angle = 0;
-        axis = Vector3<num_type>();
-      }
+      constexpr AngleAxisRotator() : angle(0), axis() {}
       template <typename other_num_type>
-      AngleAxisRotator(other_num_type ang,const Vector3<other_num_type>& a) {
-         angle = ang; axis = a;
-      }
+      constexpr AngleAxisRotator(other_num_type ang, const Vector3<other_num_type>& a) : angle(ang), axis(a) {}
       template <typename other_num_type>
-      AngleAxisRotator(other_num_type ang, other_num_type x, other_num_type y, other_num_type z) {
-         angle = ang; axis = Vector3<num_type>(x,y,z);
-      }
+      constexpr AngleAxisRotator(other_num_type ang, other_num_type x, other_num_type y, other_num_type z)
+        : angle(ang), axis(x, y, z) {}
       template <typename other_num_type>
-      AngleAxisRotator<num_type>& operator=(const AngleAxisRotator<other_num_type>& aar) {
+      constexpr AngleAxisRotator<num_type>& operator=(const AngleAxisRotator<other_num_type>& aar) {
          angle = aar.angle; axis = aar.axis;
-         return this;
+         return *this;
       }
       template <typename other_num_type>
-      AngleAxisRotator(AngleAxisRotator<other_num_type>& aar) {
-        *this = aar;
+      constexpr AngleAxisRotator(const AngleAxisRotator<other_num_type>& aar) : angle(aar.angle), axis(aar.axis) {}
+      // Same signature as the other rotators' factories, for generic code
+      template <class precision, typename other_num_type>
+      static constexpr AngleAxisRotator<num_type> fromAngleAxis(other_num_type angle, const Vector3<other_num_type>& axis) {
+        return AngleAxisRotator<num_type>(angle, axis);
       }
       
       // Identity element
       static const AngleAxisRotator identity;
       
-      // Virtual function implementations
+      // Rotator interface
       Vector3<num_type> rotate(const Vector3<num_type>& vec) const {
         if (axis.sqrMagnitude() == 0)
           return Vector3<num_type>();
@@ -73,61 +111,76 @@
              + axis * axis.dotProduct(vec) * (1 - cos(angle)) / axis.magnitude()
              + axis.crossProduct(vec) * sin(angle);
       }
-      AngleAxisRotator<num_type> normalized() const {
-        return AngleAxisRotator<num_type>(angle, axis.normalized());
-      }
-      AngleAxisRotator<num_type> inverse() const {
+      void rotateLanes(const num_type* x, const num_type* y, const num_type* z,
+                       num_type* out_x, num_type* out_y, num_type* out_z, size_t n) const {
+        // Rodrigues' formula with the trig and magnitude terms hoisted out of the loop
+        num_type mag = axis.magnitude();
+        num_type c_0 = 0, c_1 = 0, s = 0;
+        if (mag != 0) {
+          c_0 = mag * cos(angle);
+          c_1 = (1 - cos(angle)) / mag;
+          s = sin(angle);
+        }
+        num_type a_x = axis.x, a_y = axis.y, a_z = axis.z;
+        forEachLane<num_type>(n, [&](auto lanes, size_t i) {
+          typedef decltype(lanes) L;
+          typename L::reg ax = L::set(a_x), ay = L::set(a_y), az = L::set(a_z);
+          typename L::reg vx = L::load(x + i), vy = L::load(y + i), vz = L::load(z + i);
+          typename L::reg dot = L::mul(L::mulAdd(az, vz, L::mulAdd(ay, vy, L::mul(ax, vx))), L::set(c_1));
+          typename L::reg cx = L::negMulAdd(az, vy, L::mul(ay, vz)),
+                          cy = L::negMulAdd(ax, vz, L::mul(az, vx)),
+                          cz = L::negMulAdd(ay, vx, L::mul(ax, vy));
+          typename L::reg k_c = L::set(c_0), k_s = L::set(s);
+          L::store(out_x + i, L::mulAdd(cx, k_s, L::mulAdd(ax, dot, L::mul(vx, k_c))));
+          L::store(out_y + i, L::mulAdd(cy, k_s, L::mulAdd(ay, dot, L::mul(vy, k_c))));
+          L::store(out_z + i, L::mulAdd(cz, k_s, L::mulAdd(az, dot, L::mul(vz, k_c))));
+        });
+      }
+      template <class precision = typename DefaultPrecision<num_type>::type>
+      constexpr AngleAxisRotator<num_type> normalized() const {
+        return AngleAxisRotator<num_type>(angle, axis.template normalized<precision>());
+      }
+      constexpr AngleAxisRotator<num_type> inverse() const {
         return AngleAxisRotator(-angle, axis / axis.sqrMagnitude());
         // Alternate :
         // return AngleAxisRotator(angle, -axis / axis.sqrMagnitude());
       }
+      // Rotates by *this first and then by aar, like QuaternionRotator and
+      // RotationMatrix compose; before it went through the quaternion product
+      // (exactly) it applied aar first
       AngleAxisRotator<num_type> compose(const AngleAxisRotator<num_type>& aar) const {
-        // TODO : Not be so cheap in the method of calculation
-        Vector3<num_type> vec = Vector3<num_type>::right, rot_vec = rotate(aar.rotate(Vector3<num_type>::right));
-        if (vec.normalized() != rot_vec.normalized())
-          return rotateFromTo(vec, rot_vec);
-        else {
-          vec = Vector3<num_type>::up;
-          rot_vec = rotate(aar.rotate(Vector3<num_type>::right));
-          return rotateFromTo(vec, rot_vec);
-        }
+        return AngleAxisRotator<num_type>(QuaternionRotator<num_type>(*this).compose(QuaternionRotator<num_type>(aar)));
       }
       AngleAxisRotator<num_type> rotateFromTo(const Vector3<num_type>& vec1, const Vector3<num_type>& vec2) const {
         return AngleAxisRotator(vec1.angleTo(vec2), vec1.crossProduct(vec2) / vec1.sqrMagnitude());
       }
   };
-  template <typename num_type> const AngleAxisRotator<num_type> AngleAxisRotator<num_type>::identity(0, 1, 0, 0);
+  template <typename num_type> constexpr AngleAxisRotator<num_type> AngleAxisRotator<num_type>::identity(0, 1, 0, 0);
 
 
   template <typename num_type = float>
-  class RotationMatrix : virtual public Rotator<RotationMatrix<num_type>, num_type> {
+  class RotationMatrix : public Rotator<RotationMatrix<num_type>, num_type> {
     public :
       num_type matrix[3][3];
       
-      RotationMatrix() {
-        // Identity matrix      
-        matrix[0][0] = 1;
-        matrix[0][1] = 0;
-        matrix[0][2] = 0;
-        
-        matrix[1][0] = 0;
-        matrix[1][1] = 1;
-        matrix[1][2] = 0;
-        
-        matrix[2][0] = 0;
-        matrix[2][1] = 0;
-        matrix[2][2] = 1;
-      }
+      // Identity matrix
+      constexpr RotationMatrix() : matrix{{1, 0, 0}, {0, 1, 0}, {0, 0, 1}} {}
       template <typename other_num_type>
-      RotationMatrix(other_num_type alpha, other_num_type beta, other_num_type gamma, other_num_type mag = 1) {
+      RotationMatrix(other_num_type alpha, other_num_type beta, other_num_type gamma, other_num_type mag = 1)
+        : RotationMatrix(fromEuler<typename DefaultPrecision<num_type>::type>(alpha, beta, gamma, mag)) {}
+      template <class precision, typename other_num_type>
+      static constexpr RotationMatrix<num_type> fromEuler(other_num_type alpha, other_num_type beta, other_num_type gamma, other_num_type mag = 1) {
         // alpha (roll) : rotation angle in YZ plane i.e. around X
         // beta (pitch) : rotation angle in ZX plane i.e. around Y
         // gamma (yaw) : rotation angle in XY plane i.e. around Z
         // Order : XY * ZX * YZ * vec
-        num_type c_a = cos(alpha), s_a = sin(alpha),
-                 c_b = cos(beta), s_b = sin(beta),
-                 c_g = cos(gamma), s_g = sin(gamma);
+        num_type c_a = 0, s_a = 0, c_b = 0, s_b = 0, c_g = 0, s_g = 0;
+        precision::sineCosine(num_type(alpha), s_a, c_a);
+        precision::sineCosine(num_type(beta), s_b, c_b);
+        precision::sineCosine(num_type(gamma), s_g, c_g);
         
+        RotationMatrix<num_type> rot;
+        num_type (&matrix)[3][3] = rot.matrix;
         matrix[0][0] = c_b * c_g;
         matrix[0][1] = s_a * s_b * c_g - c_a * s_g;
         matrix[0][2] = c_a * s_b * c_g + s_a * s_g;
@@ -143,25 +196,32 @@
         for (int i = 0; i < 3; ++i)
           for (int j = 0; j < 3; ++j)
             matrix[i][j] = matrix[i][j] * mag;
+        return rot;
       }
       template <typename other_num_type>
-      RotationMatrix<num_type>& operator=(const RotationMatrix<other_num_type>& rot) {
+      constexpr RotationMatrix<num_type>& operator=(const RotationMatrix<other_num_type>& rot) {
         for (int i = 0; i < 3; ++i)
           for (int j = 0; j < 3; ++j)
             matrix[i][j] = rot.matrix[i][j];
         return *this;
       }
       template <typename other_num_type>
-      RotationMatrix(const RotationMatrix<other_num_type>& rot){
-        *this = rot;
-      }
+      constexpr RotationMatrix(const RotationMatrix<other_num_type>& rot)
+        : matrix{{num_type(rot.matrix[0][0]), num_type(rot.matrix[0][1]), num_type(rot.matrix[0][2])},
+                 {num_type(rot.matrix[1][0]), num_type(rot.matrix[1][1]), num_type(rot.matrix[1][2])},
+                 {num_type(rot.matrix[2][0]), num_type(rot.matrix[2][1]), num_type(rot.matrix[2][2])}} {}
       template <typename other_num_type>
-      RotationMatrix(other_num_type angle, const Vector3<other_num_type>& axis) {
-        other_num_type c = cos(angle);
-        other_num_type s = sin(angle);
-        other_num_type mag = axis.magnitude();
+      RotationMatrix(other_num_type angle, const Vector3<other_num_type>& axis)
+        : RotationMatrix(fromAngleAxis<typename DefaultPrecision<num_type>::type>(angle, axis)) {}
+      template <class precision, typename other_num_type>
+      static constexpr RotationMatrix<num_type> fromAngleAxis(other_num_type angle, const Vector3<other_num_type>& axis) {
+        other_num_type c = 0, s = 0;
+        precision::sineCosine(angle, s, c);
+        other_num_type mag = precision::squareRoot(axis.sqrMagnitude());
         other_num_type c_1 = 1 - c;
         // Matrix-ified Rodriegues Rotation formula 
+        RotationMatrix<num_type> rot;
+        num_type (&matrix)[3][3] = rot.matrix;
         matrix[0][0] = mag * c + axis.x * axis.x * c_1 / mag;
         matrix[0][1] = axis.x * axis.y * c_1 / mag - axis.z * s;
         matrix[0][2] = axis.z * axis.x * c_1 / mag + axis.y * s;
@@ -173,68 +233,55 @@
         matrix[2][0] = axis.z * axis.x * c_1 / mag - axis.y * s;
         matrix[2][1] = axis.y * axis.z * c_1 / mag + axis.x * s;
         matrix[2][2] = mag * c + axis.z * axis.z * c_1 / mag;
+        return rot;
       }
       
       // Convertors
       template <typename other_num_type>
       RotationMatrix(const AngleAxisRotator<other_num_type>& aar) : RotationMatrix(aar.angle, aar.axis) {}
+      // Through the quaternion of Shepperd's method, see QuaternionRotator
       template <typename other_num_type>
       operator AngleAxisRotator<other_num_type>() const {
-        // TODO : improve the function, you know it can be
-        other_num_type e_val, angle;
-        
-        // Eigenvalue is simply the 'magnitude' of the rotation
-        e_val = sqrt(matrix[0][0] * matrix[0][0] + matrix[1][0] * matrix[1][0] + matrix[2][0] * matrix[2][0]);
-        
-        Vector3<other_num_type> e_vec, v1 = Vector3<other_num_type>(matrix[0][0] - e_val, matrix[0][1], matrix[0][2]),
-                                       v2 = Vector3<other_num_type>(matrix[1][0], matrix[1][1] - e_val, matrix[1][2]),
-                                       v3 = Vector3<other_num_type>(matrix[2][0], matrix[2][1], matrix[2][2] - e_val);
-        // ERR: MAGIC NUMBER ALERT
-        // Check to see if v1 is approximately zero
-        if (v1.sqrMagnitude() > 0.000001 and v2.sqrMagnitude() > 0.000001) {
-          e_vec = v1.crossProduct(v2);
-          v2 = rotate(v1);
-          angle = v1.angleTo(v2);
-          if (v1.crossProduct(v2).dotProduct(e_vec) < 0);
-            angle *= -1;
-        } else if (v2.sqrMagnitude() > 0.000001) {
-          e_vec = v2.crossProduct(v3);
-          v3 = rotate(v2);
-          angle = v2.angleTo(v3);
-          if (v2.crossProduct(v3).dotProduct(e_vec) < 0);
-            angle *= -1;
-        } else {
-          e_vec = v3.crossProduct(v1);
-          v1 = rotate(v3);
-          angle = v3.angleTo(v1);
-          if (v3.crossProduct(v1).dotProduct(e_vec) < 0);
-            angle *= -1;
-        }
-        
-        return AngleAxisRotator<other_num_type>(angle, e_vec.setMagnitude(e_val));
+        return AngleAxisRotator<other_num_type>(QuaternionRotator<num_type>(*this));
       }
       
       // Identity element
       const static RotationMatrix identity;
       
-      // Virtual function implementations
-      Vector3<num_type> rotate(const Vector3<num_type>& vec) const {
-        Vector3<num_type> rot_vec = Vector3<num_type>();
-        for (int i = 0; i < 3; ++i)
+      // Rotator interface
+      constexpr Vector3<num_type> rotate(const Vector3<num_type>& vec) const {
+        // Written out rather than looped over Vector3::operator[], whose index
+        // wrapping keeps the compiler from unrolling it
+        return Vector3<num_type>(matrix[0][0] * vec.x + matrix[0][1] * vec.y + matrix[0][2] * vec.z,
+                                 matrix[1][0] * vec.x + matrix[1][1] * vec.y + matrix[1][2] * vec.z,
+                                 matrix[2][0] * vec.x + matrix[2][1] * vec.y + matrix[2][2] * vec.z);
+      }
+      void rotateLanes(const num_type* x, const num_type* y, const num_type* z,
+                       num_type* out_x, num_type* out_y, num_type* out_z, size_t n) const {
+        forEachLane<num_type>(n, [&](auto lanes, size_t i) {
+          typedef decltype(lanes) L;
+          typename L::reg vx = L::load(x + i), vy = L::load(y + i), vz = L::load(z + i);
+          typename L::reg r[3];
           for (int j = 0; j < 3; ++j)
-            rot_vec[i] += vec[j] * matrix[i][j];
-        return rot_vec;
-      }
-      RotationMatrix<num_type> normalized() const {
-        num_type mag = matrix[0][0] * matrix[0][0] + matrix[1][0] * matrix[1][0] + matrix[2][0] * matrix[2][0];
-        mag = sqrt(mag);
+            r[j] = L::mulAdd(L::set(matrix[j][2]), vz,
+                   L::mulAdd(L::set(matrix[j][1]), vy,
+                   L::mul(L::set(matrix[j][0]), vx)));
+          L::store(out_x + i, r[0]);
+          L::store(out_y + i, r[1]);
+          L::store(out_z + i, r[2]);
+        });
+      }
+      template <class precision = typename DefaultPrecision<num_type>::type>
+      constexpr RotationMatrix<num_type> normalized() const {
+        num_type sqr_mag = matrix[0][0] * matrix[0][0] + matrix[1][0] * matrix[1][0] + matrix[2][0] * matrix[2][0];
+        num_type inv_mag = precision::reciprocalSquareRoot(sqr_mag);
         RotationMatrix<num_type> rot_mat;
         for (int i = 0; i < 3; ++i)
           for (int j = 0; j < 3; ++j)
-            rot_mat.matrix[i][j] = matrix[i][j] / mag;
+            rot_mat.matrix[i][j] = matrix[i][j] * inv_mag;
         return rot_mat;
       }
-      RotationMatrix<num_type> inverse() const {
+      constexpr RotationMatrix<num_type> inverse() const {
         // It is a composition of pseudo-orthogonal matrices i.e.
         // A^T = A^-1 / sqr(mag)
         num_type sqr_mag = matrix[0][0] * matrix[0][0] + matrix[1][0] * matrix[1][0] + matrix[2][0] * matrix[2][0];
@@ -244,7 +291,7 @@
             rot_mat.matrix[i][j] = matrix[j][i] / sqr_mag;
         return rot_mat;
       }
-      RotationMatrix<num_type> compose(const RotationMatrix<num_type>& mat) const {
+      constexpr RotationMatrix<num_type> compose(const RotationMatrix<num_type>& mat) const {
         RotationMatrix<num_type> new_mat = RotationMatrix();
         for (int i = 0; i < 3; ++i)
           for (int j = 0; j < 3; ++j) {
@@ -259,73 +306,209 @@
       }
       
   };
-  template <typename num_type> const RotationMatrix<num_type> RotationMatrix<num_type>::identity(0,0,0,1);
+  template <typename num_type> constexpr RotationMatrix<num_type> RotationMatrix<num_type>::identity;
 
   template <typename num_type = float>
-  class QuaternionRotator : virtual public Rotator<QuaternionRotator<num_type>, num_type>, public Quaternion<num_type> {
+  class QuaternionRotator : public Rotator<QuaternionRotator<num_type>, num_type>, public Quaternion<num_type> {
     public :
-      QuaternionRotator() : Quaternion<num_type>(1, 0, 0, 0){}
-      operator Quaternion<num_type>() const {
+      constexpr QuaternionRotator() : Quaternion<num_type>(1, 0, 0, 0) {}
+      constexpr operator Quaternion<num_type>() const {
         return Quaternion<num_type>(this->w,this->x,this->y,this->z);
       }
       template <typename other_num_type>
-      QuaternionRotator(const Quaternion<other_num_type>& q) : Quaternion<num_type>(q) {}
+      constexpr QuaternionRotator(const Quaternion<other_num_type>& q) : Quaternion<num_type>(q) {}
       template <typename other_num_type>
-      QuaternionRotator(other_num_type angle, const Vector3<other_num_type>& axis) {
-        num_type m = sqrt(axis.magnitude());
+      QuaternionRotator(other_num_type angle, const Vector3<other_num_type>& axis)
+        : QuaternionRotator(fromAngleAxis<typename DefaultPrecision<num_type>::type>(angle, axis)) {}
+      template <class precision, typename other_num_type>
+      static constexpr QuaternionRotator<num_type> fromAngleAxis(other_num_type angle, const Vector3<other_num_type>& axis) {
+        QuaternionRotator<num_type> q(Quaternion<num_type>(0, 0, 0, 0));
+        num_type m = precision::squareRoot(precision::squareRoot(num_type(axis.sqrMagnitude())));
         if (m != 0) {
-          this->w = cos(angle / 2) * m;
-          num_type s = sin(angle / 2);
-          this->x = s * axis.x / m;
-          this->y = s * axis.y / m;
-          this->z = s * axis.z / m;
-        } else {
-          QuaternionRotator();
+          num_type s = 0, c = 0;
+          precision::sineCosine(num_type(angle / 2), s, c);
+          q.w = c * m;
+          q.x = s * axis.x / m;
+          q.y = s * axis.y / m;
+          q.z = s * axis.z / m;
         }
+        return q;
       }
       template <typename other_num_type>
-      QuaternionRotator<num_type>& operator=(const QuaternionRotator<other_num_type>& q) {
+      constexpr QuaternionRotator<num_type>& operator=(const QuaternionRotator<other_num_type>& q) {
         Quaternion<num_type>::operator=(q);
         return *this;
       }
       template <typename other_num_type>
-      QuaternionRotator(const QuaternionRotator<other_num_type>& q) {
-        *this = q;
-      }
+      constexpr QuaternionRotator(const QuaternionRotator<other_num_type>& q) : Quaternion<num_type>(q) {}
       
       // Convertors
       template <typename other_num_type>
       QuaternionRotator(const AngleAxisRotator<other_num_type>& aar) : QuaternionRotator(aar.angle, aar.axis) {}
       template <typename other_num_type>
-      QuaternionRotator(const RotationMatrix<other_num_type>& rot_mat) : QuaternionRotator(AngleAxisRotator<num_type>(rot_mat)) {}
+      QuaternionRotator(const RotationMatrix<other_num_type>& rot_mat) {
+        num_type m[3][3], q[4];
+        for (int i = 0; i < 3; ++i)
+          for (int j = 0; j < 3; ++j)
+            m[i][j] = num_type(rot_mat.matrix[i][j]);
+        fromMatrixLanes<ScalarLanes<num_type>>(m, q);
+        this->w = q[0]; this->x = q[1]; this->y = q[2]; this->z = q[3];
+      }
+      // The axis is scaled to |q|^2 like in fromAngleAxis. atan2 keeps small angles
+      // accurate where acos(w / |q|) doesn't, and no rotation gets the x axis
       template <typename other_num_type>
       operator AngleAxisRotator<other_num_type>() const {
-        num_type mag = this->magnitude();
-        num_type half_angle = acos(this->w / mag);
-        return AngleAxisRotator<num_type>(2 * half_angle, Vector3<num_type>(this->x, this->y, this->z) * mag / sin(half_angle));
+        num_type sqr_mag = this->sqrMagnitude();
+        num_type v_mag = sqrt(this->x * this->x + this->y * this->y + this->z * this->z);
+        if (v_mag == 0)
+          return AngleAxisRotator<other_num_type>(other_num_type(0), other_num_type(sqr_mag), other_num_type(0), other_num_type(0));
+        num_type k = sqr_mag / v_mag;
+        return AngleAxisRotator<other_num_type>(other_num_type(2 * atan2(v_mag, this->w)),
+                                                Vector3<other_num_type>(this->x * k, this->y * k, this->z * k));
       }
       template <typename other_num_type>
       operator RotationMatrix<other_num_type>() const {
-        return RotationMatrix<num_type>(AngleAxisRotator<num_type>(*this));
+        num_type q[4] = {this->w, this->x, this->y, this->z}, m[3][3];
+        toMatrixLanes<ScalarLanes<num_type>>(q, m);
+        RotationMatrix<other_num_type> rot_mat;
+        for (int i = 0; i < 3; ++i)
+          for (int j = 0; j < 3; ++j)
+            rot_mat.matrix[i][j] = other_num_type(m[i][j]);
+        return rot_mat;
+      }
+
+      // Closed-form conversions on lanes of w, x, y, z and of the nine matrix
+      // entries, shared by the convertors above and the batch versions below.
+      // Like rotate, a non-unit q maps to |q|^2 times the rotation matrix
+      template <class L>
+      static void toMatrixLanes(const typename L::reg (&q)[4], typename L::reg (&m)[3][3]) {
+        typedef typename L::reg R;
+        R ww = L::mul(q[0], q[0]), xx = L::mul(q[1], q[1]), yy = L::mul(q[2], q[2]), zz = L::mul(q[3], q[3]);
+        R two = L::set(2), wx = L::mul(q[0], q[1]), wy = L::mul(q[0], q[2]), wz = L::mul(q[0], q[3]),
+          xy = L::mul(q[1], q[2]), xz = L::mul(q[1], q[3]), yz = L::mul(q[2], q[3]);
+        R diag = L::sub(ww, L::add(xx, L::add(yy, zz)));
+        m[0][0] = L::mulAdd(two, xx, diag);
+        m[1][1] = L::mulAdd(two, yy, diag);
+        m[2][2] = L::mulAdd(two, zz, diag);
+        m[0][1] = L::mul(two, L::sub(xy, wz));
+        m[1][0] = L::mul(two, L::add(xy, wz));
+        m[0][2] = L::mul(two, L::add(xz, wy));
+        m[2][0] = L::mul(two, L::sub(xz, wy));
+        m[1][2] = L::mul(two, L::sub(yz, wx));
+        m[2][1] = L::mul(two, L::add(yz, wx));
+      }
+      // Shepperd's method. With s the matrix scale (|q|^2), the diagonal gives
+      // 4w^2, 4x^2, 4y^2 and 4z^2 and the off-diagonal sums and differences give
+      // 4 times the pairwise products. The largest square is taken by square root
+      // and divides the products, so there is no cancellation and no trigonometry.
+      // The four cases are selected per lane rather than branched on
+      template <class L>
+      static void fromMatrixLanes(const typename L::reg (&m)[3][3], typename L::reg (&q)[4]) {
+        typedef typename L::reg R;
+        R s = L::squareRoot(L::mulAdd(m[2][0], m[2][0], L::mulAdd(m[1][0], m[1][0], L::mul(m[0][0], m[0][0]))));
+        R d_w = L::add(L::add(s, m[0][0]), L::add(m[1][1], m[2][2])),
+          d_x = L::sub(L::add(s, m[0][0]), L::add(m[1][1], m[2][2])),
+          d_y = L::sub(L::add(s, m[1][1]), L::add(m[0][0], m[2][2])),
+          d_z = L::sub(L::add(s, m[2][2]), L::add(m[0][0], m[1][1]));
+        R wx = L::sub(m[2][1], m[1][2]), wy = L::sub(m[0][2], m[2][0]), wz = L::sub(m[1][0], m[0][1]),
+          xy = L::add(m[0][1], m[1][0]), xz = L::add(m[0][2], m[2][0]), yz = L::add(m[1][2], m[2][1]);
+        // 4 q_k q for each choice of the largest component k
+        const R by_w[4] = {d_w, wx, wy, wz}, by_x[4] = {wx, d_x, xy, xz},
+                by_y[4] = {wy, xy, d_y, yz}, by_z[4] = {wz, xz, yz, d_z};
+        typename L::mask x_over_w = L::greater(d_x, d_w), z_over_y = L::greater(d_z, d_y);
+        R d_wx = L::select(x_over_w, d_x, d_w), d_yz = L::select(z_over_y, d_z, d_y);
+        typename L::mask yz_over_wx = L::greater(d_yz, d_wx);
+        // q_k = sqrt(d_k) / 2, so every component is its product times 1 / (2 q_k)
+        R k = L::div(L::set(num_type(0.5)), L::squareRoot(L::select(yz_over_wx, d_yz, d_wx)));
+        for (int c = 0; c < 4; ++c)
+          q[c] = L::mul(k, L::select(yz_over_wx, L::select(z_over_y, by_z[c], by_y[c]),
+                                                 L::select(x_over_w, by_x[c], by_w[c])));
+      }
+
+      // Batch conversions of n rotators; out must not alias the input. Writing
+      // whole matrices is cheaper than staging them through lanes, so toMatrices
+      // runs the closed form per rotator. fromMatrices stages 64 at a time into
+      // lanes for the square roots and the division
+      static void toMatrices(const QuaternionRotator<num_type>* quats, RotationMatrix<num_type>* out, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+          num_type q[4] = {quats[i].w, quats[i].x, quats[i].y, quats[i].z};
+          toMatrixLanes<ScalarLanes<num_type>>(q, out[i].matrix);
+        }
+      }
+      static void toMatrices(const QuaternionArray<num_type>& quats, RotationMatrix<num_type>* out) {
+        for (size_t i = 0; i < quats.size(); ++i) {
+          num_type q[4] = {quats.w[i], quats.x[i], quats.y[i], quats.z[i]};
+          toMatrixLanes<ScalarLanes<num_type>>(q, out[i].matrix);
+        }
+      }
+      static void fromMatrices(const RotationMatrix<num_type>* mats, QuaternionRotator<num_type>* out, size_t n) {
+        alignas(64) num_type w[block], x[block], y[block], z[block];
+        num_type* const q[4] = {w, x, y, z};
+        for (size_t start = 0; start < n; start += block) {
+          size_t m = n - start < block ? n - start : block;
+          fromMatrixBlock(mats + start, q, m);
+          for (size_t i = 0; i < m; ++i) {
+            out[start + i].w = w[i]; out[start + i].x = x[i]; out[start + i].y = y[i]; out[start + i].z = z[i];
+          }
+        }
+      }
+      static void fromMatrices(const RotationMatrix<num_type>* mats, QuaternionArray<num_type>& out, size_t n) {
+        out.resize(n);
+        for (size_t start = 0; start < n; start += block) {
+          num_type* const q[4] = {out.w + start, out.x + start, out.y + start, out.z + start};
+          fromMatrixBlock(mats + start, q, n - start < block ? n - start : block);
+        }
       }
       
       // Identity element
       const static QuaternionRotator identity;
       
-      // Virtual function implementations
-      Vector3<num_type> rotate(const Vector3<num_type>& vec) const {
+      // Rotator interface
+      constexpr Vector3<num_type> rotate(const Vector3<num_type>& vec) const {
         Quaternion<num_type> fin_vector = (Quaternion<num_type>)(*this)
                                         * Quaternion<num_type>(num_type(0), vec.x, vec.y, vec.z)
                                         * (Quaternion<num_type>)~(*this);
         return Vector3<num_type>(fin_vector.x, fin_vector.y, fin_vector.z);
       }
-      QuaternionRotator<num_type> normalized() const {
-        return Quaternion<num_type>::normalized();
-      }
-      QuaternionRotator<num_type> inverse() const {
+      void rotateLanes(const num_type* x, const num_type* y, const num_type* z,
+                       num_type* out_x, num_type* out_y, num_type* out_z, size_t n) const {
+        // q v q* = |q|^2 v + w t + u x t, with u the vector part and t = 2 (u x v).
+        // Same result as rotate, including the |q|^2 scaling of non-unit quaternions
+        num_type sqr_mag = this->sqrMagnitude();
+        num_type q_w = this->w, q_x = this->x, q_y = this->y, q_z = this->z;
+        forEachLane<num_type>(n, [&](auto lanes, size_t i) {
+          typedef decltype(lanes) L;
+          typename L::reg ux = L::set(q_x), uy = L::set(q_y), uz = L::set(q_z),
+                          two = L::set(2), w = L::set(q_w), s = L::set(sqr_mag);
+          typename L::reg vx = L::load(x + i), vy = L::load(y + i), vz = L::load(z + i);
+          typename L::reg tx = L::mul(two, L::negMulAdd(uz, vy, L::mul(uy, vz))),
+                          ty = L::mul(two, L::negMulAdd(ux, vz, L::mul(uz, vx))),
+                          tz = L::mul(two, L::negMulAdd(uy, vx, L::mul(ux, vy)));
+          L::store(out_x + i, L::add(L::mulAdd(w, tx, L::mul(s, vx)), L::negMulAdd(uz, ty, L::mul(uy, tz))));
+          L::store(out_y + i, L::add(L::mulAdd(w, ty, L::mul(s, vy)), L::negMulAdd(ux, tz, L::mul(uz, tx))));
+          L::store(out_z + i, L::add(L::mulAdd(w, tz, L::mul(s, vz)), L::negMulAdd(uy, tx, L::mul(ux, ty))));
+        });
+      }
+      template <class precision = typename DefaultPrecision<num_type>::type>
+      constexpr QuaternionRotator<num_type> normalized() const {
+        return Quaternion<num_type>::template normalized<precision>();
+      }
+      constexpr QuaternionRotator<num_type> inverse() const {
         return Quaternion<num_type>::inverse();
       }
-      QuaternionRotator<num_type> compose(const QuaternionRotator<num_type>& q) const {
+      template <class precision = typename DefaultPrecision<num_type>::type>
+      constexpr QuaternionRotator<num_type> nlerp(const QuaternionRotator<num_type>& q, num_type t) const {
+        return Quaternion<num_type>::template nlerp<precision>(q, t);
+      }
+      template <class precision = typename DefaultPrecision<num_type>::type>
+      constexpr QuaternionRotator<num_type> slerp(const QuaternionRotator<num_type>& q, num_type t) const {
+        return Quaternion<num_type>::template slerp<precision>(q, t);
+      }
+      template <class precision = typename DefaultPrecision<num_type>::type>
+      constexpr QuaternionRotator<num_type> fastSlerp(const QuaternionRotator<num_type>& q, num_type t) const {
+        return Quaternion<num_type>::template fastSlerp<precision>(q, t);
+      }
+      constexpr QuaternionRotator<num_type> compose(const QuaternionRotator<num_type>& q) const {
         return Quaternion<num_type>(q) * Quaternion<num_type>(*this);
       }
       QuaternionRotator<num_type> rotateFromTo(const Vector3<num_type>& vec1, const Vector3<num_type>& vec2) const {
@@ -337,8 +520,184 @@
       // They need to be in the same scope to override
       using Rotator<QuaternionRotator<num_type>, num_type>::operator*;
       using Quaternion<num_type>::operator*;
+
+    private :
+      static const size_t block = 64;
+
+      // Up to block rotators, with the matrices staged through SoA lanes
+      static void fromMatrixBlock(const RotationMatrix<num_type>* mats, num_type* const (&q)[4], size_t n) {
+        alignas(64) num_type m[3][3][block];
+        for (size_t i = 0; i < n; ++i)
+          for (int r = 0; r < 3; ++r)
+            for (int c = 0; c < 3; ++c)
+              m[r][c][i] = mats[i].matrix[r][c];
+        forEachLane<num_type>(n, [&](auto lanes, size_t i) {
+          typedef decltype(lanes) L;
+          typename L::reg m_r[3][3], q_r[4];
+          for (int r = 0; r < 3; ++r)
+            for (int c = 0; c < 3; ++c)
+              m_r[r][c] = L::load(m[r][c] + i);
+          fromMatrixLanes<L>(m_r, q_r);
+          for (int c = 0; c < 4; ++c)
+            L::store(q[c] + i, q_r[c]);
+        });
+      }
   };
-  template <typename num_type> const QuaternionRotator<num_type> QuaternionRotator<num_type>::identity(1, 0, 0, 0);
+  template <typename num_type> constexpr QuaternionRotator<num_type> QuaternionRotator<num_type>::identity;
+
+  // count rotations by 2 pi k / count about axis, for k from 0, computed by the
+  // compiler when the result is constexpr:
+  //   static constexpr auto steps = rotationSteps<QuaternionRotator<float>, 16>(Vector3<float>::up);
+  template <class RotatorType, size_t count>
+  constexpr std::array<RotatorType, count> rotationSteps(const Vector3<typename RotatorType::value_type>& axis) {
+    typedef typename RotatorType::value_type num_type;
+    std::array<RotatorType, count> steps;
+    for (size_t k = 0; k < count; ++k)
+      steps[k] = RotatorType::template fromAngleAxis<ConstexprPrecision>(num_type(2 * ConstexprPrecision::pi * k / count), axis);
+    return steps;
+  }
+
+  // How composeChain holds each rotator type on lanes: its components and their
+  // product, a applied first and then b. AngleAxisRotator goes through the
+  // quaternion form, so its trigonometry runs once per link
+  template <class RotatorType>
+  struct ChainForm;
+  template <typename num_type>
+  struct ChainForm<QuaternionRotator<num_type>> {
+    static const int size = 4;
+    static void identity(num_type* c) {
+      c[0] = 1; c[1] = c[2] = c[3] = 0;
+    }
+    static void get(const QuaternionRotator<num_type>& q, num_type* c) {
+      c[0] = q.w; c[1] = q.x; c[2] = q.y; c[3] = q.z;
+    }
+    static QuaternionRotator<num_type> make(const num_type* c) {
+      return Quaternion<num_type>(c[0], c[1], c[2], c[3]);
+    }
+    // b * a, written out like Quaternion::multiply
+    template <class L>
+    static void composeLanes(const typename L::reg* a, const typename L::reg* b, typename L::reg* out) {
+      out[0] = L::negMulAdd(b[3], a[3], L::negMulAdd(b[2], a[2], L::negMulAdd(b[1], a[1], L::mul(b[0], a[0]))));
+      out[1] = L::negMulAdd(b[3], a[2], L::mulAdd(b[2], a[3], L::mulAdd(b[1], a[0], L::mul(b[0], a[1]))));
+      out[2] = L::negMulAdd(b[1], a[3], L::mulAdd(b[3], a[1], L::mulAdd(b[2], a[0], L::mul(b[0], a[2]))));
+      out[3] = L::negMulAdd(b[2], a[1], L::mulAdd(b[1], a[2], L::mulAdd(b[3], a[0], L::mul(b[0], a[3]))));
+    }
+  };
+  template <typename num_type>
+  struct ChainForm<AngleAxisRotator<num_type>> : ChainForm<QuaternionRotator<num_type>> {
+    static void get(const AngleAxisRotator<num_type>& aar, num_type* c) {
+      ChainForm<QuaternionRotator<num_type>>::get(QuaternionRotator<num_type>(aar), c);
+    }
+    static AngleAxisRotator<num_type> make(const num_type* c) {
+      return AngleAxisRotator<num_type>(ChainForm<QuaternionRotator<num_type>>::make(c));
+    }
+  };
+  template <typename num_type>
+  struct ChainForm<RotationMatrix<num_type>> {
+    static const int size = 9;
+    static void identity(num_type* c) {
+      for (int i = 0; i < 9; ++i)
+        c[i] = i % 4 == 0 ? 1 : 0;
+    }
+    static void get(const RotationMatrix<num_type>& rot_mat, num_type* c) {
+      for (int i = 0; i < 9; ++i)
+        c[i] = rot_mat.matrix[i / 3][i % 3];
+    }
+    static RotationMatrix<num_type> make(const num_type* c) {
+      RotationMatrix<num_type> rot_mat;
+      for (int i = 0; i < 9; ++i)
+        rot_mat.matrix[i / 3][i % 3] = c[i];
+      return rot_mat;
+    }
+    // b a, row by row
+    template <class L>
+    static void composeLanes(const typename L::reg* a, const typename L::reg* b, typename L::reg* out) {
+      for (int i = 0; i < 3; ++i)
+        for (int j = 0; j < 3; ++j)
+          out[3 * i + j] = L::mulAdd(b[3 * i + 2], a[6 + j], L::mulAdd(b[3 * i + 1], a[3 + j], L::mul(b[3 * i], a[j])));
+    }
+  };
+
+  // Links of a chain composed in order, get(i, c) writing the ChainForm
+  // components of link i. The chain is cut into one segment per SIMD lane, the
+  // segments are composed side by side, then their results in order: a two level
+  // tree that keeps independent products in flight instead of waiting on each
+  // one. Products are reassociated, so the result can differ from a left to
+  // right fold by rounding
+  template <class Form, typename num_type, class Get>
+  void composeChainLanes(size_t n, Get get, num_type* result) {
+    typedef SimdLanes<num_type> L;
+    typedef typename L::reg R;
+    const int size = Form::size;
+    const size_t width = L::width, block = 16;
+    size_t segment = n / width;
+    num_type identity[size];
+    Form::identity(identity);
+    R acc[size], link[size], product[size];
+    for (int c = 0; c < size; ++c)
+      acc[c] = L::set(identity[c]);
+    // Links k0 .. k0 + block of every segment, transposed so lane j holds segment j
+    alignas(64) num_type staged[size][block][width];
+    for (size_t k_0 = 0; k_0 < segment; k_0 += block) {
+      size_t m = segment - k_0 < block ? segment - k_0 : block;
+      for (size_t j = 0; j < width; ++j)
+        for (size_t k = 0; k < m; ++k) {
+          num_type c[size];
+          get(j * segment + k_0 + k, c);
+          for (int i = 0; i < size; ++i)
+            staged[i][k][j] = c[i];
+        }
+      for (size_t k = 0; k < m; ++k) {
+        for (int c = 0; c < size; ++c)
+          link[c] = L::load(staged[c][k]);
+        Form::template composeLanes<L>(acc, link, product);
+        for (int c = 0; c < size; ++c)
+          acc[c] = product[c];
+      }
+    }
+    alignas(64) num_type segments[size][width];
+    for (int c = 0; c < size; ++c)
+      L::store(segments[c], acc[c]);
+    for (int c = 0; c < size; ++c)
+      result[c] = identity[c];
+    typedef ScalarLanes<num_type> S;
+    auto composeScalar = [&](const num_type* b) {
+      num_type a[size];
+      for (int c = 0; c < size; ++c)
+        a[c] = result[c];
+      Form::template composeLanes<S>(a, b, result);
+    };
+    for (size_t j = 0; j < width; ++j) {
+      num_type c[size];
+      for (int i = 0; i < size; ++i)
+        c[i] = segments[i][j];
+      composeScalar(c);
+    }
+    for (size_t i = segment * width; i < n; ++i) {
+      num_type c[size];
+      get(i, c);
+      composeScalar(c);
+    }
+  }
+
+  // rots[0].compose(rots[1]).compose(rots[2])... for long chains such as IK
+  // chains or the path from a deep joint to the root, see composeChainLanes
+  template <class RotatorType>
+  RotatorType composeChain(const RotatorType* rots, size_t n) {
+    typedef ChainForm<RotatorType> Form;
+    typename RotatorType::value_type result[Form::size];
+    composeChainLanes<Form>(n, [&](size_t i, typename RotatorType::value_type* c) { Form::get(rots[i], c); }, result);
+    return Form::make(result);
+  }
+  template <typename num_type>
+  QuaternionRotator<num_type> composeChain(const QuaternionArray<num_type>& quats) {
+    typedef ChainForm<QuaternionRotator<num_type>> Form;
+    num_type result[Form::size];
+    composeChainLanes<Form>(quats.size(), [&](size_t i, num_type* c) {
+      c[0] = quats.w[i]; c[1] = quats.x[i]; c[2] = quats.y[i]; c[3] = quats.z[i];
+    }, result);
+    return Form::make(result);
+  }
   
 #endif
 
@@ -0,0 +1,184 @@
+#if !defined(SIMD_H_INCLUDED)
+  #define SIMD_H_INCLUDED
+
+  #include <math.h>
+  #include <stddef.h>
+  #if defined(__SSE2__)
+    #include <immintrin.h>
+  #endif
+
+  // Lane-wise operations shared by all batch kernels, so a kernel is written once
+  // as a generic lambda and instantiated for both the widest register available
+  // and plain scalars (which handle the tail and any num_type without intrinsics)
+  template <typename num_type>
+  struct ScalarLanes {
+    typedef num_type reg;
+    typedef bool mask;
+    static const size_t width = 1;
+
+    static reg load(const num_type* p) { return *p; }
+    static void store(num_type* p, reg a) { *p = a; }
+    static reg set(num_type a) { return a; }
+
+    static reg add(reg a, reg b) { return a + b; }
+    static reg sub(reg a, reg b) { return a - b; }
+    static reg negate(reg a) { return -a; }
+    static reg mul(reg a, reg b) { return a * b; }
+    static reg div(reg a, reg b) { return a / b; }
+    // a * b + c and c - a * b
+    static reg mulAdd(reg a, reg b, reg c) { return a * b + c; }
+    static reg negMulAdd(reg a, reg b, reg c) { return c - a * b; }
+    static reg squareRoot(reg a) { return sqrt(a); }
+    static reg min(reg a, reg b) { return a < b ? a : b; }
+    static reg max(reg a, reg b) { return a > b ? a : b; }
+
+    static mask greater(reg a, reg b) { return a > b; }
+    static mask less(reg a, reg b) { return a < b; }
+    static reg select(mask m, reg a, reg b) { return m ? a : b; }
+    // Both masks set, and the mask as one bit per lane
+    static mask both(mask a, mask b) { return a and b; }
+    static int bits(mask m) { return m ? 1 : 0; }
+  };
+
+  // Widest register for the target; falls back to scalars for long double and
+  // for builds without SSE2
+  template <typename num_type>
+  struct SimdLanes : ScalarLanes<num_type> {};
+
+  #if defined(__AVX__)
+    template <>
+    struct SimdLanes<float> {
+      typedef __m256 reg;
+      typedef __m256 mask;
+      static const size_t width = 8;
+
+      static reg load(const float* p) { return _mm256_loadu_ps(p); }
+      static void store(float* p, reg a) { _mm256_storeu_ps(p, a); }
+      static reg set(float a) { return _mm256_set1_ps(a); }
+
+      static reg add(reg a, reg b) { return _mm256_add_ps(a, b); }
+      static reg sub(reg a, reg b) { return _mm256_sub_ps(a, b); }
+      static reg negate(reg a) { return _mm256_xor_ps(a, _mm256_set1_ps(-0.0f)); }
+      static reg mul(reg a, reg b) { return _mm256_mul_ps(a, b); }
+      static reg div(reg a, reg b) { return _mm256_div_ps(a, b); }
+      #if defined(__FMA__)
+        static reg mulAdd(reg a, reg b, reg c) { return _mm256_fmadd_ps(a, b, c); }
+        static reg negMulAdd(reg a, reg b, reg c) { return _mm256_fnmadd_ps(a, b, c); }
+      #else
+        static reg mulAdd(reg a, reg b, reg c) { return _mm256_add_ps(_mm256_mul_ps(a, b), c); }
+        static reg negMulAdd(reg a, reg b, reg c) { return _mm256_sub_ps(c, _mm256_mul_ps(a, b)); }
+      #endif
+      static reg squareRoot(reg a) { return _mm256_sqrt_ps(a); }
+      static reg min(reg a, reg b) { return _mm256_min_ps(a, b); }
+      static reg max(reg a, reg b) { return _mm256_max_ps(a, b); }
+
+      static mask greater(reg a, reg b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+      static mask less(reg a, reg b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+      static reg select(mask m, reg a, reg b) { return _mm256_blendv_ps(b, a, m); }
+      static mask both(mask a, mask b) { return _mm256_and_ps(a, b); }
+      static int bits(mask m) { return _mm256_movemask_ps(m); }
+    };
+
+    template <>
+    struct SimdLanes<double> {
+      typedef __m256d reg;
+      typedef __m256d mask;
+      static const size_t width = 4;
+
+      static reg load(const double* p) { return _mm256_loadu_pd(p); }
+      static void store(double* p, reg a) { _mm256_storeu_pd(p, a); }
+      static reg set(double a) { return _mm256_set1_pd(a); }
+
+      static reg add(reg a, reg b) { return _mm256_add_pd(a, b); }
+      static reg sub(reg a, reg b) { return _mm256_sub_pd(a, b); }
+      static reg negate(reg a) { return _mm256_xor_pd(a, _mm256_set1_pd(-0.0)); }
+      static reg mul(reg a, reg b) { return _mm256_mul_pd(a, b); }
+      static reg div(reg a, reg b) { return _mm256_div_pd(a, b); }
+      #if defined(__FMA__)
+        static reg mulAdd(reg a, reg b, reg c) { return _mm256_fmadd_pd(a, b, c); }
+        static reg negMulAdd(reg a, reg b, reg c) { return _mm256_fnmadd_pd(a, b, c); }
+      #else
+        static reg mulAdd(reg a, reg b, reg c) { return _mm256_add_pd(_mm256_mul_pd(a, b), c); }
+        static reg negMulAdd(reg a, reg b, reg c) { return _mm256_sub_pd(c, _mm256_mul_pd(a, b)); }
+      #endif
+      static reg squareRoot(reg a) { return _mm256_sqrt_pd(a); }
+      static reg min(reg a, reg b) { return _mm256_min_pd(a, b); }
+      static reg max(reg a, reg b) { return _mm256_max_pd(a, b); }
+
+      static mask greater(reg a, reg b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+      static mask less(reg a, reg b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+      static reg select(mask m, reg a, reg b) { return _mm256_blendv_pd(b, a, m); }
+      static mask both(mask a, mask b) { return _mm256_and_pd(a, b); }
+      static int bits(mask m) { return _mm256_movemask_pd(m); }
+    };
+  #elif defined(__SSE2__)
+    template <>
+    struct SimdLanes<float> {
+      typedef __m128 reg;
+      typedef __m128 mask;
+      static const size_t width = 4;
+
+      static reg load(const float* p) { return _mm_loadu_ps(p); }
+      static void store(float* p, reg a) { _mm_storeu_ps(p, a); }
+      static reg set(float a) { return _mm_set1_ps(a); }
+
+      static reg add(reg a, reg b) { return _mm_add_ps(a, b); }
+      static reg sub(reg a, reg b) { return _mm_sub_ps(a, b); }
+      static reg negate(reg a) { return _mm_xor_ps(a, _mm_set1_ps(-0.0f)); }
+      static reg mul(reg a, reg b) { return _mm_mul_ps(a, b); }
+      static reg div(reg a, reg b) { return _mm_div_ps(a, b); }
+      static reg mulAdd(reg a, reg b, reg c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+      static reg negMulAdd(reg a, reg b, reg c) { return _mm_sub_ps(c, _mm_mul_ps(a, b)); }
+      static reg squareRoot(reg a) { return _mm_sqrt_ps(a); }
+      static reg min(reg a, reg b) { return _mm_min_ps(a, b); }
+      static reg max(reg a, reg b) { return _mm_max_ps(a, b); }
+
+      static mask greater(reg a, reg b) { return _mm_cmpgt_ps(a, b); }
+      static mask less(reg a, reg b) { return _mm_cmplt_ps(a, b); }
+      static reg select(mask m, reg a, reg b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+      static mask both(mask a, mask b) { return _mm_and_ps(a, b); }
+      static int bits(mask m) { return _mm_movemask_ps(m); }
+    };
+
+    template <>
+    struct SimdLanes<double> {
+      typedef __m128d reg;
+      typedef __m128d mask;
+      static const size_t width = 2;
+
+      static reg load(const double* p) { return _mm_loadu_pd(p); }
+      static void store(double* p, reg a) { _mm_storeu_pd(p, a); }
+      static reg set(double a) { return _mm_set1_pd(a); }
+
+      static reg add(reg a, reg b) { return _mm_add_pd(a, b); }
+      static reg sub(reg a, reg b) { return _mm_sub_pd(a, b); }
+      static reg negate(reg a) { return _mm_xor_pd(a, _mm_set1_pd(-0.0)); }
+      static reg mul(reg a, reg b) { return _mm_mul_pd(a, b); }
+      static reg div(reg a, reg b) { return _mm_div_pd(a, b); }
+      static reg mulAdd(reg a, reg b, reg c) { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+      static reg negMulAdd(reg a, reg b, reg c) { return _mm_sub_pd(c, _mm_mul_pd(a, b)); }
+      static reg squareRoot(reg a) { return _mm_sqrt_pd(a); }
+      static reg min(reg a, reg b) { return _mm_min_pd(a, b); }
+      static reg max(reg a, reg b) { return _mm_max_pd(a, b); }
+
+      static mask greater(reg a, reg b) { return _mm_cmpgt_pd(a, b); }
+      static mask less(reg a, reg b) { return _mm_cmplt_pd(a, b); }
+      static reg select(mask m, reg a, reg b) { return _mm_or_pd(_mm_and_pd(m, a), _mm_andnot_pd(m, b)); }
+      static mask both(mask a, mask b) { return _mm_and_pd(a, b); }
+      static int bits(mask m) { return _mm_movemask_pd(m); }
+    };
+  #endif
+
+  // Runs op(lanes, i) over [0, n) in full-width blocks, then one element at a time
+  // for the remainder. op is a generic lambda taking the lane set as a tag
+  template <typename num_type, class Op>
+  inline void forEachLane(size_t n, Op op) {
+    typedef SimdLanes<num_type> Wide;
+    size_t i = 0;
+    for (; i + Wide::width <= n; i += Wide::width)
+      op(Wide(), i);
+    for (; i < n; ++i)
+      op(ScalarLanes<num_type>(), i);
+  }
+
+#endif
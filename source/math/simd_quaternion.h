@@ -0,0 +1,187 @@
+#if !defined(SIMD_QUATERNION_H_INCLUDED)
+  #define SIMD_QUATERNION_H_INCLUDED
+
+  #include "complex.h"
+  #include "simd_vector.h"
+
+  #if defined(__SSE2__)
+    // Quaternion<float> held in one 16-byte aligned SSE register as (w, x, y, z).
+    // Same interface as Quaternion, plus rotate for SimdVector3
+    class SimdQuaternion {
+      public :
+        union {
+          __m128 m;
+          struct {
+            float w, x, y, z;
+          };
+        };
+
+        SimdQuaternion() : m(_mm_setzero_ps()) {}
+        SimdQuaternion(__m128 q) : m(q) {}
+        template <typename other_num_type>
+        SimdQuaternion(other_num_type a, other_num_type b, other_num_type c, other_num_type d)
+          : m(_mm_set_ps(float(d), float(c), float(b), float(a))) {}
+        template <typename other_num_type>
+        SimdQuaternion(const Complex<other_num_type>& z1, const Complex<other_num_type>& z2)
+          : m(_mm_set_ps(float(z2.im), float(z2.re), float(z1.im), float(z1.re))) {}
+        template <typename other_num_type>
+        SimdQuaternion(const Quaternion<other_num_type>& q) : m(_mm_set_ps(float(q.z), float(q.y), float(q.x), float(q.w))) {}
+        template <typename other_num_type>
+        SimdQuaternion& operator=(const Quaternion<other_num_type>& q) {
+          m = _mm_set_ps(float(q.z), float(q.y), float(q.x), float(q.w));
+          return *this;
+        }
+        template <typename other_num_type>
+        operator Quaternion<other_num_type>() const {
+          return Quaternion<other_num_type>(other_num_type(w), other_num_type(x), other_num_type(y), other_num_type(z));
+        }
+
+        float scalar() const {
+          return w;
+        }
+        SimdQuaternion vector() const {
+          return SimdQuaternion(0.0f, x, y, z);
+        }
+        Complex<float> complex1() const {
+          return Complex<float>(w, x);
+        }
+        Complex<float> complex2() const {
+          return Complex<float>(y, z);
+        }
+        bool equals(const SimdQuaternion& q) const {
+          return _mm_movemask_ps(_mm_cmpeq_ps(m, q.m)) == 15;
+        }
+        operator bool() const {
+          return w == 0 and x == 0 and y == 0 and z == 0;
+        }
+        // Typical functions
+        float sqrMagnitude() const {
+          return _mm_cvtss_f32(simdDot4(m, m));
+        }
+        float magnitude() const {
+          return _mm_cvtss_f32(_mm_sqrt_ss(simdDot4(m, m)));
+        }
+        SimdQuaternion add(const SimdQuaternion& q) const {
+          return _mm_add_ps(m, q.m);
+        }
+        template <typename other_num_type>
+        SimdQuaternion add(other_num_type q) const {
+          return _mm_add_ss(m, _mm_set_ss(float(q)));
+        }
+        SimdQuaternion subtract(const SimdQuaternion& q) const {
+          return _mm_sub_ps(m, q.m);
+        }
+        template <typename other_num_type>
+        SimdQuaternion subtract(other_num_type q) const {
+          return _mm_sub_ss(m, _mm_set_ss(float(q)));
+        }
+        SimdQuaternion conjugate() const {
+          return _mm_xor_ps(m, _mm_set_ps(-0.0f, -0.0f, -0.0f, 0.0f));
+        }
+        SimdQuaternion multiply(const SimdQuaternion& q) const {
+          // Hamilton product as four broadcast-multiply-adds; each term permutes q
+          // and flips the signs that the scalar version subtracts
+          __m128 r = _mm_mul_ps(_mm_shuffle_ps(m, m, _MM_SHUFFLE(0, 0, 0, 0)), q.m);
+          __m128 t = _mm_mul_ps(_mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 1, 1, 1)),
+                                _mm_shuffle_ps(q.m, q.m, _MM_SHUFFLE(2, 3, 0, 1)));
+          r = _mm_add_ps(r, _mm_xor_ps(t, _mm_set_ps(0.0f, -0.0f, 0.0f, -0.0f)));
+          t = _mm_mul_ps(_mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 2, 2, 2)),
+                         _mm_shuffle_ps(q.m, q.m, _MM_SHUFFLE(1, 0, 3, 2)));
+          r = _mm_add_ps(r, _mm_xor_ps(t, _mm_set_ps(-0.0f, 0.0f, 0.0f, -0.0f)));
+          t = _mm_mul_ps(_mm_shuffle_ps(m, m, _MM_SHUFFLE(3, 3, 3, 3)),
+                         _mm_shuffle_ps(q.m, q.m, _MM_SHUFFLE(0, 1, 2, 3)));
+          return _mm_add_ps(r, _mm_xor_ps(t, _mm_set_ps(0.0f, 0.0f, -0.0f, -0.0f)));
+        }
+        template <typename other_num_type>
+        SimdQuaternion multiply(other_num_type q) const {
+          return _mm_mul_ps(m, _mm_set1_ps(float(q)));
+        }
+        template <typename other_num_type>
+        SimdQuaternion divide(other_num_type q) const {
+          if (q == 0)
+            return _mm_set1_ps(std::numeric_limits<float>::quiet_NaN());
+          return _mm_div_ps(m, _mm_set1_ps(float(q)));
+        }
+        SimdQuaternion inverse() const {
+          __m128 sqr = simdDot4(m, m);
+          if (_mm_cvtss_f32(sqr) == 0)
+            return _mm_set1_ps(std::numeric_limits<float>::quiet_NaN());
+          return _mm_div_ps(conjugate().m, sqr);
+        }
+        SimdQuaternion normalized() const {
+          __m128 sqr = simdDot4(m, m);
+          if (_mm_cvtss_f32(sqr) != 0)
+            return _mm_div_ps(m, _mm_sqrt_ps(sqr));
+          return SimdQuaternion();
+        }
+        SimdQuaternion cheapNormalized() const {
+          __m128 sqr = simdDot4(m, m);
+          if (_mm_cvtss_f32(sqr) != 0)
+            return _mm_div_ps(m, sqr);
+          return SimdQuaternion();
+        }
+        // Same as the vector part of q v q*, through |q|^2 v + w t + u x t with t = 2 (u x v)
+        SimdVector3 rotate(const SimdVector3& vec) const {
+          __m128 u = _mm_shuffle_ps(m, m, _MM_SHUFFLE(0, 3, 2, 1));
+          u = _mm_and_ps(u, _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1)));
+          SimdVector3 axis(u);
+          SimdVector3 t = axis.crossProduct(vec).scale(2.0f);
+          __m128 r = _mm_mul_ps(simdDot4(m, m), vec.m);
+          r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(m, m, _MM_SHUFFLE(0, 0, 0, 0)), t.m));
+          return _mm_add_ps(r, axis.crossProduct(t).m);
+        }
+        // Operators
+        SimdQuaternion operator+(const SimdQuaternion& q) const {return add(q);}
+        template <typename other_num_type>
+        SimdQuaternion operator+(other_num_type q) const {return add(q);}
+        SimdQuaternion operator-(const SimdQuaternion& q) const {return subtract(q);}
+        template <typename other_num_type>
+        SimdQuaternion operator-(other_num_type q) const {return subtract(q);}
+        SimdQuaternion operator*(const SimdQuaternion& q) const {return multiply(q);}
+        template <typename other_num_type>
+        SimdQuaternion operator*(other_num_type q) const {return multiply(q);}
+        template <typename other_num_type>
+        friend SimdQuaternion operator*(other_num_type q1, const SimdQuaternion& q2) {return q2.multiply(q1);}
+
+        SimdQuaternion& operator+=(const SimdQuaternion& q) { return *this = add(q);}
+        template <typename other_num_type>
+        SimdQuaternion& operator+=(other_num_type q) { return *this = add(q);}
+        SimdQuaternion& operator-=(const SimdQuaternion& q) { return *this = subtract(q);}
+        template <typename other_num_type>
+        SimdQuaternion& operator-=(other_num_type q) { return *this = subtract(q);}
+        SimdQuaternion& operator*=(const SimdQuaternion& q) { return *this = multiply(q);}
+        template <typename other_num_type>
+        SimdQuaternion& operator*=(other_num_type q) { return *this = multiply(q);}
+
+        SimdQuaternion operator~() const {return conjugate();}
+        SimdQuaternion operator+() const {return *this;}
+        SimdQuaternion operator-() const {return _mm_sub_ps(_mm_setzero_ps(), m);}
+
+        bool operator==(const SimdQuaternion& q) const {return equals(q);}
+        bool operator!=(const SimdQuaternion& q) const {return not equals(q);}
+
+        // One subscript output with mutable return type, another with const
+        float operator[](int i) const {
+          i = i % 4;
+          return (&w)[i < 0 ? i + 4 : i];
+        }
+        float& operator[](int i) {
+          i = i % 4;
+          return (&w)[i < 0 ? i + 4 : i];
+        }
+    };
+  #else
+    // Without SSE the generic template is the fastest option
+    class SimdQuaternion : public Quaternion<float> {
+      public :
+        using Quaternion<float>::Quaternion;
+        SimdQuaternion() {}
+        SimdQuaternion(const Quaternion<float>& q) : Quaternion<float>(q.w, q.x, q.y, q.z) {}
+        SimdVector3 rotate(const SimdVector3& vec) const {
+          Quaternion<float> r = multiply(Quaternion<float>(0.0f, vec.x, vec.y, vec.z)).multiply(conjugate());
+          return SimdVector3(r.x, r.y, r.z);
+        }
+    };
+  #endif
+
+#endif
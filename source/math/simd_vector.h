@@ -0,0 +1,184 @@
+#if !defined(SIMD_VECTOR_H_INCLUDED)
+  #define SIMD_VECTOR_H_INCLUDED
+
+  #include "vector.h"
+  #if defined(__SSE2__)
+    #include <immintrin.h>
+  #endif
+
+  #if defined(__SSE2__)
+    // Helpers shared with SimdQuaternion
+    // Sum of all four lanes, broadcast to every lane
+    inline __m128 simdHorizontalSum(__m128 a) {
+      a = _mm_add_ps(a, _mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)));
+      return _mm_add_ps(a, _mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 0, 3, 2)));
+    }
+    // Shuffles rather than _mm_dp_ps, which has a longer latency on most cores
+    inline __m128 simdDot4(__m128 a, __m128 b) {
+      return simdHorizontalSum(_mm_mul_ps(a, b));
+    }
+
+    // Vector3<float> held in one 16-byte aligned SSE register, with a fourth lane
+    // that is kept at zero. Same interface as Vector3, so code written against
+    // Vector3<float> compiles against SimdVector3 unchanged
+    class SimdVector3 {
+      public :
+        union {
+          __m128 m;
+          struct {
+            float x, y, z, pad;
+          };
+        };
+
+        SimdVector3() : m(_mm_setzero_ps()) {}
+        SimdVector3(__m128 v) : m(v) {}
+        template <typename other_num_type>
+        SimdVector3(other_num_type n) : m(_mm_set_ps(0, float(n), float(n), float(n))) {}
+        template <typename other_num_type>
+        SimdVector3(other_num_type x, other_num_type y, other_num_type z) : m(_mm_set_ps(0, float(z), float(y), float(x))) {}
+        template <typename other_num_type>
+        SimdVector3(const Vector2<other_num_type>& vec) : m(_mm_set_ps(0, 0, float(vec.y), float(vec.x))) {}
+        template <typename other_num_type>
+        SimdVector3(const Vector3<other_num_type>& vec) : m(_mm_set_ps(0, float(vec.z), float(vec.y), float(vec.x))) {}
+        template <typename other_num_type>
+        SimdVector3& operator=(const Vector3<other_num_type>& vec) {
+          m = _mm_set_ps(0, float(vec.z), float(vec.y), float(vec.x));
+          return *this;
+        }
+        // Vector3's catch-all scalar constructor rules out a conversion operator
+        template <typename other_num_type = float>
+        Vector3<other_num_type> toVector3() const {
+          return Vector3<other_num_type>(other_num_type(x), other_num_type(y), other_num_type(z));
+        }
+
+        // Static members
+        static const SimdVector3 up;
+        static const SimdVector3 down;
+        static const SimdVector3 left;
+        static const SimdVector3 right;
+        static const SimdVector3 forward;
+        static const SimdVector3 backward;
+
+        // Traditional functions
+        bool equals(const SimdVector3& e) const {
+          return (_mm_movemask_ps(_mm_cmpeq_ps(m, e.m)) & 7) == 7;
+        }
+        template <typename other_num_type>
+        bool equals(const Vector3<other_num_type>& e) const {
+          return equals(SimdVector3(e));
+        }
+        operator bool() const {
+          return x == 0 and y == 0 and z == 0;
+        }
+        float sqrMagnitude() const {
+          return _mm_cvtss_f32(simdDot4(m, m));
+        }
+        float magnitude() const {
+          return _mm_cvtss_f32(_mm_sqrt_ss(simdDot4(m, m)));
+        }
+        SimdVector3 add(const SimdVector3& a) const {
+          return _mm_add_ps(m, a.m);
+        }
+        template <typename other_num_type>
+        SimdVector3 scale(other_num_type s) const {
+          return _mm_mul_ps(m, _mm_set1_ps(float(s)));
+        }
+        SimdVector3 from(const SimdVector3& s) const {
+          return _mm_sub_ps(m, s.m);
+        }
+        SimdVector3 normalized() const {
+          __m128 sqr = simdDot4(m, m);
+          if (_mm_cvtss_f32(sqr) != 0)
+            return _mm_div_ps(m, _mm_sqrt_ps(sqr));
+          return SimdVector3();
+        }
+        SimdVector3 cheapNormalized() const {
+          __m128 sqr = simdDot4(m, m);
+          if (_mm_cvtss_f32(sqr) != 0)
+            return _mm_div_ps(m, sqr);
+          return SimdVector3();
+        }
+        template <typename other_num_type>
+        SimdVector3 setMagnitude(other_num_type mag) const {
+          return _mm_mul_ps(m, _mm_div_ps(_mm_set1_ps(float(mag)), _mm_sqrt_ps(simdDot4(m, m))));
+        }
+        template <typename other_num_type>
+        SimdVector3 clamp(other_num_type mag) const {
+          if (sqrMagnitude() > float(mag) * float(mag))
+            return setMagnitude(mag);
+          else
+            return *this;
+        }
+        float dotProduct(const SimdVector3& d) const {
+          return _mm_cvtss_f32(simdDot4(m, d.m));
+        }
+        SimdVector3 crossProduct(const SimdVector3& c) const {
+          // (a * c.yzx - a.yzx * c).yzx, fourth lane stays a.pad * c.pad - a.pad * c.pad = 0
+          __m128 a_yzx = _mm_shuffle_ps(m, m, _MM_SHUFFLE(3, 0, 2, 1));
+          __m128 c_yzx = _mm_shuffle_ps(c.m, c.m, _MM_SHUFFLE(3, 0, 2, 1));
+          __m128 r = _mm_sub_ps(_mm_mul_ps(m, c_yzx), _mm_mul_ps(a_yzx, c.m));
+          return _mm_shuffle_ps(r, r, _MM_SHUFFLE(3, 0, 2, 1));
+        }
+        float angleTo(const SimdVector3& a) const {
+          return acos(normalized().dotProduct(a.normalized()));
+        }
+        // Operator function definitions
+        SimdVector3 operator+(const SimdVector3& a) const { return add(a);}
+        SimdVector3 operator-(const SimdVector3& s) const { return from(s);}
+        SimdVector3 operator-() const { return _mm_sub_ps(_mm_setzero_ps(), m);}
+        template <typename other_num_type>
+        SimdVector3 operator*(other_num_type s) const { return scale(s);}
+        template <typename other_num_type>
+        friend SimdVector3 operator*(other_num_type s, const SimdVector3& vec) { return vec.scale(s);}
+        template <typename other_num_type>
+        SimdVector3 operator/(other_num_type d) const {
+          if (d == 0)
+            return SimdVector3(std::numeric_limits<float>::quiet_NaN());
+          return _mm_div_ps(m, _mm_set1_ps(float(d)));
+        }
+
+        bool operator==(const SimdVector3& e) const { return equals(e);}
+        bool operator!=(const SimdVector3& e) const { return not equals(e);}
+        bool operator>(const SimdVector3& c) const { return sqrMagnitude() > c.sqrMagnitude();}
+        bool operator<(const SimdVector3& c) const { return sqrMagnitude() < c.sqrMagnitude();}
+        bool operator>=(const SimdVector3& c) const { return sqrMagnitude() >= c.sqrMagnitude();}
+        bool operator<=(const SimdVector3& c) const { return sqrMagnitude() <= c.sqrMagnitude();}
+
+        SimdVector3& operator+=(const SimdVector3& a) { m = _mm_add_ps(m, a.m); return *this;}
+        SimdVector3& operator-=(const SimdVector3& s) { m = _mm_sub_ps(m, s.m); return *this;}
+        template <typename other_num_type>
+        SimdVector3& operator*=(other_num_type s) { return *this = scale(s);}
+        template <typename other_num_type>
+        SimdVector3& operator/=(other_num_type d) { return *this = operator/(d);}
+
+        // One subscript output with mutable return type, another with const
+        float operator[](int i) const {
+          i = i % 3;
+          return (&x)[i < 0 ? i + 3 : i];
+        }
+        float& operator[](int i) {
+          i = i % 3;
+          return (&x)[i < 0 ? i + 3 : i];
+        }
+    };
+    inline const SimdVector3 SimdVector3::up(0, 0, 1);
+    inline const SimdVector3 SimdVector3::down(0, 0, -1);
+    inline const SimdVector3 SimdVector3::left(-1, 0, 0);
+    inline const SimdVector3 SimdVector3::right(1, 0, 0);
+    inline const SimdVector3 SimdVector3::forward(0, 1, 0);
+    inline const SimdVector3 SimdVector3::backward(0, -1, 0);
+  #else
+    // Without SSE the generic template is the fastest option
+    class SimdVector3 : public Vector3<float> {
+      public :
+        using Vector3<float>::Vector3;
+        SimdVector3() {}
+        SimdVector3(const Vector3<float>& vec) : Vector3<float>(vec.x, vec.y, vec.z) {}
+        template <typename other_num_type = float>
+        Vector3<other_num_type> toVector3() const {
+          return Vector3<other_num_type>(other_num_type(x), other_num_type(y), other_num_type(z));
+        }
+    };
+  #endif
+
+#endif
@@ -0,0 +1,277 @@
+#if !defined(TRANSFORM_H_INCLUDED)
+  #define TRANSFORM_H_INCLUDED
+
+  #include "rotator.h"
+  #include "vector_array.h"
+
+  // out = a * b for row-major 4x4 matrices. The SIMD overloads broadcast each
+  // element of a row of a against whole rows of b. out may alias a or b
+  template <typename num_type>
+  inline void matrix4Multiply(const num_type a[4][4], const num_type b[4][4], num_type out[4][4]) {
+    num_type r[4][4];
+    for (int i = 0; i < 4; ++i)
+      for (int j = 0; j < 4; ++j)
+        r[i][j] = a[i][0] * b[0][j] + a[i][1] * b[1][j] + a[i][2] * b[2][j] + a[i][3] * b[3][j];
+    for (int i = 0; i < 4; ++i)
+      for (int j = 0; j < 4; ++j)
+        out[i][j] = r[i][j];
+  }
+  #if defined(__SSE2__)
+    inline void matrix4Multiply(const float a[4][4], const float b[4][4], float out[4][4]) {
+      __m128 b_0 = _mm_loadu_ps(b[0]), b_1 = _mm_loadu_ps(b[1]), b_2 = _mm_loadu_ps(b[2]), b_3 = _mm_loadu_ps(b[3]);
+      __m128 r[4];
+      for (int i = 0; i < 4; ++i)
+        r[i] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[i][0]), b_0), _mm_mul_ps(_mm_set1_ps(a[i][1]), b_1)),
+                          _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[i][2]), b_2), _mm_mul_ps(_mm_set1_ps(a[i][3]), b_3)));
+      for (int i = 0; i < 4; ++i)
+        _mm_storeu_ps(out[i], r[i]);
+    }
+  #endif
+  #if defined(__AVX__)
+    inline void matrix4Multiply(const double a[4][4], const double b[4][4], double out[4][4]) {
+      __m256d b_0 = _mm256_loadu_pd(b[0]), b_1 = _mm256_loadu_pd(b[1]), b_2 = _mm256_loadu_pd(b[2]), b_3 = _mm256_loadu_pd(b[3]);
+      __m256d r[4];
+      for (int i = 0; i < 4; ++i)
+        r[i] = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(_mm256_set1_pd(a[i][0]), b_0), _mm256_mul_pd(_mm256_set1_pd(a[i][1]), b_1)),
+                             _mm256_add_pd(_mm256_mul_pd(_mm256_set1_pd(a[i][2]), b_2), _mm256_mul_pd(_mm256_set1_pd(a[i][3]), b_3)));
+      for (int i = 0; i < 4; ++i)
+        _mm256_storeu_pd(out[i], r[i]);
+    }
+  #endif
+
+  // Row-major 4x4 matrix acting on column vectors, like RotationMatrix. Affine
+  // transforms are built as translation * rotation * scale, so the last row is
+  // (0, 0, 0, 1); transformPoint and friends assume that and skip the w divide
+  template <typename num_type = float>
+  class Matrix4x4 {
+    public :
+      num_type matrix[4][4];
+
+      constexpr Matrix4x4() : matrix{{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}, {0, 0, 0, 1}} {}
+      template <typename other_num_type>
+      constexpr Matrix4x4<num_type>& operator=(const Matrix4x4<other_num_type>& mat) {
+        for (int i = 0; i < 4; ++i)
+          for (int j = 0; j < 4; ++j)
+            matrix[i][j] = mat.matrix[i][j];
+        return *this;
+      }
+      template <typename other_num_type>
+      constexpr Matrix4x4(const Matrix4x4<other_num_type>& mat) : Matrix4x4() {
+        *this = mat;
+      }
+      // Scale, then rotate, then translate
+      template <typename other_num_type>
+      constexpr Matrix4x4(const RotationMatrix<other_num_type>& rot,
+                          const Vector3<other_num_type>& translation = Vector3<other_num_type>(),
+                          const Vector3<other_num_type>& scale = Vector3<other_num_type>(1)) : Matrix4x4() {
+        const other_num_type t[3] = {translation.x, translation.y, translation.z};
+        for (int i = 0; i < 3; ++i) {
+          matrix[i][0] = rot.matrix[i][0] * scale.x;
+          matrix[i][1] = rot.matrix[i][1] * scale.y;
+          matrix[i][2] = rot.matrix[i][2] * scale.z;
+          matrix[i][3] = t[i];
+        }
+      }
+      template <typename other_num_type>
+      Matrix4x4(const QuaternionRotator<other_num_type>& rot,
+                const Vector3<other_num_type>& translation = Vector3<other_num_type>(),
+                const Vector3<other_num_type>& scale = Vector3<other_num_type>(1))
+        : Matrix4x4(RotationMatrix<other_num_type>(rot), translation, scale) {}
+      template <typename other_num_type>
+      Matrix4x4(const AngleAxisRotator<other_num_type>& rot,
+                const Vector3<other_num_type>& translation = Vector3<other_num_type>(),
+                const Vector3<other_num_type>& scale = Vector3<other_num_type>(1))
+        : Matrix4x4(RotationMatrix<other_num_type>(rot), translation, scale) {}
+
+      // Identity element
+      static const Matrix4x4 identity;
+
+      template <typename other_num_type>
+      static constexpr Matrix4x4<num_type> translation(const Vector3<other_num_type>& t) {
+        Matrix4x4<num_type> mat;
+        mat.matrix[0][3] = t.x; mat.matrix[1][3] = t.y; mat.matrix[2][3] = t.z;
+        return mat;
+      }
+      template <typename other_num_type>
+      static constexpr Matrix4x4<num_type> scaling(const Vector3<other_num_type>& s) {
+        Matrix4x4<num_type> mat;
+        mat.matrix[0][0] = s.x; mat.matrix[1][1] = s.y; mat.matrix[2][2] = s.z;
+        return mat;
+      }
+
+      // Camera at eye looking at target, OpenGL style: the view looks down -z with
+      // up along +y
+      template <typename other_num_type>
+      static Matrix4x4<num_type> lookAt(const Vector3<other_num_type>& eye, const Vector3<other_num_type>& target,
+                                        const Vector3<other_num_type>& up) {
+        Vector3<num_type> e(eye);
+        Vector3<num_type> f = Vector3<num_type>(target).from(e).normalized();
+        Vector3<num_type> s = f.crossProduct(Vector3<num_type>(up)).normalized();
+        Vector3<num_type> u = s.crossProduct(f);
+        Matrix4x4<num_type> mat;
+        for (int j = 0; j < 3; ++j) {
+          mat.matrix[0][j] = s[j];
+          mat.matrix[1][j] = u[j];
+          mat.matrix[2][j] = -f[j];
+        }
+        mat.matrix[0][3] = -s.dotProduct(e);
+        mat.matrix[1][3] = -u.dotProduct(e);
+        mat.matrix[2][3] = f.dotProduct(e);
+        return mat;
+      }
+      // OpenGL style projection to clip space, depth -1 at near and 1 at far. Not
+      // affine, so transformPoint doesn't apply; the rasterizer takes the full product
+      static Matrix4x4<num_type> perspective(num_type fov_y, num_type aspect, num_type near, num_type far) {
+        num_type t = 1 / tan(fov_y / 2);
+        Matrix4x4<num_type> mat;
+        mat.matrix[0][0] = t / aspect;
+        mat.matrix[1][1] = t;
+        mat.matrix[2][2] = (far + near) / (near - far);
+        mat.matrix[2][3] = 2 * far * near / (near - far);
+        mat.matrix[3][2] = -1;
+        mat.matrix[3][3] = 0;
+        return mat;
+      }
+
+      Vector3<num_type> getTranslation() const {
+        return Vector3<num_type>(matrix[0][3], matrix[1][3], matrix[2][3]);
+      }
+      // The upper 3x3, a rotation only when there is no scale or shear
+      RotationMatrix<num_type> getRotation() const {
+        RotationMatrix<num_type> rot;
+        for (int i = 0; i < 3; ++i)
+          for (int j = 0; j < 3; ++j)
+            rot.matrix[i][j] = matrix[i][j];
+        return rot;
+      }
+      template <typename other_num_type>
+      void setTranslation(const Vector3<other_num_type>& t) {
+        matrix[0][3] = t.x; matrix[1][3] = t.y; matrix[2][3] = t.z;
+      }
+
+      template <typename other_num_type>
+      constexpr bool equals(const Matrix4x4<other_num_type>& mat) const {
+        for (int i = 0; i < 4; ++i)
+          for (int j = 0; j < 4; ++j)
+            if (matrix[i][j] != mat.matrix[i][j])
+              return false;
+        return true;
+      }
+      // Matrix product this * mat, i.e. mat is applied first
+      Matrix4x4<num_type> multiply(const Matrix4x4<num_type>& mat) const {
+        Matrix4x4<num_type> new_mat;
+        matrix4Multiply(matrix, mat.matrix, new_mat.matrix);
+        return new_mat;
+      }
+      // this is applied first, then mat, matching Rotator::compose
+      Matrix4x4<num_type> compose(const Matrix4x4<num_type>& mat) const {
+        return mat.multiply(*this);
+      }
+      Matrix4x4<num_type> transposed() const {
+        Matrix4x4<num_type> new_mat;
+        for (int i = 0; i < 4; ++i)
+          for (int j = 0; j < 4; ++j)
+            new_mat.matrix[i][j] = matrix[j][i];
+        return new_mat;
+      }
+      // Inverse of an affine matrix: invert the 3x3 part by cofactors (so
+      // non-uniform scale is handled) and carry the translation through it.
+      // A singular 3x3 part gives NaNs
+      Matrix4x4<num_type> affineInverse() const {
+        const num_type (*m)[4] = matrix;
+        num_type c_00 = m[1][1] * m[2][2] - m[1][2] * m[2][1],
+                 c_01 = m[1][2] * m[2][0] - m[1][0] * m[2][2],
+                 c_02 = m[1][0] * m[2][1] - m[1][1] * m[2][0];
+        num_type det = m[0][0] * c_00 + m[0][1] * c_01 + m[0][2] * c_02;
+        Matrix4x4<num_type> inv;
+        if (det == 0) {
+          for (int i = 0; i < 3; ++i)
+            for (int j = 0; j < 4; ++j)
+              inv.matrix[i][j] = std::numeric_limits<num_type>::quiet_NaN();
+          return inv;
+        }
+        num_type d = 1 / det;
+        inv.matrix[0][0] = c_00 * d;
+        inv.matrix[1][0] = c_01 * d;
+        inv.matrix[2][0] = c_02 * d;
+        inv.matrix[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) * d;
+        inv.matrix[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) * d;
+        inv.matrix[2][1] = (m[0][1] * m[2][0] - m[0][0] * m[2][1]) * d;
+        inv.matrix[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) * d;
+        inv.matrix[1][2] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) * d;
+        inv.matrix[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) * d;
+        for (int i = 0; i < 3; ++i)
+          inv.matrix[i][3] = -(inv.matrix[i][0] * m[0][3] + inv.matrix[i][1] * m[1][3] + inv.matrix[i][2] * m[2][3]);
+        return inv;
+      }
+
+      Vector3<num_type> transformPoint(const Vector3<num_type>& p) const {
+        return Vector3<num_type>(matrix[0][0] * p.x + matrix[0][1] * p.y + matrix[0][2] * p.z + matrix[0][3],
+                                 matrix[1][0] * p.x + matrix[1][1] * p.y + matrix[1][2] * p.z + matrix[1][3],
+                                 matrix[2][0] * p.x + matrix[2][1] * p.y + matrix[2][2] * p.z + matrix[2][3]);
+      }
+      Vector3<num_type> transformDirection(const Vector3<num_type>& d) const {
+        return Vector3<num_type>(matrix[0][0] * d.x + matrix[0][1] * d.y + matrix[0][2] * d.z,
+                                 matrix[1][0] * d.x + matrix[1][1] * d.y + matrix[1][2] * d.z,
+                                 matrix[2][0] * d.x + matrix[2][1] * d.y + matrix[2][2] * d.z);
+      }
+
+      // Batch transforms over SoA lanes; outputs may alias the inputs
+      void transformLanes(const num_type* x, const num_type* y, const num_type* z,
+                          num_type* out_x, num_type* out_y, num_type* out_z, size_t n, bool points = true) const {
+        num_type t[3];
+        for (int i = 0; i < 3; ++i)
+          t[i] = points ? matrix[i][3] : 0;
+        forEachLane<num_type>(n, [&](auto lanes, size_t i) {
+          typedef decltype(lanes) L;
+          typename L::reg vx = L::load(x + i), vy = L::load(y + i), vz = L::load(z + i);
+          typename L::reg r[3];
+          for (int j = 0; j < 3; ++j)
+            r[j] = L::mulAdd(L::set(matrix[j][2]), vz,
+                   L::mulAdd(L::set(matrix[j][1]), vy,
+                   L::mulAdd(L::set(matrix[j][0]), vx, L::set(t[j]))));
+          L::store(out_x + i, r[0]);
+          L::store(out_y + i, r[1]);
+          L::store(out_z + i, r[2]);
+        });
+      }
+      void transformPoints(const Vector3Array<num_type>& points, Vector3Array<num_type>& out) const {
+        if (&out != &points)
+          out.resize(points.size());
+        transformLanes(points.x, points.y, points.z, out.x, out.y, out.z, points.size(), true);
+      }
+      void transformDirections(const Vector3Array<num_type>& dirs, Vector3Array<num_type>& out) const {
+        if (&out != &dirs)
+          out.resize(dirs.size());
+        transformLanes(dirs.x, dirs.y, dirs.z, out.x, out.y, out.z, dirs.size(), false);
+      }
+      void transformPoints(const Vector3<num_type>* points, Vector3<num_type>* out, size_t n) const {
+        forEachVectorBlock(points, out, n, [&](const num_type* x, const num_type* y, const num_type* z,
+                                               num_type* out_x, num_type* out_y, num_type* out_z, size_t m) {
+          transformLanes(x, y, z, out_x, out_y, out_z, m, true);
+        });
+      }
+      void transformDirections(const Vector3<num_type>* dirs, Vector3<num_type>* out, size_t n) const {
+        forEachVectorBlock(dirs, out, n, [&](const num_type* x, const num_type* y, const num_type* z,
+                                             num_type* out_x, num_type* out_y, num_type* out_z, size_t m) {
+          transformLanes(x, y, z, out_x, out_y, out_z, m, false);
+        });
+      }
+
+      // Operators
+      Matrix4x4<num_type> operator*(const Matrix4x4<num_type>& mat) const { return multiply(mat);}
+      Matrix4x4<num_type>& operator*=(const Matrix4x4<num_type>& mat) { return *this = multiply(mat);}
+      Vector3<num_type> operator*(const Vector3<num_type>& p) const { return transformPoint(p);}
+      template <typename other_num_type>
+      constexpr bool operator==(const Matrix4x4<other_num_type>& mat) const { return equals(mat);}
+      template <typename other_num_type>
+      constexpr bool operator!=(const Matrix4x4<other_num_type>& mat) const { return not equals(mat);}
+      constexpr num_type* operator[](int i) { return matrix[i];}
+      constexpr const num_type* operator[](int i) const { return matrix[i];}
+  };
+  template <typename num_type> constexpr Matrix4x4<num_type> Matrix4x4<num_type>::identity;
+
+  template <typename num_type = float>
+  using Transform = Matrix4x4<num_type>;
+
+#endif
@@ -0,0 +1,307 @@
+#if !defined(VECTOR_ARRAY_H_INCLUDED)
+  #define VECTOR_ARRAY_H_INCLUDED
+
+  #include <new>
+  #include <string.h>
+  #include "vector.h"
+  #include "simd.h"
+
+  // Structure-of-arrays container of Vector3s. Each component lives in its own
+  // cache line aligned lane so the batch kernels below can stream full registers.
+  // Kernels write into an output array which may alias this or the inputs.
+  template <typename num_type = float>
+  class Vector3Array {
+    public :
+      static const size_t alignment = 64;
+
+      num_type* x;
+      num_type* y;
+      num_type* z;
+
+      Vector3Array() : x(nullptr), y(nullptr), z(nullptr), count(0), cap(0) {}
+      explicit Vector3Array(size_t n) : Vector3Array() {
+        resize(n);
+      }
+      template <typename other_num_type>
+      Vector3Array(const Vector3<other_num_type>* vecs, size_t n) : Vector3Array() {
+        fromVectors(vecs, n);
+      }
+      Vector3Array(const Vector3Array<num_type>& arr) : Vector3Array() {
+        *this = arr;
+      }
+      // n elements of lanes owned elsewhere, e.g. a mapped file, which must outlive
+      // the array and are never freed by it. Growing or resizing first copies them
+      // into storage of its own, but kernels run in place write into the lanes
+      // themselves, so they must be writable unless the array is only read
+      static Vector3Array<num_type> borrow(const num_type* x, const num_type* y, const num_type* z, size_t n) {
+        Vector3Array<num_type> arr;
+        arr.x = const_cast<num_type*>(x);
+        arr.y = const_cast<num_type*>(y);
+        arr.z = const_cast<num_type*>(z);
+        arr.count = n;
+        return arr;
+      }
+      Vector3Array(Vector3Array<num_type>&& arr) : Vector3Array() {
+        swap(arr);
+      }
+      Vector3Array<num_type>& operator=(const Vector3Array<num_type>& arr) {
+        if (this != &arr) {
+          resize(arr.count);
+          memcpy(x, arr.x, count * sizeof(num_type));
+          memcpy(y, arr.y, count * sizeof(num_type));
+          memcpy(z, arr.z, count * sizeof(num_type));
+        }
+        return *this;
+      }
+      Vector3Array<num_type>& operator=(Vector3Array<num_type>&& arr) {
+        swap(arr);
+        return *this;
+      }
+      ~Vector3Array() {
+        if (cap != 0)
+          release(x);
+      }
+
+      void swap(Vector3Array<num_type>& arr) {
+        num_type* t;
+        t = x; x = arr.x; arr.x = t;
+        t = y; y = arr.y; arr.y = t;
+        t = z; z = arr.z; arr.z = t;
+        size_t s;
+        s = count; count = arr.count; arr.count = s;
+        s = cap; cap = arr.cap; arr.cap = s;
+      }
+
+      // Container functions
+      size_t size() const {
+        return count;
+      }
+      size_t capacity() const {
+        return cap;
+      }
+      bool empty() const {
+        return count == 0;
+      }
+      void clear() {
+        count = 0;
+      }
+      void reserve(size_t n) {
+        if (n < count)
+          n = count;
+        if (n <= cap)
+          return;
+        // Keep every lane a whole number of cache lines so y and z stay aligned
+        size_t per_line = alignment / sizeof(num_type);
+        size_t new_cap = (n + per_line - 1) / per_line * per_line;
+        num_type* block = allocate(3 * new_cap);
+        if (count != 0) {
+          memcpy(block, x, count * sizeof(num_type));
+          memcpy(block + new_cap, y, count * sizeof(num_type));
+          memcpy(block + 2 * new_cap, z, count * sizeof(num_type));
+        }
+        if (cap != 0)
+          release(x);
+        x = block;
+        y = block + new_cap;
+        z = block + 2 * new_cap;
+        cap = new_cap;
+      }
+      // New elements are zero vectors, as with Vector3()
+      void resize(size_t n) {
+        if (n > cap)
+          reserve(n > 2 * cap ? n : 2 * cap);
+        for (size_t i = count; i < n; ++i)
+          x[i] = y[i] = z[i] = 0;
+        count = n;
+      }
+      template <typename other_num_type>
+      void append(const Vector3<other_num_type>& vec) {
+        if (count >= cap)
+          reserve(count == 0 ? alignment / sizeof(num_type) : 2 * count);
+        set(count++, vec);
+      }
+
+      // Conversion to and from plain Vector3
+      Vector3<num_type> get(size_t i) const {
+        return Vector3<num_type>(x[i], y[i], z[i]);
+      }
+      template <typename other_num_type>
+      void set(size_t i, const Vector3<other_num_type>& vec) {
+        x[i] = vec.x; y[i] = vec.y; z[i] = vec.z;
+      }
+      Vector3<num_type> operator[](size_t i) const {
+        return get(i);
+      }
+      template <typename other_num_type>
+      void fromVectors(const Vector3<other_num_type>* vecs, size_t n) {
+        resize(n);
+        for (size_t i = 0; i < n; ++i)
+          set(i, vecs[i]);
+      }
+      template <typename other_num_type>
+      void toVectors(Vector3<other_num_type>* vecs) const {
+        for (size_t i = 0; i < count; ++i) {
+          vecs[i].x = x[i]; vecs[i].y = y[i]; vecs[i].z = z[i];
+        }
+      }
+
+      // Batch kernels, element-wise counterparts of the Vector3 functions
+      void add(const Vector3Array<num_type>& a, Vector3Array<num_type>& out) const {
+        size_t n = prepare(a, out);
+        const num_type *ax = a.x, *ay = a.y, *az = a.z;
+        num_type *ox = out.x, *oy = out.y, *oz = out.z;
+        forEachLane<num_type>(n, [&](auto lanes, size_t i) {
+          typedef decltype(lanes) L;
+          L::store(ox + i, L::add(L::load(x + i), L::load(ax + i)));
+          L::store(oy + i, L::add(L::load(y + i), L::load(ay + i)));
+          L::store(oz + i, L::add(L::load(z + i), L::load(az + i)));
+        });
+      }
+      void from(const Vector3Array<num_type>& s, Vector3Array<num_type>& out) const {
+        size_t n = prepare(s, out);
+        const num_type *sx = s.x, *sy = s.y, *sz = s.z;
+        num_type *ox = out.x, *oy = out.y, *oz = out.z;
+        forEachLane<num_type>(n, [&](auto lanes, size_t i) {
+          typedef decltype(lanes) L;
+          L::store(ox + i, L::sub(L::load(x + i), L::load(sx + i)));
+          L::store(oy + i, L::sub(L::load(y + i), L::load(sy + i)));
+          L::store(oz + i, L::sub(L::load(z + i), L::load(sz + i)));
+        });
+      }
+      void scale(num_type s, Vector3Array<num_type>& out) const {
+        size_t n = prepare(out);
+        num_type *ox = out.x, *oy = out.y, *oz = out.z;
+        forEachLane<num_type>(n, [&](auto lanes, size_t i) {
+          typedef decltype(lanes) L;
+          typename L::reg k = L::set(s);
+          L::store(ox + i, L::mul(L::load(x + i), k));
+          L::store(oy + i, L::mul(L::load(y + i), k));
+          L::store(oz + i, L::mul(L::load(z + i), k));
+        });
+      }
+      // out = this + a * s, e.g. position.multiplyAdd(velocity, dt, position)
+      void multiplyAdd(const Vector3Array<num_type>& a, num_type s, Vector3Array<num_type>& out) const {
+        size_t n = prepare(a, out);
+        const num_type *ax = a.x, *ay = a.y, *az = a.z;
+        num_type *ox = out.x, *oy = out.y, *oz = out.z;
+        forEachLane<num_type>(n, [&](auto lanes, size_t i) {
+          typedef decltype(lanes) L;
+          typename L::reg k = L::set(s);
+          L::store(ox + i, L::mulAdd(L::load(ax + i), k, L::load(x + i)));
+          L::store(oy + i, L::mulAdd(L::load(ay + i), k, L::load(y + i)));
+          L::store(oz + i, L::mulAdd(L::load(az + i), k, L::load(z + i)));
+        });
+      }
+      // out must hold min(size(), d.size()) numbers
+      void dotProduct(const Vector3Array<num_type>& d, num_type* out) const {
+        size_t n = count < d.count ? count : d.count;
+        const num_type *dx = d.x, *dy = d.y, *dz = d.z;
+        forEachLane<num_type>(n, [&](auto lanes, size_t i) {
+          typedef decltype(lanes) L;
+          typename L::reg dot = L::mul(L::load(x + i), L::load(dx + i));
+          dot = L::mulAdd(L::load(y + i), L::load(dy + i), dot);
+          dot = L::mulAdd(L::load(z + i), L::load(dz + i), dot);
+          L::store(out + i, dot);
+        });
+      }
+      void crossProduct(const Vector3Array<num_type>& c, Vector3Array<num_type>& out) const {
+        size_t n = prepare(c, out);
+        const num_type *cx = c.x, *cy = c.y, *cz = c.z;
+        num_type *ox = out.x, *oy = out.y, *oz = out.z;
+        forEachLane<num_type>(n, [&](auto lanes, size_t i) {
+          typedef decltype(lanes) L;
+          typename L::reg ax = L::load(x + i), ay = L::load(y + i), az = L::load(z + i),
+                          bx = L::load(cx + i), by = L::load(cy + i), bz = L::load(cz + i);
+          L::store(ox + i, L::negMulAdd(az, by, L::mul(ay, bz)));
+          L::store(oy + i, L::negMulAdd(ax, bz, L::mul(az, bx)));
+          L::store(oz + i, L::negMulAdd(ay, bx, L::mul(ax, by)));
+        });
+      }
+      // out must hold size() numbers
+      void sqrMagnitude(num_type* out) const {
+        forEachLane<num_type>(count, [&](auto lanes, size_t i) {
+          typedef decltype(lanes) L;
+          typename L::reg vx = L::load(x + i), vy = L::load(y + i), vz = L::load(z + i);
+          L::store(out + i, L::mulAdd(vz, vz, L::mulAdd(vy, vy, L::mul(vx, vx))));
+        });
+      }
+      // Zero vectors stay zero, as in Vector3::normalized
+      void normalized(Vector3Array<num_type>& out) const {
+        size_t n = prepare(out);
+        num_type *ox = out.x, *oy = out.y, *oz = out.z;
+        forEachLane<num_type>(n, [&](auto lanes, size_t i) {
+          typedef decltype(lanes) L;
+          typename L::reg vx = L::load(x + i), vy = L::load(y + i), vz = L::load(z + i);
+          typename L::reg sqr = L::mulAdd(vz, vz, L::mulAdd(vy, vy, L::mul(vx, vx)));
+          typename L::reg zero = L::set(0);
+          typename L::reg inv = L::select(L::greater(sqr, zero), L::div(L::set(1), L::squareRoot(sqr)), zero);
+          L::store(ox + i, L::mul(vx, inv));
+          L::store(oy + i, L::mul(vy, inv));
+          L::store(oz + i, L::mul(vz, inv));
+        });
+      }
+      void clamp(num_type m, Vector3Array<num_type>& out) const {
+        size_t n = prepare(out);
+        num_type *ox = out.x, *oy = out.y, *oz = out.z;
+        forEachLane<num_type>(n, [&](auto lanes, size_t i) {
+          typedef decltype(lanes) L;
+          typename L::reg vx = L::load(x + i), vy = L::load(y + i), vz = L::load(z + i);
+          typename L::reg sqr = L::mulAdd(vz, vz, L::mulAdd(vy, vy, L::mul(vx, vx)));
+          typename L::reg mag = L::set(m);
+          typename L::reg k = L::select(L::greater(sqr, L::mul(mag, mag)), L::div(mag, L::squareRoot(sqr)), L::set(1));
+          L::store(ox + i, L::mul(vx, k));
+          L::store(oy + i, L::mul(vy, k));
+          L::store(oz + i, L::mul(vz, k));
+        });
+      }
+
+      // In-place operators
+      Vector3Array<num_type>& operator+=(const Vector3Array<num_type>& a) { add(a, *this); return *this;}
+      Vector3Array<num_type>& operator-=(const Vector3Array<num_type>& s) { from(s, *this); return *this;}
+      Vector3Array<num_type>& operator*=(num_type m) { scale(m, *this); return *this;}
+
+    private :
+      size_t count;
+      size_t cap;
+
+      static num_type* allocate(size_t n) {
+        return static_cast<num_type*>(::operator new(n * sizeof(num_type), std::align_val_t(alignment)));
+      }
+      static void release(num_type* p) {
+        if (p != nullptr)
+          ::operator delete(p, std::align_val_t(alignment));
+      }
+      // Sizes the output for an element-wise kernel and returns the element count
+      size_t prepare(Vector3Array<num_type>& out) const {
+        if (&out != this)
+          out.resize(count);
+        return count;
+      }
+      size_t prepare(const Vector3Array<num_type>& a, Vector3Array<num_type>& out) const {
+        size_t n = count < a.count ? count : a.count;
+        if (&out != this and &out != &a)
+          out.resize(n);
+        return n;
+      }
+  };
+
+  // Runs kernel(x, y, z, out_x, out_y, out_z, m) over a plain Vector3 array,
+  // deinterleaving up to 64 elements at a time so SoA kernels can be used on
+  // AoS data. out may alias vecs
+  template <typename num_type, class Kernel>
+  inline void forEachVectorBlock(const Vector3<num_type>* vecs, Vector3<num_type>* out, size_t n, Kernel kernel) {
+    const size_t block = 64;
+    alignas(64) num_type x[block], y[block], z[block];
+    for (size_t start = 0; start < n; start += block) {
+      size_t m = n - start < block ? n - start : block;
+      for (size_t i = 0; i < m; ++i) {
+        x[i] = vecs[start + i].x; y[i] = vecs[start + i].y; z[i] = vecs[start + i].z;
+      }
+      kernel(x, y, z, x, y, z, m);
+      for (size_t i = 0; i < m; ++i) {
+        out[start + i].x = x[i]; out[start + i].y = y[i]; out[start + i].z = z[i];
+      }
+    }
+  }
+
+#endif
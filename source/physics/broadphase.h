@@ -0,0 +1,449 @@
+#if !defined(BROADPHASE_H_INCLUDED)
+  #define BROADPHASE_H_INCLUDED
+
+  #include <algorithm>
+  #include <math.h>
+  #include <stdint.h>
+  #include <string.h>
+  #include <vector>
+  #include "../math/vector_array.h"
+  #include "../core/parallel.h"
+
+  // Candidate pair of object indices, a < b
+  struct BroadphasePair {
+    uint32_t a, b;
+    bool operator==(const BroadphasePair& p) const {return a == p.a and b == p.b;}
+    bool operator<(const BroadphasePair& p) const {return a < p.a or (a == p.a and b < p.b);}
+  };
+
+  // Common interface of the broadphases. Objects are bounding spheres given by
+  // index; update takes this frame's centres and radii, then findPairs reports
+  // every pair whose spheres overlap, each once, in no particular order.
+  // FinalType must provide refresh(threads), sliceCount() and collect(begin,
+  // end, pairs), where collect reports the pairs owned by its slice [begin, end)
+  // of [0, sliceCount()), e.g. objects or cells
+  template <class FinalType, typename num_type>
+  class Broadphase {
+    public :
+      static constexpr uint32_t none = 0xFFFFFFFF;
+      // Smallest slice of objects worth giving to another thread
+      static constexpr size_t min_chunk = 4096;
+
+      void update(const Vector3Array<num_type>& positions, const num_type* radii, unsigned threads = 1) {
+        size_t n = positions.size();
+        x.assign(positions.x, positions.x + n);
+        y.assign(positions.y, positions.y + n);
+        z.assign(positions.z, positions.z + n);
+        r.assign(radii, radii + n);
+        derived().refresh(threads);
+      }
+      void findPairs(std::vector<BroadphasePair>& pairs, unsigned threads = 1) const {
+        pairs.clear();
+        size_t n = derived().sliceCount();
+        size_t chunks = std::min<size_t>(threads == 0 ? 1 : threads, (n + min_chunk - 1) / min_chunk);
+        if (chunks <= 1) {
+          derived().collect(0, n, pairs);
+          return;
+        }
+        // Slices are finer than threads, since pair density varies across them
+        chunks *= 4;
+        std::vector<std::vector<BroadphasePair>> parts(chunks);
+        parallelChunks(chunks, threads, 1, [&](size_t begin, size_t end) {
+          for (size_t c = begin; c < end; ++c)
+            derived().collect(n * c / chunks, n * (c + 1) / chunks, parts[c]);
+        });
+        size_t total = 0;
+        for (const std::vector<BroadphasePair>& part : parts)
+          total += part.size();
+        pairs.reserve(total);
+        for (const std::vector<BroadphasePair>& part : parts)
+          pairs.insert(pairs.end(), part.begin(), part.end());
+      }
+      size_t size() const {
+        return x.size();
+      }
+
+    protected :
+      std::vector<num_type> x, y, z, r;
+
+      bool overlaps(size_t i, size_t j) const {
+        num_type dx = x[i] - x[j], dy = y[i] - y[j], dz = z[i] - z[j], s = r[i] + r[j];
+        return dx * dx + dy * dy + dz * dz < s * s;
+      }
+      static void report(size_t i, size_t j, std::vector<BroadphasePair>& pairs) {
+        BroadphasePair p;
+        p.a = uint32_t(i < j ? i : j);
+        p.b = uint32_t(i < j ? j : i);
+        pairs.push_back(p);
+      }
+
+    private :
+      const FinalType& derived() const {
+        return static_cast<const FinalType&>(*this);
+      }
+      FinalType& derived() {
+        return static_cast<FinalType&>(*this);
+      }
+  };
+
+  // Uniform grid hashed into an open addressing table, with each cell's objects
+  // in an intrusive doubly linked list. Objects are filed under the cell holding
+  // their centre, so with radii up to half the cell size every overlap lies in
+  // the 27 surrounding cells. update only moves objects whose cell changed.
+  // Larger objects bypass the grid and are tested against everything, so pick
+  // the cell size from the typical object, not the largest.
+  //
+  // Slots follow the cell coordinates, z fastest, rather than a scrambling hash,
+  // and findPairs walks the table in slot order. Consecutive cells then share
+  // most of their neighbours' cache lines. Each cell is tested against itself
+  // and the 13 neighbours that follow it, so each pair is met once
+  template <typename num_type = float>
+  class SpatialHashBroadphase : public Broadphase<SpatialHashBroadphase<num_type>, num_type> {
+    typedef Broadphase<SpatialHashBroadphase<num_type>, num_type> Base;
+    friend Base;
+    using Base::none;
+    using Base::x;
+    using Base::y;
+    using Base::z;
+    using Base::r;
+
+    public :
+      explicit SpatialHashBroadphase(num_type cell_size = 1) : cell(cell_size), inv_cell(1 / cell_size),
+                                                               used(0), reinserted(0) {}
+
+      num_type cellSize() const {
+        return cell;
+      }
+      // Objects the last update moved between cells, including new ones
+      size_t lastReinserted() const {
+        return reinserted;
+      }
+
+    private :
+      static constexpr uint64_t empty = ~uint64_t(0);
+      // Objects too large for the grid
+      static constexpr uint64_t oversized = empty - 1;
+      static constexpr int64_t bias = 1 << 20;
+      static constexpr uint64_t axis_mask = (1 << 21) - 1;
+
+      struct Sphere {
+        num_type x, y, z, r;
+      };
+
+      num_type cell;
+      num_type inv_cell;
+      // Cell table
+      std::vector<uint64_t> keys;
+      std::vector<uint32_t> heads;
+      size_t used;
+      // Per object
+      std::vector<uint64_t> object_key;
+      std::vector<uint64_t> new_key;
+      std::vector<uint32_t> next;
+      std::vector<uint32_t> prev;
+      // Copy of x, y, z and r, one cache line access per candidate
+      std::vector<Sphere> spheres;
+      std::vector<uint32_t> large;
+      size_t reinserted;
+
+      // 21 bits per axis, about a million cells each way
+      static uint64_t pack(int64_t cx, int64_t cy, int64_t cz) {
+        return (uint64_t(cx + bias) & axis_mask) << 42 | (uint64_t(cy + bias) & axis_mask) << 21 | (uint64_t(cz + bias) & axis_mask);
+      }
+      uint64_t keyOf(size_t i) const {
+        if (r[i] * 2 > cell)
+          return oversized;
+        return pack(int64_t(floor(x[i] * inv_cell)), int64_t(floor(y[i] * inv_cell)), int64_t(floor(z[i] * inv_cell)));
+      }
+      size_t slotOf(uint64_t key) const {
+        size_t mask = keys.size() - 1;
+        // Odd strides keep rows and planes of cells from landing on the same slots
+        size_t s = size_t((key & axis_mask) + (key >> 21 & axis_mask) * 1009 + (key >> 42) * 1018081) & mask;
+        while (keys[s] != key and keys[s] != empty)
+          s = (s + 1) & mask;
+        return s;
+      }
+      uint32_t headOf(uint64_t key) const {
+        size_t s = slotOf(key);
+        return keys[s] == key ? heads[s] : none;
+      }
+      bool overlaps(uint32_t i, uint32_t j) const {
+        const Sphere& a = spheres[i];
+        const Sphere& b = spheres[j];
+        num_type dx = a.x - b.x, dy = a.y - b.y, dz = a.z - b.z, s = a.r + b.r;
+        return dx * dx + dy * dy + dz * dz < s * s;
+      }
+
+      void link(uint32_t i, uint64_t key) {
+        object_key[i] = key;
+        prev[i] = none;
+        if (key == oversized) {
+          next[i] = none;
+          return;
+        }
+        size_t s = slotOf(key);
+        if (keys[s] == empty) {
+          keys[s] = key;
+          heads[s] = none;
+          ++used;
+        }
+        next[i] = heads[s];
+        if (heads[s] != none)
+          prev[heads[s]] = i;
+        heads[s] = i;
+      }
+      void unlink(uint32_t i) {
+        uint64_t key = object_key[i];
+        if (key == oversized)
+          return;
+        if (prev[i] != none)
+          next[prev[i]] = next[i];
+        else
+          heads[slotOf(key)] = next[i];
+        if (next[i] != none)
+          prev[next[i]] = prev[i];
+      }
+      // Empties the table and files every object again, dropping cells left empty
+      void rebuild(size_t n) {
+        size_t capacity = 64;
+        while (capacity < 4 * n)
+          capacity *= 2;
+        keys.assign(capacity, empty);
+        heads.assign(capacity, none);
+        used = 0;
+        for (size_t i = 0; i < n; ++i)
+          link(uint32_t(i), new_key[i]);
+        reinserted = n;
+      }
+
+      void refresh(unsigned threads) {
+        size_t n = this->size();
+        new_key.resize(n);
+        spheres.resize(n);
+        parallelChunks(n, threads, Base::min_chunk, [&](size_t begin, size_t end) {
+          for (size_t i = begin; i < end; ++i) {
+            new_key[i] = keyOf(i);
+            spheres[i].x = x[i];
+            spheres[i].y = y[i];
+            spheres[i].z = z[i];
+            spheres[i].r = r[i];
+          }
+        });
+        size_t old_n = object_key.size();
+        object_key.resize(n);
+        next.resize(n);
+        prev.resize(n);
+        if (n < old_n or keys.empty())
+          rebuild(n);
+        else {
+          reinserted = 0;
+          for (size_t i = 0; i < n; ++i) {
+            if (i < old_n) {
+              if (new_key[i] == object_key[i])
+                continue;
+              unlink(uint32_t(i));
+            }
+            // Keep the table at most half full, counting cells that have emptied
+            if (2 * (used + 1) > keys.size()) {
+              rebuild(n);
+              break;
+            }
+            link(uint32_t(i), new_key[i]);
+            ++reinserted;
+          }
+        }
+        large.clear();
+        for (size_t i = 0; i < n; ++i)
+          if (new_key[i] == oversized)
+            large.push_back(uint32_t(i));
+      }
+
+      // Table slots, then one slice per oversized object
+      size_t sliceCount() const {
+        return keys.size() + large.size();
+      }
+      void collect(size_t begin, size_t end, std::vector<BroadphasePair>& pairs) const {
+        size_t slots = keys.size();
+        for (size_t s = begin; s < end and s < slots; ++s) {
+          uint32_t head = heads[s];
+          if (keys[s] == empty or head == none)
+            continue;
+          for (uint32_t i = head; i != none; i = next[i])
+            for (uint32_t j = next[i]; j != none; j = next[j])
+              if (overlaps(i, j))
+                Base::report(i, j, pairs);
+          uint64_t key = keys[s];
+          int64_t cx = int64_t(key >> 42) - bias, cy = int64_t(key >> 21 & axis_mask) - bias, cz = int64_t(key & axis_mask) - bias;
+          for (int k = 14; k < 27; ++k) {
+            uint32_t other = headOf(pack(cx + k / 9 - 1, cy + k / 3 % 3 - 1, cz + k % 3 - 1));
+            if (other == none)
+              continue;
+            for (uint32_t i = head; i != none; i = next[i])
+              for (uint32_t j = other; j != none; j = next[j])
+                if (overlaps(i, j))
+                  Base::report(i, j, pairs);
+          }
+        }
+        size_t n = this->size();
+        for (size_t l = (begin > slots ? begin : slots); l < end; ++l) {
+          // Against every grid object, and against later oversized ones
+          uint32_t i = large[l - slots];
+          for (uint32_t j = 0; j < n; ++j)
+            if (j != i and (object_key[j] != oversized or j > i) and overlaps(i, j))
+              Base::report(i, j, pairs);
+        }
+      }
+  };
+
+  // Sweep and prune along the axis where the centres spread the most. Intervals
+  // stay sorted between frames, so the re-sort after small motions is an
+  // insertion sort that costs little more than a pass. Positions are gathered in
+  // sorted order so the sweep reads memory sequentially. Each object is tested
+  // against every interval starting within its own, which in a uniformly filled
+  // volume grows as n^(2/3); prefer the spatial hash there, and this for scenes
+  // spread out along one axis
+  template <typename num_type = float>
+  class SweepAndPruneBroadphase : public Broadphase<SweepAndPruneBroadphase<num_type>, num_type> {
+    typedef Broadphase<SweepAndPruneBroadphase<num_type>, num_type> Base;
+    friend Base;
+    using Base::x;
+    using Base::y;
+    using Base::z;
+    using Base::r;
+
+    public :
+      SweepAndPruneBroadphase() : axis(0), full_sorts(0) {}
+
+      // 0, 1 or 2 for x, y or z
+      int sweepAxis() const {
+        return axis;
+      }
+      // Updates that fell back to a full sort, after an axis change or large motions
+      size_t fullSorts() const {
+        return full_sorts;
+      }
+
+    private :
+      int axis;
+      size_t full_sorts;
+      std::vector<uint32_t> order;
+      std::vector<num_type> lo;
+      // In sorted order
+      std::vector<num_type> sorted_lo, sorted_hi, sorted_x, sorted_y, sorted_z, sorted_r;
+
+      const std::vector<num_type>& coordinate(int a) const {
+        return a == 0 ? x : (a == 1 ? y : z);
+      }
+      int widestAxis() const {
+        size_t n = this->size();
+        if (n == 0)
+          return axis;
+        double spread[3];
+        for (int a = 0; a < 3; ++a) {
+          const std::vector<num_type>& c = coordinate(a);
+          double sum = 0, sqr_sum = 0;
+          for (size_t i = 0; i < n; ++i) {
+            sum += double(c[i]);
+            sqr_sum += double(c[i]) * double(c[i]);
+          }
+          spread[a] = sqr_sum / n - (sum / n) * (sum / n);
+        }
+        // Only switch for a clear gain, since switching costs a full sort
+        int best = axis;
+        for (int a = 0; a < 3; ++a)
+          if (spread[a] > 1.5 * spread[best])
+            best = a;
+        return best;
+      }
+
+      void refresh(unsigned threads) {
+        size_t n = this->size();
+        int new_axis = widestAxis();
+        bool full = new_axis != axis or order.size() != n;
+        axis = new_axis;
+        const std::vector<num_type>& c = coordinate(axis);
+        lo.resize(n);
+        parallelChunks(n, threads, Base::min_chunk, [&](size_t begin, size_t end) {
+          for (size_t i = begin; i < end; ++i)
+            lo[i] = c[i] - r[i];
+        });
+        if (not full) {
+          // Insertion sort, giving up once it has shifted several times the element count
+          size_t budget = 8 * n + 64;
+          for (size_t k = 1; k < n and not full; ++k) {
+            uint32_t o = order[k];
+            num_type key = lo[o];
+            size_t m = k;
+            while (m > 0 and lo[order[m - 1]] > key) {
+              order[m] = order[m - 1];
+              --m;
+              if (--budget == 0) {
+                full = true;
+                break;
+              }
+            }
+            order[m] = o;
+          }
+        }
+        if (full) {
+          ++full_sorts;
+          if (order.size() != n) {
+            order.resize(n);
+            for (size_t i = 0; i < n; ++i)
+              order[i] = uint32_t(i);
+          }
+          std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return lo[a] < lo[b]; });
+        }
+        sorted_lo.resize(n);
+        sorted_hi.resize(n);
+        sorted_x.resize(n);
+        sorted_y.resize(n);
+        sorted_z.resize(n);
+        sorted_r.resize(n);
+        parallelChunks(n, threads, Base::min_chunk, [&](size_t begin, size_t end) {
+          for (size_t k = begin; k < end; ++k) {
+            uint32_t o = order[k];
+            sorted_lo[k] = lo[o];
+            sorted_hi[k] = c[o] + r[o];
+            sorted_x[k] = x[o];
+            sorted_y[k] = y[o];
+            sorted_z[k] = z[o];
+            sorted_r[k] = r[o];
+          }
+        });
+      }
+
+      size_t sliceCount() const {
+        return this->size();
+      }
+      // [begin, end) are positions in sorted order; each owns the pairs it starts
+      void collect(size_t begin, size_t end, std::vector<BroadphasePair>& pairs) const {
+        const size_t block = 64;
+        uint8_t hit[block];
+        for (size_t k = begin; k < end; ++k) {
+          num_type hi = sorted_hi[k], px = sorted_x[k], py = sorted_y[k], pz = sorted_z[k], pr = sorted_r[k];
+          size_t last = std::upper_bound(sorted_lo.begin() + k + 1, sorted_lo.end(), hi) - sorted_lo.begin();
+          // Branch-free tests a block at a time, which the compiler can vectorize
+          for (size_t m = k + 1; m < last; m += block) {
+            size_t count = last - m < block ? last - m : block;
+            for (size_t t = 0; t < count; ++t) {
+              num_type dx = px - sorted_x[m + t], dy = py - sorted_y[m + t], dz = pz - sorted_z[m + t], s = pr + sorted_r[m + t];
+              hit[t] = dx * dx + dy * dy + dz * dz < s * s;
+            }
+            for (size_t t = count; t % 8 != 0; ++t)
+              hit[t] = 0;
+            // Hits are rare, so skip eight misses at a time
+            for (size_t t = 0; t < count; t += 8) {
+              uint64_t word;
+              memcpy(&word, hit + t, 8);
+              if (word != 0)
+                for (size_t u = t; u < t + 8; ++u)
+                  if (hit[u])
+                    Base::report(order[k], order[m + u], pairs);
+            }
+          }
+        }
+      }
+  };
+
+#endif
@@ -0,0 +1,197 @@
+#if !defined(RIGID_BODY_H_INCLUDED)
+  #define RIGID_BODY_H_INCLUDED
+
+  #include <vector>
+  #include "../math/rotator.h"
+  #include "../math/vector_array.h"
+  #include "../math/quaternion_array.h"
+  #include "../core/parallel.h"
+
+  // Rigid bodies stored as structure-of-arrays, one lane per component, so the
+  // integrators stream through whole registers of bodies at a time. Bodies are
+  // addressed by index; force and torque accumulate between steps and each step
+  // clears them.
+  //
+  // Angular velocity is in world space and inverse_inertia is the diagonal of the
+  // inverse inertia tensor in the body's principal frame. Torque is turned into
+  // angular acceleration through the current orientation; the gyroscopic term
+  // is left out, which is the usual trade for stability in games.
+  template <typename num_type = float>
+  class RigidBodies {
+    public :
+      // Smallest share of the bodies worth giving to another thread
+      static constexpr size_t min_chunk = 8192;
+
+      Vector3Array<num_type> position;
+      Vector3Array<num_type> velocity;
+      QuaternionArray<num_type> orientation;
+      Vector3Array<num_type> angular_velocity;
+      Vector3Array<num_type> force;
+      Vector3Array<num_type> torque;
+      Vector3Array<num_type> inverse_inertia;
+      std::vector<num_type> inverse_mass;
+      Vector3<num_type> gravity;
+
+      RigidBodies() : gravity(num_type(0), num_type(0), num_type(-9.81)) {}
+
+      size_t size() const {
+        return position.size();
+      }
+      // Zero mass makes a static body, which gravity and forces leave in place.
+      // inertia is the diagonal of the inertia tensor in the body's principal frame
+      size_t add(const Vector3<num_type>& pos, const QuaternionRotator<num_type>& rot, num_type mass,
+                 const Vector3<num_type>& inertia, const Vector3<num_type>& vel = Vector3<num_type>(),
+                 const Vector3<num_type>& ang_vel = Vector3<num_type>()) {
+        position.append(pos);
+        velocity.append(vel);
+        orientation.append(rot.normalized());
+        angular_velocity.append(ang_vel);
+        force.append(Vector3<num_type>());
+        torque.append(Vector3<num_type>());
+        bool dynamic = mass > 0;
+        inverse_inertia.append(Vector3<num_type>(dynamic and inertia.x > 0 ? 1 / inertia.x : num_type(0),
+                                                 dynamic and inertia.y > 0 ? 1 / inertia.y : num_type(0),
+                                                 dynamic and inertia.z > 0 ? 1 / inertia.z : num_type(0)));
+        inverse_mass.push_back(dynamic ? 1 / mass : num_type(0));
+        return size() - 1;
+      }
+      // Inertia diagonals of common shapes, for add
+      static Vector3<num_type> boxInertia(num_type mass, const Vector3<num_type>& half_extents) {
+        Vector3<num_type> s(half_extents.x * half_extents.x, half_extents.y * half_extents.y, half_extents.z * half_extents.z);
+        num_type k = mass / 3;
+        return Vector3<num_type>(k * (s.y + s.z), k * (s.x + s.z), k * (s.x + s.y));
+      }
+      static Vector3<num_type> sphereInertia(num_type mass, num_type radius) {
+        num_type i = num_type(0.4) * mass * radius * radius;
+        return Vector3<num_type>(i, i, i);
+      }
+
+      void applyForce(size_t i, const Vector3<num_type>& f) {
+        force.x[i] += f.x; force.y[i] += f.y; force.z[i] += f.z;
+      }
+      void applyTorque(size_t i, const Vector3<num_type>& t) {
+        torque.x[i] += t.x; torque.y[i] += t.y; torque.z[i] += t.z;
+      }
+      // Force at a world space point, which also produces a torque about the centre of mass
+      void applyForceAt(size_t i, const Vector3<num_type>& f, const Vector3<num_type>& point) {
+        applyForce(i, f);
+        applyTorque(i, point.from(position.get(i)).crossProduct(f));
+      }
+      void applyImpulse(size_t i, const Vector3<num_type>& impulse) {
+        num_type im = inverse_mass[i];
+        velocity.x[i] += impulse.x * im; velocity.y[i] += impulse.y * im; velocity.z[i] += impulse.z * im;
+      }
+
+      // Semi-implicit Euler: velocities first, then positions from the new
+      // velocities. First order, but symplectic, so orbits and springs keep their energy
+      void integrate(num_type dt, unsigned threads = 1) {
+        step<false>(dt, threads);
+      }
+      // Velocity Verlet with the acceleration held over the step, x += v dt + a dt^2 / 2.
+      // Exact under constant forces such as gravity, where semi-implicit Euler
+      // overshoots by a dt^2 / 2 per step
+      void integrateVerlet(num_type dt, unsigned threads = 1) {
+        step<true>(dt, threads);
+      }
+
+    private :
+      // Rotates (x, y, z) by the unit quaternion (w, u), or by its conjugate when u
+      // is negated, through v + w t + u x t with t = 2 (u x v)
+      template <class L>
+      static void rotateLane(typename L::reg w, typename L::reg ux, typename L::reg uy, typename L::reg uz,
+                             typename L::reg& x, typename L::reg& y, typename L::reg& z) {
+        typename L::reg tx = L::negMulAdd(uz, y, L::mul(uy, z));
+        typename L::reg ty = L::negMulAdd(ux, z, L::mul(uz, x));
+        typename L::reg tz = L::negMulAdd(uy, x, L::mul(ux, y));
+        tx = L::add(tx, tx); ty = L::add(ty, ty); tz = L::add(tz, tz);
+        typename L::reg cx = L::negMulAdd(uz, ty, L::mul(uy, tz));
+        typename L::reg cy = L::negMulAdd(ux, tz, L::mul(uz, tx));
+        typename L::reg cz = L::negMulAdd(uy, tx, L::mul(ux, ty));
+        x = L::add(L::mulAdd(w, tx, x), cx);
+        y = L::add(L::mulAdd(w, ty, y), cy);
+        z = L::add(L::mulAdd(w, tz, z), cz);
+      }
+
+      template <bool verlet>
+      void step(num_type dt, unsigned threads) {
+        parallelChunks(size(), threads, min_chunk, [&](size_t begin, size_t end) {
+          stepRange<verlet>(dt, begin, end);
+        });
+      }
+
+      template <bool verlet>
+      void stepRange(num_type dt, size_t begin, size_t end) {
+        num_type *px = position.x + begin, *py = position.y + begin, *pz = position.z + begin;
+        num_type *vx = velocity.x + begin, *vy = velocity.y + begin, *vz = velocity.z + begin;
+        num_type *qw = orientation.w + begin, *qx = orientation.x + begin, *qy = orientation.y + begin, *qz = orientation.z + begin;
+        num_type *wx = angular_velocity.x + begin, *wy = angular_velocity.y + begin, *wz = angular_velocity.z + begin;
+        num_type *fx = force.x + begin, *fy = force.y + begin, *fz = force.z + begin;
+        num_type *tx = torque.x + begin, *ty = torque.y + begin, *tz = torque.z + begin;
+        const num_type *ix = inverse_inertia.x + begin, *iy = inverse_inertia.y + begin, *iz = inverse_inertia.z + begin;
+        const num_type* im = inverse_mass.data() + begin;
+        Vector3<num_type> g = gravity;
+        forEachLane<num_type>(end - begin, [&](auto lanes, size_t i) {
+          typedef decltype(lanes) L;
+          typename L::reg zero = L::set(0), h = L::set(dt);
+          // Linear; gravity only acts on dynamic bodies
+          typename L::reg m = L::load(im + i);
+          typename L::mask dynamic = L::greater(m, zero);
+          typename L::reg ax = L::mulAdd(L::load(fx + i), m, L::select(dynamic, L::set(g.x), zero));
+          typename L::reg ay = L::mulAdd(L::load(fy + i), m, L::select(dynamic, L::set(g.y), zero));
+          typename L::reg az = L::mulAdd(L::load(fz + i), m, L::select(dynamic, L::set(g.z), zero));
+          typename L::reg v_x = L::load(vx + i), v_y = L::load(vy + i), v_z = L::load(vz + i);
+          if (verlet) {
+            typename L::reg half_h2 = L::set(dt * dt / 2);
+            L::store(px + i, L::mulAdd(ax, half_h2, L::mulAdd(v_x, h, L::load(px + i))));
+            L::store(py + i, L::mulAdd(ay, half_h2, L::mulAdd(v_y, h, L::load(py + i))));
+            L::store(pz + i, L::mulAdd(az, half_h2, L::mulAdd(v_z, h, L::load(pz + i))));
+          }
+          v_x = L::mulAdd(ax, h, v_x);
+          v_y = L::mulAdd(ay, h, v_y);
+          v_z = L::mulAdd(az, h, v_z);
+          if (not verlet) {
+            L::store(px + i, L::mulAdd(v_x, h, L::load(px + i)));
+            L::store(py + i, L::mulAdd(v_y, h, L::load(py + i)));
+            L::store(pz + i, L::mulAdd(v_z, h, L::load(pz + i)));
+          }
+          L::store(vx + i, v_x);
+          L::store(vy + i, v_y);
+          L::store(vz + i, v_z);
+
+          // Angular acceleration R I^-1 R^T torque
+          typename L::reg w = L::load(qw + i), ux = L::load(qx + i), uy = L::load(qy + i), uz = L::load(qz + i);
+          typename L::reg t_x = L::load(tx + i), t_y = L::load(ty + i), t_z = L::load(tz + i);
+          rotateLane<L>(w, L::sub(zero, ux), L::sub(zero, uy), L::sub(zero, uz), t_x, t_y, t_z);
+          t_x = L::mul(t_x, L::load(ix + i));
+          t_y = L::mul(t_y, L::load(iy + i));
+          t_z = L::mul(t_z, L::load(iz + i));
+          rotateLane<L>(w, ux, uy, uz, t_x, t_y, t_z);
+          typename L::reg w_x = L::mulAdd(t_x, h, L::load(wx + i));
+          typename L::reg w_y = L::mulAdd(t_y, h, L::load(wy + i));
+          typename L::reg w_z = L::mulAdd(t_z, h, L::load(wz + i));
+          L::store(wx + i, w_x);
+          L::store(wy + i, w_y);
+          L::store(wz + i, w_z);
+
+          // q += dt / 2 (0, omega) q, then one Newton step towards unit length,
+          // q (3 - |q|^2) / 2, which is plenty for the small drift of one step
+          typename L::reg k = L::set(dt / 2);
+          w_x = L::mul(w_x, k); w_y = L::mul(w_y, k); w_z = L::mul(w_z, k);
+          typename L::reg nw = L::negMulAdd(w_z, uz, L::negMulAdd(w_y, uy, L::negMulAdd(w_x, ux, w)));
+          typename L::reg nx = L::add(ux, L::negMulAdd(w_z, uy, L::mulAdd(w_y, uz, L::mul(w_x, w))));
+          typename L::reg ny = L::add(uy, L::negMulAdd(w_x, uz, L::mulAdd(w_z, ux, L::mul(w_y, w))));
+          typename L::reg nz = L::add(uz, L::negMulAdd(w_y, ux, L::mulAdd(w_x, uy, L::mul(w_z, w))));
+          typename L::reg sqr = L::mulAdd(nz, nz, L::mulAdd(ny, ny, L::mulAdd(nx, nx, L::mul(nw, nw))));
+          typename L::reg r = L::mul(L::sub(L::set(3), sqr), L::set(num_type(0.5)));
+          L::store(qw + i, L::mul(nw, r));
+          L::store(qx + i, L::mul(nx, r));
+          L::store(qy + i, L::mul(ny, r));
+          L::store(qz + i, L::mul(nz, r));
+
+          L::store(fx + i, zero); L::store(fy + i, zero); L::store(fz + i, zero);
+          L::store(tx + i, zero); L::store(ty + i, zero); L::store(tz + i, zero);
+        });
+      }
+  };
+
+#endif
@@ -0,0 +1,95 @@
+#if !defined(FRAMEBUFFER_H_INCLUDED)
+  #define FRAMEBUFFER_H_INCLUDED
+
+  #include <algorithm>
+  #include <fstream>
+  #include <stdint.h>
+  #include <string>
+  #include <vector>
+
+  // 0xRRGGBB
+  inline uint32_t packColor(uint8_t r, uint8_t g, uint8_t b) {
+    return uint32_t(r) << 16 | uint32_t(g) << 8 | b;
+  }
+
+  // Color and depth planes in memory. Both are padded to whole 8x8 blocks, so the
+  // rasterizer can write full blocks along the right and bottom edges, and each
+  // block keeps the largest depth in it for hierarchical rejection
+  class Framebuffer {
+    public :
+      static constexpr int block_size = 8;
+
+      std::vector<uint32_t> color;
+      std::vector<float> depth;
+      // Per block, no less than any depth in the block
+      std::vector<float> block_max_depth;
+
+      Framebuffer(int width = 0, int height = 0) {
+        resize(width, height);
+      }
+
+      void resize(int width, int height) {
+        w = width > 0 ? width : 0;
+        h = height > 0 ? height : 0;
+        blocks_x = (w + block_size - 1) / block_size;
+        blocks_y = (h + block_size - 1) / block_size;
+        color.assign(size_t(stride()) * blocks_y * block_size, 0);
+        depth.assign(color.size(), 1.0f);
+        block_max_depth.assign(size_t(blocks_x) * blocks_y, 1.0f);
+      }
+      void clear(uint32_t clear_color = 0, float clear_depth = 1) {
+        std::fill(color.begin(), color.end(), clear_color);
+        std::fill(depth.begin(), depth.end(), clear_depth);
+        std::fill(block_max_depth.begin(), block_max_depth.end(), clear_depth);
+      }
+
+      int width() const {
+        return w;
+      }
+      int height() const {
+        return h;
+      }
+      // Elements per row of color and depth
+      int stride() const {
+        return blocks_x * block_size;
+      }
+      int blocksX() const {
+        return blocks_x;
+      }
+      int blocksY() const {
+        return blocks_y;
+      }
+      uint32_t pixel(int x, int y) const {
+        return color[size_t(y) * stride() + x];
+      }
+      float depthAt(int x, int y) const {
+        return depth[size_t(y) * stride() + x];
+      }
+
+      // Binary PPM (P6); returns false if the file can't be written
+      bool savePPM(const std::string& path) const {
+        std::ofstream out(path.c_str(), std::ios::binary);
+        if (not out)
+          return false;
+        writePPM(out);
+        return bool(out);
+      }
+      void writePPM(std::ostream& out) const {
+        out << "P6\n" << w << " " << h << "\n255\n";
+        std::vector<char> row(size_t(w) * 3);
+        for (int y = 0; y < h; ++y) {
+          for (int x = 0; x < w; ++x) {
+            uint32_t c = pixel(x, y);
+            row[x * 3] = char(c >> 16);
+            row[x * 3 + 1] = char(c >> 8);
+            row[x * 3 + 2] = char(c);
+          }
+          out.write(row.data(), std::streamsize(row.size()));
+        }
+      }
+
+    private :
+      int w, h, blocks_x, blocks_y;
+  };
+
+#endif
@@ -0,0 +1,475 @@
+#if !defined(RASTERIZER_H_INCLUDED)
+  #define RASTERIZER_H_INCLUDED
+
+  #include <algorithm>
+  #include <atomic>
+  #include <chrono>
+  #include <math.h>
+  #include <stdint.h>
+  #include <vector>
+  #include "../math/transform.h"
+  #include "../core/parallel.h"
+  #include "framebuffer.h"
+
+  // Counters and phase times of the last Rasterizer frame
+  struct RasterStats {
+    size_t triangles;
+    // Back facing, degenerate or outside the view
+    size_t culled;
+    // Crossing the near plane, each clipped into one or two triangles
+    size_t clipped;
+    // Triangle and tile pairs after binning
+    size_t tile_entries;
+    // Of the tile entries, those behind everything already drawn in the tile
+    size_t tiles_rejected;
+    // 8x8 blocks that a triangle covers at least partly, and how many of those the
+    // per-block maximum depth rejected without touching a pixel
+    size_t blocks;
+    size_t blocks_rejected;
+    size_t pixels;
+    double vertex_ms, setup_ms, binning_ms, raster_ms;
+
+    RasterStats() : triangles(0), culled(0), clipped(0), tile_entries(0), tiles_rejected(0), blocks(0), blocks_rejected(0), pixels(0),
+                    vertex_ms(0), setup_ms(0), binning_ms(0), raster_ms(0) {}
+    double totalMs() const {
+      return vertex_ms + setup_ms + binning_ms + raster_ms;
+    }
+    double trianglesPerSecond() const {
+      return totalMs() > 0 ? triangles / totalMs() * 1000 : 0;
+    }
+  };
+
+  // Tiled software rasterizer for headless rendering. draw() transforms vertices
+  // to clip space and queues triangles; render() then
+  //  - sets triangles up in parallel chunks: frustum culling, near plane clipping,
+  //    back face culling, screen positions snapped to 1/16 pixel, edge functions
+  //    and a depth plane,
+  //  - bins each chunk's triangles into 64x64 pixel screen tiles,
+  //  - rasterizes tiles in parallel, each tile walking the chunks in submission
+  //    order, so the image doesn't depend on the thread count.
+  // Depth rejection is hierarchical: a triangle is dropped from a tile when it lies
+  // behind the largest depth in the tile, then goes 8x8 block by block, with
+  // blocks tested against the edges at their corners and against the
+  // framebuffer's per-block maximum depth before any pixel is touched. The pixels
+  // of a block row are then tested and written a whole SIMD register at a time.
+  //
+  // Shading is one flat color per triangle; depth is OpenGL style, -1 to 1 in
+  // clip space mapped to 0 to 1, with smaller depths in front.
+  class Rasterizer {
+    public :
+      static constexpr int tile_size = 64;
+      // Smallest share of the triangles worth giving to another thread
+      static constexpr size_t min_chunk = 4096;
+
+      bool cull_backfaces;
+
+      Rasterizer() : cull_backfaces(true) {}
+
+      // Drops queued triangles and starts new stats
+      void begin() {
+        vertices.clear();
+        triangles.clear();
+        stats = RasterStats();
+      }
+      // Queues indexed triangles with positions transformed by transform, usually
+      // projection * view * model. Triangles counter-clockwise on screen face the
+      // camera. triangle_colors, when given, has a color per triangle instead of color
+      template <typename num_type>
+      void draw(const Vector3<num_type>* positions, size_t vertex_count, const uint32_t* indices, size_t index_count,
+                const Matrix4x4<num_type>& transform, uint32_t color, const uint32_t* triangle_colors = nullptr) {
+        clock::time_point start = clock::now();
+        uint32_t base = uint32_t(vertices.size());
+        vertices.resize(base + vertex_count);
+        const num_type (*m)[4] = transform.matrix;
+        for (size_t i = 0; i < vertex_count; ++i) {
+          const Vector3<num_type>& p = positions[i];
+          ClipVertex& v = vertices[base + i];
+          v.x = float(m[0][0] * p.x + m[0][1] * p.y + m[0][2] * p.z + m[0][3]);
+          v.y = float(m[1][0] * p.x + m[1][1] * p.y + m[1][2] * p.z + m[1][3]);
+          v.z = float(m[2][0] * p.x + m[2][1] * p.y + m[2][2] * p.z + m[2][3]);
+          v.w = float(m[3][0] * p.x + m[3][1] * p.y + m[3][2] * p.z + m[3][3]);
+        }
+        for (size_t t = 0; t + 2 < index_count; t += 3) {
+          QueuedTriangle tri = {{base + indices[t], base + indices[t + 1], base + indices[t + 2]},
+                                triangle_colors ? triangle_colors[t / 3] : color};
+          triangles.push_back(tri);
+        }
+        stats.triangles += index_count / 3;
+        stats.vertex_ms += milliseconds(start);
+      }
+      template <typename num_type>
+      void draw(const std::vector<Vector3<num_type>>& positions, const std::vector<uint32_t>& indices,
+                const Matrix4x4<num_type>& transform, uint32_t color) {
+        draw(positions.data(), positions.size(), indices.data(), indices.size(), transform, color);
+      }
+
+      // Rasterizes everything queued since begin() over what target already holds.
+      // Rendering the same queue again starts the setup, binning and raster stats over
+      void render(Framebuffer& target, unsigned threads = 1) {
+        RasterStats queued = stats;
+        stats = RasterStats();
+        stats.triangles = queued.triangles;
+        stats.vertex_ms = queued.vertex_ms;
+        target_buffer = &target;
+        tiles_x = (target.width() + tile_size - 1) / tile_size;
+        tiles_y = (target.height() + tile_size - 1) / tile_size;
+        size_t n = triangles.size();
+        size_t chunk_count = (n + min_chunk - 1) / min_chunk;
+        chunk_count = std::max<size_t>(1, std::min<size_t>(chunk_count, threads == 0 ? 1 : threads));
+        chunks.resize(chunk_count);
+
+        clock::time_point start = clock::now();
+        parallelTasks(chunk_count, threads, [&](size_t c) {
+          setupRange(chunks[c], n * c / chunk_count, n * (c + 1) / chunk_count);
+        });
+        stats.setup_ms = milliseconds(start);
+
+        start = clock::now();
+        parallelTasks(chunk_count, threads, [&](size_t c) { binChunk(chunks[c]); });
+        for (const Chunk& chunk : chunks) {
+          stats.culled += chunk.culled;
+          stats.clipped += chunk.clipped;
+          stats.tile_entries += chunk.entries;
+        }
+        stats.binning_ms = milliseconds(start);
+
+        start = clock::now();
+        std::atomic<size_t> tiles_rejected(0), blocks(0), blocks_rejected(0), pixels(0);
+        parallelTasks(size_t(tiles_x) * tiles_y, threads, [&](size_t tile) {
+          TileCounters counters = {0, 0, 0, 0};
+          rasterTile(int(tile), counters);
+          tiles_rejected += counters.tiles_rejected;
+          blocks += counters.blocks;
+          blocks_rejected += counters.blocks_rejected;
+          pixels += counters.pixels;
+        });
+        stats.tiles_rejected = tiles_rejected;
+        stats.blocks = blocks;
+        stats.blocks_rejected = blocks_rejected;
+        stats.pixels = pixels;
+        stats.raster_ms = milliseconds(start);
+      }
+
+      const RasterStats& lastStats() const {
+        return stats;
+      }
+
+    private :
+      typedef std::chrono::steady_clock clock;
+
+      struct ClipVertex {
+        float x, y, z, w;
+      };
+      struct QueuedTriangle {
+        uint32_t v[3];
+        uint32_t color;
+      };
+      // Edge i runs from (x[i], y[i]) and is a[i] (px - x[i]) + b[i] (py - y[i]),
+      // positive inside. A pixel on an edge belongs to the triangle whose bias for
+      // it is negative, so of two triangles sharing an edge exactly one draws it.
+      // Depth is z0 + dzdx (px - x[0]) + dzdy (py - y[0])
+      struct SetupTriangle {
+        float x[3], y[3];
+        float a[3], b[3], bias[3];
+        float z0, dzdx, dzdy, z_min;
+        int min_x, min_y, max_x, max_y;
+        uint32_t color;
+      };
+      struct Chunk {
+        std::vector<SetupTriangle> setup;
+        // Per tile, indices into setup
+        std::vector<std::vector<uint32_t>> bins;
+        size_t culled, clipped, entries;
+      };
+      struct TileCounters {
+        size_t tiles_rejected, blocks, blocks_rejected, pixels;
+      };
+
+      std::vector<ClipVertex> vertices;
+      std::vector<QueuedTriangle> triangles;
+      std::vector<Chunk> chunks;
+      Framebuffer* target_buffer;
+      int tiles_x, tiles_y;
+      RasterStats stats;
+
+      static double milliseconds(clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(clock::now() - start).count();
+      }
+
+      void setupRange(Chunk& chunk, size_t begin, size_t end) {
+        chunk.setup.clear();
+        chunk.culled = chunk.clipped = 0;
+        for (size_t t = begin; t < end; ++t) {
+          const QueuedTriangle& tri = triangles[t];
+          ClipVertex v[3] = {vertices[tri.v[0]], vertices[tri.v[1]], vertices[tri.v[2]]};
+          int outside_all = 63, outside_any = 0;
+          for (int i = 0; i < 3; ++i) {
+            int code = outcode(v[i]);
+            outside_all &= code;
+            outside_any |= code;
+          }
+          if (outside_all != 0) {
+            ++chunk.culled;
+            continue;
+          }
+          bool kept;
+          if (outside_any & near_plane) {
+            ++chunk.clipped;
+            ClipVertex polygon[4];
+            int count = clipNear(v, polygon);
+            kept = count >= 3 and setup(chunk, polygon[0], polygon[1], polygon[2], tri.color);
+            if (count == 4)
+              kept = setup(chunk, polygon[0], polygon[2], polygon[3], tri.color) or kept;
+          }
+          else
+            kept = setup(chunk, v[0], v[1], v[2], tri.color);
+          if (not kept)
+            ++chunk.culled;
+        }
+      }
+
+      static constexpr int near_plane = 16;
+      static int outcode(const ClipVertex& v) {
+        return (v.x < -v.w) | (v.x > v.w) << 1 | (v.y < -v.w) << 2 | (v.y > v.w) << 3 | (v.z < -v.w) << 4 | (v.z > v.w) << 5;
+      }
+      // Clips against z >= -w, giving a polygon of 3 or 4 vertices (or fewer when nothing is left)
+      static int clipNear(const ClipVertex v[3], ClipVertex out[4]) {
+        int count = 0;
+        for (int i = 0; i < 3; ++i) {
+          const ClipVertex& a = v[i];
+          const ClipVertex& b = v[(i + 1) % 3];
+          float d_a = a.z + a.w, d_b = b.z + b.w;
+          if (d_a >= 0)
+            out[count++] = a;
+          if ((d_a >= 0) != (d_b >= 0)) {
+            float t = d_a / (d_a - d_b);
+            out[count++] = {a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t, a.w + (b.w - a.w) * t};
+          }
+        }
+        return count;
+      }
+
+      // Projects and sets up one triangle; false when it's culled
+      bool setup(Chunk& chunk, const ClipVertex& v_0, const ClipVertex& v_1, const ClipVertex& v_2, uint32_t color) {
+        const ClipVertex* v[3] = {&v_0, &v_1, &v_2};
+        float width = float(target_buffer->width()), height = float(target_buffer->height());
+        float sx[3], sy[3], sz[3];
+        for (int i = 0; i < 3; ++i) {
+          if (not (v[i]->w > 0))
+            return false;
+          float inv_w = 1 / v[i]->w;
+          sx[i] = floorf((v[i]->x * inv_w * 0.5f + 0.5f) * width * 16 + 0.5f) / 16;
+          sy[i] = floorf((0.5f - v[i]->y * inv_w * 0.5f) * height * 16 + 0.5f) / 16;
+          sz[i] = v[i]->z * inv_w * 0.5f + 0.5f;
+        }
+        // Twice the signed area; negative for triangles counter-clockwise on screen
+        double area = double(sx[1] - sx[0]) * (sy[2] - sy[0]) - double(sx[2] - sx[0]) * (sy[1] - sy[0]);
+        if (area == 0 or (area > 0 and cull_backfaces))
+          return false;
+        if (area > 0) {
+          std::swap(sx[1], sx[2]);
+          std::swap(sy[1], sy[2]);
+          std::swap(sz[1], sz[2]);
+          area = -area;
+        }
+
+        SetupTriangle tri;
+        tri.min_x = std::max(0, int(floorf(std::min(sx[0], std::min(sx[1], sx[2])))));
+        tri.min_y = std::max(0, int(floorf(std::min(sy[0], std::min(sy[1], sy[2])))));
+        tri.max_x = std::min(target_buffer->width() - 1, int(floorf(std::max(sx[0], std::max(sx[1], sx[2])))));
+        tri.max_y = std::min(target_buffer->height() - 1, int(floorf(std::max(sy[0], std::max(sy[1], sy[2])))));
+        if (tri.min_x > tri.max_x or tri.min_y > tri.max_y)
+          return false;
+        for (int i = 0; i < 3; ++i) {
+          int j = (i + 1) % 3;
+          tri.x[i] = sx[i];
+          tri.y[i] = sy[i];
+          tri.a[i] = sy[j] - sy[i];
+          tri.b[i] = sx[i] - sx[j];
+          // Edge values at pixel centres are multiples of 1 / 256 between snapped vertices
+          bool owner = tri.a[i] > 0 or (tri.a[i] == 0 and tri.b[i] < 0);
+          tri.bias[i] = owner ? -1.0f / 512 : 0.0f;
+        }
+        float dx_1 = sx[1] - sx[0], dy_1 = sy[1] - sy[0], dz_1 = sz[1] - sz[0];
+        float dx_2 = sx[2] - sx[0], dy_2 = sy[2] - sy[0], dz_2 = sz[2] - sz[0];
+        float inv_area = float(1 / area);
+        tri.z0 = sz[0];
+        tri.dzdx = (dz_1 * dy_2 - dz_2 * dy_1) * inv_area;
+        tri.dzdy = (dx_1 * dz_2 - dx_2 * dz_1) * inv_area;
+        tri.z_min = std::min(sz[0], std::min(sz[1], sz[2]));
+        tri.color = color;
+        chunk.setup.push_back(tri);
+        return true;
+      }
+
+      // Largest value of edge e over the pixel centres of [x_0, x_1] x [y_0, y_1]
+      static double edgeMax(const SetupTriangle& tri, int e, int x_0, int y_0, int x_1, int y_1) {
+        double px = (tri.a[e] > 0 ? x_1 : x_0) + 0.5, py = (tri.b[e] > 0 ? y_1 : y_0) + 0.5;
+        return double(tri.a[e]) * (px - tri.x[e]) + double(tri.b[e]) * (py - tri.y[e]);
+      }
+      static double edgeMin(const SetupTriangle& tri, int e, int x_0, int y_0, int x_1, int y_1) {
+        double px = (tri.a[e] > 0 ? x_0 : x_1) + 0.5, py = (tri.b[e] > 0 ? y_0 : y_1) + 0.5;
+        return double(tri.a[e]) * (px - tri.x[e]) + double(tri.b[e]) * (py - tri.y[e]);
+      }
+
+      void binChunk(Chunk& chunk) {
+        size_t tile_count = size_t(tiles_x) * tiles_y;
+        chunk.bins.resize(tile_count);
+        for (std::vector<uint32_t>& bin : chunk.bins)
+          bin.clear();
+        chunk.entries = 0;
+        for (size_t t = 0; t < chunk.setup.size(); ++t) {
+          const SetupTriangle& tri = chunk.setup[t];
+          int tx_0 = tri.min_x / tile_size, tx_1 = tri.max_x / tile_size;
+          int ty_0 = tri.min_y / tile_size, ty_1 = tri.max_y / tile_size;
+          bool single = tx_0 == tx_1 and ty_0 == ty_1;
+          for (int ty = ty_0; ty <= ty_1; ++ty)
+            for (int tx = tx_0; tx <= tx_1; ++tx) {
+              if (not single) {
+                // Large triangles skip the tiles of their bounding box that an edge misses
+                int x_0 = tx * tile_size, y_0 = ty * tile_size;
+                bool outside = false;
+                for (int e = 0; e < 3 and not outside; ++e)
+                  outside = edgeMax(tri, e, x_0, y_0, x_0 + tile_size - 1, y_0 + tile_size - 1) <= tri.bias[e];
+                if (outside)
+                  continue;
+              }
+              chunk.bins[size_t(ty) * tiles_x + tx].push_back(uint32_t(t));
+              ++chunk.entries;
+            }
+        }
+      }
+
+      void rasterTile(int tile, TileCounters& counters) {
+        int x_0 = tile % tiles_x * tile_size, y_0 = tile / tiles_x * tile_size;
+        int x_1 = std::min(x_0 + tile_size, target_buffer->width()) - 1;
+        int y_1 = std::min(y_0 + tile_size, target_buffer->height()) - 1;
+        // Largest depth in the tile, refreshed from the blocks after each triangle that wrote something
+        float tile_max = tileMaxDepth(x_0, y_0, x_1, y_1);
+        for (const Chunk& chunk : chunks)
+          for (uint32_t t : chunk.bins[tile]) {
+            const SetupTriangle& tri = chunk.setup[t];
+            if (tri.z_min >= tile_max) {
+              ++counters.tiles_rejected;
+              continue;
+            }
+            size_t pixels = counters.pixels;
+            rasterTriangle(tri, std::max(x_0, tri.min_x), std::max(y_0, tri.min_y),
+                           std::min(x_1, tri.max_x), std::min(y_1, tri.max_y), counters);
+            if (counters.pixels != pixels)
+              tile_max = tileMaxDepth(x_0, y_0, x_1, y_1);
+          }
+      }
+      float tileMaxDepth(int x_0, int y_0, int x_1, int y_1) const {
+        const int s = Framebuffer::block_size;
+        const Framebuffer& fb = *target_buffer;
+        float result = 0;
+        for (int by = y_0 / s; by <= y_1 / s; ++by)
+          for (int bx = x_0 / s; bx <= x_1 / s; ++bx) {
+            float d = fb.block_max_depth[size_t(by) * fb.blocksX() + bx];
+            result = d > result ? d : result;
+          }
+        return result;
+      }
+
+      void rasterTriangle(const SetupTriangle& tri, int x_0, int y_0, int x_1, int y_1, TileCounters& counters) {
+        const int s = Framebuffer::block_size;
+        Framebuffer& fb = *target_buffer;
+        for (int by = y_0 / s; by <= y_1 / s; ++by)
+          for (int bx = x_0 / s; bx <= x_1 / s; ++bx) {
+            int px = bx * s, py = by * s;
+            bool outside = false, inside = true;
+            for (int e = 0; e < 3; ++e) {
+              outside = outside or edgeMax(tri, e, px, py, px + s - 1, py + s - 1) <= tri.bias[e];
+              inside = inside and edgeMin(tri, e, px, py, px + s - 1, py + s - 1) > tri.bias[e];
+            }
+            if (outside)
+              continue;
+            ++counters.blocks;
+            float& block_max = fb.block_max_depth[size_t(by) * fb.blocksX() + bx];
+            if (tri.z_min >= block_max) {
+              ++counters.blocks_rejected;
+              continue;
+            }
+            counters.pixels += inside ? rasterBlock<true>(tri, px, py, block_max) : rasterBlock<false>(tri, px, py, block_max);
+          }
+      }
+
+      // Depth tests and writes one 8x8 block a row at a time; with inside set, the
+      // whole block is known to be in the triangle and the edge tests are skipped.
+      // Pixels in the padding past the framebuffer's right and bottom edges are left
+      // alone. The block's largest depth is gathered on the way and stored if anything was written
+      template <bool inside>
+      size_t rasterBlock(const SetupTriangle& tri, int px, int py, float& block_max_depth) {
+        typedef SimdLanes<float> L;
+        typedef typename L::reg reg;
+        const int s = Framebuffer::block_size;
+        static const float offsets[s] = {0, 1, 2, 3, 4, 5, 6, 7};
+        Framebuffer& fb = *target_buffer;
+        size_t stride = size_t(fb.stride());
+        double centre_x = px + 0.5, centre_y = py + 0.5;
+        float edge_0[3];
+        reg a[3], bias[3];
+        for (int e = 0; e < 3; ++e) {
+          edge_0[e] = float(double(tri.a[e]) * (centre_x - tri.x[e]) + double(tri.b[e]) * (centre_y - tri.y[e]));
+          a[e] = L::set(tri.a[e]);
+          bias[e] = L::set(tri.bias[e]);
+        }
+        float z_0 = tri.z0 + tri.dzdx * float(centre_x - tri.x[0]) + tri.dzdy * float(centre_y - tri.y[0]);
+        reg dzdx = L::set(tri.dzdx), columns = L::set(float(std::min(s, fb.width() - px)));
+        bool clip_columns = px + s > fb.width();
+        int rows = std::min(s, fb.height() - py);
+        uint32_t c = tri.color;
+        size_t written = 0;
+        reg block_max = L::set(0);
+        for (int r = 0; r < rows; ++r) {
+          float* depth = &fb.depth[(py + r) * stride + px];
+          uint32_t* color = &fb.color[(py + r) * stride + px];
+          reg z_row = L::set(z_0 + tri.dzdy * float(r));
+          for (int i = 0; i < s; i += int(L::width)) {
+            reg x = L::load(offsets + i);
+            reg z = L::mulAdd(x, dzdx, z_row);
+            reg old = L::load(depth + i);
+            typename L::mask pass = L::less(z, old);
+            if (clip_columns)
+              pass = L::both(pass, L::less(x, columns));
+            if (not inside)
+              for (int e = 0; e < 3; ++e)
+                pass = L::both(pass, L::greater(L::mulAdd(x, a[e], L::set(edge_0[e] + tri.b[e] * float(r))), bias[e]));
+            int bits = L::bits(pass);
+            if (bits == 0) {
+              block_max = L::max(block_max, old);
+              continue;
+            }
+            reg result = L::select(pass, z, old);
+            block_max = L::max(block_max, result);
+            L::store(depth + i, result);
+            for (int k = 0; k < int(L::width); ++k)
+              if (bits & (1 << k))
+                color[i + k] = c;
+            written += popCount(bits);
+          }
+        }
+        if (written != 0) {
+          float lanes[L::width];
+          L::store(lanes, block_max);
+          block_max_depth = lanes[0];
+          for (size_t k = 1; k < L::width; ++k)
+            block_max_depth = lanes[k] > block_max_depth ? lanes[k] : block_max_depth;
+        }
+        return written;
+      }
+
+      static int popCount(int bits) {
+        #if defined(__GNUC__)
+          return __builtin_popcount(unsigned(bits));
+        #else
+          int c = 0;
+          for (; bits != 0; bits &= bits - 1)
+            ++c;
+          return c;
+        #endif
+      }
+  };
+
+#endif
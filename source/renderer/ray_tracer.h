@@ -0,0 +1,486 @@
+#if !defined(RAY_TRACER_H_INCLUDED)
+  #define RAY_TRACER_H_INCLUDED
+
+  #include <algorithm>
+  #include <atomic>
+  #include <chrono>
+  #include <limits>
+  #include <math.h>
+  #include <stdint.h>
+  #include <vector>
+  #include "../math/bvh.h"
+  #include "../math/simd.h"
+  #include "../math/transform.h"
+  #include "../core/parallel.h"
+  #include "framebuffer.h"
+
+  // Pinhole camera at position, looking along its forward (+y) axis with +z up and
+  // +x to the right, as the rest of the engine; orientation turns those axes into
+  // the world. fov_y is the vertical field of view in radians
+  struct RayCamera {
+    Vector3<float> position;
+    RotationMatrix<float> orientation;
+    float fov_y;
+
+    RayCamera() : position(0, 0, 0), fov_y(1) {}
+    RayCamera(const Vector3<float>& eye, const RotationMatrix<float>& rotation, float fov) : position(eye), orientation(rotation), fov_y(fov) {}
+    // Looking from eye at target, with up pointing to the top of the image as near as it can
+    static RayCamera lookAt(const Vector3<float>& eye, const Vector3<float>& target, const Vector3<float>& up, float fov) {
+      Vector3<float> forward = target.from(eye).normalized();
+      Vector3<float> right = forward.crossProduct(up).normalized();
+      Vector3<float> top = right.crossProduct(forward);
+      RotationMatrix<float> rotation;
+      float axes[3][3] = {{right.x, right.y, right.z}, {forward.x, forward.y, forward.z}, {top.x, top.y, top.z}};
+      for (int r = 0; r < 3; ++r)
+        for (int c = 0; c < 3; ++c)
+          rotation.matrix[r][c] = axes[c][r];
+      return RayCamera(eye, rotation, fov);
+    }
+  };
+
+  // Counters and time of the last RayTracer pass
+  struct RayTraceStats {
+    size_t passes;
+    size_t primary_rays;
+    size_t shadow_rays;
+    // Ray packets through the BVH, primary and shadow
+    size_t packets;
+    double build_ms, trace_ms;
+
+    RayTraceStats() : passes(0), primary_rays(0), shadow_rays(0), packets(0), build_ms(0), trace_ms(0) {}
+    double raysPerSecond() const {
+      return trace_ms > 0 ? (primary_rays + shadow_rays) / trace_ms * 1000 : 0;
+    }
+  };
+
+  // Progressive CPU ray tracer for reference images and offline work. draw()
+  // queues triangles in world space, build() puts a BVH over them, and each
+  // renderPass() traces one more sample per pixel and writes the running average
+  // to the framebuffer, so the first pass is already a complete (if aliased and
+  // hard shadowed) image and later ones antialias it and soften the shadows.
+  //
+  // Rays go in packets of one SIMD register, 4x2 pixels with AVX and 2x2 with
+  // SSE, which walk the BVH together: a node is opened when any ray in the packet
+  // reaches it, and the ray-triangle tests run across the lanes. The image is cut
+  // into 16x16 pixel tiles handed to threads as they finish the last, and the
+  // samples only depend on the pixel and the pass, not on the thread count.
+  //
+  // Shading is the triangle's color lit by a sun of angular radius sun_radius,
+  // with shadows, plus ambient light; rays that hit nothing take the sky color.
+  class RayTracer {
+    public :
+      static constexpr int tile_size = 16;
+
+      Vector3<float> sun_direction;
+      float sun_radius;
+      float sun_intensity;
+      float ambient;
+      uint32_t sky_color;
+
+      RayTracer() : sun_direction(0.4f, -0.3f, 0.85f), sun_radius(0.05f), sun_intensity(0.8f), ambient(0.25f),
+                    sky_color(packColor(150, 180, 220)), width(0), height(0), pass_count(0) {}
+
+      // Drops the scene and the accumulated image
+      void begin() {
+        triangles.clear();
+        bvh = BVH<float>();
+        stats = RayTraceStats();
+        reset();
+      }
+      // Queues indexed triangles with positions transformed by transform, a model
+      // to world matrix. triangle_colors, when given, has a color per triangle instead of color
+      template <typename num_type>
+      void draw(const Vector3<num_type>* positions, size_t vertex_count, const uint32_t* indices, size_t index_count,
+                const Matrix4x4<num_type>& transform, uint32_t color, const uint32_t* triangle_colors = nullptr) {
+        const num_type (*m)[4] = transform.matrix;
+        std::vector<Vector3<float>> world(vertex_count);
+        for (size_t i = 0; i < vertex_count; ++i) {
+          const Vector3<num_type>& p = positions[i];
+          world[i] = Vector3<float>(float(m[0][0] * p.x + m[0][1] * p.y + m[0][2] * p.z + m[0][3]),
+                                    float(m[1][0] * p.x + m[1][1] * p.y + m[1][2] * p.z + m[1][3]),
+                                    float(m[2][0] * p.x + m[2][1] * p.y + m[2][2] * p.z + m[2][3]));
+        }
+        for (size_t t = 0; t + 2 < index_count; t += 3) {
+          const Vector3<float>& a = world[indices[t]];
+          Vector3<float> e_1 = world[indices[t + 1]].from(a), e_2 = world[indices[t + 2]].from(a);
+          Vector3<float> n = e_1.crossProduct(e_2);
+          float length = n.magnitude();
+          n = length > 0 ? n * (1 / length) : Vector3<float>(0.0f, 0.0f, 1.0f);
+          Triangle tri = {{a.x, a.y, a.z}, {e_1.x, e_1.y, e_1.z}, {e_2.x, e_2.y, e_2.z}, {n.x, n.y, n.z},
+                          triangle_colors ? triangle_colors[t / 3] : color};
+          triangles.push_back(tri);
+        }
+      }
+      template <typename num_type>
+      void draw(const std::vector<Vector3<num_type>>& positions, const std::vector<uint32_t>& indices,
+                const Matrix4x4<num_type>& transform, uint32_t color) {
+        draw(positions.data(), positions.size(), indices.data(), indices.size(), transform, color);
+      }
+      // Builds the BVH over everything queued since begin(); call before rendering
+      void build(unsigned threads = 1) {
+        clock::time_point start = clock::now();
+        std::vector<AABB<float>> boxes(triangles.size());
+        for (size_t t = 0; t < triangles.size(); ++t) {
+          const Triangle& tri = triangles[t];
+          Vector3<float> a(tri.v_0[0], tri.v_0[1], tri.v_0[2]);
+          Vector3<float> b = a + Vector3<float>(tri.e_1[0], tri.e_1[1], tri.e_1[2]);
+          Vector3<float> c = a + Vector3<float>(tri.e_2[0], tri.e_2[1], tri.e_2[2]);
+          boxes[t] = AABB<float>().merged(a).merged(b).merged(c);
+        }
+        bvh.build(boxes, threads);
+        stats.build_ms = milliseconds(start);
+        reset();
+      }
+
+      // Starts the accumulation over, as after moving the camera or the lights
+      void setCamera(const RayCamera& new_camera) {
+        camera = new_camera;
+        reset();
+      }
+      void reset() {
+        pass_count = 0;
+        std::fill(accumulation.begin(), accumulation.end(), 0.0f);
+      }
+      size_t passes() const {
+        return pass_count;
+      }
+
+      // Traces one sample per pixel, adds it to the running sums and writes their
+      // average to target's color. A target of another size starts over
+      void renderPass(Framebuffer& target, unsigned threads = 1) {
+        if (target.width() != width or target.height() != height) {
+          width = target.width();
+          height = target.height();
+          accumulation.assign(size_t(width) * height * 3, 0.0f);
+          pass_count = 0;
+        }
+        clock::time_point start = clock::now();
+        Vector3<float> sun = sun_direction.normalized();
+        // Two directions across the sun, for jittering shadow rays over its disc
+        Vector3<float> across = fabs(sun.x) < 0.9f ? Vector3<float>::right : Vector3<float>::forward;
+        sun_tangent = sun.crossProduct(across).normalized();
+        sun_bitangent = sun.crossProduct(sun_tangent);
+        sun_unit = sun;
+        tiles_x = (width + tile_size - 1) / tile_size;
+        int tiles_y = (height + tile_size - 1) / tile_size;
+        std::atomic<size_t> primary(0), shadow(0), packets(0);
+        parallelTasks(size_t(tiles_x) * tiles_y, threads, [&](size_t tile) {
+          TileCounters counters = {0, 0, 0};
+          traceTile(int(tile), counters);
+          primary += counters.primary_rays;
+          shadow += counters.shadow_rays;
+          packets += counters.packets;
+        });
+        ++pass_count;
+        resolve(target);
+        stats.passes = pass_count;
+        stats.primary_rays = primary;
+        stats.shadow_rays = shadow;
+        stats.packets = packets;
+        stats.trace_ms = milliseconds(start);
+      }
+
+      const RayTraceStats& lastStats() const {
+        return stats;
+      }
+      size_t triangleCount() const {
+        return triangles.size();
+      }
+
+    private :
+      typedef std::chrono::steady_clock clock;
+      typedef SimdLanes<float> L;
+      typedef L::reg reg;
+      typedef L::mask mask;
+      static constexpr int packet_size = int(L::width);
+      static constexpr int packet_width = packet_size >= 8 ? 4 : (packet_size >= 4 ? 2 : 1);
+      static constexpr int packet_height = packet_size / packet_width;
+
+      // First vertex, the two edges from it and the unit normal
+      struct Triangle {
+        float v_0[3], e_1[3], e_2[3], normal[3];
+        uint32_t color;
+      };
+      // One ray per lane. t is the closest hit so far, or how far to look
+      struct Packet {
+        float origin[3][packet_size];
+        float direction[3][packet_size];
+        float inv[3][packet_size];
+        float t[packet_size];
+        uint32_t triangle[packet_size];
+      };
+      struct TileCounters {
+        size_t primary_rays, shadow_rays, packets;
+      };
+
+      std::vector<Triangle> triangles;
+      BVH<float> bvh;
+      RayCamera camera;
+      std::vector<float> accumulation;
+      int width, height, tiles_x;
+      size_t pass_count;
+      Vector3<float> sun_unit, sun_tangent, sun_bitangent;
+      RayTraceStats stats;
+
+      static double milliseconds(clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(clock::now() - start).count();
+      }
+
+      // Uniform in [0, 1) from the pixel, the pass and which of the pixel's random numbers it is
+      static float random01(uint32_t pixel, uint32_t pass, uint32_t dimension) {
+        uint32_t h = pixel * 0x9E3779B1u ^ (pass + 0x7F4A7C15u) * 0x85EBCA77u ^ dimension * 0xC2B2AE3Du;
+        h ^= h >> 16;
+        h *= 0x7FEB352Du;
+        h ^= h >> 15;
+        h *= 0x846CA68Bu;
+        h ^= h >> 16;
+        return float(h >> 8) * (1.0f / 16777216.0f);
+      }
+
+      void traceTile(int tile, TileCounters& counters) {
+        int x_0 = tile % tiles_x * tile_size, y_0 = tile / tiles_x * tile_size;
+        int x_1 = std::min(x_0 + tile_size, width), y_1 = std::min(y_0 + tile_size, height);
+        for (int y = y_0; y < y_1; y += packet_height)
+          for (int x = x_0; x < x_1; x += packet_width)
+            tracePacket(x, y, counters);
+      }
+
+      void tracePacket(int x_0, int y_0, TileCounters& counters) {
+        const float inf = std::numeric_limits<float>::infinity();
+        float scale_y = float(tan(camera.fov_y / 2)), scale_x = scale_y * width / height;
+        Vector3<float> right = camera.orientation.rotate(Vector3<float>::right);
+        Vector3<float> forward = camera.orientation.rotate(Vector3<float>::forward);
+        Vector3<float> up = camera.orientation.rotate(Vector3<float>::up);
+        uint32_t pass = uint32_t(pass_count);
+
+        Packet primary;
+        int active = 0;
+        uint32_t pixels[packet_size];
+        for (int i = 0; i < packet_size; ++i) {
+          int x = x_0 + i % packet_width, y = y_0 + i / packet_width;
+          pixels[i] = uint32_t(std::min(y, height - 1)) * uint32_t(width) + uint32_t(std::min(x, width - 1));
+          if (x < width and y < height)
+            active |= 1 << i;
+          // Jittered inside the pixel, centred on the first pass
+          float jx = pass == 0 ? 0.5f : random01(pixels[i], pass, 0), jy = pass == 0 ? 0.5f : random01(pixels[i], pass, 1);
+          float sx = (2 * (x + jx) / width - 1) * scale_x, sy = (1 - 2 * (y + jy) / height) * scale_y;
+          Vector3<float> d = (forward + right * sx + up * sy).normalized();
+          setRay(primary, i, camera.position, d, inf);
+        }
+        counters.primary_rays += popCount(active);
+        ++counters.packets;
+        intersect<false>(primary, active);
+
+        // Shadow rays toward a random point of the sun from every hit
+        Packet shadow;
+        float direct[packet_size];
+        int lit = 0;
+        for (int i = 0; i < packet_size; ++i) {
+          if (not (active & (1 << i)) or primary.triangle[i] == BVH<float>::none) {
+            setRay(shadow, i, camera.position, sun_unit, 0);
+            continue;
+          }
+          const Triangle& tri = triangles[primary.triangle[i]];
+          Vector3<float> n(tri.normal[0], tri.normal[1], tri.normal[2]);
+          Vector3<float> d(primary.direction[0][i], primary.direction[1][i], primary.direction[2][i]);
+          if (n.dotProduct(d) > 0)
+            n = n * -1.0f;
+          Vector3<float> p = camera.position + d * primary.t[i];
+          float u = random01(pixels[i], pass, 2) * 2 - 1, v = random01(pixels[i], pass, 3) * 2 - 1;
+          Vector3<float> l = pass == 0 ? sun_unit : (sun_unit + sun_tangent * (u * sun_radius) + sun_bitangent * (v * sun_radius)).normalized();
+          float facing = n.dotProduct(l);
+          float largest = std::max(fabs(p.x), std::max(fabs(p.y), fabs(p.z)));
+          setRay(shadow, i, p + n * (1e-4f * (1 + largest)), l, inf);
+          direct[i] = facing > 0 ? facing * sun_intensity : 0;
+          if (facing > 0)
+            lit |= 1 << i;
+        }
+        if (lit != 0) {
+          counters.shadow_rays += popCount(lit);
+          ++counters.packets;
+          int unoccluded = lit;
+          intersect<true>(shadow, unoccluded);
+          lit = unoccluded;
+        }
+
+        for (int i = 0; i < packet_size; ++i) {
+          if (not (active & (1 << i)))
+            continue;
+          uint32_t c = sky_color;
+          float light = 1;
+          if (primary.triangle[i] != BVH<float>::none) {
+            c = triangles[primary.triangle[i]].color;
+            light = ambient + ((lit & (1 << i)) ? direct[i] : 0);
+          }
+          float* sum = &accumulation[size_t(pixels[i]) * 3];
+          sum[0] += float(c >> 16 & 0xFF) * light;
+          sum[1] += float(c >> 8 & 0xFF) * light;
+          sum[2] += float(c & 0xFF) * light;
+        }
+      }
+
+      static void setRay(Packet& packet, int i, const Vector3<float>& origin, const Vector3<float>& direction, float t_max) {
+        float o[3] = {origin.x, origin.y, origin.z}, d[3] = {direction.x, direction.y, direction.z};
+        for (int a = 0; a < 3; ++a) {
+          packet.origin[a][i] = o[a];
+          packet.direction[a][i] = d[a];
+          packet.inv[a][i] = 1 / d[a];
+        }
+        packet.t[i] = t_max;
+        packet.triangle[i] = BVH<float>::none;
+      }
+
+      // Closest hits of the active rays, or with any_hit set, clears the bits of
+      // active rays that hit anything
+      template <bool any_hit>
+      void intersect(Packet& packet, int& active) const {
+        if (bvh.nodeCount() == 0 or active == 0)
+          return;
+        struct Entry {
+          uint32_t node;
+          float t;
+        };
+        Entry stack[BVH<float>::stack_size];
+        size_t top = 0;
+        stack[top++] = {0, 0};
+        while (top != 0) {
+          Entry entry = stack[--top];
+          if (not any_hit and entry.t > farthest(packet, active))
+            continue;
+          const BVH<float>::Node& node = bvh.node(entry.node);
+          Entry inner[4];
+          int inner_count = 0;
+          for (int c = 0; c < 4; ++c) {
+            if (node.count[c] == 0 and node.child[c] == BVH<float>::none)
+              continue;
+            float t_near;
+            int hits = boxTest(packet, node.bounds, c, active, t_near);
+            if (hits == 0)
+              continue;
+            if (node.count[c] == 0) {
+              // Nearest last, so it's popped first
+              int k = inner_count++;
+              for (; k > 0 and inner[k - 1].t < t_near; --k)
+                inner[k] = inner[k - 1];
+              inner[k] = {node.child[c], t_near};
+              continue;
+            }
+            const BVH<float>::Leaf& leaf = bvh.leaf(node.child[c]);
+            for (uint32_t k = 0; k < node.count[c]; ++k) {
+              int found = triangleTest<any_hit>(packet, leaf.primitive[k], hits);
+              if (any_hit) {
+                hits &= ~found;
+                active &= ~found;
+                if (active == 0)
+                  return;
+              }
+            }
+          }
+          for (int k = 0; k < inner_count; ++k)
+            stack[top++] = inner[k];
+        }
+      }
+
+      static float farthest(const Packet& packet, int active) {
+        float result = 0;
+        for (int i = 0; i < packet_size; ++i)
+          if ((active & (1 << i)) and packet.t[i] > result)
+            result = packet.t[i];
+        return result;
+      }
+
+      // Active rays reaching box c of bounds before their t, and the nearest entry among them
+      static int boxTest(const Packet& packet, const float bounds[2][3][4], int c, int active, float& t_near) {
+        reg t_0 = L::set(0), t_1 = L::load(packet.t);
+        for (int a = 0; a < 3; ++a) {
+          reg o = L::load(packet.origin[a]), inv = L::load(packet.inv[a]);
+          reg low = L::mul(L::sub(L::set(bounds[0][a][c]), o), inv);
+          reg high = L::mul(L::sub(L::set(bounds[1][a][c]), o), inv);
+          // Near and far planes by the sign of inv, as in slabTest4, so a NaN from
+          // 0 * inf is the first operand and max and min keep the running bounds
+          mask backwards = L::less(inv, L::set(0));
+          t_0 = L::max(L::select(backwards, high, low), t_0);
+          t_1 = L::min(L::select(backwards, low, high), t_1);
+        }
+        int hits = active & ~L::bits(L::greater(t_0, t_1));
+        if (hits == 0)
+          return 0;
+        float entry[packet_size];
+        L::store(entry, t_0);
+        t_near = std::numeric_limits<float>::infinity();
+        for (int i = 0; i < packet_size; ++i)
+          if ((hits & (1 << i)) and entry[i] < t_near)
+            t_near = entry[i];
+        return hits;
+      }
+
+      // Moller-Trumbore across the lanes in active, for either side of the
+      // triangle. Returns the rays that hit before their t, which closest hit mode
+      // also records in the packet
+      template <bool any_hit>
+      int triangleTest(Packet& packet, uint32_t index, int active) const {
+        const Triangle& tri = triangles[index];
+        reg e_1[3], e_2[3], d[3], s[3];
+        for (int a = 0; a < 3; ++a) {
+          e_1[a] = L::set(tri.e_1[a]);
+          e_2[a] = L::set(tri.e_2[a]);
+          d[a] = L::load(packet.direction[a]);
+          s[a] = L::sub(L::load(packet.origin[a]), L::set(tri.v_0[a]));
+        }
+        reg p[3], q[3];
+        cross(d, e_2, p);
+        cross(s, e_1, q);
+        reg inv_det = L::div(L::set(1), dot(e_1, p));
+        reg u = L::mul(dot(s, p), inv_det), v = L::mul(dot(d, q), inv_det), t = L::mul(dot(e_2, q), inv_det);
+        reg zero = L::set(0);
+        // A parallel ray gives an infinite or NaN t, which fails the range test
+        int hits = active & L::bits(L::both(L::greater(t, zero), L::less(t, L::load(packet.t))))
+                 & ~L::bits(L::less(u, zero)) & ~L::bits(L::less(v, zero)) & ~L::bits(L::greater(L::add(u, v), L::set(1)));
+        if (any_hit or hits == 0)
+          return hits;
+        float distance[packet_size];
+        L::store(distance, t);
+        for (int i = 0; i < packet_size; ++i)
+          if (hits & (1 << i)) {
+            packet.t[i] = distance[i];
+            packet.triangle[i] = index;
+          }
+        return hits;
+      }
+
+      static void cross(const reg a[3], const reg b[3], reg out[3]) {
+        out[0] = L::sub(L::mul(a[1], b[2]), L::mul(a[2], b[1]));
+        out[1] = L::sub(L::mul(a[2], b[0]), L::mul(a[0], b[2]));
+        out[2] = L::sub(L::mul(a[0], b[1]), L::mul(a[1], b[0]));
+      }
+      static reg dot(const reg a[3], const reg b[3]) {
+        return L::mulAdd(a[2], b[2], L::mulAdd(a[1], b[1], L::mul(a[0], b[0])));
+      }
+
+      void resolve(Framebuffer& target) const {
+        float scale = 1.0f / float(pass_count);
+        for (int y = 0; y < height; ++y)
+          for (int x = 0; x < width; ++x) {
+            const float* sum = &accumulation[(size_t(y) * width + x) * 3];
+            uint8_t rgb[3];
+            for (int k = 0; k < 3; ++k) {
+              float value = sum[k] * scale;
+              rgb[k] = uint8_t(value < 255 ? value + 0.5f : 255);
+            }
+            target.color[size_t(y) * target.stride() + x] = packColor(rgb[0], rgb[1], rgb[2]);
+          }
+      }
+
+      static int popCount(int bits) {
+        #if defined(__GNUC__)
+          return __builtin_popcount(unsigned(bits));
+        #else
+          int c = 0;
+          for (; bits != 0; bits &= bits - 1)
+            ++c;
+          return c;
+        #endif
+      }
+  };
+
+#endif
@@ -0,0 +1,253 @@
+#if !defined(SKINNING_H_INCLUDED)
+  #define SKINNING_H_INCLUDED
+
+  #include <stdint.h>
+  #include <vector>
+  #include "../math/dual_quaternion.h"
+  #include "../math/vector_array.h"
+  #include "../core/parallel.h"
+
+  // Blends the bones of n vertices with four influences each: out[c][i] is
+  // component c (real w x y z, then dual w x y z) of vertex i's blend, not yet
+  // normalized. Every bone is flipped into the hemisphere of the vertex's first
+  // bone, so the blend takes the short way round
+  template <typename num_type>
+  inline void blendDualQuaternions(const DualQuaternion<num_type>* palette, const uint16_t* const bones[4],
+                                   const num_type* const weights[4], size_t n, num_type* const out[8]) {
+    for (size_t i = 0; i < n; ++i) {
+      const DualQuaternion<num_type>& first = palette[bones[0][i]];
+      Quaternion<num_type> r = first.real.multiply(weights[0][i]), d = first.dual.multiply(weights[0][i]);
+      for (int j = 1; j < 4; ++j) {
+        const DualQuaternion<num_type>& dq = palette[bones[j][i]];
+        num_type k = dq.real.dotProduct(first.real) < 0 ? -weights[j][i] : weights[j][i];
+        r = r.add(dq.real.multiply(k));
+        d = d.add(dq.dual.multiply(k));
+      }
+      out[0][i] = r.w; out[1][i] = r.x; out[2][i] = r.y; out[3][i] = r.z;
+      out[4][i] = d.w; out[5][i] = d.x; out[6][i] = d.y; out[7][i] = d.z;
+    }
+  }
+  // A vertex is blended in registers, a float dual quaternion being one and a
+  // double one two, and groups of vertices are transposed into the lanes. The
+  // scalar version above is much slower, it moves all 32 numbers one at a time
+  #if defined(__AVX2__) and defined(__FMA__)
+    inline void blendDualQuaternions(const DualQuaternion<float>* palette, const uint16_t* const bones[4],
+                                     const float* const weights[4], size_t n, float* const out[8]) {
+      static_assert(sizeof(DualQuaternion<float>) == 8 * sizeof(float), "DualQuaternion<float> must be 8 packed floats");
+      const float* p = reinterpret_cast<const float*>(palette);
+      size_t i = 0;
+      for (; i + 8 <= n; i += 8) {
+        __m256 s[8], t[8];
+        for (size_t v = 0; v < 8; ++v) {
+          __m256 q_0 = _mm256_loadu_ps(p + 8 * size_t(bones[0][i + v])), q_1 = _mm256_loadu_ps(p + 8 * size_t(bones[1][i + v])),
+                 q_2 = _mm256_loadu_ps(p + 8 * size_t(bones[2][i + v])), q_3 = _mm256_loadu_ps(p + 8 * size_t(bones[3][i + v]));
+          // Dot products of the real parts with the first bone's, then their signs onto the weights
+          __m128 r_0 = _mm256_castps256_ps128(q_0);
+          __m128 d_1 = _mm_mul_ps(_mm256_castps256_ps128(q_1), r_0), d_2 = _mm_mul_ps(_mm256_castps256_ps128(q_2), r_0),
+                 d_3 = _mm_mul_ps(_mm256_castps256_ps128(q_3), r_0);
+          __m128 dots = _mm_hadd_ps(_mm_hadd_ps(d_1, d_2), _mm_hadd_ps(d_3, d_3));
+          __m128 k = _mm_xor_ps(_mm_setr_ps(weights[1][i + v], weights[2][i + v], weights[3][i + v], 0),
+                                _mm_and_ps(dots, _mm_set1_ps(-0.0f)));
+          __m256 sum = _mm256_mul_ps(q_0, _mm256_set1_ps(weights[0][i + v]));
+          sum = _mm256_fmadd_ps(q_1, _mm256_broadcastss_ps(k), sum);
+          sum = _mm256_fmadd_ps(q_2, _mm256_broadcastss_ps(_mm_permute_ps(k, 0x55)), sum);
+          s[v] = _mm256_fmadd_ps(q_3, _mm256_broadcastss_ps(_mm_permute_ps(k, 0xAA)), sum);
+        }
+        // 8x8 transpose
+        for (size_t v = 0; v < 8; v += 2) {
+          t[v] = _mm256_unpacklo_ps(s[v], s[v + 1]);
+          t[v + 1] = _mm256_unpackhi_ps(s[v], s[v + 1]);
+        }
+        for (size_t v = 0; v < 8; v += 4) {
+          s[v] = _mm256_shuffle_ps(t[v], t[v + 2], 0x44);
+          s[v + 1] = _mm256_shuffle_ps(t[v], t[v + 2], 0xEE);
+          s[v + 2] = _mm256_shuffle_ps(t[v + 1], t[v + 3], 0x44);
+          s[v + 3] = _mm256_shuffle_ps(t[v + 1], t[v + 3], 0xEE);
+        }
+        for (size_t c = 0; c < 4; ++c) {
+          _mm256_storeu_ps(out[c] + i, _mm256_permute2f128_ps(s[c], s[c + 4], 0x20));
+          _mm256_storeu_ps(out[c + 4] + i, _mm256_permute2f128_ps(s[c], s[c + 4], 0x31));
+        }
+      }
+      const uint16_t* rest_bones[4] = {bones[0] + i, bones[1] + i, bones[2] + i, bones[3] + i};
+      const float* rest_weights[4] = {weights[0] + i, weights[1] + i, weights[2] + i, weights[3] + i};
+      float* const rest_out[8] = {out[0] + i, out[1] + i, out[2] + i, out[3] + i, out[4] + i, out[5] + i, out[6] + i, out[7] + i};
+      blendDualQuaternions<float>(palette, rest_bones, rest_weights, n - i, rest_out);
+    }
+    inline void blendDualQuaternions(const DualQuaternion<double>* palette, const uint16_t* const bones[4],
+                                     const double* const weights[4], size_t n, double* const out[8]) {
+      static_assert(sizeof(DualQuaternion<double>) == 8 * sizeof(double), "DualQuaternion<double> must be 8 packed doubles");
+      const double* p = reinterpret_cast<const double*>(palette);
+      const __m256d sign = _mm256_set1_pd(-0.0);
+      size_t i = 0;
+      for (; i + 4 <= n; i += 4) {
+        __m256d r[4], d[4], t[4];
+        for (size_t v = 0; v < 4; ++v) {
+          const double* q = p + 8 * size_t(bones[0][i + v]);
+          __m256d r_0 = _mm256_loadu_pd(q);
+          r[v] = _mm256_mul_pd(r_0, _mm256_set1_pd(weights[0][i + v]));
+          d[v] = _mm256_mul_pd(_mm256_loadu_pd(q + 4), _mm256_set1_pd(weights[0][i + v]));
+          for (int j = 1; j < 4; ++j) {
+            q = p + 8 * size_t(bones[j][i + v]);
+            __m256d r_j = _mm256_loadu_pd(q);
+            // Dot product with the first bone's real part in every lane, its sign onto the weight
+            __m256d dot = _mm256_mul_pd(r_j, r_0);
+            dot = _mm256_add_pd(dot, _mm256_permute2f128_pd(dot, dot, 0x01));
+            dot = _mm256_add_pd(dot, _mm256_permute_pd(dot, 0x5));
+            __m256d k = _mm256_xor_pd(_mm256_set1_pd(weights[j][i + v]), _mm256_and_pd(dot, sign));
+            r[v] = _mm256_fmadd_pd(r_j, k, r[v]);
+            d[v] = _mm256_fmadd_pd(_mm256_loadu_pd(q + 4), k, d[v]);
+          }
+        }
+        // Two 4x4 transposes
+        for (int half = 0; half < 2; ++half) {
+          __m256d* s = half == 0 ? r : d;
+          t[0] = _mm256_unpacklo_pd(s[0], s[1]);
+          t[1] = _mm256_unpackhi_pd(s[0], s[1]);
+          t[2] = _mm256_unpacklo_pd(s[2], s[3]);
+          t[3] = _mm256_unpackhi_pd(s[2], s[3]);
+          _mm256_storeu_pd(out[4 * half] + i, _mm256_permute2f128_pd(t[0], t[2], 0x20));
+          _mm256_storeu_pd(out[4 * half + 1] + i, _mm256_permute2f128_pd(t[1], t[3], 0x20));
+          _mm256_storeu_pd(out[4 * half + 2] + i, _mm256_permute2f128_pd(t[0], t[2], 0x31));
+          _mm256_storeu_pd(out[4 * half + 3] + i, _mm256_permute2f128_pd(t[1], t[3], 0x31));
+        }
+      }
+      const uint16_t* rest_bones[4] = {bones[0] + i, bones[1] + i, bones[2] + i, bones[3] + i};
+      const double* rest_weights[4] = {weights[0] + i, weights[1] + i, weights[2] + i, weights[3] + i};
+      double* const rest_out[8] = {out[0] + i, out[1] + i, out[2] + i, out[3] + i, out[4] + i, out[5] + i, out[6] + i, out[7] + i};
+      blendDualQuaternions<double>(palette, rest_bones, rest_weights, n - i, rest_out);
+    }
+  #endif
+
+  // Bind pose vertices of a skinned mesh, structure-of-arrays, with up to four
+  // bone influences per vertex kept as one lane per influence slot. Unused slots
+  // have bone 0 and weight 0.
+  //
+  // skin is dual quaternion skinning (Kavan et al., "Skinning with dual
+  // quaternions"): each vertex blends the dual quaternions of its bones,
+  // renormalizes, and transforms its position and normal by the result. Unlike
+  // blending matrices it keeps volume at twisting joints, and a bone costs 8
+  // numbers to gather instead of 12
+  template <typename num_type = float>
+  class SkinnedMesh {
+    public :
+      static constexpr size_t max_influences = 4;
+      // Smallest share of the vertices worth giving to another thread
+      static constexpr size_t min_chunk = 4096;
+
+      Vector3Array<num_type> positions;
+      Vector3Array<num_type> normals;
+      std::vector<uint16_t> bone[max_influences];
+      std::vector<num_type> weight[max_influences];
+
+      size_t size() const {
+        return positions.size();
+      }
+      // Keeps the four heaviest of the n influences, with weights rescaled to sum
+      // to 1. A vertex without a positive weight follows its first bone, or bone
+      // 0 when n is 0, with weight 1. Returns the vertex index
+      size_t add(const Vector3<num_type>& position, const Vector3<num_type>& normal,
+                 const uint16_t* bones, const num_type* weights, size_t n) {
+        uint16_t b[max_influences] = {0, 0, 0, 0};
+        num_type w[max_influences] = {0, 0, 0, 0};
+        for (size_t k = 0; k < n; ++k) {
+          size_t j = max_influences;
+          while (j > 0 and weights[k] > w[j - 1])
+            --j;
+          if (j == max_influences)
+            continue;
+          for (size_t s = max_influences - 1; s > j; --s) {
+            b[s] = b[s - 1];
+            w[s] = w[s - 1];
+          }
+          b[j] = bones[k];
+          w[j] = weights[k];
+        }
+        num_type sum = w[0] + w[1] + w[2] + w[3];
+        if (not (sum > 0)) {
+          // A zero blend would divide by |r|^2 = 0 in skin()
+          b[0] = n > 0 ? bones[0] : uint16_t(0);
+          w[0] = sum = num_type(1);
+        }
+        positions.append(position);
+        normals.append(normal);
+        for (size_t k = 0; k < max_influences; ++k) {
+          bone[k].push_back(b[k]);
+          weight[k].push_back(w[k] / sum);
+        }
+        return size() - 1;
+      }
+
+      // palette[b] is bone b's skinning transform, its current pose composed
+      // after the inverse of its bind pose
+      void skin(const DualQuaternion<num_type>* palette, Vector3Array<num_type>& out_positions,
+                Vector3Array<num_type>& out_normals, unsigned threads = 1) const {
+        out_positions.resize(size());
+        out_normals.resize(size());
+        parallelChunks(size(), threads, min_chunk, [&](size_t begin, size_t end) {
+          skinRange(palette, out_positions, out_normals, begin, end);
+        });
+      }
+
+    private :
+      // Gathers and blends the bones of a block of vertices into SoA lanes, the
+      // palette lookups are what keeps this part scalar, then normalizes and
+      // transforms a register of vertices at a time
+      void skinRange(const DualQuaternion<num_type>* palette, Vector3Array<num_type>& out_positions,
+                     Vector3Array<num_type>& out_normals, size_t begin, size_t end) const {
+        const size_t block = 64;
+        alignas(64) num_type rw[block], rx[block], ry[block], rz[block], dw[block], dx[block], dy[block], dz[block];
+        for (size_t start = begin; start < end; start += block) {
+          size_t m = end - start < block ? end - start : block;
+          const uint16_t* bones[max_influences] = {bone[0].data() + start, bone[1].data() + start,
+                                                   bone[2].data() + start, bone[3].data() + start};
+          const num_type* weights[max_influences] = {weight[0].data() + start, weight[1].data() + start,
+                                                     weight[2].data() + start, weight[3].data() + start};
+          num_type* const blended[8] = {rw, rx, ry, rz, dw, dx, dy, dz};
+          blendDualQuaternions(palette, bones, weights, m, blended);
+          const num_type *px = positions.x + start, *py = positions.y + start, *pz = positions.z + start;
+          const num_type *nx = normals.x + start, *ny = normals.y + start, *nz = normals.z + start;
+          num_type *opx = out_positions.x + start, *opy = out_positions.y + start, *opz = out_positions.z + start;
+          num_type *onx = out_normals.x + start, *ony = out_normals.y + start, *onz = out_normals.z + start;
+          forEachLane<num_type>(m, [&](auto lanes, size_t i) {
+            typedef decltype(lanes) L;
+            typename L::reg w = L::load(rw + i), ux = L::load(rx + i), uy = L::load(ry + i), uz = L::load(rz + i);
+            typename L::reg ew = L::load(dw + i), ex = L::load(dx + i), ey = L::load(dy + i), ez = L::load(dz + i);
+            // The blend isn't normalized; both the rotation and the translation
+            // carry 1 / |r|^2, so one division replaces normalizing it
+            typename L::reg k = L::div(L::set(2), L::mulAdd(uz, uz, L::mulAdd(uy, uy, L::mulAdd(ux, ux, L::mul(w, w)))));
+            // Translation k (w d - d_w u + u x d)
+            typename L::reg tx = L::add(L::negMulAdd(ew, ux, L::mul(w, ex)), L::negMulAdd(uz, ey, L::mul(uy, ez)));
+            typename L::reg ty = L::add(L::negMulAdd(ew, uy, L::mul(w, ey)), L::negMulAdd(ux, ez, L::mul(uz, ex)));
+            typename L::reg tz = L::add(L::negMulAdd(ew, uz, L::mul(w, ez)), L::negMulAdd(uy, ex, L::mul(ux, ey)));
+            typename L::reg x = L::load(px + i), y = L::load(py + i), z = L::load(pz + i);
+            rotateLane<L>(w, ux, uy, uz, k, x, y, z);
+            L::store(opx + i, L::mulAdd(k, tx, x));
+            L::store(opy + i, L::mulAdd(k, ty, y));
+            L::store(opz + i, L::mulAdd(k, tz, z));
+            x = L::load(nx + i); y = L::load(ny + i); z = L::load(nz + i);
+            rotateLane<L>(w, ux, uy, uz, k, x, y, z);
+            L::store(onx + i, x);
+            L::store(ony + i, y);
+            L::store(onz + i, z);
+          });
+        }
+      }
+      // Rotates (x, y, z) by the quaternion (w, u) with k = 2 / |(w, u)|^2, through
+      // v + k (w a + u x a) with a = u x v
+      template <class L>
+      static void rotateLane(typename L::reg w, typename L::reg ux, typename L::reg uy, typename L::reg uz, typename L::reg k,
+                             typename L::reg& x, typename L::reg& y, typename L::reg& z) {
+        typename L::reg ax = L::negMulAdd(uz, y, L::mul(uy, z));
+        typename L::reg ay = L::negMulAdd(ux, z, L::mul(uz, x));
+        typename L::reg az = L::negMulAdd(uy, x, L::mul(ux, y));
+        typename L::reg cx = L::negMulAdd(uz, ay, L::mul(uy, az));
+        typename L::reg cy = L::negMulAdd(ux, az, L::mul(uz, ax));
+        typename L::reg cz = L::negMulAdd(uy, ax, L::mul(ux, ay));
+        x = L::mulAdd(k, L::mulAdd(w, ax, cx), x);
+        y = L::mulAdd(k, L::mulAdd(w, ay, cy), y);
+        z = L::mulAdd(k, L::mulAdd(w, az, cz), z);
+      }
+  };
+
+#endif
@@ -0,0 +1,551 @@
+#if !defined(SNAPSHOT_H_INCLUDED)
+  #define SNAPSHOT_H_INCLUDED
+
+  #include <fstream>
+  #include <functional>
+  #include <stdint.h>
+  #include <string.h>
+  #include <string>
+  #include <type_traits>
+  #include <vector>
+  #include "../math/quantized.h"
+  #if defined(_WIN32)
+    #if !defined(NOMINMAX)
+      #define NOMINMAX
+    #endif
+    #include <windows.h>
+  #else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+  #endif
+
+  // Binary snapshot files of large arrays of engine math types, read through a
+  // memory map so opening costs the same for any size and pages load on first
+  // touch. Layout, all little or all big endian as recorded in the header:
+  //   SnapshotHeader, 64 bytes
+  //   SnapshotSection[section_count], 128 bytes each
+  //   section data, each at a multiple of 64 bytes
+  // Raw sections are SoA: component c of element i is at
+  //   offset + c * lane_stride + i * precision
+  // with lane_stride a multiple of 64, so each lane can be handed to the batch
+  // kernels in place. Vector3 and quaternion sections may instead be packed with
+  // the codes of math/quantized.h, which trades zero-copy access for a 2.3 to 4
+  // times smaller file and decodes on load
+  struct SnapshotHeader {
+    static constexpr uint32_t current_version = 1;
+    static constexpr uint32_t byte_order_mark = 0x01020304;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t header_size;
+    uint32_t section_size;
+    uint64_t section_count;
+    uint64_t file_size;
+    uint8_t reserved[24];
+
+    static bool validMagic(const char* magic) {
+      return memcmp(magic, "SNAPSHOT", 8) == 0;
+    }
+  };
+
+  struct SnapshotSection {
+    // kind
+    static constexpr uint32_t scalars = 0;
+    static constexpr uint32_t vectors = 1;
+    static constexpr uint32_t quaternions = 2;
+    static constexpr uint32_t rotation_matrices = 3;
+    // number
+    static constexpr uint32_t float32 = 0;
+    static constexpr uint32_t float64 = 1;
+    // encoding
+    static constexpr uint32_t raw = 0;
+    static constexpr uint32_t packed_quaternion32 = 1;
+    static constexpr uint32_t packed_quaternion48 = 2;
+    static constexpr uint32_t packed_vector3 = 3;
+
+    static constexpr size_t max_name_length = 31;
+
+    char name[max_name_length + 1];
+    uint32_t kind;
+    uint32_t number;
+    uint32_t encoding;
+    // 1, 3, 4 or 9 numbers per element
+    uint32_t components;
+    uint64_t count;
+    uint64_t offset;
+    uint64_t lane_stride;
+    uint64_t size;
+    // Range of packed_vector3, min then max
+    double bounds[6];
+
+    // Bytes per number of the source data; packed sections decode to it
+    size_t precision() const {
+      return number == float64 ? 8 : 4;
+    }
+  };
+
+  template <typename num_type>
+  struct SnapshotNumber;
+  template <>
+  struct SnapshotNumber<float> {
+    static constexpr uint32_t value = SnapshotSection::float32;
+  };
+  template <>
+  struct SnapshotNumber<double> {
+    static constexpr uint32_t value = SnapshotSection::float64;
+  };
+
+  // Collects sections and writes them in one pass. Arrays are referenced, not
+  // copied, so they must live until write() returns
+  class SnapshotWriter {
+    public :
+      // Each add returns false if the name is longer than
+      // SnapshotSection::max_name_length or already taken
+      template <typename num_type>
+      bool add(const std::string& name, const num_type* values, size_t n) {
+        SnapshotSection section = makeSection<num_type>(name, SnapshotSection::scalars, 1, n);
+        return addSection(name, section, [values](std::ostream& out, const SnapshotSection& s) {
+          writeLane(out, values, s);
+        });
+      }
+      // encoding is raw or packed_vector3. Packed sections store 16 bits per axis
+      // over the bounds of the data
+      template <typename num_type>
+      bool add(const std::string& name, const Vector3Array<num_type>& vecs, uint32_t encoding = SnapshotSection::raw) {
+        SnapshotSection section = makeSection<num_type>(name, SnapshotSection::vectors, 3, vecs.size());
+        const Vector3Array<num_type>* arr = &vecs;
+        if (encoding == SnapshotSection::packed_vector3) {
+          AABB<num_type> bounds;
+          for (size_t i = 0; i < vecs.size(); ++i)
+            bounds += vecs.get(i);
+          setPacked(section, encoding, sizeof(PackedVector3));
+          const num_type limits[6] = {bounds.min.x, bounds.min.y, bounds.min.z, bounds.max.x, bounds.max.y, bounds.max.z};
+          for (int c = 0; c < 6; ++c)
+            section.bounds[c] = vecs.empty() ? 0 : double(limits[c]);
+          return addSection(name, section, [arr, bounds](std::ostream& out, const SnapshotSection&) {
+            writePacked<PackedVector3>(out, arr->size(), [&](size_t start, size_t m, PackedVector3* packed) {
+              packVectors(Vector3Array<num_type>::borrow(arr->x + start, arr->y + start, arr->z + start, m), bounds, packed);
+            });
+          });
+        }
+        if (encoding != SnapshotSection::raw)
+          return false;
+        return addSection(name, section, [arr](std::ostream& out, const SnapshotSection& s) {
+          const num_type* lanes[3] = {arr->x, arr->y, arr->z};
+          for (int c = 0; c < 3; ++c)
+            writeLane(out, lanes[c], s);
+        });
+      }
+      // encoding is raw, packed_quaternion32 or packed_quaternion48. Packed
+      // sections keep only the rotation of each quaternion
+      template <typename num_type>
+      bool add(const std::string& name, const QuaternionArray<num_type>& quats, uint32_t encoding = SnapshotSection::raw) {
+        SnapshotSection section = makeSection<num_type>(name, SnapshotSection::quaternions, 4, quats.size());
+        const QuaternionArray<num_type>* arr = &quats;
+        auto pack = [arr](auto packed_type) {
+          typedef decltype(packed_type) Packed;
+          return [arr](std::ostream& out, const SnapshotSection&) {
+            writePacked<Packed>(out, arr->size(), [&](size_t start, size_t m, Packed* packed) {
+              packQuaternions(QuaternionArray<num_type>::borrow(arr->w + start, arr->x + start, arr->y + start, arr->z + start, m), packed);
+            });
+          };
+        };
+        if (encoding == SnapshotSection::packed_quaternion32) {
+          setPacked(section, encoding, sizeof(PackedQuaternion32));
+          return addSection(name, section, pack(PackedQuaternion32()));
+        }
+        if (encoding == SnapshotSection::packed_quaternion48) {
+          setPacked(section, encoding, sizeof(PackedQuaternion48));
+          return addSection(name, section, pack(PackedQuaternion48()));
+        }
+        if (encoding != SnapshotSection::raw)
+          return false;
+        return addSection(name, section, [arr](std::ostream& out, const SnapshotSection& s) {
+          const num_type* lanes[4] = {arr->w, arr->x, arr->y, arr->z};
+          for (int c = 0; c < 4; ++c)
+            writeLane(out, lanes[c], s);
+        });
+      }
+      // One lane per matrix entry, row by row
+      template <typename num_type>
+      bool add(const std::string& name, const RotationMatrix<num_type>* mats, size_t n) {
+        SnapshotSection section = makeSection<num_type>(name, SnapshotSection::rotation_matrices, 9, n);
+        return addSection(name, section, [mats](std::ostream& out, const SnapshotSection& s) {
+          std::vector<num_type> lane(s.count);
+          for (int c = 0; c < 9; ++c) {
+            for (size_t i = 0; i < s.count; ++i)
+              lane[i] = mats[i].matrix[c / 3][c % 3];
+            writeLane(out, lane.data(), s);
+          }
+        });
+      }
+
+      // Returns false if the file can't be written
+      bool write(const std::string& path) const {
+        std::ofstream out(path.c_str(), std::ios::binary);
+        if (not out)
+          return false;
+        SnapshotHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, "SNAPSHOT", 8);
+        header.version = SnapshotHeader::current_version;
+        header.byte_order = SnapshotHeader::byte_order_mark;
+        header.header_size = sizeof(SnapshotHeader);
+        header.section_size = sizeof(SnapshotSection);
+        header.section_count = sections.size();
+        std::vector<SnapshotSection> table(sections.size());
+        uint64_t offset = alignUp(sizeof(SnapshotHeader) + sections.size() * sizeof(SnapshotSection));
+        for (size_t i = 0; i < sections.size(); ++i) {
+          table[i] = sections[i].section;
+          table[i].offset = offset;
+          offset = alignUp(offset + table[i].size);
+        }
+        header.file_size = offset;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(table.data()), std::streamsize(table.size() * sizeof(SnapshotSection)));
+        for (size_t i = 0; i < sections.size(); ++i) {
+          pad(out, table[i].offset);
+          sections[i].write(out, table[i]);
+        }
+        pad(out, header.file_size);
+        return bool(out);
+      }
+
+    private :
+      struct Pending {
+        SnapshotSection section;
+        std::function<void(std::ostream&, const SnapshotSection&)> write;
+      };
+      std::vector<Pending> sections;
+
+      static uint64_t alignUp(uint64_t n) {
+        return (n + 63) & ~uint64_t(63);
+      }
+      static void pad(std::ostream& out, uint64_t to) {
+        static const char zeros[64] = {};
+        uint64_t at = uint64_t(out.tellp());
+        while (at < to) {
+          uint64_t m = to - at < 64 ? to - at : 64;
+          out.write(zeros, std::streamsize(m));
+          at += m;
+        }
+      }
+
+      template <typename num_type>
+      static SnapshotSection makeSection(const std::string& name, uint32_t kind, uint32_t components, size_t n) {
+        static_assert(std::is_same<num_type, float>::value or std::is_same<num_type, double>::value,
+                      "snapshots store float or double");
+        SnapshotSection section;
+        memset(&section, 0, sizeof(section));
+        memcpy(section.name, name.c_str(), name.size() < SnapshotSection::max_name_length ? name.size() : SnapshotSection::max_name_length);
+        section.kind = kind;
+        section.number = SnapshotNumber<num_type>::value;
+        section.encoding = SnapshotSection::raw;
+        section.components = components;
+        section.count = n;
+        section.lane_stride = alignUp(n * sizeof(num_type));
+        section.size = components * section.lane_stride;
+        return section;
+      }
+      static void setPacked(SnapshotSection& section, uint32_t encoding, size_t packed_size) {
+        section.encoding = encoding;
+        section.lane_stride = 0;
+        section.size = section.count * packed_size;
+      }
+      template <class Write>
+      bool addSection(const std::string& name, const SnapshotSection& section, Write write) {
+        if (name.size() > SnapshotSection::max_name_length)
+          return false;
+        for (const Pending& p : sections)
+          if (name == p.section.name)
+            return false;
+        sections.push_back(Pending{section, write});
+        return true;
+      }
+      // One lane, padded to lane_stride
+      template <typename num_type>
+      static void writeLane(std::ostream& out, const num_type* lane, const SnapshotSection& s) {
+        uint64_t end = uint64_t(out.tellp()) + s.lane_stride;
+        out.write(reinterpret_cast<const char*>(lane), std::streamsize(s.count * sizeof(num_type)));
+        pad(out, end);
+      }
+      // Encodes n elements in chunks with encode(start, m, packed)
+      template <class Packed, class Encode>
+      static void writePacked(std::ostream& out, size_t n, Encode encode) {
+        const size_t chunk = 4096;
+        std::vector<Packed> packed(n < chunk ? n : chunk);
+        for (size_t start = 0; start < n; start += chunk) {
+          size_t m = n - start < chunk ? n - start : chunk;
+          encode(start, m, packed.data());
+          out.write(reinterpret_cast<const char*>(packed.data()), std::streamsize(m * sizeof(Packed)));
+        }
+      }
+  };
+
+  // Read-only memory map of a snapshot file. open() checks the header and that
+  // every section lies within the file. Views point into the map and stay valid
+  // until close() or destruction
+  class Snapshot {
+    public :
+      Snapshot() : data(nullptr), file_size(0) {}
+      ~Snapshot() {
+        close();
+      }
+      Snapshot(const Snapshot&) = delete;
+      Snapshot& operator=(const Snapshot&) = delete;
+
+      // Returns false if the file can't be mapped, or isn't a snapshot of this
+      // version and byte order
+      bool open(const std::string& path) {
+        close();
+        if (not map(path))
+          return false;
+        if (not valid()) {
+          close();
+          return false;
+        }
+        return true;
+      }
+      void close() {
+        if (data != nullptr)
+          unmap();
+        data = nullptr;
+        file_size = 0;
+      }
+      bool isOpen() const {
+        return data != nullptr;
+      }
+
+      size_t sectionCount() const {
+        return data == nullptr ? 0 : size_t(header().section_count);
+      }
+      const SnapshotSection& section(size_t i) const {
+        return table()[i];
+      }
+      const SnapshotSection* find(const std::string& name) const {
+        for (size_t i = 0; i < sectionCount(); ++i)
+          if (strncmp(table()[i].name, name.c_str(), SnapshotSection::max_name_length + 1) == 0)
+            return &table()[i];
+        return nullptr;
+      }
+
+      // Zero-copy access to raw sections stored as num_type: lane c of a section,
+      // or nullptr if there is no such raw section
+      template <typename num_type>
+      const num_type* lane(const std::string& name, uint32_t c) const {
+        const SnapshotSection* s = find(name);
+        if (s == nullptr or s->encoding != SnapshotSection::raw or s->number != SnapshotNumber<num_type>::value or c >= s->components)
+          return nullptr;
+        return reinterpret_cast<const num_type*>(data + s->offset + c * s->lane_stride);
+      }
+      // Arrays borrowing the mapped lanes; empty if the section is missing, packed,
+      // of another kind or stored with another precision. The mapping is
+      // copy-on-write: writes through a view, e.g. a kernel run in place, never
+      // reach the file but are seen by later views until the snapshot is closed
+      template <typename num_type>
+      const Vector3Array<num_type> vectors(const std::string& name) const {
+        const SnapshotSection* s = find(name);
+        if (s == nullptr or s->kind != SnapshotSection::vectors or lane<num_type>(name, 0) == nullptr)
+          return Vector3Array<num_type>();
+        return Vector3Array<num_type>::borrow(lane<num_type>(name, 0), lane<num_type>(name, 1), lane<num_type>(name, 2), size_t(s->count));
+      }
+      template <typename num_type>
+      const QuaternionArray<num_type> quaternions(const std::string& name) const {
+        const SnapshotSection* s = find(name);
+        if (s == nullptr or s->kind != SnapshotSection::quaternions or lane<num_type>(name, 0) == nullptr)
+          return QuaternionArray<num_type>();
+        return QuaternionArray<num_type>::borrow(lane<num_type>(name, 0), lane<num_type>(name, 1), lane<num_type>(name, 2),
+                                                 lane<num_type>(name, 3), size_t(s->count));
+      }
+
+      // Copies into owned storage, converting the precision and decoding packed
+      // sections. Returns false if the section is missing or of another kind
+      template <typename num_type>
+      bool load(const std::string& name, std::vector<num_type>& out) const {
+        const SnapshotSection* s = find(name);
+        if (s == nullptr or s->kind != SnapshotSection::scalars)
+          return false;
+        out.resize(size_t(s->count));
+        copyLane(*s, 0, out.data());
+        return true;
+      }
+      template <typename num_type>
+      bool load(const std::string& name, Vector3Array<num_type>& out) const {
+        const SnapshotSection* s = find(name);
+        if (s == nullptr or s->kind != SnapshotSection::vectors)
+          return false;
+        if (s->encoding == SnapshotSection::packed_vector3) {
+          AABB<num_type> bounds(Vector3<num_type>(num_type(s->bounds[0]), num_type(s->bounds[1]), num_type(s->bounds[2])),
+                                Vector3<num_type>(num_type(s->bounds[3]), num_type(s->bounds[4]), num_type(s->bounds[5])));
+          unpackVectors(reinterpret_cast<const PackedVector3*>(data + s->offset), size_t(s->count), bounds, out);
+          return true;
+        }
+        out.resize(size_t(s->count));
+        num_type* lanes[3] = {out.x, out.y, out.z};
+        for (uint32_t c = 0; c < 3; ++c)
+          copyLane(*s, c, lanes[c]);
+        return true;
+      }
+      template <typename num_type>
+      bool load(const std::string& name, QuaternionArray<num_type>& out) const {
+        const SnapshotSection* s = find(name);
+        if (s == nullptr or s->kind != SnapshotSection::quaternions)
+          return false;
+        if (s->encoding == SnapshotSection::packed_quaternion32) {
+          unpackQuaternions(reinterpret_cast<const PackedQuaternion32*>(data + s->offset), size_t(s->count), out);
+          return true;
+        }
+        if (s->encoding == SnapshotSection::packed_quaternion48) {
+          unpackQuaternions(reinterpret_cast<const PackedQuaternion48*>(data + s->offset), size_t(s->count), out);
+          return true;
+        }
+        out.resize(size_t(s->count));
+        num_type* lanes[4] = {out.w, out.x, out.y, out.z};
+        for (uint32_t c = 0; c < 4; ++c)
+          copyLane(*s, c, lanes[c]);
+        return true;
+      }
+      template <typename num_type>
+      bool load(const std::string& name, std::vector<RotationMatrix<num_type>>& out) const {
+        const SnapshotSection* s = find(name);
+        if (s == nullptr or s->kind != SnapshotSection::rotation_matrices)
+          return false;
+        out.resize(size_t(s->count));
+        std::vector<num_type> lane(size_t(s->count));
+        for (uint32_t c = 0; c < 9; ++c) {
+          copyLane(*s, c, lane.data());
+          for (size_t i = 0; i < lane.size(); ++i)
+            out[i].matrix[c / 3][c % 3] = lane[i];
+        }
+        return true;
+      }
+
+    private :
+      const char* data;
+      size_t file_size;
+      #if defined(_WIN32)
+        HANDLE file_handle;
+        HANDLE mapping_handle;
+      #endif
+
+      const SnapshotHeader& header() const {
+        return *reinterpret_cast<const SnapshotHeader*>(data);
+      }
+      const SnapshotSection* table() const {
+        return reinterpret_cast<const SnapshotSection*>(data + sizeof(SnapshotHeader));
+      }
+
+      bool valid() const {
+        if (file_size < sizeof(SnapshotHeader))
+          return false;
+        const SnapshotHeader& h = header();
+        if (not SnapshotHeader::validMagic(h.magic) or h.version != SnapshotHeader::current_version or
+            h.byte_order != SnapshotHeader::byte_order_mark or h.header_size != sizeof(SnapshotHeader) or
+            h.section_size != sizeof(SnapshotSection) or h.file_size != file_size or
+            h.section_count > (file_size - sizeof(SnapshotHeader)) / sizeof(SnapshotSection))
+          return false;
+        for (size_t i = 0; i < size_t(h.section_count); ++i) {
+          const SnapshotSection& s = table()[i];
+          if (s.name[SnapshotSection::max_name_length] != 0 or s.kind > SnapshotSection::rotation_matrices or
+              s.number > SnapshotSection::float64 or s.offset % 64 != 0 or s.offset > file_size or s.size > file_size - s.offset)
+            return false;
+          const uint32_t components[4] = {1, 3, 4, 9};
+          if (s.components != components[s.kind])
+            return false;
+          // Divided rather than multiplied, so huge fields can't wrap around
+          uint64_t element_size = 0;
+          if (s.encoding == SnapshotSection::raw) {
+            if (s.lane_stride % 64 != 0 or s.lane_stride > s.size / s.components)
+              return false;
+            element_size = s.precision();
+            if (s.count > s.lane_stride / element_size)
+              return false;
+          }
+          else if (s.encoding == SnapshotSection::packed_vector3 and s.kind == SnapshotSection::vectors)
+            element_size = sizeof(PackedVector3);
+          else if (s.encoding == SnapshotSection::packed_quaternion32 and s.kind == SnapshotSection::quaternions)
+            element_size = sizeof(PackedQuaternion32);
+          else if (s.encoding == SnapshotSection::packed_quaternion48 and s.kind == SnapshotSection::quaternions)
+            element_size = sizeof(PackedQuaternion48);
+          else
+            return false;
+          if (s.count > s.size / element_size)
+            return false;
+        }
+        return true;
+      }
+
+      // Lane c of a raw section converted to num_type
+      template <typename num_type>
+      void copyLane(const SnapshotSection& s, uint32_t c, num_type* out) const {
+        const char* lane = data + s.offset + c * s.lane_stride;
+        size_t n = size_t(s.count);
+        if (s.number == SnapshotNumber<num_type>::value)
+          memcpy(out, lane, n * sizeof(num_type));
+        else if (s.number == SnapshotSection::float32)
+          for (size_t i = 0; i < n; ++i)
+            out[i] = num_type(reinterpret_cast<const float*>(lane)[i]);
+        else
+          for (size_t i = 0; i < n; ++i)
+            out[i] = num_type(reinterpret_cast<const double*>(lane)[i]);
+      }
+
+      #if defined(_WIN32)
+        bool map(const std::string& path) {
+          file_handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+          if (file_handle == INVALID_HANDLE_VALUE)
+            return false;
+          LARGE_INTEGER size;
+          if (not GetFileSizeEx(file_handle, &size) or size.QuadPart == 0) {
+            CloseHandle(file_handle);
+            return false;
+          }
+          mapping_handle = CreateFileMappingA(file_handle, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+          if (mapping_handle == nullptr) {
+            CloseHandle(file_handle);
+            return false;
+          }
+          data = static_cast<const char*>(MapViewOfFile(mapping_handle, FILE_MAP_COPY, 0, 0, 0));
+          if (data == nullptr) {
+            CloseHandle(mapping_handle);
+            CloseHandle(file_handle);
+            return false;
+          }
+          file_size = size_t(size.QuadPart);
+          return true;
+        }
+        void unmap() {
+          UnmapViewOfFile(data);
+          CloseHandle(mapping_handle);
+          CloseHandle(file_handle);
+        }
+      #else
+        bool map(const std::string& path) {
+          int fd = ::open(path.c_str(), O_RDONLY);
+          if (fd < 0)
+            return false;
+          struct stat st;
+          if (fstat(fd, &st) != 0 or st.st_size == 0) {
+            ::close(fd);
+            return false;
+          }
+          // Copy-on-write, so kernels run in place on the views write to private pages
+          void* p = mmap(nullptr, size_t(st.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+          // The mapping keeps the file open
+          ::close(fd);
+          if (p == MAP_FAILED)
+            return false;
+          data = static_cast<const char*>(p);
+          file_size = size_t(st.st_size);
+          return true;
+        }
+        void unmap() {
+          munmap(const_cast<char*>(data), file_size);
+        }
+      #endif
+  };
+
+#endif
@@ -0,0 +1,310 @@
+#if !defined(TRANSFORM_HIERARCHY_H_INCLUDED)
+  #define TRANSFORM_HIERARCHY_H_INCLUDED
+
+  #include <atomic>
+  #include <stdint.h>
+  #include <string.h>
+  #include <vector>
+  #include "../math/transform.h"
+  #include "../core/parallel.h"
+
+  // Rotation, translation and uniform scale. Composes exactly, unlike a
+  // non-uniform scale under rotation, so world poses never need a matrix
+  template <typename num_type = float>
+  class Pose {
+    public :
+      QuaternionRotator<num_type> rotation;
+      Vector3<num_type> position;
+      num_type scale;
+
+      Pose() : scale(1) {}
+      Pose(const QuaternionRotator<num_type>& rot, const Vector3<num_type>& pos, num_type s = 1)
+        : rotation(rot), position(pos), scale(s) {}
+
+      // child is expressed in this pose's frame
+      Pose<num_type> compose(const Pose<num_type>& child) const {
+        return Pose<num_type>(child.rotation.compose(rotation), position + rotation * (child.position * scale),
+                              scale * child.scale);
+      }
+      Vector3<num_type> transformPoint(const Vector3<num_type>& p) const {
+        return position + rotation * (p * scale);
+      }
+      Matrix4x4<num_type> toMatrix() const {
+        return Matrix4x4<num_type>(rotation, position, Vector3<num_type>(scale, scale, scale));
+      }
+  };
+
+  // Scene graph of Poses stored flat in depth order, so every parent precedes its
+  // children and each depth level is one contiguous range. setLocal only marks a
+  // node dirty; update() then walks the levels once, recomputing the world pose
+  // of dirty nodes and of children whose parent was recomputed on this pass.
+  // Levels with nothing to do are skipped, and large levels are split across
+  // threads since nodes on one level never depend on each other.
+  //
+  // Nodes are addressed by stable handles. Structural changes (create, destroy,
+  // setParent) reorder the flat arrays at the next update
+  template <typename num_type = float>
+  class TransformHierarchy {
+    public :
+      typedef uint32_t Node;
+      static constexpr Node none = 0xFFFFFFFF;
+      // Smallest share of a level worth giving to another thread
+      static constexpr size_t min_chunk = 2048;
+
+      TransformHierarchy() : reorder(false), recomputed(0) {}
+
+      Node create(const Pose<num_type>& local = Pose<num_type>(), Node parent = none) {
+        Node node;
+        if (free_nodes.empty()) {
+          node = Node(node_slot.size());
+          node_slot.push_back(none);
+        }
+        else {
+          node = free_nodes.back();
+          free_nodes.pop_back();
+        }
+        node_slot[node] = Node(slot_node.size());
+        slot_node.push_back(node);
+        slot_parent.push_back(parent);
+        slot_depth.push_back(0);
+        local_pose.push_back(local);
+        world_pose.push_back(local);
+        dirty.push_back(1);
+        reorder = true;
+        return node;
+      }
+      // Removes node and all of its descendants
+      void destroy(Node node) {
+        if (not valid(node))
+          return;
+        Node slot = node_slot[node];
+        slot_node[slot] = none;
+        node_slot[node] = none;
+        // Handles are recycled after the reorder, once no slot can still name this one as parent
+        dead_nodes.push_back(node);
+        reorder = true;
+      }
+      // Returns false, changing nothing, if parent is node itself or one of its descendants
+      bool setParent(Node node, Node parent) {
+        if (not valid(node) or (parent != none and not valid(parent)))
+          return false;
+        for (Node p = parent; p != none; p = slot_parent[node_slot[p]])
+          if (p == node)
+            return false;
+        Node slot = node_slot[node];
+        slot_parent[slot] = parent;
+        dirty[slot] = 1;
+        reorder = true;
+        return true;
+      }
+
+      // A node is valid until it or one of its ancestors is destroyed
+      bool valid(Node node) const {
+        while (node != none) {
+          if (node >= node_slot.size() or node_slot[node] == none)
+            return false;
+          node = slot_parent[node_slot[node]];
+        }
+        return true;
+      }
+      Node parent(Node node) const {
+        return slot_parent[node_slot[node]];
+      }
+      const Pose<num_type>& local(Node node) const {
+        return local_pose[node_slot[node]];
+      }
+      void setLocal(Node node, const Pose<num_type>& pose) {
+        Node slot = node_slot[node];
+        local_pose[slot] = pose;
+        dirty[slot] = 1;
+        if (not reorder)
+          level_dirty[slot_depth[slot]] = 1;
+      }
+      // As of the last update
+      const Pose<num_type>& world(Node node) const {
+        return world_pose[node_slot[node]];
+      }
+      Matrix4x4<num_type> worldMatrix(Node node) const {
+        return world(node).toMatrix();
+      }
+
+      // Live node count after the last update
+      size_t size() const {
+        return slot_node.size();
+      }
+      size_t levels() const {
+        return level_start.empty() ? 0 : level_start.size() - 1;
+      }
+      // Nodes whose world pose the last update recomputed
+      size_t lastRecomputed() const {
+        return recomputed;
+      }
+
+      // Brings every world pose up to date and returns how many were recomputed
+      size_t update(unsigned threads = 1) {
+        if (reorder)
+          rebuild();
+        recomputed = 0;
+        size_t prev_begin = 0, prev_end = 0;
+        bool prev_changed = false;
+        for (size_t l = 0; l + 1 < level_start.size(); ++l) {
+          size_t begin = level_start[l], end = level_start[l + 1];
+          size_t changed = 0;
+          if (level_dirty[l] or prev_changed) {
+            std::atomic<size_t> count(0);
+            parallelChunks(end - begin, threads, min_chunk, [&](size_t b, size_t e) {
+              size_t c = updateRange(begin + b, begin + e);
+              count += c;
+            });
+            changed = count;
+            level_dirty[l] = 0;
+          }
+          // Children have read the previous level's flags, so they can be cleared
+          if (prev_changed)
+            memset(&dirty[prev_begin], 0, prev_end - prev_begin);
+          prev_begin = begin;
+          prev_end = end;
+          prev_changed = changed != 0;
+          recomputed += changed;
+        }
+        if (prev_changed)
+          memset(&dirty[prev_begin], 0, prev_end - prev_begin);
+        return recomputed;
+      }
+
+    private :
+      // Per node handle
+      std::vector<Node> node_slot;
+      std::vector<Node> free_nodes;
+      std::vector<Node> dead_nodes;
+      // Per slot, in depth order after a rebuild. Parents are handles until the
+      // rebuild turns them into slot indices in slot_parent_slot
+      std::vector<Node> slot_node;
+      std::vector<Node> slot_parent;
+      std::vector<Node> slot_parent_slot;
+      std::vector<uint32_t> slot_depth;
+      std::vector<Pose<num_type>> local_pose;
+      std::vector<Pose<num_type>> world_pose;
+      std::vector<uint8_t> dirty;
+      // level_start[l] is the first slot at depth l, with a final entry for the end
+      std::vector<size_t> level_start;
+      std::vector<uint8_t> level_dirty;
+      bool reorder;
+      size_t recomputed;
+
+      size_t updateRange(size_t begin, size_t end) {
+        size_t count = 0;
+        for (size_t i = begin; i < end; ++i) {
+          Node p = slot_parent_slot[i];
+          if (p == none) {
+            if (dirty[i]) {
+              world_pose[i] = local_pose[i];
+              ++count;
+            }
+          }
+          else if (dirty[i] or dirty[p]) {
+            world_pose[i] = world_pose[p].compose(local_pose[i]);
+            dirty[i] = 1;
+            ++count;
+          }
+        }
+        return count;
+      }
+
+      // Drops destroyed subtrees and stably sorts the remaining slots by depth
+      void rebuild() {
+        size_t n = slot_node.size();
+        const uint32_t unknown = 0xFFFFFFFF, dead = 0xFFFFFFFE;
+        std::vector<uint32_t> depth(n, unknown);
+        std::vector<Node> chain;
+        uint32_t max_depth = 0;
+        for (size_t i = 0; i < n; ++i) {
+          if (depth[i] != unknown)
+            continue;
+          // Walk up to a slot whose depth is known or implied, then fill the chain back in
+          size_t s = i;
+          uint32_t d;
+          for (;;) {
+            chain.push_back(Node(s));
+            if (slot_node[s] == none) {
+              d = dead;
+              break;
+            }
+            Node p = slot_parent[s];
+            if (p == none) {
+              d = 0;
+              break;
+            }
+            Node ps = node_slot[p];
+            if (ps == none) {
+              d = dead;
+              break;
+            }
+            if (depth[ps] != unknown) {
+              d = depth[ps] == dead ? dead : depth[ps] + 1;
+              break;
+            }
+            s = ps;
+          }
+          for (size_t k = chain.size(); k-- > 0;) {
+            depth[chain[k]] = d;
+            if (d != dead)
+              ++d;
+          }
+          chain.clear();
+        }
+        for (size_t i = 0; i < n; ++i)
+          if (depth[i] != dead and depth[i] > max_depth)
+            max_depth = depth[i];
+
+        // Counting sort, stable so siblings keep their creation order
+        level_start.assign(max_depth + 2, 0);
+        for (size_t i = 0; i < n; ++i)
+          if (depth[i] != dead)
+            ++level_start[depth[i] + 1];
+        for (size_t l = 1; l < level_start.size(); ++l)
+          level_start[l] += level_start[l - 1];
+        size_t live = level_start.back();
+        std::vector<size_t> next(level_start.begin(), level_start.end() - 1);
+        std::vector<Node> new_node(live), new_parent(live);
+        std::vector<uint32_t> new_depth(live);
+        std::vector<Pose<num_type>> new_local(live), new_world(live);
+        std::vector<uint8_t> new_dirty(live);
+        for (size_t i = 0; i < n; ++i) {
+          if (depth[i] == dead) {
+            if (slot_node[i] != none) {
+              dead_nodes.push_back(slot_node[i]);
+              node_slot[slot_node[i]] = none;
+            }
+            continue;
+          }
+          size_t j = next[depth[i]]++;
+          new_node[j] = slot_node[i];
+          new_parent[j] = slot_parent[i];
+          new_depth[j] = depth[i];
+          new_local[j] = local_pose[i];
+          new_world[j] = world_pose[i];
+          new_dirty[j] = dirty[i];
+        }
+        slot_node.swap(new_node);
+        slot_parent.swap(new_parent);
+        slot_depth.swap(new_depth);
+        local_pose.swap(new_local);
+        world_pose.swap(new_world);
+        dirty.swap(new_dirty);
+        slot_parent_slot.resize(live);
+        for (size_t j = 0; j < live; ++j)
+          node_slot[slot_node[j]] = Node(j);
+        for (size_t j = 0; j < live; ++j)
+          slot_parent_slot[j] = slot_parent[j] == none ? none : node_slot[slot_parent[j]];
+        level_dirty.assign(max_depth + 1, 0);
+        for (size_t j = 0; j < live; ++j)
+          if (dirty[j])
+            level_dirty[slot_depth[j]] = 1;
+        free_nodes.insert(free_nodes.end(), dead_nodes.begin(), dead_nodes.end());
+        dead_nodes.clear();
+        reorder = false;
+      }
+  };
+
+#endif